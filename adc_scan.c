@@ -0,0 +1,179 @@
+/**
+* \file  adc_scan.c
+*
+* \brief Multi-channel ADC scan of one wakeup
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <string.h>
+#include "adc_scan.h"
+#include "adc_window.h"
+
+/******************************** MACROS ***************************************/
+#define ADC_SCAN_MAX_CODE                   4095u
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t adc_scan_code_to_mv(uint16_t code, uint16_t vrefMv)
+{
+    return ((uint32_t)code * vrefMv + ADC_SCAN_MAX_CODE / 2u) / ADC_SCAN_MAX_CODE;
+}
+
+/* Splits a value in 1/10 into sign, whole and decimal parts for printing */
+static const char *adc_scan_split_deci(int32_t deci, unsigned long *whole, unsigned long *frac)
+{
+    uint32_t magnitude = (deci < 0) ? (uint32_t)(-deci) : (uint32_t)deci;
+
+    *whole = magnitude / 10u;
+    *frac = magnitude % 10u;
+    return (deci < 0) ? "-" : "";
+}
+
+/*********************************************************************//**
+\brief      Builds the sequencer setup of a set of inputs
+\param[in]  inputs - MUXPOS of every AdcScanSignal_t, ADC_SCAN_INPUT_NONE
+                     for a signal that is not fitted
+\param[out] plan   - SEQCTRL value and conversion order
+\return     false if an input is out of range or used twice
+*************************************************************************/
+bool ADC_SCAN_Plan(const uint8_t *inputs, AdcScanPlan_t *plan)
+{
+    memset(plan, 0, sizeof(*plan));
+
+    for (uint8_t signal = 0; signal < ADC_SCAN_SIGNAL_COUNT; signal++)
+    {
+        if (ADC_SCAN_INPUT_NONE == inputs[signal])
+        {
+            continue;
+        }
+        if ((inputs[signal] >= ADC_SCAN_SEQ_INPUTS) || (plan->seqMask & (1uL << inputs[signal])))
+        {
+            return false;
+        }
+        plan->seqMask |= 1uL << inputs[signal];
+    }
+
+    /* The sequencer walks the mask from the lowest MUXPOS up */
+    for (uint8_t input = 0; input < ADC_SCAN_SEQ_INPUTS; input++)
+    {
+        if (!(plan->seqMask & (1uL << input)))
+        {
+            continue;
+        }
+        for (uint8_t signal = 0; signal < ADC_SCAN_SIGNAL_COUNT; signal++)
+        {
+            if (inputs[signal] == input)
+            {
+                plan->order[plan->count++] = signal;
+            }
+        }
+    }
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Models the time the ADC is active for a scan
+\param[in]  timing      - ADC clock and conversion setup
+\param[in]  conversions - number of inputs in the scan
+\return     active time in us, the start-up included
+*************************************************************************/
+uint32_t ADC_SCAN_ActiveTimeUs(const AdcScanTiming_t *timing, uint8_t conversions)
+{
+    uint32_t cycles = (uint32_t)timing->sampleLength + 1u + timing->resolutionBits;
+
+    if (0 == timing->adcClockHz)
+    {
+        return 0;
+    }
+    return timing->startupUs +
+           (uint32_t)(((uint64_t)cycles * conversions * 1000000u + timing->adcClockHz - 1u) / timing->adcClockHz);
+}
+
+/*********************************************************************//**
+\brief      Converts the raw codes of a scan
+\param[in]  plan   - plan the scan ran with
+\param[in]  codes  - results in sequencer order
+\param[in]  cal    - reference, divider and temperature calibration
+\param[out] result - converted signals
+*************************************************************************/
+void ADC_SCAN_Convert(const AdcScanPlan_t *plan, const uint16_t *codes, const AdcScanCal_t *cal,
+                      AdcScanResult_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    for (uint8_t i = 0; i < plan->count; i++)
+    {
+        uint8_t signal = plan->order[i];
+
+        result->raw[signal] = codes[i];
+        result->validMask |= (uint8_t)(1u << signal);
+
+        if (signal <= ADC_SCAN_ACC_Z)
+        {
+            result->acc[signal - ADC_SCAN_ACC_X] = ACC_CODE_TO_VALUE(codes[i]);
+        }
+        else if (ADC_SCAN_VBAT == signal)
+        {
+            result->vbatMv = (uint16_t)(adc_scan_code_to_mv(codes[i], cal->vrefMv) * cal->vbatDivider);
+        }
+        else if ((ADC_SCAN_TEMP == signal) && (cal->hotMv != cal->roomMv))
+        {
+            int32_t mv = (int32_t)adc_scan_code_to_mv(codes[i], cal->vrefMv);
+
+            result->tempDeci = (int16_t)(cal->roomTempDeci +
+                               ((mv - cal->roomMv) * (cal->hotTempDeci - cal->roomTempDeci)) /
+                               ((int32_t)cal->hotMv - cal->roomMv));
+        }
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the largest accelerometer value of the scan
+*************************************************************************/
+float ADC_SCAN_AccPeak(const AdcScanResult_t *result)
+{
+    float peak = 0.0f;
+
+    for (uint8_t axis = 0; axis < ADC_SCAN_ACC_AXES; axis++)
+    {
+        if ((result->validMask & (1u << (ADC_SCAN_ACC_X + axis))) && (result->acc[axis] > peak))
+        {
+            peak = result->acc[axis];
+        }
+    }
+    return peak;
+}
+
+/*********************************************************************//**
+\brief      Formats the uplink reading of a scan
+\param[in]  result - converted scan
+\param[out] str    - "<peak>C[ <vbat>mV][ <temp>T]\n", one decimal
+\param[in]  size   - size of str
+\return     length of the string, as snprintf()
+*************************************************************************/
+int ADC_SCAN_FormatPayload(const AdcScanResult_t *result, char *str, size_t size)
+{
+    float peak = ADC_SCAN_AccPeak(result);
+    int32_t peakDeci = (int32_t)(peak * 10.0f + 0.5f);
+    char vbat[10] = "";
+    char temp[12] = "";
+    unsigned long whole;
+    unsigned long frac;
+    const char *sign;
+
+    if (result->validMask & (1u << ADC_SCAN_VBAT))
+    {
+        snprintf(vbat, sizeof(vbat), " %umV", result->vbatMv);
+    }
+    if (result->validMask & (1u << ADC_SCAN_TEMP))
+    {
+        sign = adc_scan_split_deci(result->tempDeci, &whole, &frac);
+        snprintf(temp, sizeof(temp), " %s%lu.%luT", sign, whole, frac);
+    }
+
+    /* Integer formatting, the float printf support is not needed */
+    sign = adc_scan_split_deci(peakDeci, &whole, &frac);
+    return snprintf(str, size, "%s%lu.%luC%s%s\n", sign, whole, frac, vbat, temp);
+}
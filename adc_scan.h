@@ -0,0 +1,97 @@
+/**
+* \file  adc_scan.h
+*
+* \brief Multi-channel ADC scan of one wakeup
+*
+* The inputs of the scan (accelerometer axes, VBAT divider, internal
+* temperature sensor) are converted back to back by the ADC input
+* sequencer, one bit per MUXPOS value in SEQCTRL, and moved to RAM by
+* the DMA. The sequencer converts in ascending MUXPOS order; the plan
+* records which signal every conversion belongs to.
+* Planning, timing model, conversion and payload formatting do not touch
+* the hardware and also build on a host.
+*/
+
+#ifndef ADC_SCAN_H_
+#define ADC_SCAN_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/****************************** MACROS **************************************/
+/* Input of a signal that is not fitted */
+#define ADC_SCAN_INPUT_NONE                 0xFFu
+/* Number of MUXPOS values the sequencer can select */
+#define ADC_SCAN_SEQ_INPUTS                 32u
+
+#define ADC_SCAN_ACC_AXES                   3u
+
+/****************************** TYPES **************************************/
+typedef enum _AdcScanSignal_t
+{
+    ADC_SCAN_ACC_X = 0,
+    ADC_SCAN_ACC_Y,
+    ADC_SCAN_ACC_Z,
+    ADC_SCAN_VBAT,
+    ADC_SCAN_TEMP,
+    ADC_SCAN_SIGNAL_COUNT
+} AdcScanSignal_t;
+
+typedef struct _AdcScanPlan_t
+{
+    /* Value of the SEQCTRL register */
+    uint32_t seqMask;
+    uint8_t count;
+    /* Signal of every conversion, in sequencer order */
+    uint8_t order[ADC_SCAN_SIGNAL_COUNT];
+} AdcScanPlan_t;
+
+typedef struct _AdcScanTiming_t
+{
+    /* ADC clock after the prescaler */
+    uint32_t adcClockHz;
+    /* SAMPLEN, the sampling lasts sampleLength + 1 cycles */
+    uint8_t sampleLength;
+    uint8_t resolutionBits;
+    /* Enabling the ADC and starting the DMA, once per scan */
+    uint16_t startupUs;
+} AdcScanTiming_t;
+
+typedef struct _AdcScanCal_t
+{
+    /* Reference voltage of the conversions */
+    uint16_t vrefMv;
+    /* VBAT = divider ratio x input voltage */
+    uint8_t vbatDivider;
+    /* Two point calibration of the temperature sensor */
+    int16_t roomTempDeci;
+    int16_t hotTempDeci;
+    uint16_t roomMv;
+    uint16_t hotMv;
+} AdcScanCal_t;
+
+typedef struct _AdcScanResult_t
+{
+    /* Bit per AdcScanSignal_t converted in this scan */
+    uint8_t validMask;
+    uint16_t raw[ADC_SCAN_SIGNAL_COUNT];
+    float acc[ADC_SCAN_ACC_AXES];
+    uint16_t vbatMv;
+    /* Temperature in 1/10 degree C */
+    int16_t tempDeci;
+} AdcScanResult_t;
+
+/****************************** PROTOTYPES **************************************/
+bool ADC_SCAN_Plan(const uint8_t *inputs, AdcScanPlan_t *plan);
+uint32_t ADC_SCAN_ActiveTimeUs(const AdcScanTiming_t *timing, uint8_t conversions);
+void ADC_SCAN_Convert(const AdcScanPlan_t *plan, const uint16_t *codes, const AdcScanCal_t *cal,
+                      AdcScanResult_t *result);
+float ADC_SCAN_AccPeak(const AdcScanResult_t *result);
+int ADC_SCAN_FormatPayload(const AdcScanResult_t *result, char *str, size_t size);
+
+/* Implemented by the ADC setup of the application (main.c) */
+bool adc_scan_run(AdcScanResult_t *result);
+
+#endif /* ADC_SCAN_H_ */
@@ -0,0 +1,104 @@
+/**
+* \file  adc_window.c
+*
+* \brief ADC window monitor wake planning
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "adc_window.h"
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Translates an accelerometer threshold into a window limit
+\param[in]  threshold - alarm threshold in the unit of ACC_CODE_TO_VALUE()
+\return     Largest raw code whose value does not exceed the threshold, so
+            that "raw > limit" gives the same answer as "value > threshold"
+*************************************************************************/
+uint16_t ADC_WINDOW_ThresholdToCode(float threshold)
+{
+    int32_t code;
+
+    if (threshold < ACC_CODE_TO_VALUE(0))
+    {
+        return 0;
+    }
+    if (threshold >= ACC_CODE_TO_VALUE(ACC_ADC_MAX_CODE))
+    {
+        return ACC_ADC_MAX_CODE;
+    }
+
+    code = (int32_t)((threshold * (float)ACC_ADC_MAX_CODE) / ACC_ADC_FULL_SCALE);
+
+    /* Settle float rounding against the exact conversion used at runtime */
+    while ((code < (int32_t)ACC_ADC_MAX_CODE) && !(ACC_CODE_TO_VALUE(code + 1) > threshold))
+    {
+        code++;
+    }
+    while ((code > 0) && (ACC_CODE_TO_VALUE(code) > threshold))
+    {
+        code--;
+    }
+
+    return (uint16_t)code;
+}
+
+/*********************************************************************//**
+\brief      Selects the RTC periodic event starting the conversions
+\param[in]  periodMs - longest time allowed between two conversions
+\param[in]  rtcHz    - RTC counter clock
+\return     n of the slowest event PERn not slower than periodMs, 0 if
+            even PER0 is
+*************************************************************************/
+uint8_t ADC_WINDOW_RtcEvent(uint32_t periodMs, uint32_t rtcHz)
+{
+    uint8_t event = 0;
+
+    /* PERn ticks every 2^(n+3) RTC cycles */
+    while (((event + 1u) < ADC_WINDOW_RTC_EVENTS) &&
+           (((uint64_t)8u << (event + 1u)) * 1000u <= (uint64_t)periodMs * rtcHz))
+    {
+        event++;
+    }
+
+    return event;
+}
+
+/*********************************************************************//**
+\brief      Selects the wake mode and the sleep schedule
+\param[in]  requested      - mode asked for by the configuration
+\param[in]  threshold      - alarm threshold in the unit of ACC_CODE_TO_VALUE()
+\param[in]  samplePeriodMs - sample period of the polling mode
+\param[in]  statusPeriods  - sample periods between two status reports
+\param[in]  rtcHz          - RTC counter clock, for the conversion rate
+\param[out] plan           - resulting wake plan
+\return     The mode that was selected
+*************************************************************************/
+AdcWakeMode_t ADC_WINDOW_Plan(AdcWakeMode_t requested, float threshold, uint32_t samplePeriodMs,
+                              uint8_t statusPeriods, uint32_t rtcHz, AdcWakePlan_t *plan)
+{
+    if (0 == statusPeriods)
+    {
+        statusPeriods = 1;
+    }
+
+    plan->windowLimit = ADC_WINDOW_ThresholdToCode(threshold);
+    plan->rtcEvent = ADC_WINDOW_RtcEvent(samplePeriodMs, rtcHz);
+
+    /* A negative threshold means every reading alarms, which only polling can follow */
+    if ((ADC_WAKE_MODE_WINDOW == requested) && (threshold >= ACC_CODE_TO_VALUE(0)))
+    {
+        plan->mode = ADC_WAKE_MODE_WINDOW;
+        plan->sleepTimeMs = samplePeriodMs * statusPeriods;
+        plan->periodsPerWake = statusPeriods;
+    }
+    else
+    {
+        plan->mode = ADC_WAKE_MODE_POLL;
+        plan->sleepTimeMs = samplePeriodMs;
+        plan->periodsPerWake = 1;
+    }
+
+    return plan->mode;
+}
@@ -0,0 +1,69 @@
+/**
+* \file  adc_window.h
+*
+* \brief ADC window monitor wake planning
+*
+* Decides whether the accelerometer threshold is watched by the ADC window
+* comparator while the CPU sleeps, or by waking up and polling the ADC.
+* The plan is made again from the configured mode whenever the parameters
+* change, so a fallback to polling ends when the window can be used again.
+* In window mode an RTC periodic event starts the conversions, the slowest
+* one that still converts at least once per sample period.
+* Nothing in here touches the hardware, so the planning logic also builds
+* on a host.
+*/
+
+#ifndef ADC_WINDOW_H_
+#define ADC_WINDOW_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Full scale value returned by ACC_CODE_TO_VALUE() and the matching ADC code */
+#define ACC_ADC_FULL_SCALE                  20.0f
+#define ACC_ADC_MAX_CODE                    4095u
+
+/* RTC periodic events PER0..PER7, PERn at CLK_RTC / 2^(n+3) */
+#define ADC_WINDOW_RTC_EVENTS               8u
+
+/* Converts a raw ADC code into the accelerometer value */
+#define ACC_CODE_TO_VALUE(code)             (((float)(code) * ACC_ADC_FULL_SCALE) / (float)ACC_ADC_MAX_CODE)
+
+/****************************** TYPES **************************************/
+typedef enum _AdcWakeMode_t
+{
+    /* Wake up every sample period and read the ADC */
+    ADC_WAKE_MODE_POLL = 0,
+    /* Let the ADC window comparator wake the CPU, wake periodically only for status */
+    ADC_WAKE_MODE_WINDOW
+} AdcWakeMode_t;
+
+typedef struct _AdcWakePlan_t
+{
+    AdcWakeMode_t mode;
+    /* Window lower limit: an alarm candidate is any raw code above it */
+    uint16_t windowLimit;
+    /* Duration of one timed sleep in ms */
+    uint32_t sleepTimeMs;
+    /* Sample periods covered by one timed wakeup, used for the status counter */
+    uint8_t periodsPerWake;
+    /* RTC periodic event n starting the conversions in window mode */
+    uint8_t rtcEvent;
+} AdcWakePlan_t;
+
+/****************************** PROTOTYPES **************************************/
+uint16_t ADC_WINDOW_ThresholdToCode(float threshold);
+uint8_t ADC_WINDOW_RtcEvent(uint32_t periodMs, uint32_t rtcHz);
+AdcWakeMode_t ADC_WINDOW_Plan(AdcWakeMode_t requested, float threshold, uint32_t samplePeriodMs,
+                              uint8_t statusPeriods, uint32_t rtcHz, AdcWakePlan_t *plan);
+
+/* Implemented by the ADC setup of the application (main.c) */
+void adc_window_arm(bool enable);
+void adc_window_update(void);
+
+/* Implemented by the alarm detection of the application (enddevice_demo.c) */
+float app_alarm_level(void);
+
+#endif /* ADC_WINDOW_H_ */
@@ -0,0 +1,264 @@
+/**
+* \file  anomaly.c
+*
+* \brief Online detector of abnormal accelerometer readings
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "anomaly.h"
+
+/******************************** MACROS ***************************************/
+/* Anomalous samples are learned 2^3 times slower */
+#define ANOMALY_SLOW_SHIFT                  3u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static AnomalyConfig_t anomalyConfig;
+/* One per season, then the global one */
+static AnomalyBaseline_t anomalyBaselines[ANOMALY_SEASONS + 1u];
+static AnomalyStats_t anomalyStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t anomaly_sqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1ul << 30;
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= (root + bit))
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/* Division by 2^shift rounded toward zero, the EWMA steps need no divide */
+static int32_t anomaly_shift(int32_t value, uint8_t shift)
+{
+    return (value >= 0) ? (int32_t)((uint32_t)value >> shift) : -(int32_t)((uint32_t)-value >> shift);
+}
+
+/* Square of a 1/65536 unit difference, in 1/256 units squared */
+static uint32_t anomaly_square(int32_t deltaQ16)
+{
+    uint64_t square = ((uint64_t)((int64_t)deltaQ16 * deltaQ16)) >> 24;
+
+    return (square > UINT32_MAX) ? UINT32_MAX : (uint32_t)square;
+}
+
+static void anomaly_learn(AnomalyBaseline_t *baseline, int32_t sampleQ16, bool anomalous)
+{
+    int32_t deltaQ16 = sampleQ16 - baseline->meanQ16;
+    int64_t varianceStep = (int64_t)anomaly_square(deltaQ16) - (int64_t)baseline->varianceQ8;
+    uint8_t shift = (uint8_t)(anomalyConfig.shift + (anomalous ? ANOMALY_SLOW_SHIFT : 0u));
+
+    if (0 == baseline->count)
+    {
+        baseline->meanQ16 = sampleQ16;
+        baseline->varianceQ8 = 0;
+        baseline->count = 1;
+        return;
+    }
+    if (baseline->count < (1u << anomalyConfig.shift))
+    {
+        /* Plain average over the first samples, then exponential */
+        int32_t divisor = (int32_t)(baseline->count + 1u) << (anomalous ? ANOMALY_SLOW_SHIFT : 0u);
+
+        baseline->meanQ16 += deltaQ16 / divisor;
+        varianceStep /= divisor;
+    }
+    else
+    {
+        baseline->meanQ16 += anomaly_shift(deltaQ16, shift);
+        varianceStep = (varianceStep >= 0) ? (varianceStep >> shift) : -((-varianceStep) >> shift);
+    }
+    baseline->varianceQ8 = (uint32_t)((int64_t)baseline->varianceQ8 + varianceStep);
+    if (baseline->count < UINT16_MAX)
+    {
+        baseline->count++;
+    }
+}
+
+/* The count is checked too, nothing is learned before ANOMALY_Init() */
+static bool anomaly_learned(const AnomalyBaseline_t *baseline)
+{
+    return (baseline->count > 0) && (baseline->count >= anomalyConfig.warmup);
+}
+
+/* Baseline a sample of the season is judged against, NULL while learning */
+static AnomalyBaseline_t *anomaly_baseline(uint8_t season)
+{
+    AnomalyBaseline_t *global = &anomalyBaselines[ANOMALY_SEASONS];
+
+    if ((season < ANOMALY_SEASONS) && anomaly_learned(&anomalyBaselines[season]))
+    {
+        return &anomalyBaselines[season];
+    }
+    return anomaly_learned(global) ? global : NULL;
+}
+
+/* Variance of a baseline, never below the noise floor */
+static uint32_t anomaly_variance(const AnomalyBaseline_t *baseline)
+{
+    uint32_t floorQ8 = ((uint32_t)anomalyConfig.sigmaMin * anomalyConfig.sigmaMin) << 8;
+
+    return (baseline->varianceQ8 > floorQ8) ? baseline->varianceQ8 : floorQ8;
+}
+
+/* Only a rise is an event: (delta / sigma)^2 > (zQ4 / 16)^2 */
+static bool anomaly_exceeds(const AnomalyBaseline_t *baseline, uint32_t varianceQ8, int32_t sampleQ16)
+{
+    int32_t deltaQ16 = sampleQ16 - baseline->meanQ16;
+
+    return (deltaQ16 > 0) &&
+           (anomaly_square(deltaQ16) > (((uint64_t)anomalyConfig.zQ4 * anomalyConfig.zQ4 * varianceQ8) >> 8));
+}
+
+/*********************************************************************//**
+\brief      Initializes the detector, every baseline is to be learned
+\param[in]  config - smoothing, limit, warm-up and noise floor
+*************************************************************************/
+void ANOMALY_Init(const AnomalyConfig_t *config)
+{
+    anomalyConfig = *config;
+    if (anomalyConfig.shift > 12u)
+    {
+        anomalyConfig.shift = 12u;
+    }
+    if (0 == anomalyConfig.warmup)
+    {
+        anomalyConfig.warmup = 1;
+    }
+    memset(anomalyBaselines, 0, sizeof(anomalyBaselines));
+    memset(&anomalyStats, 0, sizeof(anomalyStats));
+    anomalyStats.lastBaseline = ANOMALY_SEASONS;
+}
+
+/*********************************************************************//**
+\brief      Judges a sample against the learned baseline, then learns it
+\param[in]  sample - reading in fixed point, clamped to
+                     +/-ANOMALY_SAMPLE_MAX
+\param[in]  season - season of the sample, ANOMALY_NO_SEASON if none
+\return     ANOMALY_LEARNING as long as no baseline is learned
+*************************************************************************/
+AnomalyResult_t ANOMALY_Update(int16_t sample, uint8_t season)
+{
+    int32_t sampleQ16;
+    AnomalyBaseline_t *global = &anomalyBaselines[ANOMALY_SEASONS];
+    AnomalyBaseline_t *seasonal = (season < ANOMALY_SEASONS) ? &anomalyBaselines[season] : NULL;
+    AnomalyBaseline_t *baseline = anomaly_baseline(season);
+    bool anomalous = false;
+
+    /* Differences of two samples then fit the 1/65536 unit range */
+    if (sample > ANOMALY_SAMPLE_MAX)
+    {
+        sample = ANOMALY_SAMPLE_MAX;
+    }
+    else if (sample < -ANOMALY_SAMPLE_MAX)
+    {
+        sample = -ANOMALY_SAMPLE_MAX;
+    }
+    sampleQ16 = (int32_t)sample * 65536;
+
+    if (NULL != baseline)
+    {
+        int32_t deltaQ16 = sampleQ16 - baseline->meanQ16;
+        uint32_t varianceQ8 = anomaly_variance(baseline);
+        /* Standard deviation in 1/16 units */
+        int32_t sigmaQ4 = (int32_t)anomaly_sqrt(varianceQ8);
+        int32_t zQ4 = (sigmaQ4 > 0) ? ((deltaQ16 / sigmaQ4) / 256) : 0;
+
+        anomalous = anomaly_exceeds(baseline, varianceQ8, sampleQ16);
+        anomalyStats.lastZQ4 = (zQ4 > INT16_MAX) ? INT16_MAX : ((zQ4 < INT16_MIN) ? INT16_MIN : (int16_t)zQ4);
+        anomalyStats.lastBaseline = (baseline == global) ? ANOMALY_SEASONS : season;
+    }
+
+    anomaly_learn(global, sampleQ16, anomalous);
+    if (NULL != seasonal)
+    {
+        anomaly_learn(seasonal, sampleQ16, anomalous);
+    }
+    anomalyStats.samples++;
+    if (anomalous)
+    {
+        anomalyStats.anomalies++;
+    }
+
+    if (NULL == baseline)
+    {
+        return ANOMALY_LEARNING;
+    }
+    return anomalous ? ANOMALY_DETECTED : ANOMALY_NORMAL;
+}
+
+/*********************************************************************//**
+\brief      Gives the highest sample of the season judged normal, the
+            level above which ANOMALY_Update() detects an anomaly
+\param[in]  season - season of the next sample, ANOMALY_NO_SEASON if none
+\param[out] limit  - highest normal sample, ANOMALY_SAMPLE_MAX at most
+\return     false as long as no baseline is learned
+*************************************************************************/
+bool ANOMALY_GetLimit(uint8_t season, int16_t *limit)
+{
+    const AnomalyBaseline_t *baseline = anomaly_baseline(season);
+    uint32_t varianceQ8;
+    int64_t sample;
+
+    if (NULL == baseline)
+    {
+        return false;
+    }
+    varianceQ8 = anomaly_variance(baseline);
+    /* Mean plus zQ4 / 16 deviations, settled on the test of ANOMALY_Update()
+       as the square root is rounded */
+    sample = (baseline->meanQ16 + (int64_t)anomalyConfig.zQ4 * anomaly_sqrt(varianceQ8) * 256) / 65536;
+    if (sample > ANOMALY_SAMPLE_MAX)
+    {
+        sample = ANOMALY_SAMPLE_MAX;
+    }
+    else if (sample < -ANOMALY_SAMPLE_MAX)
+    {
+        sample = -ANOMALY_SAMPLE_MAX;
+    }
+    while ((sample < ANOMALY_SAMPLE_MAX) && !anomaly_exceeds(baseline, varianceQ8, (int32_t)(sample + 1) * 65536))
+    {
+        sample++;
+    }
+    while ((sample > -ANOMALY_SAMPLE_MAX) && anomaly_exceeds(baseline, varianceQ8, (int32_t)sample * 65536))
+    {
+        sample--;
+    }
+    *limit = (int16_t)sample;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Returns the baseline of a season, the global one for
+            ANOMALY_NO_SEASON
+*************************************************************************/
+const AnomalyBaseline_t *ANOMALY_GetBaseline(uint8_t season)
+{
+    return &anomalyBaselines[(season < ANOMALY_SEASONS) ? season : ANOMALY_SEASONS];
+}
+
+/*********************************************************************//**
+\brief      Returns the sample counters and the last deviation
+*************************************************************************/
+const AnomalyStats_t *ANOMALY_GetStats(void)
+{
+    return &anomalyStats;
+}
@@ -0,0 +1,85 @@
+/**
+* \file  anomaly.h
+*
+* \brief Online detector of abnormal accelerometer readings
+*
+* A baseline learns the normal level of the asset: an exponentially
+* weighted mean and variance of its samples, in fixed point. A sample is
+* anomalous when it exceeds the mean by more than zQ4 / 16 standard
+* deviations; the deviation is never taken below sigmaMin so that a quiet
+* asset does not alarm on noise. Anomalous samples update the baseline
+* 8 times slower, a lasting change of level is learned without the event
+* itself raising the limit. ANOMALY_GetLimit() gives that limit as a level,
+* for a comparator that watches it while the CPU sleeps.
+* With seasons, every season (the hour of the day for instance) has its
+* own baseline, used once learned; a global baseline covers the others.
+* Memory is constant, an update costs a few products and an integer
+* square root per baseline. The module does not touch the hardware and
+* also builds on a host.
+*/
+
+#ifndef ANOMALY_H_
+#define ANOMALY_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+#ifndef ANOMALY_SEASONS
+#define ANOMALY_SEASONS                     24u
+#endif
+/* Largest sample magnitude */
+#define ANOMALY_SAMPLE_MAX                  16383
+
+/* Sample without season, only the global baseline is used */
+#define ANOMALY_NO_SEASON                   0xFFu
+
+/****************************** TYPES **************************************/
+typedef enum _AnomalyResult_t
+{
+    /* No baseline learned yet, the caller decides */
+    ANOMALY_LEARNING = 0,
+    ANOMALY_NORMAL,
+    ANOMALY_DETECTED
+} AnomalyResult_t;
+
+typedef struct _AnomalyConfig_t
+{
+    /* Weight of a new sample 1 / 2^shift, a memory of about 2^shift samples */
+    uint8_t shift;
+    /* Limit in standard deviations, 1/16 units */
+    uint8_t zQ4;
+    /* Samples a baseline needs before it is used */
+    uint16_t warmup;
+    /* Smallest standard deviation, in sample units */
+    uint16_t sigmaMin;
+} AnomalyConfig_t;
+
+typedef struct _AnomalyBaseline_t
+{
+    /* 1/65536 sample units */
+    int32_t meanQ16;
+    /* 1/256 sample units squared */
+    uint32_t varianceQ8;
+    uint16_t count;
+} AnomalyBaseline_t;
+
+typedef struct _AnomalyStats_t
+{
+    uint32_t samples;
+    uint32_t anomalies;
+    /* Deviation of the last sample in standard deviations, 1/16 units */
+    int16_t lastZQ4;
+    /* Baseline the last sample was judged against, ANOMALY_SEASONS for the global one */
+    uint8_t lastBaseline;
+} AnomalyStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void ANOMALY_Init(const AnomalyConfig_t *config);
+AnomalyResult_t ANOMALY_Update(int16_t sample, uint8_t season);
+bool ANOMALY_GetLimit(uint8_t season, int16_t *limit);
+const AnomalyBaseline_t *ANOMALY_GetBaseline(uint8_t season);
+const AnomalyStats_t *ANOMALY_GetStats(void);
+
+#endif /* ANOMALY_H_ */
@@ -0,0 +1,491 @@
+/**
+* \file  app_crypto.c
+*
+* \brief End-to-end encryption of the application payload
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "app_crypto.h"
+
+/******************************** MACROS ***************************************/
+#define AES_ROUNDS                          10u
+#define AES_ROUND_KEYS_LENGTH               ((AES_ROUNDS + 1u) * APP_CRYPTO_BLOCK_LENGTH)
+
+#define APP_CRYPTO_BLOCK_TAG                0x01u
+/* Key derivation blocks, apart from the counter blocks by the tag */
+#define APP_CRYPTO_DERIVE_ENC_TAG           0x11u
+#define APP_CRYPTO_DERIVE_MAC_TAG           0x12u
+
+/****************************** TYPES **************************************/
+typedef struct _AppCryptoKey_t
+{
+    uint8_t key[APP_CRYPTO_KEY_LENGTH];
+    /* Expanded key of the software cipher */
+    uint8_t roundKeys[AES_ROUND_KEYS_LENGTH];
+} AppCryptoKey_t;
+
+typedef struct _AppCryptoCmac_t
+{
+    AppCryptoKey_t *key;
+    uint8_t x[APP_CRYPTO_BLOCK_LENGTH];
+    uint8_t buf[APP_CRYPTO_BLOCK_LENGTH];
+    uint8_t fill;
+} AppCryptoCmac_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static AppCryptoKey_t encSlot;
+static AppCryptoKey_t macSlot;
+static AppCryptoCipher_t cryptoEngine = NULL;
+static bool cryptoReady = false;
+
+/* FIPS-197 appendix C.1 */
+static const uint8_t aesTestKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+static const uint8_t aesTestPlain[APP_CRYPTO_BLOCK_LENGTH] =
+{
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static const uint8_t aesTestCipher[APP_CRYPTO_BLOCK_LENGTH] =
+{
+    0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+};
+
+/* RFC 4493 section 4, examples 1 and 2 */
+static const uint8_t cmacTestKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t cmacTestMsg[APP_CRYPTO_BLOCK_LENGTH] =
+{
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a
+};
+static const uint8_t cmacTestMacEmpty[APP_CRYPTO_BLOCK_LENGTH] =
+{
+    0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46
+};
+static const uint8_t cmacTestMacBlock[APP_CRYPTO_BLOCK_LENGTH] =
+{
+    0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Multiplication in GF(2^8), no data dependent branch or lookup */
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    uint8_t r = 0;
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        r ^= (uint8_t)(a & (uint8_t)(0u - (b & 1u)));
+        a = (uint8_t)((a << 1) ^ (0x1bu & (uint8_t)(0u - (a >> 7))));
+        b >>= 1;
+    }
+    return r;
+}
+
+/* S-box computed as inverse (x^254) followed by the affine map */
+static uint8_t aes_sbox(uint8_t x)
+{
+    uint8_t x2 = gf_mul(x, x);
+    uint8_t x3 = gf_mul(x2, x);
+    uint8_t x12 = gf_mul(x3, x3);
+    uint8_t x15;
+    uint8_t inv;
+    uint8_t s;
+
+    x12 = gf_mul(x12, x12);
+    x15 = gf_mul(x12, x3);
+    inv = gf_mul(x15, x15);
+    inv = gf_mul(inv, inv);
+    inv = gf_mul(inv, inv);
+    inv = gf_mul(inv, inv);
+    inv = gf_mul(inv, x12);
+    inv = gf_mul(inv, x2);
+
+    s = inv;
+    for (uint8_t i = 1; i < 5; i++)
+    {
+        s ^= (uint8_t)((inv << i) | (inv >> (8 - i)));
+    }
+    return (uint8_t)(s ^ 0x63u);
+}
+
+static void aes_expand_key(AppCryptoKey_t *slot)
+{
+    uint8_t *rk = slot->roundKeys;
+    uint8_t rcon = 0x01;
+
+    memcpy(rk, slot->key, APP_CRYPTO_KEY_LENGTH);
+    for (uint8_t i = APP_CRYPTO_KEY_LENGTH; i < AES_ROUND_KEYS_LENGTH; i += 4)
+    {
+        uint8_t t[4];
+
+        memcpy(t, &rk[i - 4], 4);
+        if (0 == (i % APP_CRYPTO_KEY_LENGTH))
+        {
+            uint8_t first = t[0];
+
+            t[0] = (uint8_t)(aes_sbox(t[1]) ^ rcon);
+            t[1] = aes_sbox(t[2]);
+            t[2] = aes_sbox(t[3]);
+            t[3] = aes_sbox(first);
+            rcon = gf_mul(rcon, 0x02);
+        }
+        for (uint8_t j = 0; j < 4; j++)
+        {
+            rk[i + j] = (uint8_t)(rk[i + j - APP_CRYPTO_KEY_LENGTH] ^ t[j]);
+        }
+    }
+}
+
+static void aes_encrypt_sw(uint8_t *state, const uint8_t *roundKeys)
+{
+    for (uint8_t i = 0; i < APP_CRYPTO_BLOCK_LENGTH; i++)
+    {
+        state[i] ^= roundKeys[i];
+    }
+
+    for (uint8_t round = 1; round <= AES_ROUNDS; round++)
+    {
+        uint8_t t[APP_CRYPTO_BLOCK_LENGTH];
+
+        /* SubBytes and ShiftRows, the state is column major */
+        for (uint8_t i = 0; i < APP_CRYPTO_BLOCK_LENGTH; i++)
+        {
+            t[i] = aes_sbox(state[(i + 4u * (i % 4u)) % APP_CRYPTO_BLOCK_LENGTH]);
+        }
+
+        if (round < AES_ROUNDS)
+        {
+            /* MixColumns */
+            for (uint8_t c = 0; c < APP_CRYPTO_BLOCK_LENGTH; c += 4)
+            {
+                uint8_t a0 = t[c], a1 = t[c + 1], a2 = t[c + 2], a3 = t[c + 3];
+                uint8_t all = (uint8_t)(a0 ^ a1 ^ a2 ^ a3);
+
+                t[c]     ^= (uint8_t)(all ^ gf_mul((uint8_t)(a0 ^ a1), 0x02));
+                t[c + 1] ^= (uint8_t)(all ^ gf_mul((uint8_t)(a1 ^ a2), 0x02));
+                t[c + 2] ^= (uint8_t)(all ^ gf_mul((uint8_t)(a2 ^ a3), 0x02));
+                t[c + 3] ^= (uint8_t)(all ^ gf_mul((uint8_t)(a3 ^ a0), 0x02));
+            }
+        }
+
+        for (uint8_t i = 0; i < APP_CRYPTO_BLOCK_LENGTH; i++)
+        {
+            state[i] = (uint8_t)(t[i] ^ roundKeys[round * APP_CRYPTO_BLOCK_LENGTH + i]);
+        }
+    }
+}
+
+static void app_crypto_load_key(AppCryptoKey_t *slot, const uint8_t *key)
+{
+    memcpy(slot->key, key, APP_CRYPTO_KEY_LENGTH);
+    aes_expand_key(slot);
+}
+
+static void app_crypto_encrypt(AppCryptoKey_t *slot, uint8_t *block)
+{
+    if (NULL != cryptoEngine)
+    {
+        cryptoEngine(block, slot->key);
+    }
+    else
+    {
+        aes_encrypt_sw(block, slot->roundKeys);
+    }
+}
+
+static void app_crypto_block(uint8_t *block, AppCryptoDir_t dir, uint32_t devAddr, uint32_t epoch, uint32_t fCnt,
+                             uint8_t index)
+{
+    memset(block, 0, APP_CRYPTO_BLOCK_LENGTH);
+    block[0] = APP_CRYPTO_BLOCK_TAG;
+    block[5] = (uint8_t)dir;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        block[1 + i] = (uint8_t)(epoch >> (8 * i));
+        block[6 + i] = (uint8_t)(devAddr >> (8 * i));
+        block[10 + i] = (uint8_t)(fCnt >> (8 * i));
+    }
+    block[15] = index;
+}
+
+/* Doubling in GF(2^128) used for the CMAC subkeys */
+static void cmac_double(uint8_t *block)
+{
+    uint8_t carry = (uint8_t)(block[0] >> 7);
+
+    for (uint8_t i = 0; i < APP_CRYPTO_BLOCK_LENGTH - 1u; i++)
+    {
+        block[i] = (uint8_t)((block[i] << 1) | (block[i + 1] >> 7));
+    }
+    block[APP_CRYPTO_BLOCK_LENGTH - 1u] = (uint8_t)((block[APP_CRYPTO_BLOCK_LENGTH - 1u] << 1) ^
+                                                    (0x87u & (uint8_t)(0u - carry)));
+}
+
+static void cmac_start(AppCryptoCmac_t *ctx, AppCryptoKey_t *slot)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->key = slot;
+}
+
+static void cmac_update(AppCryptoCmac_t *ctx, const uint8_t *data, uint8_t length)
+{
+    for (uint8_t i = 0; i < length; i++)
+    {
+        /* The last block is kept back for the subkey */
+        if (APP_CRYPTO_BLOCK_LENGTH == ctx->fill)
+        {
+            for (uint8_t j = 0; j < APP_CRYPTO_BLOCK_LENGTH; j++)
+            {
+                ctx->x[j] ^= ctx->buf[j];
+            }
+            app_crypto_encrypt(ctx->key, ctx->x);
+            ctx->fill = 0;
+        }
+        ctx->buf[ctx->fill++] = data[i];
+    }
+}
+
+static void cmac_finish(AppCryptoCmac_t *ctx, uint8_t *mac)
+{
+    uint8_t subkey[APP_CRYPTO_BLOCK_LENGTH];
+
+    memset(subkey, 0, sizeof(subkey));
+    app_crypto_encrypt(ctx->key, subkey);
+    cmac_double(subkey);
+    if (ctx->fill < APP_CRYPTO_BLOCK_LENGTH)
+    {
+        cmac_double(subkey);
+        ctx->buf[ctx->fill] = 0x80;
+        memset(&ctx->buf[ctx->fill + 1], 0, APP_CRYPTO_BLOCK_LENGTH - ctx->fill - 1u);
+    }
+
+    for (uint8_t j = 0; j < APP_CRYPTO_BLOCK_LENGTH; j++)
+    {
+        ctx->x[j] ^= (uint8_t)(ctx->buf[j] ^ subkey[j]);
+    }
+    app_crypto_encrypt(ctx->key, ctx->x);
+    memcpy(mac, ctx->x, APP_CRYPTO_BLOCK_LENGTH);
+}
+
+/*********************************************************************//**
+\brief      Encrypts one block with the configured cipher, for tests and
+            tools: the key is expanded on every call
+\param[in]  key   - AES-128 key
+\param[in,out] block - plaintext on entry, ciphertext on return
+*************************************************************************/
+void APP_CRYPTO_Encrypt(const uint8_t *key, uint8_t *block)
+{
+    AppCryptoKey_t slot;
+
+    app_crypto_load_key(&slot, key);
+    app_crypto_encrypt(&slot, block);
+}
+
+/*********************************************************************//**
+\brief      Computes the full AES-CMAC of a message with the configured
+            cipher, for tests and tools
+\param[in]  key    - AES-128 key
+\param[in]  data   - message
+\param[in]  length - message length
+\param[out] mac    - APP_CRYPTO_BLOCK_LENGTH bytes
+*************************************************************************/
+void APP_CRYPTO_Cmac(const uint8_t *key, const uint8_t *data, uint8_t length, uint8_t *mac)
+{
+    AppCryptoKey_t slot;
+    AppCryptoCmac_t cmac;
+
+    app_crypto_load_key(&slot, key);
+    cmac_start(&cmac, &slot);
+    cmac_update(&cmac, data, length);
+    cmac_finish(&cmac, mac);
+}
+
+/*********************************************************************//**
+\brief      Checks the configured cipher against the published vectors
+\return     true if AES-128 and AES-CMAC give the expected results
+
+The session keys are overwritten, APP_CRYPTO_Init() loads them after.
+*************************************************************************/
+bool APP_CRYPTO_SelfTest(void)
+{
+    uint8_t block[APP_CRYPTO_BLOCK_LENGTH];
+    AppCryptoCmac_t cmac;
+    bool ok;
+
+    app_crypto_load_key(&encSlot, aesTestKey);
+    memcpy(block, aesTestPlain, sizeof(block));
+    app_crypto_encrypt(&encSlot, block);
+    ok = (0 == memcmp(block, aesTestCipher, sizeof(block)));
+
+    app_crypto_load_key(&macSlot, cmacTestKey);
+    cmac_start(&cmac, &macSlot);
+    cmac_finish(&cmac, block);
+    ok = ok && (0 == memcmp(block, cmacTestMacEmpty, sizeof(block)));
+
+    cmac_start(&cmac, &macSlot);
+    cmac_update(&cmac, cmacTestMsg, sizeof(cmacTestMsg));
+    cmac_finish(&cmac, block);
+    ok = ok && (0 == memcmp(block, cmacTestMacBlock, sizeof(block)));
+
+    return ok;
+}
+
+/*********************************************************************//**
+\brief      Selects the cipher, runs the self test and loads the keys
+\param[in]  encKey - payload encryption key
+\param[in]  macKey - payload authentication key
+\param[in]  engine - block cipher of the stack, NULL for the software one
+\return     false if the self test failed, frames are not sealed then
+*************************************************************************/
+bool APP_CRYPTO_Init(const uint8_t *encKey, const uint8_t *macKey, AppCryptoCipher_t engine)
+{
+    cryptoEngine = engine;
+    cryptoReady = APP_CRYPTO_SelfTest();
+
+    app_crypto_load_key(&encSlot, encKey);
+    app_crypto_load_key(&macSlot, macKey);
+
+    return cryptoReady;
+}
+
+/* [tag] [DevEUI, 8 MSB first] [generation, 4 LE] [0, 3] */
+static void app_crypto_derive(const uint8_t *rootKey, uint8_t tag, const uint8_t *devEui, uint32_t generation,
+                              uint8_t *key)
+{
+    memset(key, 0, APP_CRYPTO_KEY_LENGTH);
+    key[0] = tag;
+    memcpy(&key[1], devEui, APP_CRYPTO_DEV_EUI_LENGTH);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        key[9 + i] = (uint8_t)(generation >> (8 * i));
+    }
+    APP_CRYPTO_Encrypt(rootKey, key);
+}
+
+/*********************************************************************//**
+\brief      Derives the payload keys of one device from the root key of
+            the backend, for provisioning tools and the backend
+\param[in]  rootKey    - root key, never stored on a device
+\param[in]  devEui     - DevEUI of the device, MSB first
+\param[in]  generation - key generation, bumped every time the device is
+                         provisioned again so that an erased device never
+                         gets back the keys its old epochs were used with
+\param[out] encKey     - payload encryption key of the device
+\param[out] macKey     - payload authentication key of the device
+*************************************************************************/
+void APP_CRYPTO_DeriveKeys(const uint8_t *rootKey, const uint8_t *devEui, uint32_t generation, uint8_t *encKey,
+                           uint8_t *macKey)
+{
+    app_crypto_derive(rootKey, APP_CRYPTO_DERIVE_ENC_TAG, devEui, generation, encKey);
+    app_crypto_derive(rootKey, APP_CRYPTO_DERIVE_MAC_TAG, devEui, generation, macKey);
+}
+
+/* XORs the key stream of a frame into data */
+static void app_crypto_ctr(uint8_t *data, uint8_t length, AppCryptoDir_t dir, uint32_t devAddr, uint32_t epoch,
+                           uint32_t fCnt)
+{
+    uint8_t block[APP_CRYPTO_BLOCK_LENGTH];
+
+    for (uint8_t pos = 0; pos < length; pos += APP_CRYPTO_BLOCK_LENGTH)
+    {
+        uint8_t count = ((uint8_t)(length - pos) < APP_CRYPTO_BLOCK_LENGTH) ? (uint8_t)(length - pos) : APP_CRYPTO_BLOCK_LENGTH;
+
+        app_crypto_block(block, dir, devAddr, epoch, fCnt, (uint8_t)(pos / APP_CRYPTO_BLOCK_LENGTH + 1u));
+        app_crypto_encrypt(&encSlot, block);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            data[pos + i] ^= block[i];
+        }
+    }
+}
+
+/* MIC over the counter block of index 0, the epoch byte and the ciphertext */
+static void app_crypto_mic(const uint8_t *frame, uint8_t length, AppCryptoDir_t dir, uint32_t devAddr,
+                           uint32_t epoch, uint32_t fCnt, uint8_t *mic)
+{
+    uint8_t block[APP_CRYPTO_BLOCK_LENGTH];
+    AppCryptoCmac_t cmac;
+
+    app_crypto_block(block, dir, devAddr, epoch, fCnt, 0);
+    cmac_start(&cmac, &macSlot);
+    cmac_update(&cmac, block, sizeof(block));
+    cmac_update(&cmac, frame, length);
+    cmac_finish(&cmac, block);
+    memcpy(mic, block, APP_CRYPTO_MIC_LENGTH);
+}
+
+/*********************************************************************//**
+\brief      Encrypts a payload in place and appends its MIC
+\param[in,out] payload - plaintext on entry, sealed frame on return
+\param[in]  length    - plaintext length
+\param[in]  maxLength - size of payload, at least length + APP_CRYPTO_OVERHEAD
+\param[in]  dir       - direction of the frame
+\param[in]  devAddr   - device address of the session
+\param[in]  epoch     - epoch of the session
+\param[in]  fCnt      - frame counter the frame is sent with
+\return     length of the sealed frame, 0 on error
+*************************************************************************/
+uint8_t APP_CRYPTO_Seal(uint8_t *payload, uint8_t length, uint8_t maxLength,
+                        AppCryptoDir_t dir, uint32_t devAddr, uint32_t epoch, uint32_t fCnt)
+{
+    if (!cryptoReady || (NULL == payload) ||
+        ((uint16_t)length + APP_CRYPTO_OVERHEAD > maxLength))
+    {
+        return 0;
+    }
+
+    memmove(&payload[1], payload, length);
+    payload[0] = (uint8_t)epoch;
+    app_crypto_ctr(&payload[1], length, dir, devAddr, epoch, fCnt);
+    app_crypto_mic(payload, (uint8_t)(length + 1u), dir, devAddr, epoch, fCnt, &payload[length + 1u]);
+
+    return (uint8_t)(length + APP_CRYPTO_OVERHEAD);
+}
+
+/*********************************************************************//**
+\brief      Checks the MIC of a sealed frame and decrypts it in place
+\param[in,out] frame - sealed frame on entry, plaintext on return
+\param[in]  length   - sealed frame length
+\param[in]  dir      - direction of the frame
+\param[in]  devAddr  - device address of the session
+\param[in]  epoch    - epoch of the session, its low byte must match the
+                       one of the frame
+\param[in]  fCnt     - frame counter the frame was sent with
+\return     plaintext length, 0 if the frame is not authentic
+*************************************************************************/
+uint8_t APP_CRYPTO_Open(uint8_t *frame, uint8_t length, AppCryptoDir_t dir, uint32_t devAddr, uint32_t epoch,
+                        uint32_t fCnt)
+{
+    uint8_t mic[APP_CRYPTO_MIC_LENGTH];
+    uint8_t diff = 0;
+    uint8_t plainLength;
+
+    if (!cryptoReady || (NULL == frame) || (length < APP_CRYPTO_OVERHEAD) || (frame[0] != (uint8_t)epoch))
+    {
+        return 0;
+    }
+    plainLength = (uint8_t)(length - APP_CRYPTO_OVERHEAD);
+
+    app_crypto_mic(frame, (uint8_t)(plainLength + 1u), dir, devAddr, epoch, fCnt, mic);
+    /* Compared in constant time */
+    for (uint8_t i = 0; i < APP_CRYPTO_MIC_LENGTH; i++)
+    {
+        diff |= (uint8_t)(mic[i] ^ frame[plainLength + 1u + i]);
+    }
+    if (0 != diff)
+    {
+        return 0;
+    }
+
+    app_crypto_ctr(&frame[1], plainLength, dir, devAddr, epoch, fCnt);
+    memmove(frame, &frame[1], plainLength);
+    return plainLength;
+}
@@ -0,0 +1,66 @@
+/**
+* \file  app_crypto.h
+*
+* \brief End-to-end encryption of the application payload
+*
+* On top of the LoRaWAN session encryption, the payload is encrypted with
+* AES-128 in CTR mode and authenticated with a truncated AES-CMAC, using
+* keys only the application backend knows. A frame becomes
+*   [epoch, low byte] [ciphertext ...] [MIC, 4 bytes]
+* Counter block i (i = 1, 2, ...) and the CMAC prefix block (i = 0) are
+*   [0x01] [epoch, 4 LE] [dir] [DevAddr, 4 LE] [FCntUp, 4 LE] [0] [i]
+* The keys are per device: the backend derives them from a root key, the
+* DevEUI and a key generation with APP_CRYPTO_DeriveKeys(), so devices
+* sharing a DevAddr, now or after a reassignment, never share a key stream
+* and cannot forge each other's MIC; the root key stays in the backend.
+* The keys are static while the frame counters restart at every join, the
+* session epoch, bumped at every join and kept in flash along the frame
+* counters (fcnt_store.h), makes the key stream of every (session, frame
+* counter) fresh. The backend tracks the
+* epoch of each device and resynchronizes it from the low byte sent along.
+* An erase restarts the epochs, a device is provisioned again with the
+* keys of the next generation then.
+*
+* The block cipher is the stack AES engine when one is given, a constant
+* time software AES-128 otherwise.
+*/
+
+#ifndef APP_CRYPTO_H_
+#define APP_CRYPTO_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+#define APP_CRYPTO_KEY_LENGTH               16u
+#define APP_CRYPTO_BLOCK_LENGTH             16u
+#define APP_CRYPTO_DEV_EUI_LENGTH           8u
+/* Truncated CMAC appended to a frame */
+#define APP_CRYPTO_MIC_LENGTH               4u
+/* Epoch byte and MIC added to the payload */
+#define APP_CRYPTO_OVERHEAD                 (1u + APP_CRYPTO_MIC_LENGTH)
+
+/****************************** TYPES **************************************/
+/* Encrypts one block in place, same prototype as AESEncode() */
+typedef void (*AppCryptoCipher_t)(uint8_t *block, uint8_t *key);
+
+typedef enum _AppCryptoDir_t
+{
+    APP_CRYPTO_UPLINK = 0,
+    APP_CRYPTO_DOWNLINK
+} AppCryptoDir_t;
+
+/****************************** PROTOTYPES **************************************/
+bool APP_CRYPTO_Init(const uint8_t *encKey, const uint8_t *macKey, AppCryptoCipher_t engine);
+uint8_t APP_CRYPTO_Seal(uint8_t *payload, uint8_t length, uint8_t maxLength,
+                        AppCryptoDir_t dir, uint32_t devAddr, uint32_t epoch, uint32_t fCnt);
+uint8_t APP_CRYPTO_Open(uint8_t *frame, uint8_t length, AppCryptoDir_t dir, uint32_t devAddr, uint32_t epoch,
+                        uint32_t fCnt);
+void APP_CRYPTO_DeriveKeys(const uint8_t *rootKey, const uint8_t *devEui, uint32_t generation, uint8_t *encKey,
+                           uint8_t *macKey);
+void APP_CRYPTO_Encrypt(const uint8_t *key, uint8_t *block);
+void APP_CRYPTO_Cmac(const uint8_t *key, const uint8_t *data, uint8_t length, uint8_t *mac);
+bool APP_CRYPTO_SelfTest(void);
+
+#endif /* APP_CRYPTO_H_ */
@@ -0,0 +1,241 @@
+/**
+* \file  app_diag.c
+*
+* \brief Stack and scheduling diagnostics of the application
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "app_diag.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static AppDiag_t appDiag;
+/* Painted region of the stack, lowest address first */
+static uint32_t *stackBottom = NULL;
+static uint32_t *stackTop = NULL;
+
+/***************************** FUNCTIONS ***************************************/
+
+static void app_diag_put_u16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void app_diag_put_u32(uint8_t *buffer, uint32_t value)
+{
+    app_diag_put_u16(buffer, (uint16_t)value);
+    app_diag_put_u16(buffer + 2, (uint16_t)(value >> 16));
+}
+
+/* Updates a timing entry, returns true when the run was a stall */
+static bool app_diag_record(AppDiagTiming_t *timing, uint32_t durationUs, uint32_t budgetUs)
+{
+    timing->runs++;
+    timing->totalUs += durationUs;
+    if (durationUs > timing->maxUs)
+    {
+        timing->maxUs = durationUs;
+    }
+    if (durationUs > budgetUs)
+    {
+        if (timing->stalls < UINT16_MAX)
+        {
+            timing->stalls++;
+        }
+        return true;
+    }
+    return false;
+}
+
+/*********************************************************************//**
+\brief      Clears the diagnostics and stores the reset cause
+\param[in]  resetCause - cause of the last reset
+*************************************************************************/
+void APP_DIAG_Init(uint8_t resetCause)
+{
+    memset(&appDiag, 0, sizeof(appDiag));
+    appDiag.resetCause = resetCause;
+    appDiag.lastStallId = APP_DIAG_LOOP_ID;
+    if ((NULL != stackBottom) && (NULL != stackTop))
+    {
+        appDiag.stackSize = (uint32_t)(stackTop - stackBottom) * sizeof(uint32_t);
+    }
+}
+
+/*********************************************************************//**
+\brief      Paints the unused stack, must run before the stack grows
+\param[in]  bottom     - lowest address of the stack
+\param[in]  top        - end of the stack, the initial stack pointer
+\param[in]  paintLimit - first word not to paint, below the live frames
+*************************************************************************/
+void APP_DIAG_StackInit(uint32_t *bottom, uint32_t *top, uint32_t *paintLimit)
+{
+    stackBottom = bottom;
+    stackTop = top;
+    appDiag.stackSize = (uint32_t)(top - bottom) * sizeof(uint32_t);
+
+    for (uint32_t *word = bottom; word < paintLimit; word++)
+    {
+        *word = APP_DIAG_STACK_PATTERN;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the deepest stack use seen since boot
+\return     bytes used, 0 if the stack was not painted
+*************************************************************************/
+uint32_t APP_DIAG_StackUsed(void)
+{
+    uint32_t *word = stackBottom;
+
+    if (NULL == word)
+    {
+        return 0;
+    }
+
+    /* The stack grows down: the first overwritten word is the high-water mark */
+    while ((word < stackTop) && (APP_DIAG_STACK_PATTERN == *word))
+    {
+        word++;
+    }
+    return (uint32_t)(stackTop - word) * sizeof(uint32_t);
+}
+
+/*********************************************************************//**
+\brief      Records the duration of an application task handler
+\param[in]  taskId     - task that ran
+\param[in]  durationUs - time spent in the handler
+*************************************************************************/
+void APP_DIAG_RecordTask(uint8_t taskId, uint32_t durationUs)
+{
+    if (taskId >= APP_DIAG_MAX_TASKS)
+    {
+        return;
+    }
+
+    if (app_diag_record(&appDiag.task[taskId], durationUs, APP_DIAG_TASK_BUDGET_US))
+    {
+        appDiag.lastStallId = taskId;
+        appDiag.lastStallUs = durationUs;
+    }
+}
+
+/*********************************************************************//**
+\brief      Records the duration of a scheduler loop iteration
+\param[in]  durationUs - time spent in SYSTEM_RunTasks()
+*************************************************************************/
+void APP_DIAG_RecordLoop(uint32_t durationUs)
+{
+    if (app_diag_record(&appDiag.loop, durationUs, APP_DIAG_LOOP_BUDGET_US))
+    {
+        appDiag.lastStallId = APP_DIAG_LOOP_ID;
+        appDiag.lastStallUs = durationUs;
+    }
+}
+
+/*********************************************************************//**
+\brief      Records the cost of the frame counter persistence
+\param[in]  writes  - records written to the flash
+\param[in]  uplinks - uplinks sent meanwhile
+\param[in]  gap     - counters skipped by the last restore
+*************************************************************************/
+void APP_DIAG_RecordFcnt(uint32_t writes, uint32_t uplinks, uint32_t gap)
+{
+    appDiag.fcntWrites = writes;
+    appDiag.fcntUplinks = uplinks;
+    appDiag.fcntGap = gap;
+}
+
+/*********************************************************************//**
+\brief      Returns the collected diagnostics
+*************************************************************************/
+const AppDiag_t *APP_DIAG_Get(void)
+{
+    return &appDiag;
+}
+
+/*********************************************************************//**
+\brief      Packs the diagnostics into an uplink record
+\param[out] buffer    - record, little endian
+\param[in]  maxLength - size of buffer
+\return     length of the record, 0 if it does not fit
+
+Layout: version, reset cause, stack used (u16), stack size (u16),
+worst task (u32 us), worst loop (u32 us), task stalls (u16),
+loop stalls (u16), last stall id, last stall (u24 ms),
+frame counter writes (u16), frame counter gap (u16).
+*************************************************************************/
+uint8_t APP_DIAG_Serialize(uint8_t *buffer, uint8_t maxLength)
+{
+    uint32_t taskMaxUs = 0;
+    uint32_t taskStalls = 0;
+    uint32_t stallMs;
+
+    if (maxLength < APP_DIAG_RECORD_LENGTH)
+    {
+        return 0;
+    }
+
+    for (uint8_t id = 0; id < APP_DIAG_MAX_TASKS; id++)
+    {
+        if (appDiag.task[id].maxUs > taskMaxUs)
+        {
+            taskMaxUs = appDiag.task[id].maxUs;
+        }
+        taskStalls += appDiag.task[id].stalls;
+    }
+    stallMs = appDiag.lastStallUs / 1000u;
+
+    buffer[0] = APP_DIAG_RECORD_VERSION;
+    buffer[1] = appDiag.resetCause;
+    app_diag_put_u16(&buffer[2], (uint16_t)APP_DIAG_StackUsed());
+    app_diag_put_u16(&buffer[4], (uint16_t)appDiag.stackSize);
+    app_diag_put_u32(&buffer[6], taskMaxUs);
+    app_diag_put_u32(&buffer[10], appDiag.loop.maxUs);
+    app_diag_put_u16(&buffer[14], (uint16_t)((taskStalls > UINT16_MAX) ? UINT16_MAX : taskStalls));
+    app_diag_put_u16(&buffer[16], appDiag.loop.stalls);
+    buffer[18] = appDiag.lastStallId;
+    buffer[19] = (uint8_t)stallMs;
+    buffer[20] = (uint8_t)(stallMs >> 8);
+    buffer[21] = (uint8_t)(stallMs >> 16);
+    app_diag_put_u16(&buffer[22], (uint16_t)((appDiag.fcntWrites > UINT16_MAX) ? UINT16_MAX : appDiag.fcntWrites));
+    app_diag_put_u16(&buffer[24], (uint16_t)((appDiag.fcntGap > UINT16_MAX) ? UINT16_MAX : appDiag.fcntGap));
+
+    return APP_DIAG_RECORD_LENGTH;
+}
+
+/*********************************************************************//**
+\brief      Prints the diagnostics on the console
+*************************************************************************/
+void APP_DIAG_Print(void)
+{
+    printf("\r\nReset cause: 0x%02x\r\n", appDiag.resetCause);
+    printf("Stack: %lu of %lu bytes used\r\n",
+           (unsigned long)APP_DIAG_StackUsed(), (unsigned long)appDiag.stackSize);
+    for (uint8_t id = 0; id < APP_DIAG_MAX_TASKS; id++)
+    {
+        if (0 == appDiag.task[id].runs)
+        {
+            continue;
+        }
+        printf("Task %d: %lu runs, avg %lu us, max %lu us, %d stalls\r\n", id,
+               (unsigned long)appDiag.task[id].runs,
+               (unsigned long)(appDiag.task[id].totalUs / appDiag.task[id].runs),
+               (unsigned long)appDiag.task[id].maxUs, appDiag.task[id].stalls);
+    }
+    printf("Loop: %lu runs, max %lu us, %d stalls\r\n",
+           (unsigned long)appDiag.loop.runs, (unsigned long)appDiag.loop.maxUs, appDiag.loop.stalls);
+    if (0 != appDiag.lastStallUs)
+    {
+        printf("Last stall: %s %d, %lu us\r\n",
+               (APP_DIAG_LOOP_ID == appDiag.lastStallId) ? "loop" : "task",
+               appDiag.lastStallId, (unsigned long)appDiag.lastStallUs);
+    }
+    printf("Frame counters: %lu writes for %lu uplinks, %lu skipped at restore\r\n",
+           (unsigned long)appDiag.fcntWrites, (unsigned long)appDiag.fcntUplinks,
+           (unsigned long)appDiag.fcntGap);
+}
@@ -0,0 +1,83 @@
+/**
+* \file  app_diag.h
+*
+* \brief Stack and scheduling diagnostics of the application
+*
+* The unused part of the stack is painted at boot, the high-water mark is
+* found by looking for the first overwritten word. Every application task
+* handler and every SYSTEM_RunTasks() iteration is timed, runs above their
+* budget are counted as stalls. Results are kept with the reset cause and
+* the cost of the frame counter persistence, and can be printed or packed
+* into a diagnostic uplink.
+*/
+
+#ifndef APP_DIAG_H_
+#define APP_DIAG_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+#define APP_DIAG_STACK_PATTERN              0xC5C5C5C5uL
+
+/* Words left unpainted below the stack pointer of the painting code */
+#define APP_DIAG_STACK_MARGIN_WORDS         16u
+
+/* Durations above which a task handler or a loop iteration is a stall */
+#ifndef APP_DIAG_TASK_BUDGET_US
+#define APP_DIAG_TASK_BUDGET_US             50000uL
+#endif
+#ifndef APP_DIAG_LOOP_BUDGET_US
+#define APP_DIAG_LOOP_BUDGET_US             100000uL
+#endif
+
+/* Number of application tasks that are timed */
+#ifndef APP_DIAG_MAX_TASKS
+#define APP_DIAG_MAX_TASKS                  4u
+#endif
+
+#define APP_DIAG_RECORD_VERSION             2u
+/* Length of the record built by APP_DIAG_Serialize() */
+#define APP_DIAG_RECORD_LENGTH              26u
+
+/* Task identifier of a stall in the main loop */
+#define APP_DIAG_LOOP_ID                    0xFFu
+
+/****************************** TYPES **************************************/
+typedef struct _AppDiagTiming_t
+{
+    uint32_t runs;
+    uint32_t maxUs;
+    uint32_t totalUs;
+    uint16_t stalls;
+} AppDiagTiming_t;
+
+typedef struct _AppDiag_t
+{
+    uint8_t resetCause;
+    uint32_t stackSize;
+    AppDiagTiming_t task[APP_DIAG_MAX_TASKS];
+    AppDiagTiming_t loop;
+    /* Task of the last stall, APP_DIAG_LOOP_ID for the loop */
+    uint8_t lastStallId;
+    uint32_t lastStallUs;
+    /* Frame counter records written for the uplinks sent, counters
+     * skipped by the last restore */
+    uint32_t fcntWrites;
+    uint32_t fcntUplinks;
+    uint32_t fcntGap;
+} AppDiag_t;
+
+/****************************** PROTOTYPES **************************************/
+void APP_DIAG_Init(uint8_t resetCause);
+void APP_DIAG_StackInit(uint32_t *bottom, uint32_t *top, uint32_t *paintLimit);
+uint32_t APP_DIAG_StackUsed(void);
+void APP_DIAG_RecordTask(uint8_t taskId, uint32_t durationUs);
+void APP_DIAG_RecordLoop(uint32_t durationUs);
+void APP_DIAG_RecordFcnt(uint32_t writes, uint32_t uplinks, uint32_t gap);
+const AppDiag_t *APP_DIAG_Get(void);
+uint8_t APP_DIAG_Serialize(uint8_t *buffer, uint8_t maxLength);
+void APP_DIAG_Print(void);
+
+#endif /* APP_DIAG_H_ */
@@ -0,0 +1,269 @@
+/**
+* \file  app_format.c
+*
+* \brief Console output and band lookup of the application
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include "app_format.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+const char *bandStrings[] =
+{
+    "FactoryDefaultReset",
+#if (EU_BAND == 1)
+    "EU868",
+#endif
+    "Clear PDS",
+    "Reset Board"
+};
+
+uint8_t bandTable[] =
+{
+    0xFF,
+#if (EU_BAND == 1)
+    ISM_EU868,
+#endif
+    0xFF,
+    0xFF
+};
+
+const uint8_t bandCount = sizeof(bandTable);
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Prints an array as one hexadecimal number
+\param[in]  array  - bytes to print, first byte first
+\param[in]  length - number of bytes
+*************************************************************************/
+void APP_FORMAT_PrintArray(const uint8_t *array, uint8_t length)
+{
+    printf("0x");
+    for (uint8_t i =0; i < length; i++)
+    {
+        printf("%02x", *array);
+        array++;
+    }
+    printf("\n\r");
+}
+
+/*********************************************************************//**
+\brief      Prints the status of a received data event
+\param[in]  status - status of the event, nothing is printed on success
+*************************************************************************/
+void APP_FORMAT_PrintRxStatus(StackRetStatus_t status)
+{
+    switch(status)
+    {
+        case LORAWAN_SUCCESS:
+            /* The payload is handled by the caller */
+        break;
+        case LORAWAN_RADIO_NO_DATA:
+        {
+            printf("\n\rRADIO_NO_DATA \n\r");
+        }
+        break;
+        case LORAWAN_RADIO_DATA_SIZE:
+            printf("\n\rRADIO_DATA_SIZE \n\r");
+        break;
+        case LORAWAN_RADIO_INVALID_REQ:
+            printf("\n\rRADIO_INVALID_REQ \n\r");
+        break;
+        case LORAWAN_RADIO_BUSY:
+            printf("\n\rRADIO_BUSY \n\r");
+        break;
+        case LORAWAN_RADIO_OUT_OF_RANGE:
+            printf("\n\rRADIO_OUT_OF_RANGE \n\r");
+        break;
+        case LORAWAN_RADIO_UNSUPPORTED_ATTR:
+            printf("\n\rRADIO_UNSUPPORTED_ATTR \n\r");
+        break;
+        case LORAWAN_RADIO_CHANNEL_BUSY:
+            printf("\n\rRADIO_CHANNEL_BUSY \n\r");
+        break;
+        case LORAWAN_NWK_NOT_JOINED:
+            printf("\n\rNWK_NOT_JOINED \n\r");
+        break;
+        case LORAWAN_INVALID_PARAMETER:
+            printf("\n\rINVALID_PARAMETER \n\r");
+        break;
+        case LORAWAN_KEYS_NOT_INITIALIZED:
+            printf("\n\rKEYS_NOT_INITIALIZED \n\r");
+        break;
+        case LORAWAN_SILENT_IMMEDIATELY_ACTIVE:
+            printf("\n\rSILENT_IMMEDIATELY_ACTIVE\n\r");
+        break;
+        case LORAWAN_FCNTR_ERROR_REJOIN_NEEDED:
+            printf("\n\rFCNTR_ERROR_REJOIN_NEEDED \n\r");
+        break;
+        case LORAWAN_INVALID_BUFFER_LENGTH:
+            printf("\n\rINVALID_BUFFER_LENGTH \n\r");
+        break;
+        case LORAWAN_MAC_PAUSED :
+            printf("\n\rMAC_PAUSED  \n\r");
+        break;
+        case LORAWAN_NO_CHANNELS_FOUND:
+            printf("\n\rNO_CHANNELS_FOUND_1 \n\r");
+        break;
+        case LORAWAN_BUSY:
+            printf("\n\rBUSY\n\r");
+        break;
+        case LORAWAN_NO_ACK:
+            printf("\n\rNO_ACK \n\r");
+        break;
+        case LORAWAN_NWK_JOIN_IN_PROGRESS:
+            printf("\n\rALREADY JOINING IS IN PROGRESS \n\r");
+        break;
+        case LORAWAN_RESOURCE_UNAVAILABLE:
+            printf("\n\rRESOURCE_UNAVAILABLE \n\r");
+        break;
+        case LORAWAN_INVALID_REQUEST:
+            printf("\n\rINVALID_REQUEST \n\r");
+        break;
+        case LORAWAN_FCNTR_ERROR:
+            printf("\n\rFCNTR_ERROR \n\r");
+        break;
+        case LORAWAN_MIC_ERROR:
+            printf("\n\rMIC_ERROR \n\r");
+        break;
+        case LORAWAN_INVALID_MTYPE:
+            printf("\n\rINVALID_MTYPE \n\r");
+        break;
+        case LORAWAN_MCAST_HDR_INVALID:
+            printf("\n\rMCAST_HDR_INVALID \n\r");
+        break;
+        case LORAWAN_INVALID_PACKET:
+            printf("\n\rINVALID_PACKET \n\r");
+        break;
+        default:
+            printf("UNKNOWN ERROR\n\r");
+        break;
+    }
+}
+
+/*********************************************************************//**
+\brief      Prints the status of a completed transaction
+\param[in]  status - status of the transaction
+*************************************************************************/
+void APP_FORMAT_PrintTxStatus(StackRetStatus_t status)
+{
+    switch(status)
+    {
+        case LORAWAN_SUCCESS:
+        {
+            printf("Transmission Success 1\r\n");
+        }
+        break;
+        case LORAWAN_RADIO_SUCCESS:
+        {
+            printf("Transmission Success 2\r\n");
+        }
+        break;
+        case LORAWAN_RADIO_NO_DATA:
+        {
+            printf("\n\rRADIO_NO_DATA \n\r");
+        }
+        break;
+        case LORAWAN_RADIO_DATA_SIZE:
+            printf("\n\rRADIO_DATA_SIZE \n\r");
+        break;
+        case LORAWAN_RADIO_INVALID_REQ:
+            printf("\n\rRADIO_INVALID_REQ \n\r");
+        break;
+        case LORAWAN_RADIO_BUSY:
+            printf("\n\rRADIO_BUSY \n\r");
+        break;
+        case LORAWAN_TX_TIMEOUT:
+            printf("\nTx Timeout\n\r");
+        break;
+        case LORAWAN_RADIO_OUT_OF_RANGE:
+            printf("\n\rRADIO_OUT_OF_RANGE \n\r");
+        break;
+        case LORAWAN_RADIO_UNSUPPORTED_ATTR:
+            printf("\n\rRADIO_UNSUPPORTED_ATTR \n\r");
+        break;
+        case LORAWAN_RADIO_CHANNEL_BUSY:
+            printf("\n\rRADIO_CHANNEL_BUSY \n\r");
+        break;
+        case LORAWAN_NWK_NOT_JOINED:
+            printf("\n\rNWK_NOT_JOINED \n\r");
+        break;
+        case LORAWAN_INVALID_PARAMETER:
+            printf("\n\rINVALID_PARAMETER \n\r");
+        break;
+        case LORAWAN_KEYS_NOT_INITIALIZED:
+            printf("\n\rKEYS_NOT_INITIALIZED \n\r");
+        break;
+        case LORAWAN_SILENT_IMMEDIATELY_ACTIVE:
+            printf("\n\rSILENT_IMMEDIATELY_ACTIVE\n\r");
+        break;
+        case LORAWAN_FCNTR_ERROR_REJOIN_NEEDED:
+            printf("\n\rFCNTR_ERROR_REJOIN_NEEDED \n\r");
+        break;
+        case LORAWAN_INVALID_BUFFER_LENGTH:
+            printf("\n\rINVALID_BUFFER_LENGTH \n\r");
+        break;
+        case LORAWAN_MAC_PAUSED :
+            printf("\n\rMAC_PAUSED  \n\r");
+        break;
+        case LORAWAN_NO_CHANNELS_FOUND:
+            printf("\n\rNO_CHANNELS_FOUND_2 \n\r");
+        break;
+        case LORAWAN_BUSY:
+            printf("\n\rBUSY\n\r");
+        break;
+        case LORAWAN_NO_ACK:
+            printf("\n\rNO_ACK \n\r");
+        break;
+        case LORAWAN_NWK_JOIN_IN_PROGRESS:
+            printf("\n\rALREADY JOINING IS IN PROGRESS \n\r");
+        break;
+        case LORAWAN_RESOURCE_UNAVAILABLE:
+            printf("\n\rRESOURCE_UNAVAILABLE \n\r");
+        break;
+        case LORAWAN_INVALID_REQUEST:
+            printf("\n\rINVALID_REQUEST \n\r");
+        break;
+        case LORAWAN_FCNTR_ERROR:
+            printf("\n\rFCNTR_ERROR \n\r");
+        break;
+        case LORAWAN_MIC_ERROR:
+            printf("\n\rMIC_ERROR \n\r");
+        break;
+        case LORAWAN_INVALID_MTYPE:
+            printf("\n\rINVALID_MTYPE \n\r");
+        break;
+        case LORAWAN_MCAST_HDR_INVALID:
+            printf("\n\rMCAST_HDR_INVALID \n\r");
+        break;
+        case LORAWAN_INVALID_PACKET:
+            printf("\n\rINVALID_PACKET \n\r");
+        break;
+        default:
+            printf("\n\rUNKNOWN ERROR\n\r");
+        break;
+    }
+}
+
+/*********************************************************************//**
+\brief      Finds a band among the bands of the start-up menu
+\param[in]  band - band identifier of the stack
+\return     index in bandTable, 0xFF if the band is not offered
+*************************************************************************/
+uint8_t APP_FORMAT_FindBand(uint8_t band)
+{
+    uint8_t choice = 0xff;
+
+    for (uint32_t i = 0; i < sizeof(bandTable)-1; i++)
+    {
+        if(bandTable[i] == band)
+        {
+            choice = i;
+            break;
+        }
+    }
+    return choice;
+}
@@ -0,0 +1,36 @@
+/**
+* \file  app_format.h
+*
+* \brief Console output and band lookup of the application that do not
+*        depend on the stack, so that the host benchmarks build them too
+*
+* The stack status codes come from lorawan.h on the device and from the
+* stand-in of the host programs when APP_HOST_BUILD is defined.
+*/
+
+#ifndef APP_FORMAT_H_
+#define APP_FORMAT_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef APP_HOST_BUILD
+#include "stack_status.h"
+#else
+#include "lorawan.h"
+#endif
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* Bands of the start-up menu, with the reset choices around them */
+extern uint8_t bandTable[];
+extern const char *bandStrings[];
+/* Entries of bandTable and bandStrings */
+extern const uint8_t bandCount;
+
+/****************************** PROTOTYPES **************************************/
+void APP_FORMAT_PrintArray(const uint8_t *array, uint8_t length);
+void APP_FORMAT_PrintRxStatus(StackRetStatus_t status);
+void APP_FORMAT_PrintTxStatus(StackRetStatus_t status);
+uint8_t APP_FORMAT_FindBand(uint8_t band);
+
+#endif /* APP_FORMAT_H_ */
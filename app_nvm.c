@@ -0,0 +1,121 @@
+/**
+* \file  app_nvm.c
+*
+* \brief Application data storage in the internal flash
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "asf.h"
+#include "nvm.h"
+#include "conf_app.h"
+#include "app_nvm.h"
+
+/************************** FUNCTION PROTOTYPES ********************************/
+static bool app_nvm_read(uint32_t offset, uint8_t *data, uint16_t length);
+static bool app_nvm_write(uint32_t offset, const uint8_t *data, uint16_t length);
+static bool app_nvm_erase(uint32_t offset, uint32_t length);
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const AppNvmOps_t appNvmOps =
+{
+    app_nvm_read,
+    app_nvm_write,
+    app_nvm_erase
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Configures the NVM controller for automatic page writes
+*************************************************************************/
+void APP_NVM_Init(void)
+{
+    struct nvm_config config_nvm;
+
+    nvm_get_config_defaults(&config_nvm);
+    config_nvm.manual_page_write = false;
+    nvm_set_config(&config_nvm);
+}
+
+/*********************************************************************//**
+\brief      Returns the flash backed storage operations
+*************************************************************************/
+const AppNvmOps_t *APP_NVM_GetOps(void)
+{
+    return &appNvmOps;
+}
+
+static bool app_nvm_read(uint32_t offset, uint8_t *data, uint16_t length)
+{
+    if ((offset + length) > APP_NVM_SIZE)
+    {
+        return false;
+    }
+    /* The flash is memory mapped */
+    memcpy(data, (const void *)(uintptr_t)(APP_NVM_BASE + offset), length);
+    return true;
+}
+
+static bool app_nvm_write(uint32_t offset, const uint8_t *data, uint16_t length)
+{
+    uint8_t page[APP_NVM_PAGE_SIZE];
+    enum status_code status;
+
+    if ((offset + length) > APP_NVM_SIZE)
+    {
+        return false;
+    }
+
+    while (length > 0)
+    {
+        uint32_t pageOffset = offset % APP_NVM_PAGE_SIZE;
+        uint16_t chunk = APP_NVM_PAGE_SIZE - pageOffset;
+
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+
+        /* Erased bytes are 0xFF, programming them again leaves them untouched */
+        memset(page, 0xFF, sizeof(page));
+        memcpy(&page[pageOffset], data, chunk);
+        do
+        {
+            status = nvm_write_buffer(APP_NVM_BASE + offset - pageOffset, page, APP_NVM_PAGE_SIZE);
+        } while (STATUS_BUSY == status);
+
+        if (STATUS_OK != status)
+        {
+            return false;
+        }
+        offset += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+static bool app_nvm_erase(uint32_t offset, uint32_t length)
+{
+    enum status_code status;
+
+    if (((offset % APP_NVM_ROW_SIZE) != 0) || ((offset + length) > APP_NVM_SIZE))
+    {
+        return false;
+    }
+
+    for (uint32_t row = 0; row < length; row += APP_NVM_ROW_SIZE)
+    {
+        do
+        {
+            status = nvm_erase_row(APP_NVM_BASE + offset + row);
+        } while (STATUS_BUSY == status);
+
+        if (STATUS_OK != status)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+/**
+* \file  app_nvm.h
+*
+* \brief Application data storage in the internal flash
+*
+* The application owns APP_NVM_SIZE bytes of main flash from APP_NVM_BASE,
+* outside of the area used by PDS. Modules address it through an
+* AppNvmOps_t table with offsets relative to the start of that area, so a
+* RAM stand-in can replace the flash on a host.
+*/
+
+#ifndef APP_NVM_H_
+#define APP_NVM_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Smallest erasable unit and smallest programmable unit */
+#define APP_NVM_ROW_SIZE                    256u
+#define APP_NVM_PAGE_SIZE                   64u
+
+/* Rounds a length up to whole rows */
+#define APP_NVM_ROW_ALIGN(len)              ((((len) + APP_NVM_ROW_SIZE - 1u) / APP_NVM_ROW_SIZE) * APP_NVM_ROW_SIZE)
+
+/****************************** TYPES **************************************/
+typedef struct _AppNvmOps_t
+{
+    bool (*read)(uint32_t offset, uint8_t *data, uint16_t length);
+    /* Programs previously erased bytes, any alignment */
+    bool (*write)(uint32_t offset, const uint8_t *data, uint16_t length);
+    /* Erases whole rows, offset and length are row aligned */
+    bool (*erase)(uint32_t offset, uint32_t length);
+} AppNvmOps_t;
+
+/****************************** PROTOTYPES **************************************/
+void APP_NVM_Init(void);
+const AppNvmOps_t *APP_NVM_GetOps(void);
+
+#endif /* APP_NVM_H_ */
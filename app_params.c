@@ -0,0 +1,80 @@
+/**
+* \file  app_params.c
+*
+* \brief Runtime tunable sampling and reporting parameters
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "app_params.h"
+#include "conf_app.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* Only written from task context, readers always see a complete set */
+static AppParams_t appParams;
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Loads the build time defaults of conf_app.h
+*************************************************************************/
+void APP_PARAMS_Init(void)
+{
+    appParams.alarmThreshold = DEMO_APP_ACC_ALARM_THRESHOLD;
+    appParams.samplePeriodMs = DEMO_CONF_DEFAULT_APP_SLEEP_TIME_MS;
+    appParams.confirmCount = DEMO_APP_ACC_ALARM_CONFIRM_COUNT;
+    appParams.statusPeriods = DEMO_APP_STATUS_REPORT_PERIODS;
+}
+
+/*********************************************************************//**
+\brief      Returns the parameters in use
+*************************************************************************/
+const AppParams_t *APP_PARAMS_Get(void)
+{
+    return &appParams;
+}
+
+/*********************************************************************//**
+\brief      Checks every field of a parameter set against its range
+\param[in]  params - parameter set to check
+\return     true if the whole set may be applied
+*************************************************************************/
+bool APP_PARAMS_Validate(const AppParams_t *params)
+{
+    /* Written so that a NaN threshold is rejected as well */
+    if (!((params->alarmThreshold >= APP_PARAMS_THRESHOLD_MIN) &&
+          (params->alarmThreshold <= APP_PARAMS_THRESHOLD_MAX)))
+    {
+        return false;
+    }
+    if ((params->samplePeriodMs < APP_PARAMS_SAMPLE_PERIOD_MIN_MS) ||
+        (params->samplePeriodMs > APP_PARAMS_SAMPLE_PERIOD_MAX_MS))
+    {
+        return false;
+    }
+    if ((params->confirmCount < APP_PARAMS_CONFIRM_COUNT_MIN) ||
+        (params->confirmCount > APP_PARAMS_CONFIRM_COUNT_MAX))
+    {
+        return false;
+    }
+    if (params->statusPeriods < APP_PARAMS_STATUS_PERIODS_MIN)
+    {
+        return false;
+    }
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Replaces the parameters in use by a validated set
+\param[in]  params - new parameter set
+\return     true if applied, false if rejected and nothing changed
+*************************************************************************/
+bool APP_PARAMS_Apply(const AppParams_t *params)
+{
+    if (!APP_PARAMS_Validate(params))
+    {
+        return false;
+    }
+    appParams = *params;
+    return true;
+}
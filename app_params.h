@@ -0,0 +1,44 @@
+/**
+* \file  app_params.h
+*
+* \brief Runtime tunable sampling and reporting parameters
+*
+*/
+
+#ifndef APP_PARAMS_H_
+#define APP_PARAMS_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Accepted ranges of the runtime parameters */
+#define APP_PARAMS_THRESHOLD_MIN            0.0f
+#define APP_PARAMS_THRESHOLD_MAX            20.0f
+#define APP_PARAMS_SAMPLE_PERIOD_MIN_MS     1000u
+#define APP_PARAMS_SAMPLE_PERIOD_MAX_MS     3600000u
+#define APP_PARAMS_CONFIRM_COUNT_MIN        1u
+#define APP_PARAMS_CONFIRM_COUNT_MAX        20u
+#define APP_PARAMS_STATUS_PERIODS_MIN       1u
+
+/****************************** TYPES **************************************/
+typedef struct _AppParams_t
+{
+    /* Alarm threshold, in the unit returned by ACC_CODE_TO_VALUE() */
+    float alarmThreshold;
+    /* Sleep duration between two samples */
+    uint32_t samplePeriodMs;
+    /* Consecutive readings above the threshold that raise an alarm */
+    uint8_t confirmCount;
+    /* Sample periods between two status reports */
+    uint8_t statusPeriods;
+} AppParams_t;
+
+/****************************** PROTOTYPES **************************************/
+void APP_PARAMS_Init(void);
+const AppParams_t *APP_PARAMS_Get(void);
+bool APP_PARAMS_Validate(const AppParams_t *params);
+bool APP_PARAMS_Apply(const AppParams_t *params);
+
+#endif /* APP_PARAMS_H_ */
@@ -0,0 +1,188 @@
+/**
+* \file  app_timer.c
+*
+* \brief Application timers multiplexed over one SW timer
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "app_timer.h"
+
+/****************************** TYPES **************************************/
+typedef struct _AppTimer_t
+{
+    bool created;
+    bool running;
+    uint64_t expiry;
+    uint32_t slack;
+    AppTimerCb_t cb;
+    void *param;
+} AppTimer_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static AppTimer_t appTimers[APP_TIMER_COUNT];
+static const AppTimerOps_t *appTimerOps = NULL;
+static AppTimerStats_t appTimerStats;
+/* Set while callbacks run, re-arming is done once they all returned */
+static bool appTimerDispatching = false;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Arms the underlying timer for the earliest expiry + slack */
+static void app_timer_schedule(void)
+{
+    uint64_t deadline = UINT64_MAX;
+    uint64_t now;
+
+    if (appTimerDispatching)
+    {
+        return;
+    }
+
+    for (uint8_t id = 0; id < APP_TIMER_COUNT; id++)
+    {
+        if (appTimers[id].running && ((appTimers[id].expiry + appTimers[id].slack) < deadline))
+        {
+            deadline = appTimers[id].expiry + appTimers[id].slack;
+        }
+    }
+
+    if (UINT64_MAX == deadline)
+    {
+        appTimerOps->disarm();
+        return;
+    }
+
+    now = appTimerOps->now();
+    if (deadline < (now + APP_TIMER_MIN_DELAY_US))
+    {
+        deadline = now + APP_TIMER_MIN_DELAY_US;
+    }
+    appTimerOps->arm((uint32_t)(deadline - now));
+}
+
+/*********************************************************************//**
+\brief      Initializes the timer service
+\param[in]  ops - underlying timer and time base
+*************************************************************************/
+void APP_TIMER_Init(const AppTimerOps_t *ops)
+{
+    appTimerOps = ops;
+    appTimerDispatching = false;
+    memset(appTimers, 0, sizeof(appTimers));
+    memset(&appTimerStats, 0, sizeof(appTimerStats));
+}
+
+/*********************************************************************//**
+\brief      Allocates a logical timer
+\param[out] id - identifier of the timer
+\return     false if every timer is in use
+*************************************************************************/
+bool APP_TIMER_Create(uint8_t *id)
+{
+    for (uint8_t i = 0; i < APP_TIMER_COUNT; i++)
+    {
+        if (!appTimers[i].created)
+        {
+            appTimers[i].created = true;
+            *id = i;
+            return true;
+        }
+    }
+    *id = APP_TIMER_INVALID_ID;
+    return false;
+}
+
+/*********************************************************************//**
+\brief      Starts or restarts a logical timer
+\param[in]  id        - timer identifier
+\param[in]  timeoutUs - delay from now
+\param[in]  slackUs   - tolerated extra delay, used to merge wakeups
+\param[in]  cb        - called on expiry
+\param[in]  param     - passed to cb
+*************************************************************************/
+void APP_TIMER_Start(uint8_t id, uint32_t timeoutUs, uint32_t slackUs, AppTimerCb_t cb, void *param)
+{
+    if ((id >= APP_TIMER_COUNT) || !appTimers[id].created || (NULL == appTimerOps))
+    {
+        return;
+    }
+
+    appTimers[id].expiry = appTimerOps->now() + timeoutUs;
+    appTimers[id].slack = slackUs;
+    appTimers[id].cb = cb;
+    appTimers[id].param = param;
+    appTimers[id].running = true;
+    app_timer_schedule();
+}
+
+/*********************************************************************//**
+\brief      Stops a logical timer
+*************************************************************************/
+void APP_TIMER_Stop(uint8_t id)
+{
+    if ((id >= APP_TIMER_COUNT) || !appTimers[id].running)
+    {
+        return;
+    }
+    appTimers[id].running = false;
+    app_timer_schedule();
+}
+
+/*********************************************************************//**
+\brief      Returns true while a logical timer is running
+*************************************************************************/
+bool APP_TIMER_IsRunning(uint8_t id)
+{
+    return (id < APP_TIMER_COUNT) && appTimers[id].running;
+}
+
+/*********************************************************************//**
+\brief      Expiry of the underlying timer, fires every due logical timer
+*************************************************************************/
+void APP_TIMER_Expired(void)
+{
+    uint64_t now;
+    bool due[APP_TIMER_COUNT];
+
+    if (NULL == appTimerOps)
+    {
+        return;
+    }
+
+    appTimerStats.wakeups++;
+    now = appTimerOps->now();
+
+    /* Collect first, callbacks may restart their own timer */
+    for (uint8_t id = 0; id < APP_TIMER_COUNT; id++)
+    {
+        due[id] = appTimers[id].running && (appTimers[id].expiry <= now);
+        if (due[id])
+        {
+            appTimers[id].running = false;
+        }
+    }
+
+    appTimerDispatching = true;
+    for (uint8_t id = 0; id < APP_TIMER_COUNT; id++)
+    {
+        if (due[id] && (NULL != appTimers[id].cb))
+        {
+            appTimerStats.fired++;
+            appTimers[id].cb(appTimers[id].param);
+        }
+    }
+    appTimerDispatching = false;
+
+    app_timer_schedule();
+}
+
+/*********************************************************************//**
+\brief      Returns the wakeup and callback counters
+*************************************************************************/
+const AppTimerStats_t *APP_TIMER_GetStats(void)
+{
+    return &appTimerStats;
+}
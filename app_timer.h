@@ -0,0 +1,59 @@
+/**
+* \file  app_timer.h
+*
+* \brief Application timers multiplexed over one SW timer
+*
+* Every logical timer carries a slack, the delay it tolerates after its
+* expiry. The underlying timer is armed for the earliest expiry + slack,
+* and every logical timer already due at that point fires in the same
+* wakeup.
+*/
+
+#ifndef APP_TIMER_H_
+#define APP_TIMER_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Number of logical timers */
+#ifndef APP_TIMER_COUNT
+#define APP_TIMER_COUNT                     6u
+#endif
+
+/* Shortest delay the underlying timer is armed with */
+#define APP_TIMER_MIN_DELAY_US              1000u
+
+#define APP_TIMER_INVALID_ID                0xFFu
+
+/****************************** TYPES **************************************/
+typedef void (*AppTimerCb_t)(void *param);
+
+typedef struct _AppTimerOps_t
+{
+    /* Free running time in microseconds */
+    uint64_t (*now)(void);
+    /* (Re)arms the underlying timer, APP_TIMER_Expired() is called on expiry */
+    void (*arm)(uint32_t delayUs);
+    void (*disarm)(void);
+} AppTimerOps_t;
+
+typedef struct _AppTimerStats_t
+{
+    /* Expirations of the underlying timer */
+    uint32_t wakeups;
+    /* Logical timer callbacks run */
+    uint32_t fired;
+} AppTimerStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void APP_TIMER_Init(const AppTimerOps_t *ops);
+bool APP_TIMER_Create(uint8_t *id);
+void APP_TIMER_Start(uint8_t id, uint32_t timeoutUs, uint32_t slackUs, AppTimerCb_t cb, void *param);
+void APP_TIMER_Stop(uint8_t id);
+bool APP_TIMER_IsRunning(uint8_t id);
+void APP_TIMER_Expired(void);
+const AppTimerStats_t *APP_TIMER_GetStats(void);
+
+#endif /* APP_TIMER_H_ */
@@ -0,0 +1,161 @@
+/**
+* \file  battery.c
+*
+* \brief Battery state of charge and power tiers
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include "battery.h"
+
+/****************************** TYPES **************************************/
+typedef struct _BatteryCurvePoint_t
+{
+    uint16_t mv;
+    uint8_t soc;
+} BatteryCurvePoint_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* Two alkaline AA cells at a low drain, highest voltage first */
+static const BatteryCurvePoint_t batteryCurve[] =
+{
+    { 3200, 100 },
+    { 2900, 80 },
+    { 2700, 60 },
+    { 2550, 40 },
+    { 2400, 20 },
+    { 2200, 5 },
+    { 2000, 0 }
+};
+
+static const BatteryPolicy_t batteryPolicies[BATTERY_TIER_COUNT] =
+{
+    /* sleep, status, LED */
+    { 1, 1, true },
+    { 2, 2, false },
+    { 4, 4, false }
+};
+
+static uint16_t batteryMv = 0;
+static uint8_t batterySoc = 100;
+static BatteryTier_t batteryTier = BATTERY_TIER_NORMAL;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Tier for a charge level, leaving a tier needs the hysteresis on top */
+static BatteryTier_t battery_next_tier(BatteryTier_t tier, uint8_t soc)
+{
+    BatteryTier_t target = BATTERY_TIER_NORMAL;
+
+    if (soc < BATTERY_CRITICAL_ENTER_SOC)
+    {
+        target = BATTERY_TIER_CRITICAL;
+    }
+    else if (soc < BATTERY_SAVE_ENTER_SOC)
+    {
+        target = BATTERY_TIER_SAVE;
+    }
+
+    if (target >= tier)
+    {
+        return target;
+    }
+
+    /* Moving up one tier at a time once clear of its entry level */
+    if ((BATTERY_TIER_CRITICAL == tier) && (soc >= (BATTERY_CRITICAL_ENTER_SOC + BATTERY_TIER_HYSTERESIS)))
+    {
+        tier = BATTERY_TIER_SAVE;
+    }
+    if ((BATTERY_TIER_SAVE == tier) && (soc >= (BATTERY_SAVE_ENTER_SOC + BATTERY_TIER_HYSTERESIS)))
+    {
+        tier = BATTERY_TIER_NORMAL;
+    }
+    return tier;
+}
+
+/*********************************************************************//**
+\brief      Resets the estimator, the first reading is taken as is
+*************************************************************************/
+void BATTERY_Init(void)
+{
+    batteryMv = 0;
+    batterySoc = 100;
+    batteryTier = BATTERY_TIER_NORMAL;
+}
+
+/*********************************************************************//**
+\brief      Maps a voltage on the discharge curve
+\param[in]  mv - battery voltage
+\return     state of charge in percent
+*************************************************************************/
+uint8_t BATTERY_SocFromMv(uint16_t mv)
+{
+    const uint8_t last = (uint8_t)(sizeof(batteryCurve) / sizeof(batteryCurve[0]) - 1u);
+
+    if (mv >= batteryCurve[0].mv)
+    {
+        return batteryCurve[0].soc;
+    }
+
+    for (uint8_t i = 1; i <= last; i++)
+    {
+        if (mv >= batteryCurve[i].mv)
+        {
+            const BatteryCurvePoint_t *hi = &batteryCurve[i - 1u];
+            const BatteryCurvePoint_t *lo = &batteryCurve[i];
+
+            return (uint8_t)(lo->soc + ((uint32_t)(mv - lo->mv) * (hi->soc - lo->soc)) / (hi->mv - lo->mv));
+        }
+    }
+    return batteryCurve[last].soc;
+}
+
+/*********************************************************************//**
+\brief      Takes a new VBAT reading into account
+\param[in]  vbatMv - measured battery voltage
+\return     tier the application runs in
+*************************************************************************/
+BatteryTier_t BATTERY_Update(uint16_t vbatMv)
+{
+    if (0 == batteryMv)
+    {
+        batteryMv = vbatMv;
+    }
+    else
+    {
+        if ((vbatMv + BATTERY_MAX_DIP_MV) < batteryMv)
+        {
+            vbatMv = (uint16_t)(batteryMv - BATTERY_MAX_DIP_MV);
+        }
+        batteryMv = (uint16_t)(batteryMv - (batteryMv >> BATTERY_EWMA_SHIFT) + (vbatMv >> BATTERY_EWMA_SHIFT));
+    }
+
+    batterySoc = BATTERY_SocFromMv(batteryMv);
+    batteryTier = battery_next_tier(batteryTier, batterySoc);
+    return batteryTier;
+}
+
+/*********************************************************************//**
+\brief      Returns the estimated state of charge in percent
+*************************************************************************/
+uint8_t BATTERY_GetSoc(void)
+{
+    return batterySoc;
+}
+
+/*********************************************************************//**
+\brief      Returns the current power tier
+*************************************************************************/
+BatteryTier_t BATTERY_GetTier(void)
+{
+    return batteryTier;
+}
+
+/*********************************************************************//**
+\brief      Returns the behaviour of the current power tier
+*************************************************************************/
+const BatteryPolicy_t *BATTERY_GetPolicy(void)
+{
+    return &batteryPolicies[batteryTier];
+}
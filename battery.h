@@ -0,0 +1,60 @@
+/**
+* \file  battery.h
+*
+* \brief Battery state of charge and power tiers
+*
+* The smoothed VBAT reading is mapped onto a discharge curve to estimate
+* the state of charge. As the charge drops, the application moves to
+* tiers that sleep longer, report status less often and keep the LEDs
+* off. Alarms are sent in every tier. Tier changes have hysteresis, and
+* readings far below the smoothed voltage are limited, so a voltage
+* sagging under load does not make the tier flap.
+*/
+
+#ifndef BATTERY_H_
+#define BATTERY_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* State of charge, in percent, below which a tier is entered */
+#define BATTERY_SAVE_ENTER_SOC              30u
+#define BATTERY_CRITICAL_ENTER_SOC          10u
+/* Charge to regain over the entry level before leaving a tier */
+#define BATTERY_TIER_HYSTERESIS             5u
+
+/* Weight of a new reading in the smoothed voltage, 1/2^n */
+#define BATTERY_EWMA_SHIFT                  2
+/* Largest drop of a reading under the smoothed voltage taken into account,
+ * deeper readings are dips of the supply under load */
+#define BATTERY_MAX_DIP_MV                  40u
+
+/****************************** TYPES **************************************/
+typedef enum _BatteryTier_t
+{
+    BATTERY_TIER_NORMAL = 0,
+    BATTERY_TIER_SAVE,
+    BATTERY_TIER_CRITICAL,
+    BATTERY_TIER_COUNT
+} BatteryTier_t;
+
+typedef struct _BatteryPolicy_t
+{
+    /* Factor applied to the sleep duration */
+    uint8_t sleepMultiplier;
+    /* Factor applied to the sample periods between status reports */
+    uint8_t statusScale;
+    bool ledEnabled;
+} BatteryPolicy_t;
+
+/****************************** PROTOTYPES **************************************/
+void BATTERY_Init(void);
+BatteryTier_t BATTERY_Update(uint16_t vbatMv);
+uint8_t BATTERY_SocFromMv(uint16_t mv);
+uint8_t BATTERY_GetSoc(void);
+BatteryTier_t BATTERY_GetTier(void);
+const BatteryPolicy_t *BATTERY_GetPolicy(void);
+
+#endif /* BATTERY_H_ */
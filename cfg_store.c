@@ -0,0 +1,315 @@
+/**
+* \file  cfg_store.c
+*
+* \brief Site configuration record in the application flash area
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "cfg_store.h"
+
+/******************************** MACROS ***************************************/
+#define CFG_STORE_HEADER_LENGTH             6u
+#define CFG_STORE_CRC_LENGTH                2u
+#define CFG_STORE_SLOTS                     2u
+#define CFG_STORE_SUBBAND_MAX               8u
+#define CFG_STORE_FPORT_MAX                 223u
+
+#define CFG_FIELD(field)                    { offsetof(CfgValues_t, field), sizeof(((CfgValues_t *)0)->field) }
+
+/****************************** TYPES **************************************/
+typedef struct _CfgStoreField_t
+{
+    uint8_t offset;
+    uint8_t size;
+} CfgStoreField_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* Append only, a new schema adds its fields at the end */
+static const CfgStoreField_t cfgFields[] =
+{
+    /* Schema 1 */
+    CFG_FIELD(fport),
+    CFG_FIELD(edClass),
+    CFG_FIELD(activationType),
+    CFG_FIELD(subband),
+    CFG_FIELD(params.alarmThreshold),
+    CFG_FIELD(params.samplePeriodMs),
+    CFG_FIELD(params.confirmCount),
+    CFG_FIELD(params.statusPeriods),
+    CFG_FIELD(mcastEnable),
+    CFG_FIELD(mcastGroupId),
+    CFG_FIELD(mcastGroupAddr),
+    CFG_FIELD(mcastNwkSKey),
+    CFG_FIELD(mcastAppSKey),
+    CFG_FIELD(payloadEncKey),
+    CFG_FIELD(payloadMacKey)
+};
+
+/* Number of fields of every schema, indexed by version */
+static const uint8_t cfgFieldsOfVersion[CFG_STORE_VERSION + 1u] =
+{
+    0,
+    15
+};
+
+static CfgValues_t cfgValues;
+const CfgValues_t *const cfgStoreValues = &cfgValues;
+/* Content of the record in use, later saves start from it */
+static CfgValues_t cfgStored;
+
+static const AppNvmOps_t *cfgNvm = NULL;
+static uint32_t cfgNvmOffset = 0;
+/* Slot of the record in use, CFG_STORE_SLOTS when there is none */
+static uint8_t cfgSlot = CFG_STORE_SLOTS;
+static uint16_t cfgSequence = 0;
+static uint8_t cfgBuffer[APP_NVM_ROW_SIZE];
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint16_t cfg_get_u16(const uint8_t *data)
+{
+    return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static void cfg_put_u16(uint8_t *data, uint16_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+}
+
+/* Bytes taken by the first count fields */
+static uint16_t cfg_fields_length(uint8_t count)
+{
+    uint16_t length = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        length += cfgFields[i].size;
+    }
+    return length;
+}
+
+/* Reads the record of a slot into cfgBuffer, returns its version or 0 */
+static uint8_t cfg_read_slot(uint8_t slot, uint16_t *sequence)
+{
+    uint8_t *header = cfgBuffer;
+    uint16_t length;
+
+    if (!cfgNvm->read(cfgNvmOffset + slot * APP_NVM_ROW_SIZE, header, CFG_STORE_HEADER_LENGTH) ||
+        (CFG_STORE_MAGIC != cfg_get_u16(&header[0])) || (0 == header[2]))
+    {
+        return 0;
+    }
+
+    length = CFG_STORE_HEADER_LENGTH + header[3];
+    if (((length + CFG_STORE_CRC_LENGTH) > sizeof(cfgBuffer)) ||
+        !cfgNvm->read(cfgNvmOffset + slot * APP_NVM_ROW_SIZE + CFG_STORE_HEADER_LENGTH,
+                      &cfgBuffer[CFG_STORE_HEADER_LENGTH], header[3] + CFG_STORE_CRC_LENGTH) ||
+        (CFG_STORE_Crc16(cfgBuffer, length) != cfg_get_u16(&cfgBuffer[length])))
+    {
+        return 0;
+    }
+
+    *sequence = cfg_get_u16(&header[4]);
+    return header[2];
+}
+
+/* Replaces the defaults by the fields of the record in cfgBuffer */
+static CfgStoreSource_t cfg_decode(CfgValues_t *values)
+{
+    uint8_t version = cfgBuffer[2];
+    uint8_t count = (version > CFG_STORE_VERSION) ? cfgFieldsOfVersion[CFG_STORE_VERSION] : cfgFieldsOfVersion[version];
+    const uint8_t *field = &cfgBuffer[CFG_STORE_HEADER_LENGTH];
+
+    /* A newer schema starts with the current fields, an older one must hold all of its own */
+    if ((cfgBuffer[3] < cfg_fields_length(count)) ||
+        ((version <= CFG_STORE_VERSION) && (cfgBuffer[3] != cfg_fields_length(count))))
+    {
+        return CFG_STORE_DEFAULTS;
+    }
+
+    /* Fields are stored in the byte order of the device */
+    for (uint8_t i = 0; i < count; i++)
+    {
+        memcpy((uint8_t *)values + cfgFields[i].offset, field, cfgFields[i].size);
+        field += cfgFields[i].size;
+    }
+    return (version < CFG_STORE_VERSION) ? CFG_STORE_MIGRATED : CFG_STORE_LOADED;
+}
+
+/* Replaces out of range settings by their defaults */
+static void cfg_sanitize(CfgValues_t *values, const CfgValues_t *defaults)
+{
+    /* Stored as a byte, any non-zero value enables */
+    values->mcastEnable = (0 != *(const uint8_t *)&values->mcastEnable);
+
+    if ((0 == values->fport) || (values->fport > CFG_STORE_FPORT_MAX))
+    {
+        values->fport = defaults->fport;
+    }
+    if ((0 == values->subband) || (values->subband > CFG_STORE_SUBBAND_MAX))
+    {
+        values->subband = defaults->subband;
+    }
+    if (!APP_PARAMS_Validate(&values->params))
+    {
+        values->params = defaults->params;
+    }
+}
+
+/*********************************************************************//**
+\brief      Loads the newest valid record, called once at boot
+\param[in]  nvm       - storage of the records
+\param[in]  nvmOffset - row aligned start of CFG_STORE_NVM_SIZE bytes
+\param[in]  defaults  - settings of conf_app.h
+\return     where the settings in use come from
+*************************************************************************/
+CfgStoreSource_t CFG_STORE_Load(const AppNvmOps_t *nvm, uint32_t nvmOffset, const CfgValues_t *defaults)
+{
+    CfgStoreSource_t source = CFG_STORE_DEFAULTS;
+    uint16_t sequence[CFG_STORE_SLOTS] = { 0 };
+    uint8_t version[CFG_STORE_SLOTS];
+
+    cfgNvm = nvm;
+    cfgNvmOffset = nvmOffset;
+    cfgSlot = CFG_STORE_SLOTS;
+    cfgSequence = 0;
+    cfgValues = *defaults;
+
+    for (uint8_t slot = 0; slot < CFG_STORE_SLOTS; slot++)
+    {
+        version[slot] = cfg_read_slot(slot, &sequence[slot]);
+    }
+    if ((0 != version[0]) && ((0 == version[1]) || ((int16_t)(sequence[0] - sequence[1]) > 0)))
+    {
+        cfgSlot = 0;
+    }
+    else if (0 != version[1])
+    {
+        cfgSlot = 1;
+    }
+
+    if (cfgSlot < CFG_STORE_SLOTS)
+    {
+        cfgSequence = sequence[cfgSlot];
+        cfg_read_slot(cfgSlot, &cfgSequence);
+        source = cfg_decode(&cfgValues);
+        if (CFG_STORE_DEFAULTS == source)
+        {
+            cfgValues = *defaults;
+        }
+        cfg_sanitize(&cfgValues, defaults);
+    }
+    cfgStored = cfgValues;
+    return source;
+}
+
+/*********************************************************************//**
+\brief      Writes a record of the current schema for the next boot. The
+            settings in use do not change
+\param[in]  values - settings to store
+\return     false if the flash could not be written
+*************************************************************************/
+bool CFG_STORE_Save(const CfgValues_t *values)
+{
+    uint8_t slot = (0 == cfgSlot) ? 1 : 0;
+    uint16_t length = CFG_STORE_HEADER_LENGTH;
+    uint8_t count = cfgFieldsOfVersion[CFG_STORE_VERSION];
+
+    if (NULL == cfgNvm)
+    {
+        return false;
+    }
+
+    cfg_put_u16(&cfgBuffer[0], CFG_STORE_MAGIC);
+    cfgBuffer[2] = CFG_STORE_VERSION;
+    cfgBuffer[3] = (uint8_t)cfg_fields_length(count);
+    cfg_put_u16(&cfgBuffer[4], (uint16_t)(cfgSequence + 1u));
+    for (uint8_t i = 0; i < count; i++)
+    {
+        memcpy(&cfgBuffer[length], (const uint8_t *)values + cfgFields[i].offset, cfgFields[i].size);
+        length += cfgFields[i].size;
+    }
+    cfg_put_u16(&cfgBuffer[length], CFG_STORE_Crc16(cfgBuffer, length));
+    length += CFG_STORE_CRC_LENGTH;
+
+    /* The record in use stays intact until the new one is complete */
+    if (!cfgNvm->erase(cfgNvmOffset + slot * APP_NVM_ROW_SIZE, APP_NVM_ROW_SIZE) ||
+        !cfgNvm->write(cfgNvmOffset + slot * APP_NVM_ROW_SIZE, cfgBuffer, length))
+    {
+        return false;
+    }
+    cfgSlot = slot;
+    cfgSequence++;
+    cfgStored = *values;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Stores new runtime parameters, e.g. set by a downlink, along
+            the settings in use. Nothing is written if they are unchanged
+\param[in]  params - parameters to keep across resets
+\return     false if the flash could not be written
+*************************************************************************/
+bool CFG_STORE_SaveParams(const AppParams_t *params)
+{
+    CfgValues_t values = cfgStored;
+
+    if ((values.params.alarmThreshold == params->alarmThreshold) &&
+        (values.params.samplePeriodMs == params->samplePeriodMs) &&
+        (values.params.confirmCount == params->confirmCount) &&
+        (values.params.statusPeriods == params->statusPeriods))
+    {
+        return true;
+    }
+    values.params = *params;
+    return CFG_STORE_Save(&values);
+}
+
+/*********************************************************************//**
+\brief      Tells whether the payload keys were provisioned. Erased or
+            never written keys are all zero or all 0xFF
+\return     false if either key is blank
+*************************************************************************/
+bool CFG_STORE_PayloadKeysSet(void)
+{
+    const uint8_t *keys[] = { cfgValues.payloadEncKey, cfgValues.payloadMacKey };
+
+    for (uint8_t k = 0; k < 2u; k++)
+    {
+        uint8_t orBits = 0;
+        uint8_t andBits = 0xFFu;
+
+        for (uint8_t i = 0; i < CFG_STORE_KEY_LENGTH; i++)
+        {
+            orBits |= keys[k][i];
+            andBits &= keys[k][i];
+        }
+        if ((0 == orBits) || (0xFFu == andBits))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*********************************************************************//**
+\brief      CRC-16/CCITT-FALSE of a buffer
+*************************************************************************/
+uint16_t CFG_STORE_Crc16(const uint8_t *data, uint16_t length)
+{
+    uint16_t crc = 0xFFFFu;
+
+    while (length--)
+    {
+        crc ^= (uint16_t)(*data++ << 8);
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000u) ? (uint16_t)((crc << 1) ^ 0x1021u) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
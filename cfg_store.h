@@ -0,0 +1,142 @@
+/**
+* \file  cfg_store.h
+*
+* \brief Site configuration record in the application flash area
+*
+* The operational settings are loaded once at boot from a versioned,
+* CRC protected record and stay constant afterwards. Settings the record
+* does not hold (no record, or an older schema) keep the conf_app.h
+* defaults, so one image serves every site.
+*
+* Record, little endian, in one of two rows used alternately:
+*   [magic u16] [version u8] [length u8] [sequence u16] [fields]
+*   [CRC-16/CCITT u16 of everything before]
+* Fields are only ever appended. A record of an older version holds a
+* prefix of the current fields, the missing ones take their defaults.
+*
+* The payload keys of app_crypto.h have no conf_app.h default: they belong
+* to one device and are written with its record at provisioning. Without
+* them the payload is not sealed and no uplink is sent.
+*/
+
+#ifndef CFG_STORE_H_
+#define CFG_STORE_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_nvm.h"
+#include "app_params.h"
+
+/****************************** MACROS **************************************/
+#define CFG_STORE_MAGIC                     0xC5F6u
+/* Schema of the records written by this firmware */
+#define CFG_STORE_VERSION                   1u
+/* Two rows, the newest valid one is used */
+#define CFG_STORE_NVM_SIZE                  (2u * APP_NVM_ROW_SIZE)
+#define CFG_STORE_KEY_LENGTH                16u
+
+/****************************** TYPES **************************************/
+typedef enum _CfgStoreSource_t
+{
+    /* No valid record, conf_app.h defaults */
+    CFG_STORE_DEFAULTS = 0,
+    CFG_STORE_LOADED,
+    /* Record of an older schema, completed with defaults */
+    CFG_STORE_MIGRATED
+} CfgStoreSource_t;
+
+typedef struct _CfgValues_t
+{
+    /* Schema 1 */
+    uint8_t fport;
+    /* EdClass_t */
+    uint8_t edClass;
+    /* ActivationType_t */
+    uint8_t activationType;
+    /* NA/AU 125 kHz sub-band, 1 to 8 */
+    uint8_t subband;
+    AppParams_t params;
+    bool mcastEnable;
+    uint8_t mcastGroupId;
+    uint32_t mcastGroupAddr;
+    uint8_t mcastNwkSKey[CFG_STORE_KEY_LENGTH];
+    uint8_t mcastAppSKey[CFG_STORE_KEY_LENGTH];
+    /* Derived by the backend from its root key and the DevEUI */
+    uint8_t payloadEncKey[CFG_STORE_KEY_LENGTH];
+    uint8_t payloadMacKey[CFG_STORE_KEY_LENGTH];
+} CfgValues_t;
+
+/****************************** GLOBAL VARIABLES **************************************/
+/* Settings in use, written by CFG_STORE_Load() only */
+extern const CfgValues_t *const cfgStoreValues;
+
+/****************************** PROTOTYPES **************************************/
+CfgStoreSource_t CFG_STORE_Load(const AppNvmOps_t *nvm, uint32_t nvmOffset, const CfgValues_t *defaults);
+bool CFG_STORE_Save(const CfgValues_t *values);
+bool CFG_STORE_SaveParams(const AppParams_t *params);
+bool CFG_STORE_PayloadKeysSet(void);
+uint16_t CFG_STORE_Crc16(const uint8_t *data, uint16_t length);
+
+/****************************** ACCESSORS **************************************/
+static inline uint8_t CFG_STORE_FPort(void)
+{
+    return cfgStoreValues->fport;
+}
+
+static inline uint8_t CFG_STORE_Class(void)
+{
+    return cfgStoreValues->edClass;
+}
+
+static inline uint8_t CFG_STORE_ActivationType(void)
+{
+    return cfgStoreValues->activationType;
+}
+
+static inline uint8_t CFG_STORE_Subband(void)
+{
+    return cfgStoreValues->subband;
+}
+
+static inline const AppParams_t *CFG_STORE_Params(void)
+{
+    return &cfgStoreValues->params;
+}
+
+static inline bool CFG_STORE_McastEnable(void)
+{
+    return cfgStoreValues->mcastEnable;
+}
+
+static inline uint8_t CFG_STORE_McastGroupId(void)
+{
+    return cfgStoreValues->mcastGroupId;
+}
+
+static inline uint32_t CFG_STORE_McastGroupAddr(void)
+{
+    return cfgStoreValues->mcastGroupAddr;
+}
+
+static inline const uint8_t *CFG_STORE_McastNwkSKey(void)
+{
+    return cfgStoreValues->mcastNwkSKey;
+}
+
+static inline const uint8_t *CFG_STORE_McastAppSKey(void)
+{
+    return cfgStoreValues->mcastAppSKey;
+}
+
+static inline const uint8_t *CFG_STORE_PayloadEncKey(void)
+{
+    return cfgStoreValues->payloadEncKey;
+}
+
+static inline const uint8_t *CFG_STORE_PayloadMacKey(void)
+{
+    return cfgStoreValues->payloadMacKey;
+}
+
+#endif /* CFG_STORE_H_ */
@@ -0,0 +1,315 @@
+/**
+* \file  class_mgr.c
+*
+* \brief Bounded Class C windows on top of a Class A device
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "class_mgr.h"
+
+/****************************** MACROS **************************************/
+/* Receiver-on time is kept per part of the budget period, one more part
+   holds the time of the current one */
+#define CLASS_MGR_PARTS                     48u
+#define CLASS_MGR_SLOTS                     (CLASS_MGR_PARTS + 1u)
+
+/************************** GLOBAL VARIABLES ***********************************/
+static ClassMgrConfig_t classConfig;
+static ClassMgrStats_t classStats;
+/* Receiver-on time accounted up to classLastMs, per part of partMs */
+static uint64_t classLastMs = 0;
+static uint32_t classPartMs = 1;
+static uint64_t classPart = 0;
+static uint32_t classPartOnMs[CLASS_MGR_SLOTS];
+/* Class C wanted from classWindowStartMs until classWindowEndMs */
+static bool classWindowOpen = false;
+static uint64_t classWindowStartMs = 0;
+static uint64_t classWindowEndMs = 0;
+/* Class C in use in the stack since classOnSinceMs */
+static bool classReceiverOn = false;
+static uint64_t classOnSinceMs = 0;
+static bool classSlotArmed = false;
+static uint64_t classSlotMs = 0;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Moves to the part of the period numbered part, forgetting the parts that
+   no budget period ending from now on overlaps */
+static void class_mgr_advance(uint64_t part)
+{
+    if ((part - classPart) >= CLASS_MGR_SLOTS)
+    {
+        memset(classPartOnMs, 0, sizeof(classPartOnMs));
+        classPart = part;
+        return;
+    }
+    while (classPart < part)
+    {
+        classPart++;
+        classPartOnMs[classPart % CLASS_MGR_SLOTS] = 0;
+    }
+}
+
+/* Charges the receiver-on time up to nowMs to its parts and sets the
+   credit to the budget minus the time of the parts kept */
+static void class_mgr_account(uint64_t nowMs)
+{
+    uint32_t usedMs = 0;
+
+    while (classLastMs < nowMs)
+    {
+        uint64_t part = classLastMs / classPartMs;
+        uint64_t stepEndMs = (part + 1u) * classPartMs;
+
+        class_mgr_advance(part);
+        if (!classReceiverOn)
+        {
+            classLastMs = nowMs;
+            break;
+        }
+        if (stepEndMs > nowMs)
+        {
+            stepEndMs = nowMs;
+        }
+        classPartOnMs[part % CLASS_MGR_SLOTS] += (uint32_t)(stepEndMs - classLastMs);
+        classStats.receiverOnMs += (uint32_t)(stepEndMs - classLastMs);
+        classLastMs = stepEndMs;
+    }
+    class_mgr_advance(classLastMs / classPartMs);
+
+    for (uint8_t i = 0; i < CLASS_MGR_SLOTS; i++)
+    {
+        usedMs += classPartOnMs[i];
+    }
+    classStats.creditMs = (usedMs < (uint32_t)INT32_MAX) ? (int32_t)classConfig.budgetMs - (int32_t)usedMs : INT32_MIN;
+}
+
+/*********************************************************************//**
+\brief      Initializes the manager in Class A with the whole budget
+\param[in]  config - window limits and receiver-on budget
+\param[in]  nowMs  - uptime
+*************************************************************************/
+void CLASS_MGR_Init(const ClassMgrConfig_t *config, uint64_t nowMs)
+{
+    classConfig = *config;
+    if (0 == classConfig.budgetPeriodMs)
+    {
+        classConfig.budgetPeriodMs = 1;
+    }
+    if (classConfig.budgetMs > (uint32_t)INT32_MAX)
+    {
+        classConfig.budgetMs = INT32_MAX;
+    }
+    memset(&classStats, 0, sizeof(classStats));
+    classStats.creditMs = (int32_t)classConfig.budgetMs;
+    memset(classPartOnMs, 0, sizeof(classPartOnMs));
+    /* CLASS_MGR_PARTS parts cover at least a budget period */
+    classPartMs = (uint32_t)(((uint64_t)classConfig.budgetPeriodMs + CLASS_MGR_PARTS - 1u) / CLASS_MGR_PARTS);
+    classLastMs = nowMs;
+    classPart = nowMs / classPartMs;
+    classWindowOpen = false;
+    classReceiverOn = false;
+    classSlotArmed = false;
+}
+
+/*********************************************************************//**
+\brief      Opens a Class C window or extends the open one, up to
+            maxWindowMs from its opening
+\param[in]  trigger    - origin of the request
+\param[in]  durationMs - length asked for from nowMs
+\param[in]  nowMs      - uptime
+\return     true if a window is open, possibly shorter than asked for
+*************************************************************************/
+bool CLASS_MGR_Request(ClassMgrTrigger_t trigger, uint32_t durationMs, uint64_t nowMs)
+{
+    uint32_t grantMs = durationMs;
+
+    class_mgr_account(nowMs);
+    if ((0 == durationMs) || (classStats.creditMs <= 0))
+    {
+        classStats.refused++;
+        return classWindowOpen;
+    }
+    if (grantMs > classConfig.maxWindowMs)
+    {
+        grantMs = classConfig.maxWindowMs;
+    }
+    /* An extension does not take the open window beyond the longest one */
+    if (classWindowOpen && (nowMs < classWindowEndMs) &&
+        ((nowMs + grantMs) > (classWindowStartMs + classConfig.maxWindowMs)))
+    {
+        grantMs = (uint32_t)(classWindowStartMs + classConfig.maxWindowMs - nowMs);
+    }
+    if (grantMs > (uint32_t)classStats.creditMs)
+    {
+        grantMs = (uint32_t)classStats.creditMs;
+    }
+    if (grantMs < durationMs)
+    {
+        classStats.truncated++;
+    }
+
+    if (!classWindowOpen || (nowMs >= classWindowEndMs))
+    {
+        classWindowOpen = true;
+        classWindowStartMs = nowMs;
+        classWindowEndMs = nowMs + grantMs;
+        classStats.windows++;
+    }
+    else if ((nowMs + grantMs) > classWindowEndMs)
+    {
+        classWindowEndMs = nowMs + grantMs;
+    }
+    classStats.lastTrigger = (uint8_t)trigger;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Sets the start of the next maintenance slot, replacing a
+            pending one; nothing happens if slotWindowMs is 0
+\param[in]  delayMs - from nowMs
+\param[in]  nowMs   - uptime
+*************************************************************************/
+void CLASS_MGR_ScheduleSlot(uint32_t delayMs, uint64_t nowMs)
+{
+    if (0 == classConfig.slotWindowMs)
+    {
+        return;
+    }
+    classSlotArmed = true;
+    classSlotMs = nowMs + delayMs;
+}
+
+/*********************************************************************//**
+\brief      Returns true while a maintenance slot is scheduled
+*************************************************************************/
+bool CLASS_MGR_SlotPending(void)
+{
+    return classSlotArmed;
+}
+
+/*********************************************************************//**
+\brief      Opens a due maintenance slot, closes an ended window
+\param[in]  nowMs - uptime
+\return     true if the device should be in Class C
+*************************************************************************/
+bool CLASS_MGR_Update(uint64_t nowMs)
+{
+    class_mgr_account(nowMs);
+    if (classSlotArmed && (nowMs >= classSlotMs))
+    {
+        classSlotArmed = false;
+        CLASS_MGR_Request(CLASS_MGR_MAINTENANCE, classConfig.slotWindowMs, nowMs);
+    }
+    if (classWindowOpen && ((nowMs >= classWindowEndMs) || (classReceiverOn && (classStats.creditMs <= 0))))
+    {
+        classWindowOpen = false;
+    }
+    return classWindowOpen;
+}
+
+/*********************************************************************//**
+\brief      Reports the class in use in the stack, the receiver-on time is
+            charged from the switch to Class C to the switch back
+\param[in]  classC - Class C in use
+\param[in]  nowMs  - uptime
+*************************************************************************/
+void CLASS_MGR_Switched(bool classC, uint64_t nowMs)
+{
+    class_mgr_account(nowMs);
+    if (classC == classReceiverOn)
+    {
+        return;
+    }
+    classReceiverOn = classC;
+    if (classC)
+    {
+        classOnSinceMs = nowMs;
+    }
+    else
+    {
+        classStats.lastWindowMs = (uint32_t)(nowMs - classOnSinceMs);
+        /* Back in Class A for another reason, a stack reset for instance */
+        classWindowOpen = false;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the delay before CLASS_MGR_Update() has something to
+            do, UINT32_MAX if nothing is pending
+\param[in]  nowMs - uptime
+*************************************************************************/
+uint32_t CLASS_MGR_NextEventMs(uint64_t nowMs)
+{
+    uint64_t nextMs = UINT64_MAX;
+
+    class_mgr_account(nowMs);
+    if (classWindowOpen)
+    {
+        nextMs = classWindowEndMs;
+        if (classReceiverOn)
+        {
+            /* Early, old parts of the period may free credit meanwhile */
+            uint64_t creditEndMs = nowMs + ((classStats.creditMs > 0) ? (uint64_t)classStats.creditMs : 0u);
+
+            if (creditEndMs < nextMs)
+            {
+                nextMs = creditEndMs;
+            }
+        }
+    }
+    else if (classReceiverOn)
+    {
+        /* The switch back is overdue */
+        return 0;
+    }
+    if (classSlotArmed && (classSlotMs < nextMs))
+    {
+        nextMs = classSlotMs;
+    }
+
+    if (UINT64_MAX == nextMs)
+    {
+        return UINT32_MAX;
+    }
+    if (nextMs <= nowMs)
+    {
+        return 0;
+    }
+    return ((nextMs - nowMs) < UINT32_MAX) ? (uint32_t)(nextMs - nowMs) : (UINT32_MAX - 1u);
+}
+
+/*********************************************************************//**
+\brief      Updates the manager, schedules the next maintenance slot and
+            switches the stack to the class wanted
+\param[in]  ops   - stack of the application
+\param[in]  nowMs - uptime
+\return     delay before the next call, at most CLASS_MGR_POLL_MAX_MS
+*************************************************************************/
+uint32_t CLASS_MGR_Run(const ClassMgrOps_t *ops, uint64_t nowMs)
+{
+    uint32_t nextMs;
+    bool classC = CLASS_MGR_Update(nowMs);
+
+    if (!classSlotArmed)
+    {
+        CLASS_MGR_ScheduleSlot(ops->slotDelayMs(nowMs), nowMs);
+    }
+    if ((classC != classReceiverOn) && ops->setClass(classC))
+    {
+        CLASS_MGR_Switched(classC, nowMs);
+    }
+
+    nextMs = (classC != classReceiverOn) ? CLASS_MGR_RETRY_MS : CLASS_MGR_NextEventMs(nowMs);
+    return (nextMs > CLASS_MGR_POLL_MAX_MS) ? CLASS_MGR_POLL_MAX_MS : nextMs;
+}
+
+/*********************************************************************//**
+\brief      Returns the window counters and the receiver-on accounting
+*************************************************************************/
+const ClassMgrStats_t *CLASS_MGR_GetStats(void)
+{
+    return &classStats;
+}
@@ -0,0 +1,88 @@
+/**
+* \file  class_mgr.h
+*
+* \brief Bounded Class C windows on top of a Class A device
+*
+* The device runs in Class A. A downlink command or a maintenance slot
+* opens a Class C window for multicast and large downlinks, after which
+* the device falls back to Class A. The receiver stays on at most budgetMs
+* in any budgetPeriodMs: the credit is the budget minus the receiver-on
+* time of the last period, a window is shortened to the credit left and
+* closed when it runs out, a request finding no credit is refused. The
+* time is kept per 1/48 of the period and leaves the credit once its
+* whole part is older than a period, so the credit errs on the low side.
+* The module only decides; CLASS_MGR_Run() switches the stack through
+* ClassMgrOps_t and returns when to run it again. The receiver may stay on
+* past the budget by the lateness of that call and of the switch back.
+* The module does not touch the hardware and also builds on a host.
+*/
+
+#ifndef CLASS_MGR_H_
+#define CLASS_MGR_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Class switch refused by a busy stack, CLASS_MGR_Run() tries again after */
+#define CLASS_MGR_RETRY_MS                  1000u
+/* Longest delay CLASS_MGR_Run() returns, a longer one is split */
+#define CLASS_MGR_POLL_MAX_MS               3600000u
+
+/****************************** TYPES **************************************/
+typedef enum _ClassMgrTrigger_t
+{
+    CLASS_MGR_DOWNLINK = 0,
+    CLASS_MGR_MAINTENANCE,
+    /* Console or application request */
+    CLASS_MGR_LOCAL
+} ClassMgrTrigger_t;
+
+typedef struct _ClassMgrConfig_t
+{
+    /* Longest single window */
+    uint32_t maxWindowMs;
+    /* Receiver-on time allowed per budget period */
+    uint32_t budgetMs;
+    uint32_t budgetPeriodMs;
+    /* Window opened by a maintenance slot */
+    uint32_t slotWindowMs;
+} ClassMgrConfig_t;
+
+/* Stack of the application */
+typedef struct _ClassMgrOps_t
+{
+    /* Switches to Class C or back to Class A, false if the stack cannot now */
+    bool (*setClass)(bool classC);
+    /* Delay from nowMs to the start of the next maintenance slot */
+    uint32_t (*slotDelayMs)(uint64_t nowMs);
+} ClassMgrOps_t;
+
+typedef struct _ClassMgrStats_t
+{
+    uint16_t windows;
+    /* Requests without credit */
+    uint16_t refused;
+    /* Windows shortened to the maximum or to the credit */
+    uint16_t truncated;
+    uint8_t lastTrigger;
+    /* Receiver-on time still allowed in the budget period, negative after
+       an overrun */
+    int32_t creditMs;
+    uint32_t lastWindowMs;
+    uint32_t receiverOnMs;
+} ClassMgrStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void CLASS_MGR_Init(const ClassMgrConfig_t *config, uint64_t nowMs);
+bool CLASS_MGR_Request(ClassMgrTrigger_t trigger, uint32_t durationMs, uint64_t nowMs);
+void CLASS_MGR_ScheduleSlot(uint32_t delayMs, uint64_t nowMs);
+bool CLASS_MGR_SlotPending(void);
+bool CLASS_MGR_Update(uint64_t nowMs);
+void CLASS_MGR_Switched(bool classC, uint64_t nowMs);
+uint32_t CLASS_MGR_NextEventMs(uint64_t nowMs);
+uint32_t CLASS_MGR_Run(const ClassMgrOps_t *ops, uint64_t nowMs);
+const ClassMgrStats_t *CLASS_MGR_GetStats(void);
+
+#endif /* CLASS_MGR_H_ */
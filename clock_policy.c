@@ -0,0 +1,165 @@
+/**
+* \file  clock_policy.c
+*
+* \brief CPU clock divider per application phase
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "clock_policy.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static ClockPolicy_t clockPolicy;
+static ClockPolicySet_t clockSet = NULL;
+static ClockPhase_t clockPhase = CLOCK_PHASE_IDLE;
+static uint8_t clockHeld = 0;
+/* Divider applied to the hardware, 0xFF before the first change */
+static uint8_t clockShift = 0xFF;
+static uint32_t clockSwitches = 0;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Applies the smallest divider of the current and held phases */
+static void clock_policy_apply(void)
+{
+    uint8_t shift = clockPolicy.shift[clockPhase];
+
+    for (uint8_t phase = 0; phase < CLOCK_PHASE_COUNT; phase++)
+    {
+        if ((clockHeld & (1u << phase)) && (clockPolicy.shift[phase] < shift))
+        {
+            shift = clockPolicy.shift[phase];
+        }
+    }
+
+    if (shift != clockShift)
+    {
+        clockShift = shift;
+        clockSwitches++;
+        if (NULL != clockSet)
+        {
+            clockSet(shift);
+        }
+    }
+}
+
+/*********************************************************************//**
+\brief      Initializes the policy and applies the divider of the idle phase
+\param[in]  policy - divider of every phase, clamped to CLOCK_POLICY_MAX_SHIFT
+\param[in]  set    - applies a divider to the hardware
+*************************************************************************/
+void CLOCK_POLICY_Init(const ClockPolicy_t *policy, ClockPolicySet_t set)
+{
+    memcpy(&clockPolicy, policy, sizeof(clockPolicy));
+    for (uint8_t phase = 0; phase < CLOCK_PHASE_COUNT; phase++)
+    {
+        if (clockPolicy.shift[phase] > CLOCK_POLICY_MAX_SHIFT)
+        {
+            clockPolicy.shift[phase] = CLOCK_POLICY_MAX_SHIFT;
+        }
+    }
+    clockSet = set;
+    clockPhase = CLOCK_PHASE_IDLE;
+    clockHeld = 0;
+    clockShift = 0xFF;
+    clockSwitches = 0;
+    clock_policy_apply();
+}
+
+/*********************************************************************//**
+\brief      Sets the phase of the application state machine
+\param[in]  phase - new current phase
+*************************************************************************/
+void CLOCK_POLICY_SetPhase(ClockPhase_t phase)
+{
+    if (phase < CLOCK_PHASE_COUNT)
+    {
+        clockPhase = phase;
+        clock_policy_apply();
+    }
+}
+
+/*********************************************************************//**
+\brief      Holds a phase that overlaps the current one until its release
+\param[in]  phase - phase to hold
+*************************************************************************/
+void CLOCK_POLICY_Hold(ClockPhase_t phase)
+{
+    if (phase < CLOCK_PHASE_COUNT)
+    {
+        clockHeld |= (uint8_t)(1u << phase);
+        clock_policy_apply();
+    }
+}
+
+/*********************************************************************//**
+\brief      Releases a phase taken by CLOCK_POLICY_Hold()
+\param[in]  phase - phase to release
+*************************************************************************/
+void CLOCK_POLICY_Release(ClockPhase_t phase)
+{
+    if (phase < CLOCK_PHASE_COUNT)
+    {
+        clockHeld &= (uint8_t)~(1u << phase);
+        clock_policy_apply();
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns log2 of the CPU divider in use
+*************************************************************************/
+uint8_t CLOCK_POLICY_GetShift(void)
+{
+    return clockShift;
+}
+
+/*********************************************************************//**
+\brief      Returns the number of divider changes since the initialization
+*************************************************************************/
+uint32_t CLOCK_POLICY_Switches(void)
+{
+    return clockSwitches;
+}
+
+/*********************************************************************//**
+\brief      Estimates the energy of one pass through every phase
+\param[in]  policy  - divider of every phase
+\param[in]  model   - clock and current figures of the device
+\param[in]  load    - work of every ClockPhase_t
+\param[out] phaseNj - energy of every phase, may be NULL
+\return     total energy in nJ, the divider changes to and from the idle
+            phase included
+*************************************************************************/
+uint64_t CLOCK_POLICY_EstimateNj(const ClockPolicy_t *policy, const ClockPowerModel_t *model,
+                                 const ClockPhaseLoad_t *load, uint64_t *phaseNj)
+{
+    uint64_t total = 0;
+    uint8_t idleShift = policy->shift[CLOCK_PHASE_IDLE];
+
+    for (uint8_t phase = 0; phase < CLOCK_PHASE_COUNT; phase++)
+    {
+        uint8_t shift = (policy->shift[phase] > CLOCK_POLICY_MAX_SHIFT) ? CLOCK_POLICY_MAX_SHIFT : policy->shift[phase];
+        uint32_t cpuHz = model->mainClockHz >> shift;
+        uint64_t cpuUs = (cpuHz > 0) ? ((uint64_t)load[phase].cycles * 1000000u + cpuHz - 1u) / cpuHz : 0;
+        /* uA x mV = nW, nW x us / 10^6 = nJ */
+        uint64_t currentUa = model->baseUa + ((uint64_t)model->activeUaPerMhz * cpuHz) / 1000000u;
+        uint64_t energy = (currentUa * model->supplyMv * (cpuUs + load[phase].waitUs)) / 1000000u;
+
+        if ((shift != idleShift) && ((load[phase].cycles > 0) || (load[phase].waitUs > 0)))
+        {
+            uint32_t fastHz = model->mainClockHz >> ((shift < idleShift) ? shift : idleShift);
+            uint64_t switchUa = model->baseUa + ((uint64_t)model->activeUaPerMhz * fastHz) / 1000000u;
+
+            energy += (2u * switchUa * model->supplyMv * model->switchUs) / 1000000u;
+        }
+
+        if (NULL != phaseNj)
+        {
+            phaseNj[phase] = energy;
+        }
+        total += energy;
+    }
+    return total;
+}
@@ -0,0 +1,82 @@
+/**
+* \file  clock_policy.h
+*
+* \brief CPU clock divider per application phase
+*
+* The application state machine sets its current phase; phases that
+* overlap it (an ongoing radio transaction, a payload being sealed) are
+* held on top. The CPU runs with the smallest divider of the current and
+* held phases, so sampling and logging run from a divided main clock and
+* crypto and radio servicing at full speed.
+* Peripherals clocked by their own GCLK generator (SW timers, SERCOMs,
+* ADC) are not affected by the divider.
+* The energy model does not touch the hardware and also builds on a host.
+*/
+
+#ifndef CLOCK_POLICY_H_
+#define CLOCK_POLICY_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Largest divider, CPUDIV = 1 << shift */
+#define CLOCK_POLICY_MAX_SHIFT              7u
+
+/****************************** TYPES **************************************/
+typedef enum _ClockPhase_t
+{
+    /* Waiting for the stack before sleep */
+    CLOCK_PHASE_IDLE = 0,
+    /* ADC scan and conversion of a wakeup */
+    CLOCK_PHASE_SAMPLE,
+    /* Console output, payload formatting */
+    CLOCK_PHASE_LOG,
+    /* Payload sealing */
+    CLOCK_PHASE_CRYPTO,
+    /* Join or transaction, until its callback */
+    CLOCK_PHASE_RADIO,
+    CLOCK_PHASE_COUNT
+} ClockPhase_t;
+
+typedef struct _ClockPolicy_t
+{
+    /* log2 of the CPU divider of every ClockPhase_t */
+    uint8_t shift[CLOCK_PHASE_COUNT];
+} ClockPolicy_t;
+
+/* Applies a CPU divider of 1 << shift */
+typedef void (*ClockPolicySet_t)(uint8_t shift);
+
+typedef struct _ClockPowerModel_t
+{
+    uint32_t mainClockHz;
+    uint16_t supplyMv;
+    /* Current that does not scale with the CPU clock */
+    uint16_t baseUa;
+    /* Current of the CPU per MHz of CPU clock */
+    uint16_t activeUaPerMhz;
+    /* Time spent changing the divider, at the faster clock */
+    uint16_t switchUs;
+} ClockPowerModel_t;
+
+typedef struct _ClockPhaseLoad_t
+{
+    /* CPU cycles executed in the phase */
+    uint32_t cycles;
+    /* Time bounded by peripherals (conversions, airtime, UART) */
+    uint32_t waitUs;
+} ClockPhaseLoad_t;
+
+/****************************** PROTOTYPES **************************************/
+void CLOCK_POLICY_Init(const ClockPolicy_t *policy, ClockPolicySet_t set);
+void CLOCK_POLICY_SetPhase(ClockPhase_t phase);
+void CLOCK_POLICY_Hold(ClockPhase_t phase);
+void CLOCK_POLICY_Release(ClockPhase_t phase);
+uint8_t CLOCK_POLICY_GetShift(void);
+uint32_t CLOCK_POLICY_Switches(void);
+uint64_t CLOCK_POLICY_EstimateNj(const ClockPolicy_t *policy, const ClockPowerModel_t *model,
+                                 const ClockPhaseLoad_t *load, uint64_t *phaseNj);
+
+#endif /* CLOCK_POLICY_H_ */
@@ -65,17 +65,109 @@
 #define DEMO_APP_ACTIVATION_TYPE               OVER_THE_AIR_ACTIVATION
 //#define DEMO_APP_ACTIVATION_TYPE               ACTIVATION_BY_PERSONALIZATION
 
-/* Select the Type of Transmission - Confirmed(CNF) / Unconfirmed(UNCNF) */
+/* Select the Type of Transmission - Confirmed(CNF) / Unconfirmed(UNCNF)
+   UNCONFIRMED sends alarms confirmed and status frames unconfirmed, with a
+   confirmed link probe every DEMO_APP_STATUS_PROBE_MIN..MAX status frames */
 #define DEMO_APP_TRANSMISSION_TYPE              UNCONFIRMED
 //#define DEMO_APP_TRANSMISSION_TYPE            CONFIRMED
 
+/* Bounds of the adaptive status probe interval */
+#define DEMO_APP_STATUS_PROBE_MIN               2
+#define DEMO_APP_STATUS_PROBE_MAX               16
+
 /* FPORT Value (1-255) */
 #define DEMO_APP_FPORT                           5
 
+/* Every uplink is delayed by a per-device phase within WINDOW plus a
+ * random jitter up to JITTER, see uplink_slot.h. The phase is drawn
+ * again after RESLOT consecutive NO_ACK or TX_TIMEOUT. 4 s suits a few
+ * tens of devices powered on together, widen WINDOW with the fleet: see
+ * test/sim_uplink_slot.c */
+#define DEMO_APP_UPLINK_SLOT_WINDOW_MS          4000u
+#define DEMO_APP_UPLINK_JITTER_MS               1000u
+#define DEMO_APP_UPLINK_RESLOT_FAILURES         3u
+
+/* Uplink counters reserved by a flash record, see fcnt_store.h: one
+ * write every BLOCK uplinks, at most BLOCK counters skipped after a
+ * reset. Keep it well below the counter gap accepted by the network */
+#define DEMO_APP_FCNT_BLOCK                     128u
+
+/* The session is lost after NO_ACK_LIMIT consecutive confirmed uplinks
+ * without acknowledgment, see session_health.h. Failed rejoins are
+ * retried after RETRY_MIN, doubled up to RETRY_MAX */
+#define DEMO_APP_HEALTH_NO_ACK_LIMIT            4u
+#define DEMO_APP_REJOIN_RETRY_MIN_MS            (30uL * 1000uL)
+#define DEMO_APP_REJOIN_RETRY_MAX_MS            (60uL * 60uL * 1000uL)
+
+/* 1 - while the stack ADR is off, every uplink uses the data rate and TX
+ * power of the lowest energy that keep the link, see link_quality.h.
+ * With ADR on the network stays in charge, the choice is only traced */
+#define DEMO_APP_LINK_ADAPT                     1
+/* Margin above the demodulation floor and delivery ratio (per mille) of
+ * the confirmed uplinks to keep */
+#define DEMO_APP_LINK_MARGIN_DB                 10
+#define DEMO_APP_LINK_TARGET_DELIVERY           900u
+/* Relative TX current of the TX power indexes, 2 dB apart from the
+ * highest. Rough figures, to be replaced by measurements of the board */
+#define DEMO_APP_LINK_TX_COST                   100, 80, 64, 52, 43, 36, 31, 27
+
+/* Network time, see time_sync.h. A DeviceTimeReq rides along an uplink
+ * every PERIOD, or every RETRY until the first answer. Synchronised
+ * readings end with " @<GPS seconds mod 65536>" of the sample */
+#define DEMO_APP_TIME_SYNC_PERIOD_MS            (6uL * 3600uL * 1000uL)
+#define DEMO_APP_TIME_SYNC_RETRY_MS             (30uL * 60uL * 1000uL)
+/* End of the uplink to the RX1 answer carrying the DeviceTimeAns */
+#define DEMO_APP_TIME_SYNC_RX_DELAY_MS          1000u
+/* 1 - wake on network time boundaries of the sleep period, offset by
+ * PHASE, to sample in phase with (or staggered from) other devices */
+#define DEMO_APP_SAMPLE_ALIGN                   0
+#define DEMO_APP_SAMPLE_PHASE_MS                0u
+
+/* FPORT of the downlink commands and of the uplinks acknowledging them (1-223) */
+#define DEMO_APP_CMD_FPORT                       10
+
+/* Port of the diagnostic uplink, see APP_DIAG_Serialize() */
+#define DEMO_APP_DIAG_FPORT                      11
+
+/* Waveform around the alarms, see wave_capture.h, of the accelerometer
+ * axes fitted in the scan. The wakeup scans before the alarm are followed
+ * by a burst of scans every WAVE_POST_PERIOD_MS, timed by an application
+ * timer. The capture goes out on WAVE_FPORT, one fragment per wakeup
+ * without a reading to send, when the duty cycle allows. test/wave_decode
+ * rebuilds the samples from the uplinks */
+#define DEMO_APP_WAVE_CAPTURE                    1
+#define DEMO_APP_WAVE_FPORT                      12
+#define DEMO_APP_WAVE_POST_PERIOD_MS             20u
+
+/* Application layer payload encryption, see app_crypto.h. The keys are
+ * shared with the application backend only, not with the network server.
+ * They belong to this device alone and are not built in: the backend
+ * derives them from its root key and the DevEUI, see
+ * APP_CRYPTO_DeriveKeys(), and they are provisioned in the site
+ * configuration record, see cfg_store.h */
+#define DEMO_APP_PAYLOAD_CRYPTO                  1
+/* 1 - AES engine of the stack, 0 - constant time software AES */
+#define DEMO_APP_PAYLOAD_CRYPTO_ENGINE           1
+
+/* log2 of the CPU clock divider of every phase, see clock_policy.h:
+ * idle, sample, log, crypto, radio. All 0 keeps the full clock */
+#define DEMO_APP_CLOCK_SHIFTS                    3, 2, 1, 0, 0
+
 /* Device Class - Class of the device (CLASS_A/CLASS_C) */
 #define DEMO_APP_ENDDEVICE_CLASS                 CLASS_A
 //#define DEMO_APP_ENDDEVICE_CLASS                 CLASS_C
 
+/* Class C windows of a Class A device, see class_mgr.h. A window lasts at
+ * most WINDOW_MAX, the receiver stays on at most BUDGET in any BUDGET_PERIOD.
+ * A maintenance window opens every MAINTENANCE_PERIOD at
+ * MAINTENANCE_PHASE of network time, a MAINTENANCE_WINDOW of 0 disables it */
+#define DEMO_APP_CLASS_C_WINDOW_MAX_MS           600000u
+#define DEMO_APP_CLASS_C_BUDGET_MS               1800000u
+#define DEMO_APP_CLASS_C_BUDGET_PERIOD_MS        86400000u
+#define DEMO_APP_MAINTENANCE_WINDOW_MS           300000u
+#define DEMO_APP_MAINTENANCE_PERIOD_MS           86400000u
+#define DEMO_APP_MAINTENANCE_PHASE_MS            7200000u
+
 
 /* ABP Join Parameters */
 
@@ -101,5 +193,67 @@
 /* This macro defines the application's default sleep duration in milliseconds */
 #define DEMO_CONF_DEFAULT_APP_SLEEP_TIME_MS     5000
 
+/* Accelerometer alarm threshold, in the unit returned by ACC_CODE_TO_VALUE() */
+#define DEMO_APP_ACC_ALARM_THRESHOLD            1.0f
+
+/* Number of consecutive readings above the threshold that raise an alarm */
+#define DEMO_APP_ACC_ALARM_CONFIRM_COUNT        5
+
+/* Adaptive alarm detection, see anomaly.h. A reading counts towards an
+ * alarm when it exceeds the learned level of the asset by Z_Q4 / 16
+ * standard deviations, the deviation taken at least SIGMA_MIN / 4 ADC
+ * codes; the threshold above is used until WARMUP readings are learned.
+ * In window mode the comparator watches that learned limit, the readings
+ * of the status wakeups keep it up to date.
+ * SEASONAL keeps a level per hour of network time for assets with a daily
+ * schedule */
+#define DEMO_APP_ANOMALY_DETECTOR               1
+#define DEMO_APP_ANOMALY_SEASONAL               0
+#define DEMO_APP_ANOMALY_SHIFT                  7
+#define DEMO_APP_ANOMALY_Z_Q4                   64
+#define DEMO_APP_ANOMALY_WARMUP                 60
+#define DEMO_APP_ANOMALY_SIGMA_MIN              4
+
+/* Number of sleep periods between two status reports */
+#define DEMO_APP_STATUS_REPORT_PERIODS          3
+
+/* Threshold wake mode - ADC_WAKE_MODE_POLL / ADC_WAKE_MODE_WINDOW */
+#define DEMO_APP_ADC_WAKE_MODE                  ADC_WAKE_MODE_WINDOW
+//#define DEMO_APP_ADC_WAKE_MODE                  ADC_WAKE_MODE_POLL
+
+/* RTC counter clock of the sleep timer. In window mode the conversions are
+ * started by the slowest RTC periodic event (CLK_RTC / 2^(n+3)) that still
+ * converts once per sample period */
+#define DEMO_APP_ADC_WINDOW_RTC_HZ              1024u
+
+/* Inputs (MUXPOS) converted in one scan per wakeup, ADC_SCAN_INPUT_NONE
+ * when not fitted. The alarm uses the largest axis; the window monitor
+ * only watches the input configured in ADC_start() */
+#define DEMO_APP_ADC_SCAN_ACC_X                 ADC_POSITIVE_INPUT_PIN6
+#define DEMO_APP_ADC_SCAN_ACC_Y                 ADC_SCAN_INPUT_NONE
+#define DEMO_APP_ADC_SCAN_ACC_Z                 ADC_SCAN_INPUT_NONE
+#define DEMO_APP_ADC_SCAN_VBAT                  ADC_SCAN_INPUT_NONE
+#define DEMO_APP_ADC_SCAN_TEMP                  ADC_POSITIVE_INPUT_TEMP
+
+/* Reference of the conversions, INTVCC0 is VDDANA / 1.6 */
+#define DEMO_APP_ADC_VREF_MV                    2062
+/* Ratio of the VBAT divider in front of the VBAT input. Without a VBAT
+ * input the battery power tiers stay at BATTERY_TIER_NORMAL */
+#define DEMO_APP_ADC_VBAT_DIVIDER               2
+
+/* Main flash area owned by the application, to be excluded from the linker script */
+#define APP_NVM_BASE                            0x30000
+#define APP_NVM_SIZE                            0x10000
+
+/* Row aligned regions of the application flash area, offsets from APP_NVM_BASE */
+#define APP_NVM_FRAG_OFFSET                     0x0000
+#define APP_NVM_FRAG_SIZE                       0xC000
+/* Site configuration records, CFG_STORE_NVM_SIZE bytes */
+#define APP_NVM_CFG_OFFSET                      0xC000
+/* Session of every band, SESSION_CACHE_NVM_SIZE bytes */
+#define APP_NVM_SESSION_OFFSET                  0xC200
+/* Frame counter records, FCNT_STORE_NVM_SIZE bytes */
+#define APP_NVM_FCNT_OFFSET                     0xC600
+
 #endif /* APP_CONFIG_H_ */
 
@@ -0,0 +1,241 @@
+/**
+* \file  console.c
+*
+* \brief Line based command console on the host UART
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "console.h"
+
+/******************************** MACROS ***************************************/
+#define CONSOLE_BACKSPACE                   0x08u
+#define CONSOLE_DELETE                      0x7Fu
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const ConsoleCommand_t *consoleCommands = NULL;
+static uint8_t consoleCommandCount = 0;
+static void (*consoleNotify)(void) = NULL;
+
+/* Written by the interrupt only (head) and by the task only (tail) */
+static volatile uint8_t consoleRx[CONSOLE_RX_BUFFER_SIZE];
+static volatile uint8_t consoleRxHead = 0;
+static volatile uint8_t consoleRxTail = 0;
+static volatile bool consoleKey = false;
+static volatile bool consoleRxLost = false;
+
+static char consoleLine[CONSOLE_LINE_LENGTH + 1u];
+static uint8_t consoleLineLength = 0;
+/* The line overflowed, it is dropped at its end */
+static bool consoleLineLost = false;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Splits a line into words in place, returns their number */
+static uint8_t console_split(char *line, char *argv[])
+{
+    uint8_t argc = 0;
+
+    while ('\0' != *line)
+    {
+        while (' ' == *line)
+        {
+            *line++ = '\0';
+        }
+        if ('\0' == *line)
+        {
+            break;
+        }
+        if (argc == CONSOLE_MAX_ARGS)
+        {
+            /* One word too many, reported as a wrong usage */
+            return CONSOLE_MAX_ARGS + 1u;
+        }
+        argv[argc++] = line;
+        while ((' ' != *line) && ('\0' != *line))
+        {
+            line++;
+        }
+    }
+    return argc;
+}
+
+static void console_help(void)
+{
+    printf("help\r\n");
+    for (uint8_t i = 0; i < consoleCommandCount; i++)
+    {
+        printf("%s %s\r\n", consoleCommands[i].name, consoleCommands[i].usage);
+    }
+}
+
+/*********************************************************************//**
+\brief      Initializes the console
+\param[in]  commands - command table
+\param[in]  count    - number of commands
+\param[in]  notify   - called from the interrupt when a line is complete,
+                       posts a task that calls CONSOLE_Process()
+*************************************************************************/
+void CONSOLE_Init(const ConsoleCommand_t *commands, uint8_t count, void (*notify)(void))
+{
+    consoleCommands = commands;
+    consoleCommandCount = count;
+    consoleNotify = notify;
+    consoleRxHead = 0;
+    consoleRxTail = 0;
+    consoleKey = false;
+    consoleRxLost = false;
+    consoleLineLength = 0;
+    consoleLineLost = false;
+}
+
+/*********************************************************************//**
+\brief      Stores a received byte, called from the UART interrupt
+\param[in]  data - received byte
+*************************************************************************/
+void CONSOLE_RxIsr(uint8_t data)
+{
+    uint8_t head = consoleRxHead;
+    uint8_t free = (uint8_t)((consoleRxTail - head - 1u) & (CONSOLE_RX_BUFFER_SIZE - 1u));
+    bool lineEnd = ('\r' == data) || ('\n' == data);
+
+    if (!lineEnd)
+    {
+        consoleKey = true;
+    }
+    /* The last free byte is kept for a line end, the next line then
+     * starts clean after a dropped one */
+    if ((lineEnd && (free > 0)) || (free > 1u))
+    {
+        consoleRx[head] = data;
+        consoleRxHead = (uint8_t)((head + 1u) & (CONSOLE_RX_BUFFER_SIZE - 1u));
+    }
+    else
+    {
+        consoleRxLost = true;
+    }
+    /* Half full: the task drains the bytes of a line longer than the
+     * buffer before its end arrives */
+    if ((lineEnd || consoleRxLost || (free == (CONSOLE_RX_BUFFER_SIZE / 2u))) && (NULL != consoleNotify))
+    {
+        consoleNotify();
+    }
+}
+
+/*********************************************************************//**
+\brief      Assembles the received bytes into lines and runs them, called
+            from task context
+*************************************************************************/
+void CONSOLE_Process(void)
+{
+    ConsoleStatus_t status;
+    uint8_t data;
+
+    if (consoleRxLost)
+    {
+        consoleRxLost = false;
+        consoleLineLost = true;
+    }
+    while (consoleRxTail != consoleRxHead)
+    {
+        data = consoleRx[consoleRxTail];
+        consoleRxTail = (uint8_t)((consoleRxTail + 1u) & (CONSOLE_RX_BUFFER_SIZE - 1u));
+
+        if (('\r' == data) || ('\n' == data))
+        {
+            consoleLine[consoleLineLength] = '\0';
+            status = consoleLineLost ? CONSOLE_OVERFLOW : CONSOLE_Execute(consoleLine);
+            consoleLineLength = 0;
+            consoleLineLost = false;
+            if (CONSOLE_OK == status)
+            {
+                printf("OK\r\n");
+            }
+            else if (CONSOLE_EMPTY != status)
+            {
+                printf("ERR %d\r\n", status);
+            }
+        }
+        else if ((CONSOLE_BACKSPACE == data) || (CONSOLE_DELETE == data))
+        {
+            if (consoleLineLength > 0)
+            {
+                consoleLineLength--;
+            }
+        }
+        else if (consoleLineLength < CONSOLE_LINE_LENGTH)
+        {
+            consoleLine[consoleLineLength++] = (char)data;
+        }
+        else
+        {
+            consoleLineLost = true;
+        }
+    }
+}
+
+/*********************************************************************//**
+\brief      Runs a command line
+\param[in]  line - command and arguments separated by spaces, modified
+\return     status of the command
+*************************************************************************/
+ConsoleStatus_t CONSOLE_Execute(char *line)
+{
+    char *argv[CONSOLE_MAX_ARGS];
+    uint8_t argc = console_split(line, argv);
+    const ConsoleCommand_t *command = NULL;
+
+    if (0 == argc)
+    {
+        return CONSOLE_EMPTY;
+    }
+    if (argc > CONSOLE_MAX_ARGS)
+    {
+        return CONSOLE_USAGE;
+    }
+    if (0 == strcmp(argv[0], "help"))
+    {
+        console_help();
+        return CONSOLE_OK;
+    }
+
+    for (uint8_t i = 0; i < consoleCommandCount; i++)
+    {
+        if (0 == strcmp(argv[0], consoleCommands[i].name))
+        {
+            command = &consoleCommands[i];
+            break;
+        }
+    }
+    if (NULL == command)
+    {
+        return CONSOLE_UNKNOWN;
+    }
+    if (((argc - 1u) < command->minArgs) || ((argc - 1u) > command->maxArgs))
+    {
+        printf("%s %s\r\n", command->name, command->usage);
+        return CONSOLE_USAGE;
+    }
+    return command->handler(argc, argv) ? CONSOLE_OK : CONSOLE_FAILED;
+}
+
+/*********************************************************************//**
+\brief      Returns true if a key was pressed since the last call; the
+            pending input is dropped, the key only answered a prompt
+*************************************************************************/
+bool CONSOLE_TakeKey(void)
+{
+    bool key = consoleKey;
+
+    if (key)
+    {
+        consoleKey = false;
+        consoleRxTail = consoleRxHead;
+        consoleLineLength = 0;
+        consoleLineLost = false;
+    }
+    return key;
+}
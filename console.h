@@ -0,0 +1,61 @@
+/**
+* \file  console.h
+*
+* \brief Line based command console on the host UART
+*
+* The UART receive interrupt hands every byte to CONSOLE_RxIsr(), which
+* only stores it; the CPU sleeps between characters. A line end, or a
+* half full buffer, asks the application for a CONSOLE_Process() call
+* from task context, where the line is split into words and dispatched
+* through a command table. The console is available whenever the UART
+* is powered.
+* The module does not touch the hardware and also builds on a host.
+*/
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Bytes received and not processed yet, a power of two */
+#define CONSOLE_RX_BUFFER_SIZE              32u
+/* Longest line, longer lines are dropped */
+#define CONSOLE_LINE_LENGTH                 48u
+/* Command name included */
+#define CONSOLE_MAX_ARGS                    4u
+
+/****************************** TYPES **************************************/
+typedef enum _ConsoleStatus_t
+{
+    CONSOLE_OK = 0,
+    CONSOLE_EMPTY,
+    CONSOLE_UNKNOWN,
+    /* Wrong number of arguments, the usage is printed */
+    CONSOLE_USAGE,
+    /* The handler refused the arguments or could not run */
+    CONSOLE_FAILED,
+    CONSOLE_OVERFLOW
+} ConsoleStatus_t;
+
+typedef struct _ConsoleCommand_t
+{
+    const char *name;
+    /* Arguments after the name, printed by "help" */
+    const char *usage;
+    uint8_t minArgs;
+    uint8_t maxArgs;
+    /* argv[0] is the command name */
+    bool (*handler)(uint8_t argc, char *argv[]);
+} ConsoleCommand_t;
+
+/****************************** PROTOTYPES **************************************/
+void CONSOLE_Init(const ConsoleCommand_t *commands, uint8_t count, void (*notify)(void));
+void CONSOLE_RxIsr(uint8_t data);
+void CONSOLE_Process(void);
+ConsoleStatus_t CONSOLE_Execute(char *line);
+bool CONSOLE_TakeKey(void);
+
+#endif /* CONSOLE_H_ */
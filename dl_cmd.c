@@ -0,0 +1,250 @@
+/**
+* \file  dl_cmd.c
+*
+* \brief Downlink command interface of the application
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include "dl_cmd.h"
+
+/****************************** TYPES **************************************/
+typedef struct _DlCmdEntry_t
+{
+    uint8_t type;
+    uint8_t length;
+    DlCmdStatus_t (*handler)(const uint8_t *value, DlCmdRequest_t *req);
+} DlCmdEntry_t;
+
+/************************** FUNCTION PROTOTYPES ********************************/
+static DlCmdStatus_t dl_cmd_alarm_threshold(const uint8_t *value, DlCmdRequest_t *req);
+static DlCmdStatus_t dl_cmd_sample_period(const uint8_t *value, DlCmdRequest_t *req);
+static DlCmdStatus_t dl_cmd_confirm_count(const uint8_t *value, DlCmdRequest_t *req);
+static DlCmdStatus_t dl_cmd_status_periods(const uint8_t *value, DlCmdRequest_t *req);
+static DlCmdStatus_t dl_cmd_diag_request(const uint8_t *value, DlCmdRequest_t *req);
+static DlCmdStatus_t dl_cmd_class_c_window(const uint8_t *value, DlCmdRequest_t *req);
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const DlCmdEntry_t dlCmdTable[] =
+{
+    { DL_CMD_TYPE_ALARM_THRESHOLD, 2, dl_cmd_alarm_threshold },
+    { DL_CMD_TYPE_SAMPLE_PERIOD,   2, dl_cmd_sample_period },
+    { DL_CMD_TYPE_CONFIRM_COUNT,   1, dl_cmd_confirm_count },
+    { DL_CMD_TYPE_STATUS_PERIODS,  1, dl_cmd_status_periods },
+    { DL_CMD_TYPE_DIAG_REQUEST,    0, dl_cmd_diag_request },
+    { DL_CMD_TYPE_CLASS_C_WINDOW,  2, dl_cmd_class_c_window }
+};
+
+static bool ackPending = false;
+static uint8_t ackSeq = 0;
+static uint8_t ackStatus = DL_CMD_OK;
+static bool diagPending = false;
+static uint16_t classCWindowS = 0;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint16_t dl_cmd_get_u16(const uint8_t *value)
+{
+    return (uint16_t)(value[0] | ((uint16_t)value[1] << 8));
+}
+
+static DlCmdStatus_t dl_cmd_alarm_threshold(const uint8_t *value, DlCmdRequest_t *req)
+{
+    req->params.alarmThreshold = (float)dl_cmd_get_u16(value) / 100.0f;
+    return DL_CMD_OK;
+}
+
+static DlCmdStatus_t dl_cmd_sample_period(const uint8_t *value, DlCmdRequest_t *req)
+{
+    req->params.samplePeriodMs = (uint32_t)dl_cmd_get_u16(value) * 1000u;
+    return DL_CMD_OK;
+}
+
+static DlCmdStatus_t dl_cmd_confirm_count(const uint8_t *value, DlCmdRequest_t *req)
+{
+    req->params.confirmCount = value[0];
+    return DL_CMD_OK;
+}
+
+static DlCmdStatus_t dl_cmd_status_periods(const uint8_t *value, DlCmdRequest_t *req)
+{
+    req->params.statusPeriods = value[0];
+    return DL_CMD_OK;
+}
+
+static DlCmdStatus_t dl_cmd_diag_request(const uint8_t *value, DlCmdRequest_t *req)
+{
+    (void)value;
+    req->diagRequest = true;
+    return DL_CMD_OK;
+}
+
+static DlCmdStatus_t dl_cmd_class_c_window(const uint8_t *value, DlCmdRequest_t *req)
+{
+    req->classCWindowS = dl_cmd_get_u16(value);
+    return (req->classCWindowS > 0) ? DL_CMD_OK : DL_CMD_ERR_VALUE;
+}
+
+/*********************************************************************//**
+\brief      Parses a command frame and stages its changes
+\param[in]  data   - frame payload, without the port byte
+\param[in]  length - number of bytes in data
+\param[in,out] req - params must hold the current set on entry, returns
+                     the staged set and the sequence number of the frame
+\return     DL_CMD_OK if every TLV is known and the staged set is valid
+*************************************************************************/
+DlCmdStatus_t DL_CMD_Parse(const uint8_t *data, uint8_t length, DlCmdRequest_t *req)
+{
+    uint8_t pos = 1;
+
+    if ((NULL == data) || (0 == length))
+    {
+        return DL_CMD_ERR_LENGTH;
+    }
+    req->seq = data[0];
+    req->diagRequest = false;
+    req->classCWindowS = 0;
+
+    while (pos < length)
+    {
+        const DlCmdEntry_t *entry = NULL;
+        uint8_t type;
+        uint8_t valueLength;
+        DlCmdStatus_t status;
+
+        if ((length - pos) < 2)
+        {
+            return DL_CMD_ERR_LENGTH;
+        }
+        type = data[pos];
+        valueLength = data[pos + 1];
+        pos += 2;
+
+        if (valueLength > (length - pos))
+        {
+            return DL_CMD_ERR_LENGTH;
+        }
+
+        for (uint8_t i = 0; i < sizeof(dlCmdTable) / sizeof(dlCmdTable[0]); i++)
+        {
+            if (dlCmdTable[i].type == type)
+            {
+                entry = &dlCmdTable[i];
+                break;
+            }
+        }
+        if (NULL == entry)
+        {
+            return DL_CMD_ERR_TYPE;
+        }
+        if (entry->length != valueLength)
+        {
+            return DL_CMD_ERR_LENGTH;
+        }
+
+        status = entry->handler(&data[pos], req);
+        if (DL_CMD_OK != status)
+        {
+            return status;
+        }
+        pos += valueLength;
+    }
+
+    return APP_PARAMS_Validate(&req->params) ? DL_CMD_OK : DL_CMD_ERR_VALUE;
+}
+
+/*********************************************************************//**
+\brief      Parses a command frame, applies it and queues its acknowledgment
+\param[in]  data   - frame payload, without the port byte
+\param[in]  length - number of bytes in data
+\return     Result of the frame, also reported in the acknowledgment
+*************************************************************************/
+DlCmdStatus_t DL_CMD_Handle(const uint8_t *data, uint8_t length)
+{
+    DlCmdRequest_t req;
+    DlCmdStatus_t status;
+
+    if (0 == length)
+    {
+        return DL_CMD_ERR_LENGTH;
+    }
+
+    req.seq = 0;
+    req.diagRequest = false;
+    req.classCWindowS = 0;
+    req.params = *APP_PARAMS_Get();
+    status = DL_CMD_Parse(data, length, &req);
+
+    if ((DL_CMD_OK == status) && !APP_PARAMS_Apply(&req.params))
+    {
+        status = DL_CMD_ERR_VALUE;
+    }
+    if ((DL_CMD_OK == status) && req.diagRequest)
+    {
+        diagPending = true;
+    }
+    if ((DL_CMD_OK == status) && (req.classCWindowS > 0))
+    {
+        classCWindowS = req.classCWindowS;
+    }
+
+    ackSeq = req.seq;
+    ackStatus = (uint8_t)status;
+    ackPending = true;
+
+    return status;
+}
+
+/*********************************************************************//**
+\brief      Copies the pending acknowledgment, if any, without consuming it
+\param[out] buffer    - destination of the acknowledgment
+\param[in]  maxLength - room left in buffer
+\return     Number of bytes written, 0 if nothing is pending
+*************************************************************************/
+uint8_t DL_CMD_PeekAck(uint8_t *buffer, uint8_t maxLength)
+{
+    if (!ackPending || (maxLength < DL_CMD_ACK_LENGTH))
+    {
+        return 0;
+    }
+    buffer[0] = ackSeq;
+    buffer[1] = ackStatus;
+    return DL_CMD_ACK_LENGTH;
+}
+
+/*********************************************************************//**
+\brief      Drops the acknowledgment once an uplink carrying it was accepted
+*************************************************************************/
+void DL_CMD_AckSent(void)
+{
+    ackPending = false;
+}
+
+/*********************************************************************//**
+\brief      Returns true while a requested diagnostic uplink is not sent
+*************************************************************************/
+bool DL_CMD_DiagRequested(void)
+{
+    return diagPending;
+}
+
+/*********************************************************************//**
+\brief      Clears the request once the diagnostic uplink was accepted
+*************************************************************************/
+void DL_CMD_DiagSent(void)
+{
+    diagPending = false;
+}
+
+/*********************************************************************//**
+\brief      Returns the Class C window asked for by the last command frames
+            in seconds, 0 if none, and clears the request
+*************************************************************************/
+uint16_t DL_CMD_TakeClassCWindow(void)
+{
+    uint16_t windowS = classCWindowS;
+
+    classCWindowS = 0;
+    return windowS;
+}
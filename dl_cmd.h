@@ -0,0 +1,70 @@
+/**
+* \file  dl_cmd.h
+*
+* \brief Downlink command interface of the application
+*
+* Command frames are received on DEMO_APP_CMD_FPORT:
+*   [seq] { [type] [length] [value ...] } ...
+* Multi-byte values are little endian. A frame is applied completely or
+* not at all, and its sequence number and result are reported back in the
+* next uplink as [seq] [status].
+*/
+
+#ifndef DL_CMD_H_
+#define DL_CMD_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_params.h"
+
+/****************************** MACROS **************************************/
+/* Length of the acknowledgment appended to an uplink */
+#define DL_CMD_ACK_LENGTH                   2
+
+/****************************** TYPES **************************************/
+typedef enum _DlCmdStatus_t
+{
+    DL_CMD_OK = 0,
+    DL_CMD_ERR_LENGTH,
+    DL_CMD_ERR_TYPE,
+    DL_CMD_ERR_VALUE
+} DlCmdStatus_t;
+
+typedef enum _DlCmdType_t
+{
+    /* uint16, threshold in 1/100 of the ACC_CODE_TO_VALUE() unit */
+    DL_CMD_TYPE_ALARM_THRESHOLD = 0x01,
+    /* uint16, sample period in seconds */
+    DL_CMD_TYPE_SAMPLE_PERIOD   = 0x02,
+    /* uint8, consecutive readings that raise an alarm */
+    DL_CMD_TYPE_CONFIRM_COUNT   = 0x03,
+    /* uint8, sample periods between two status reports */
+    DL_CMD_TYPE_STATUS_PERIODS  = 0x04,
+    /* no value, asks for a diagnostic uplink */
+    DL_CMD_TYPE_DIAG_REQUEST    = 0x05,
+    /* uint16, Class C window in seconds, for multicast and large downlinks */
+    DL_CMD_TYPE_CLASS_C_WINDOW  = 0x06
+} DlCmdType_t;
+
+typedef struct _DlCmdRequest_t
+{
+    uint8_t seq;
+    /* Parameter set with every change of the frame staged on top */
+    AppParams_t params;
+    /* The frame asks for a diagnostic uplink */
+    bool diagRequest;
+    /* Class C window asked for, 0 if none */
+    uint16_t classCWindowS;
+} DlCmdRequest_t;
+
+/****************************** PROTOTYPES **************************************/
+DlCmdStatus_t DL_CMD_Parse(const uint8_t *data, uint8_t length, DlCmdRequest_t *req);
+DlCmdStatus_t DL_CMD_Handle(const uint8_t *data, uint8_t length);
+uint8_t DL_CMD_PeekAck(uint8_t *buffer, uint8_t maxLength);
+void DL_CMD_AckSent(void);
+bool DL_CMD_DiagRequested(void);
+void DL_CMD_DiagSent(void);
+uint16_t DL_CMD_TakeClassCWindow(void);
+
+#endif /* DL_CMD_H_ */
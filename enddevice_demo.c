@@ -61,9 +61,37 @@
 #include "LED.h"
 #include "pmm.h"
 #include "radio_driver_hal.h"
+#include "radio_interface.h"
 #include "conf_pmm.h"
 #include "conf_sio2host.h"
 #include "pds_interface.h"
+#include "adc_window.h"
+#include "adc_scan.h"
+#include "sleep_coord.h"
+#include "periph_mgr.h"
+#include "app_params.h"
+#include "cfg_store.h"
+#include "dl_cmd.h"
+#include "frag_session.h"
+#include "tx_policy.h"
+#include "app_timer.h"
+#include "app_diag.h"
+#include "app_crypto.h"
+#include "app_format.h"
+#include "evt_trace.h"
+#include "battery.h"
+#include "clock_policy.h"
+#include "time_sync.h"
+#include "uplink_slot.h"
+#include "session_cache.h"
+#include "fcnt_store.h"
+#include "session_health.h"
+#include "link_quality.h"
+#include "console.h"
+#include "class_mgr.h"
+#include "wave_capture.h"
+#include "anomaly.h"
+#include "aes_engine.h"
 
 
 #if (CERT_APP == 1)
@@ -75,15 +103,43 @@
 #endif
 #include "atomic.h"
 #include <stdint.h>
+#include <stdlib.h>
 /******************************** MACROS ***************************************/
+/* Log only when the UART is already powered, sample-only wakeups keep it off */
+#define APP_TRACE(...)      do { if (PERIPH_IsPowered(PERIPH_UART)) { printf(__VA_ARGS__); } } while (0)
+
+/* Delays the application timers tolerate so that their wakeups can be merged */
+#define APP_LED_BLINK_SLACK_MS      50
+#define APP_COUNTDOWN_SLACK_MS      100
+#define APP_CONFIRM_SLACK_MS        50
+#define APP_UPLINK_SLOT_SLACK_MS    20
+#define APP_CLASS_SLACK_MS          100
+#define APP_WAVE_SLACK_MS           2
+
+/* Accelerometer axes fitted, a waveform frame holds one sample of each */
+#define APP_ACC_AXIS_FITTED(input)  ((ADC_SCAN_INPUT_NONE != (input)) ? 1u : 0u)
+#define APP_ACC_AXES_MASK           ((APP_ACC_AXIS_FITTED(DEMO_APP_ADC_SCAN_ACC_X) << ADC_SCAN_ACC_X) | \
+                                     (APP_ACC_AXIS_FITTED(DEMO_APP_ADC_SCAN_ACC_Y) << ADC_SCAN_ACC_Y) | \
+                                     (APP_ACC_AXIS_FITTED(DEMO_APP_ADC_SCAN_ACC_Z) << ADC_SCAN_ACC_Z))
+#define APP_ACC_AXES                (APP_ACC_AXIS_FITTED(DEMO_APP_ADC_SCAN_ACC_X) + \
+                                     APP_ACC_AXIS_FITTED(DEMO_APP_ADC_SCAN_ACC_Y) + \
+                                     APP_ACC_AXIS_FITTED(DEMO_APP_ADC_SCAN_ACC_Z))
+
+/* Accelerometer value to the 1/4 ADC code samples of the detector */
+#define APP_ANOMALY_SCALE           (4.0f * (float)ACC_ADC_MAX_CODE / ACC_ADC_FULL_SCALE)
 
 /************************** GLOBAL VARIABLES ***********************************/
 volatile uint counter = 0;
 volatile uint counter_status=0;
 static bool joined = false;
 //static float cel_val;
-static char acc_sen_str[25];
+static char acc_sen_str[32];
 static uint8_t data_len = 0;
+/* Reading + command acknowledgment, or a diagnostic record, then the payload epoch and MIC */
+#define APP_TX_BUF_LENGTH   ((((sizeof(acc_sen_str) + DL_CMD_ACK_LENGTH) > APP_DIAG_RECORD_LENGTH) ? \
+                              (sizeof(acc_sen_str) + DL_CMD_ACK_LENGTH) : APP_DIAG_RECORD_LENGTH) + \
+                             APP_CRYPTO_OVERHEAD)
+static uint8_t appTxBuf[APP_TX_BUF_LENGTH];
 bool certAppEnabled = false;
 
 static uint8_t on = LON;
@@ -94,32 +150,21 @@ static volatile uint8_t appTaskFlags = 0x00u;
 /* Default Regional band start delay time */
 volatile static uint8_t count = 5;
 
-static uint8_t rxchar[11];
 static bool startReceiving = false;
 extern uint8_t demoTimerId;
-extern uint8_t lTimerId;
-static AppTaskState_t appTaskState;
-
-static const char* bandStrings[] =
-{
-    "FactoryDefaultReset",
-#if (EU_BAND == 1)
-    "EU868",
-#endif
-    "Clear PDS",
-    "Reset Board"
-};
-
-
-uint8_t bandTable[] =
-{
-    0xFF,
-#if (EU_BAND == 1)
-    ISM_EU868,
+static uint8_t ledTimerId = APP_TIMER_INVALID_ID;
+static uint8_t countdownTimerId = APP_TIMER_INVALID_ID;
+static uint8_t confirmTimerId = APP_TIMER_INVALID_ID;
+static uint8_t uplinkSlotTimerId = APP_TIMER_INVALID_ID;
+static uint8_t classTimerId = APP_TIMER_INVALID_ID;
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+static uint8_t waveTimerId = APP_TIMER_INVALID_ID;
 #endif
-    0xFF,
-    0xFF
-};
+/* Class C window of a Class A device in use in the stack */
+static bool appClassC = false;
+static AppTaskState_t appTaskState;
+/* Send state entered when the uplink slot is due, SLEEP_STATE if none */
+static AppTaskState_t appPendingSend = SLEEP_STATE;
 
 /*ABP Join Parameters */
 static uint32_t demoDevAddr = DEMO_DEVICE_ADDRESS;
@@ -137,11 +182,6 @@ static LorawanSendReq_t lorawanSendReq;
 
 
 /* Muticast Parameters */
-static bool demoMcastEnable = DEMO_APP_MCAST_ENABLE;
-static uint32_t demoMcastDevAddr = DEMO_APP_MCAST_GROUP_ADDRESS;
-static uint8_t demoMcastNwksKey[16] = DEMO_APP_MCAST_NWK_SESSION_KEY;
-static uint8_t demoMcastAppsKey[16] = DEMO_APP_MCAST_APP_SESSION_KEY;
-static uint8_t demoMcastGroupId = DEMO_APP_MCAST_GROUPID;
 /************************** EXTERN VARIABLES ***********************************/
 extern bool button_pressed;
 extern bool factory_reset;
@@ -150,16 +190,39 @@ extern uint32_t longPress;
 
 struct adc_module adc_instance;
 float acc_val=0;
+/* Signals of the last ADC scan */
+static AdcScanResult_t adcScan;
+extern AdcWakePlan_t adcWakePlan;
+extern volatile bool adcWindowWake;
+/* A DeviceTimeReq rides along the ongoing transaction */
+static bool timeSyncPending = false;
+static uint32_t timeSyncLastGps = 0;
+/* Session of the band being joined restored from the cache */
+static bool sessionRestoring = false;
+static SessionCacheEntry_t sessionRestored;
+/* The network rejected the session, join again before sleeping */
+static bool rejoinPending = false;
+/* Frame that could not be sent for a lost session, sent after the rejoin */
+static AppTaskState_t lastSendState = STATUS_STATE;
+static bool resendPending = false;
+static AppTaskState_t resendState = STATUS_STATE;
+static char heldReading[sizeof(acc_sen_str)];
+/* The signal of the ongoing transaction was already measured */
+static bool linkSampled = false;
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+/* The next status uplink carries a fragment of the waveform instead */
+static bool waveFragmentPending = false;
+static uint64_t waveLastFrameMs = 0;
+/* Post-trigger scans taken, the failed ones included */
+static uint8_t waveScans = 0;
+#endif
+/* Sleep multiplier of the battery tier the last sleep was entered with */
+static uint8_t appSleepScale = 1;
 
 /* Modifierad */
 static void processSend(void);
 static void processSleep(void);
 //static void processADC(void);
-static void get_adc_resource_data(uint8_t * data);
-static void get_adc_data(uint8_t *data);
-static double acc_sensor_value(int type);
-static float calculate_acc(uint16_t raw_code);
-static uint16_t adc_start_read_result(void);
 
 static void appPostTask(AppTaskIds_t id);
 static SYSTEM_TaskStatus_t (*appTaskHandlers[])(void);
@@ -168,10 +231,80 @@ static void lTimerCb(void * data);
 static SYSTEM_TaskStatus_t processTask(void);
 static void processRunRestoreBand(void);
 static void read_adc(void);
+static bool app_acc_alarm(float value, float threshold);
+static void app_confirm_due(void *param);
+static void app_schedule_send(AppTaskState_t state);
+static void app_cache_session(void);
+static bool app_restore_session(IsmBand_t band);
+static void app_rejoin(void);
+static void app_session_health(StackRetStatus_t status, bool confirmed);
+static void app_link_sample(void);
+static void app_link_adapt(void);
+static void app_fcnt_track(bool resume);
+static bool app_fcnt_reserve(void);
+static void app_class_update(void);
+static void app_class_due(void *param);
+static void app_class_reset(void);
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+static bool app_wave_frame(const AdcScanResult_t *scan, uint16_t *frame);
+static void app_wave_capture(void);
+static void app_wave_due(void *param);
+static bool app_wave_fragment_due(void);
+#endif
+static void app_uplink_slot_due(void *param);
+static void app_tx_begin(void);
+static void app_tx_end(void);
+static void app_led_on(uint8_t led);
+static void app_radio_power_up(void);
+static void app_radio_power_down(void);
+static void app_uart_power_up(void);
+static void app_uart_power_down(void);
+static void app_adc_power_up(void);
+static void app_adc_power_down(void);
+
+static const PeriphOps_t appPeriphOps[PERIPH_COUNT] =
+{
+    /* PERIPH_RADIO */
+    { app_radio_power_up, app_radio_power_down },
+    /* PERIPH_UART */
+    { app_uart_power_up, app_uart_power_down },
+    /* PERIPH_ADC */
+    { app_adc_power_up, app_adc_power_down }
+};
+/* Radio and UART held for an ongoing join or transaction */
+static bool txResourcesHeld = false;
+
+static void app_console_isr(uint8_t instance);
+static void app_console_notify(void);
+static bool app_cmd_diag(uint8_t argc, char *argv[]);
+static bool app_cmd_set(uint8_t argc, char *argv[]);
+static bool app_cmd_send(uint8_t argc, char *argv[]);
+static bool app_cmd_class(uint8_t argc, char *argv[]);
+
+static const ConsoleCommand_t appCommands[] =
+{
+    { "diag", "", 0, 0, app_cmd_diag },
+    { "set", "<threshold|period|confirm|status> <value>", 2, 2, app_cmd_set },
+    { "send", "[alarm]", 0, 1, app_cmd_send },
+    { "class", "<seconds>", 1, 1, app_cmd_class }
+};
+/* A complete line waits for the application task */
+static volatile bool consolePending = false;
 
 #ifdef CONF_PMM_ENABLE
 static void appWakeup(uint32_t sleptDuration);
-static void app_resources_uninit(void);
+static bool app_stack_ready_to_sleep(void);
+static uint32_t app_next_activity_ms(void);
+static bool app_deep_sleep(uint32_t sleepTimeMs);
+static void app_idle_sleep(uint32_t maxTimeMs);
+
+static const SleepCoordOps_t appSleepOps =
+{
+    app_stack_ready_to_sleep,
+    app_next_activity_ms,
+    app_deep_sleep,
+    app_idle_sleep
+};
 #endif
 /************************** FUNCTION PROTOTYPES ********************************/
 SYSTEM_TaskStatus_t APP_TaskHandler(void);
@@ -181,6 +314,24 @@ SYSTEM_TaskStatus_t APP_TaskHandler(void);
  \param[in]  dataLen - The number of Rx bytes
  ************************************************************************/
 static void demo_handle_evt_rx_data(void *appHandle, appCbParams_t *appdata);
+static uint32_t app_time_us(void);
+static uint32_t app_time_ms(void);
+static uint64_t app_uptime_ms(void);
+#if (DEMO_APP_PAYLOAD_CRYPTO == 1)
+static uint8_t app_seal_payload(uint8_t length);
+#endif
+static uint64_t app_timer_now(void);
+static void app_timer_arm(uint32_t delayUs);
+static void app_timer_disarm(void);
+static void app_timer_fired(void *param);
+static void app_clock_set(uint8_t shift);
+
+static const AppTimerOps_t appTimerOps =
+{
+    app_timer_now,
+    app_timer_arm,
+    app_timer_disarm
+};
 
 /***************************** FUNCTIONS ***************************************/
 
@@ -195,6 +346,20 @@ static SYSTEM_TaskStatus_t (*appTaskHandlers[APP_TASKS_COUNT])(void) = {
 *************************************************************************/
 static SYSTEM_TaskStatus_t processTask(void)
 {
+	/* Radio servicing and sealing are held at their own speed, see app_tx_begin() */
+	static const ClockPhase_t statePhases[] =
+	{
+		[RESTORE_BAND_STATE] = CLOCK_PHASE_LOG,
+		[SLEEP_STATE] = CLOCK_PHASE_IDLE,
+		[READ_STATE] = CLOCK_PHASE_SAMPLE,
+		[LARM_STATE] = CLOCK_PHASE_LOG,
+		[STATUS_STATE] = CLOCK_PHASE_LOG
+	};
+
+	if ((uint32_t)appTaskState < (sizeof(statePhases) / sizeof(statePhases[0])))
+	{
+		CLOCK_POLICY_SetPhase(statePhases[appTaskState]);
+	}
 	switch(appTaskState)
 	{
 		case RESTORE_BAND_STATE:
@@ -202,18 +367,31 @@ static SYSTEM_TaskStatus_t processTask(void)
 			processRunRestoreBand();
 			break;
 		case SLEEP_STATE:
-			printf("SLEEP\r\n");
+			if (SLEEP_STATE != appPendingSend)
+			{
+				/* The uplink slot timer runs the send, the sleep follows it */
+				break;
+			}
+			if (rejoinPending || SESSION_HEALTH_RejoinDue(app_uptime_ms()))
+			{
+				rejoinPending = false;
+				app_rejoin();
+				break;
+			}
+			APP_TRACE("SLEEP\r\n");
 			processSleep();
 			break;
 		case READ_STATE:
-			printf("READ\r\n");
+			APP_TRACE("READ\r\n");
 			read_adc();
 			break;
 		case LARM_STATE:
+			app_tx_begin();
 			printf("ALARM\r\n");
 			processSend();
 			break;
 		case STATUS_STATE:
+			app_tx_begin();
 			printf("STATUS\r\n");
 			processSend();
 			break;
@@ -228,38 +406,114 @@ static SYSTEM_TaskStatus_t processTask(void)
 
 static void read_adc(void)
 {
-	/* Read temperature sensor value */
-	get_adc_resource_data((uint8_t *)&acc_val);
-	
-	printf("\nAccelerometer: ");
-	snprintf(acc_sen_str,sizeof(acc_sen_str),"%.1fC\n", acc_val);
-	printf("%.1f\n\r", acc_val);
+	const AppParams_t *params = APP_PARAMS_Get();
+	int reading_len;
+	bool scanned;
+	bool alarm;
+
+	/* Any reading taken meanwhile is the next confirmation reading */
+	APP_TIMER_Stop(confirmTimerId);
+	/* Accelerometer axes, VBAT and temperature in one scan */
+	PERIPH_Acquire(PERIPH_ADC);
+	scanned = adc_scan_run(&adcScan);
+	PERIPH_Release(PERIPH_ADC);
+	if (!scanned)
+	{
+		APP_TRACE("\nADC scan timeout\r\n");
+		counter = 0;
+		appTaskState = SLEEP_STATE;
+		appPostTask(DISPLAY_TASK_HANDLER);
+		return;
+	}
+	acc_val = ADC_SCAN_AccPeak(&adcScan);
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+	/* Wakeup scans only, the confirmation scans of an alarm are not periodic
+	 * and the post-trigger frames are taken by their own timer */
+	{
+		uint16_t frame[WAVE_CAPTURE_CHANNELS];
+
+		if ((0 == counter) && !WAVE_CAPTURE_Capturing() && app_wave_frame(&adcScan, frame))
+		{
+			uint64_t nowMs = app_uptime_ms();
+
+			WAVE_CAPTURE_Add(frame, (uint32_t)(nowMs - waveLastFrameMs));
+			waveLastFrameMs = nowMs;
+		}
+	}
+#endif
+	if (adcScan.validMask & (1u << ADC_SCAN_VBAT))
+	{
+		BatteryTier_t tier = BATTERY_GetTier();
+
+		if (BATTERY_Update(adcScan.vbatMv) != tier)
+		{
+			APP_TRACE("\nBattery %u%%, power tier %d\r\n", BATTERY_GetSoc(), BATTERY_GetTier());
+		}
+	}
 	
-	counter_status++;
+	APP_TRACE("\nAccelerometer: ");
+	reading_len = ADC_SCAN_FormatPayload(&adcScan, acc_sen_str, sizeof(acc_sen_str));
+	{
+		uint64_t sampleMs;
+
+		/* Network time of the sample, the backend unwraps it with the receive time */
+		if ((reading_len > 0) && (reading_len < (int)sizeof(acc_sen_str)) &&
+		    TIME_SYNC_Now(app_uptime_ms(), &sampleMs))
+		{
+			reading_len--;
+			reading_len += snprintf(&acc_sen_str[reading_len], sizeof(acc_sen_str) - reading_len, " @%u\n",
+			                        (unsigned int)((sampleMs / 1000u) & 0xFFFFu));
+			if (reading_len >= (int)sizeof(acc_sen_str))
+			{
+				reading_len = sizeof(acc_sen_str) - 1;
+			}
+		}
+	}
+	if (reading_len > 0)
+	{
+		APP_TRACE("%.*s\n\r", reading_len - 1, acc_sen_str);
+	}
 	
-	if(acc_val > 1.0)
+	alarm = app_acc_alarm(acc_val, params->alarmThreshold);
+#if (DEMO_APP_ANOMALY_DETECTOR == 1)
+	/* The window monitor follows the level the detector learned */
+	if ((ADC_WAKE_MODE_WINDOW == DEMO_APP_ADC_WAKE_MODE) &&
+	    (ADC_WINDOW_ThresholdToCode(app_alarm_level()) != adcWakePlan.windowLimit))
+	{
+		adc_window_update();
+	}
+#endif
+	if(alarm)
 	{
 		counter++;
-		delay_ms(1000);
 		
-		if(counter == 5)
+		if(counter >= params->confirmCount)
 		{
-			appTaskState = LARM_STATE;
-			appPostTask(DISPLAY_TASK_HANDLER);
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+			app_wave_capture();
+#endif
+			app_schedule_send(LARM_STATE);
 			counter = 0;
 		}
 		else
 		{
-			read_adc();
+			/* Next reading in a second, the task loop runs meanwhile */
+			APP_TIMER_Start(confirmTimerId, MS_TO_US(1000), MS_TO_US(APP_CONFIRM_SLACK_MS), app_confirm_due, NULL);
 		}
-		
+		return;
 	}
-	else if(counter_status ==3) // aprx, 60 min =120*6
+	else if(counter_status >= (uint32_t)params->statusPeriods * BATTERY_GetPolicy()->statusScale) // aprx, 60 min =120*6
 	{	
 		counter_status = 0;
-		appTaskState = STATUS_STATE;
-		appPostTask(DISPLAY_TASK_HANDLER);
+		app_schedule_send(STATUS_STATE);
+	}
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+	else if (app_wave_fragment_due())
+	{
+		waveFragmentPending = true;
+		app_schedule_send(STATUS_STATE);
 	}
+#endif
 	else
 	{
 		appTaskState = SLEEP_STATE;
@@ -268,6 +522,207 @@ static void read_adc(void)
 	counter = 0;
 }
 
+#if (DEMO_APP_ANOMALY_DETECTOR == 1)
+/*********************************************************************//*
+ \brief      Season of the readings of the detector
+ ************************************************************************/
+static uint8_t app_anomaly_season(void)
+{
+	uint8_t season = ANOMALY_NO_SEASON;
+#if (DEMO_APP_ANOMALY_SEASONAL == 1)
+	uint64_t networkMs;
+
+	/* Hour of the day, the seasons are meaningless before the time is known */
+	if (TIME_SYNC_Now(app_uptime_ms(), &networkMs))
+	{
+		season = (uint8_t)((networkMs / 3600000u) % ANOMALY_SEASONS);
+	}
+#endif
+	return season;
+}
+#endif
+
+/*********************************************************************//*
+ \brief      Tells whether a reading counts towards an alarm
+ \param[in]  value     - accelerometer peak
+ \param[in]  threshold - fixed threshold, used until the normal level of
+                         the asset is learned
+ ************************************************************************/
+static bool app_acc_alarm(float value, float threshold)
+{
+#if (DEMO_APP_ANOMALY_DETECTOR == 1)
+	AnomalyResult_t result;
+
+	/* In 1/4 ADC code, full scale fits the range of the detector. Rounded,
+	 * a code is judged as the window monitor compares it */
+	result = ANOMALY_Update((int16_t)(value * APP_ANOMALY_SCALE + 0.5f), app_anomaly_season());
+	if (ANOMALY_LEARNING != result)
+	{
+		return ANOMALY_DETECTED == result;
+	}
+#endif
+	return value > threshold;
+}
+
+/*********************************************************************//*
+ \brief      Level the window monitor watches while the CPU sleeps: the
+             limit learned by the detector, the fixed threshold before
+ ************************************************************************/
+float app_alarm_level(void)
+{
+#if (DEMO_APP_ANOMALY_DETECTOR == 1)
+	int16_t limit;
+
+	/* A reading alarms above the limit, a negative one leaves polling only.
+	 * Half a sample above it, clear of the float rounding of the codes */
+	if (ANOMALY_GetLimit(app_anomaly_season(), &limit))
+	{
+		return ((float)limit + 0.5f) / APP_ANOMALY_SCALE;
+	}
+#endif
+	return APP_PARAMS_Get()->alarmThreshold;
+}
+
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+/*********************************************************************//*
+ \brief      Picks the samples of the fitted axes out of a scan
+ \param[in]  scan  - scan of a wakeup or of the post-trigger burst
+ \param[out] frame - APP_ACC_AXES samples, X first
+ \return     false if an axis was not converted
+ ************************************************************************/
+static bool app_wave_frame(const AdcScanResult_t *scan, uint16_t *frame)
+{
+	uint8_t channels = 0;
+
+	if ((scan->validMask & APP_ACC_AXES_MASK) != APP_ACC_AXES_MASK)
+	{
+		return false;
+	}
+	for (uint8_t axis = ADC_SCAN_ACC_X; axis <= ADC_SCAN_ACC_Z; axis++)
+	{
+		if (APP_ACC_AXES_MASK & (1u << axis))
+		{
+			frame[channels++] = scan->raw[axis];
+		}
+	}
+	return true;
+}
+
+/*********************************************************************//*
+ \brief      Starts the burst of scans that completes the waveform of an
+             alarm, the task loop and the alarm uplink run meanwhile
+ ************************************************************************/
+static void app_wave_capture(void)
+{
+	if (!WAVE_CAPTURE_Trigger())
+	{
+		APP_TRACE("\nWaveform of the previous alarm not uploaded yet\r\n");
+		return;
+	}
+	waveScans = 0;
+	/* Kept powered between the scans of the burst */
+	PERIPH_Acquire(PERIPH_ADC);
+	APP_TIMER_Start(waveTimerId, MS_TO_US(DEMO_APP_WAVE_POST_PERIOD_MS), MS_TO_US(APP_WAVE_SLACK_MS),
+	                app_wave_due, NULL);
+}
+
+/*********************************************************************//*
+ \brief      Takes a post-trigger scan and arms the next one until the
+             capture is complete
+ ************************************************************************/
+static void app_wave_due(void *param)
+{
+	AdcScanResult_t scan;
+	uint16_t frame[WAVE_CAPTURE_CHANNELS];
+
+	/* A failed scan is taken again, up to twice the frames */
+	if (adc_scan_run(&scan) && app_wave_frame(&scan, frame))
+	{
+		WAVE_CAPTURE_Add(frame, DEMO_APP_WAVE_POST_PERIOD_MS);
+	}
+	if (WAVE_CAPTURE_Capturing() && (++waveScans < (2u * WAVE_CAPTURE_POST_FRAMES)))
+	{
+		APP_TIMER_Start(waveTimerId, MS_TO_US(DEMO_APP_WAVE_POST_PERIOD_MS), MS_TO_US(APP_WAVE_SLACK_MS),
+		                app_wave_due, NULL);
+		return;
+	}
+	PERIPH_Release(PERIPH_ADC);
+	if (WAVE_CAPTURE_Capturing())
+	{
+		WAVE_CAPTURE_Abort();
+		APP_TRACE("\nWaveform dropped, ADC scans failing\r\n");
+		return;
+	}
+	APP_TRACE("\nWaveform of %u bytes, %u raw\r\n", WAVE_CAPTURE_GetStats()->length,
+	          WAVE_CAPTURE_GetStats()->rawLength);
+}
+
+/*********************************************************************//*
+ \brief      Returns true if a fragment of the waveform can be sent now:
+             the fragments only use the duty cycle left by the readings
+ ************************************************************************/
+static bool app_wave_fragment_due(void)
+{
+	uint32_t dutyCycleMs = 0;
+
+	if (!WAVE_CAPTURE_UploadPending() || !joined)
+	{
+		return false;
+	}
+	LORAWAN_GetAttr(PENDING_DUTY_CYCLE_TIME, NULL, &dutyCycleMs);
+	return 0 == dutyCycleMs;
+}
+#endif
+
+/*********************************************************************//*
+ \brief      Enters a send state once the uplink slot delay has elapsed.
+             The state machine keeps running meanwhile, e.g. a receive
+             callback may enter SLEEP_STATE, so the send is kept apart
+ \param[in]  state - LARM_STATE or STATUS_STATE
+ ************************************************************************/
+static void app_schedule_send(AppTaskState_t state)
+{
+	uint32_t delayMs;
+
+	if (SLEEP_STATE != appPendingSend)
+	{
+		/* Already waiting for the slot, an alarm takes over a status */
+		if (LARM_STATE == state)
+		{
+			appPendingSend = LARM_STATE;
+		}
+		return;
+	}
+
+	delayMs = UPLINK_SLOT_NextDelayMs();
+	if (delayMs > 0)
+	{
+		appPendingSend = state;
+		APP_TIMER_Start(uplinkSlotTimerId, MS_TO_US(delayMs), MS_TO_US(APP_UPLINK_SLOT_SLACK_MS),
+		                app_uplink_slot_due, NULL);
+	}
+	else
+	{
+		appTaskState = state;
+		appPostTask(DISPLAY_TASK_HANDLER);
+	}
+}
+
+static void app_uplink_slot_due(void *param)
+{
+	appTaskState = appPendingSend;
+	appPendingSend = SLEEP_STATE;
+	appPostTask(DISPLAY_TASK_HANDLER);
+}
+
+/*********************************************************************//*
+ \brief      Takes the next confirmation reading of an alarm
+ ************************************************************************/
+static void app_confirm_due(void *param)
+{
+	appTaskState = READ_STATE;
+	appPostTask(DISPLAY_TASK_HANDLER);
+}
 /*********************************************************************//**
 \brief    Restores the previous band and runs
 *************************************************************************/
@@ -280,15 +735,8 @@ static void processRunRestoreBand(void)
 	
 	PDS_RestoreAll();
 	LORAWAN_GetAttr(ISMBAND,NULL,&prevBand);
-	for (uint32_t i = 0; i < sizeof(bandTable)-1; i++)
-	{
-		if(bandTable[i] == prevBand)
-		{
-			choice = i;
-			break;
-		}
-	}
-	if(choice >0 && choice < sizeof(bandTable)-1)
+	choice = APP_FORMAT_FindBand(prevBand);
+	if(choice >0 && choice < bandCount-1)
 	{
 		status = LORAWAN_Reset(bandTable[choice]);
 	}
@@ -297,7 +745,7 @@ static void processRunRestoreBand(void)
 	Needs to be enabled in Production Environment Ref Section */
     LORAWAN_SetAttr(JOIN_BACKOFF_ENABLE,&joinBackoffEnable);
 	
-	if(status == LORAWAN_SUCCESS && choice < sizeof(bandTable)-1)
+	if(status == LORAWAN_SUCCESS && choice < bandCount-1)
 	{
 		uint32_t joinStatus = 0;
 		PDS_RestoreAll();
@@ -307,6 +755,8 @@ static void processRunRestoreBand(void)
 		{
 			joined = true;
 			printf("joinStatus: Joined\r\n");
+			SESSION_HEALTH_OnJoin(true, app_uptime_ms());
+			app_fcnt_track(true);
 		}
 		else
 		{
@@ -332,114 +782,196 @@ static void processRunRestoreBand(void)
 static void processSend(void)
 {
 	int status = -1;
+	uint8_t ack_len = 0;
+	uint8_t length;
+	TxFrameKind_t kind = (LARM_STATE == appTaskState) ? TX_FRAME_ALARM : TX_FRAME_STATUS;
+	bool diag = (TX_FRAME_STATUS == kind) && DL_CMD_DiagRequested();
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+	bool wave = (TX_FRAME_STATUS == kind) && !diag && waveFragmentPending;
+#else
+	bool wave = false;
+#endif
+	/* A restored session is checked with confirmed uplinks, the fragments
+	 * are not acknowledged otherwise */
+	bool confirmed = (!wave && TX_POLICY_Select(kind)) || SESSION_CACHE_InProbation();
 
-	data_len = strlen(acc_sen_str);
-	lorawanSendReq.buffer = &acc_sen_str;
-	lorawanSendReq.bufferLength = data_len - 1;
-	lorawanSendReq.confirmed = DEMO_APP_TRANSMISSION_TYPE;
-	lorawanSendReq.port = DEMO_APP_FPORT;
-	status = LORAWAN_Send(&lorawanSendReq);
+	lastSendState = appTaskState;
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+	waveFragmentPending = false;
+#endif
+	if (diag)
+	{
+		/* A requested diagnostic record replaces the status reading */
+		length = APP_DIAG_Serialize(appTxBuf, sizeof(appTxBuf));
+		lorawanSendReq.port = DEMO_APP_DIAG_FPORT;
+	}
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+	else if (wave)
+	{
+		length = WAVE_CAPTURE_PeekFragment(appTxBuf, sizeof(appTxBuf) - APP_CRYPTO_OVERHEAD);
+		lorawanSendReq.port = DEMO_APP_WAVE_FPORT;
+	}
+#endif
+	else
+	{
+		/* The reading without its trailing newline, followed by a pending command acknowledgment */
+		data_len = strlen(acc_sen_str);
+		if (data_len > 0)
+		{
+			data_len--;
+		}
+		memcpy(appTxBuf, acc_sen_str, data_len);
+		ack_len = DL_CMD_PeekAck(&appTxBuf[data_len], sizeof(appTxBuf) - data_len);
+		length = data_len + ack_len;
+		lorawanSendReq.port = (ack_len > 0) ? DEMO_APP_CMD_FPORT : CFG_STORE_FPort();
+	}
+#if (DEMO_APP_PAYLOAD_CRYPTO == 1)
+	CLOCK_POLICY_Hold(CLOCK_PHASE_CRYPTO);
+	length = app_seal_payload(length);
+	CLOCK_POLICY_Release(CLOCK_PHASE_CRYPTO);
+#endif
+	/* A counter that could be used again after a reset is not sent */
+	if ((length > 0) && !app_fcnt_reserve())
+	{
+		printf("\nFrame counter not reserved\r\n");
+		length = 0;
+	}
+
+	lorawanSendReq.buffer = appTxBuf;
+	lorawanSendReq.bufferLength = length;
+	lorawanSendReq.confirmed = confirmed ? CONFIRMED : UNCONFIRMED;
+	app_link_adapt();
+	linkSampled = false;
+	timeSyncPending = (length > 0) && TIME_SYNC_RequestDue(app_uptime_ms()) &&
+	                  (LORAWAN_SUCCESS == LORAWAN_SetAttr(SEND_DEVICE_TIME_CMD, NULL));
+	status = (length > 0) ? LORAWAN_Send(&lorawanSendReq) : LORAWAN_INVALID_BUFFER_LENGTH;
+	EVT_TRACE_Record(EVT_TRACE_SEND, (uint8_t)status, app_time_ms());
 	if (LORAWAN_SUCCESS == status)
 	{
+		if (diag)
+		{
+			DL_CMD_DiagSent();
+			if (PERIPH_IsPowered(PERIPH_UART))
+			{
+				APP_DIAG_Print();
+				EVT_TRACE_Print();
+			}
+		}
+		if (ack_len > 0)
+		{
+			DL_CMD_AckSent();
+		}
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+		if (wave)
+		{
+			WAVE_CAPTURE_FragmentSent();
+		}
+#endif
+		if (timeSyncPending)
+		{
+			TIME_SYNC_Requested(app_uptime_ms());
+		}
+		if (!wave)
+		{
+			TX_POLICY_OnSent(kind, confirmed);
+		}
 		printf("\nTx Data Sent \r\n");
-		set_LED_data(LED_GREEN,&on);
-		SwTimerStart(lTimerId,MS_TO_US(100),SW_TIMEOUT_RELATIVE,(void *)lTimerCb,NULL);
+		if (BATTERY_GetPolicy()->ledEnabled)
+		{
+			set_LED_data(LED_GREEN,&on);
+			APP_TIMER_Start(ledTimerId, MS_TO_US(100), MS_TO_US(APP_LED_BLINK_SLACK_MS), lTimerCb, NULL);
+		}
 	}
 	else
 	{
 		printf("\nTx Data Dropped \r\n");
 		print_stack_status(status);
+		app_session_health((StackRetStatus_t)status, confirmed);
+		app_tx_end();
 		appTaskState = SLEEP_STATE;
 		appPostTask(DISPLAY_TASK_HANDLER);
 	}
 }
 
-
-static void get_adc_resource_data(uint8_t * data)
+#if (DEMO_APP_PAYLOAD_CRYPTO == 1)
+/*********************************************************************//*
+ \brief      Seals appTxBuf for the frame counter of the next uplink
+ \param[in]  length - plaintext length
+ \return     sealed length, 0 if it does not fit or crypto is unavailable
+ ************************************************************************/
+static uint8_t app_seal_payload(uint8_t length)
 {
-	get_adc_data(data);
+	uint32_t devAddr = 0;
+	uint32_t fCnt = 0;
+
+	LORAWAN_GetAttr(DEV_ADDR, NULL, &devAddr);
+	LORAWAN_GetAttr(UPLINK_COUNTER, NULL, &fCnt);
+	/* The epoch of the session is bumped by every join, see FCNT_STORE_Start().
+	   No frame sealed under it is sent before its record is written, see app_fcnt_reserve() */
+	return APP_CRYPTO_Seal(appTxBuf, length, sizeof(appTxBuf), APP_CRYPTO_UPLINK, devAddr,
+	                       FCNT_STORE_GetStats()->epoch, fCnt);
 }
+#endif
 
-static void get_adc_data(uint8_t *data)
-{
-	float local_temp = 0;
-	local_temp = acc_sensor_value(0);
-	memcpy(data,(uint8_t *)&local_temp,sizeof(local_temp));
-}
 
-static double acc_sensor_value(int type)
+static void processSleep(void)
 {
-	/*  To Store ADC output in voltage format */
-	uint16_t raw_result;
-	
-	double temp;
-	
-	//load_calibration_data();
-	
-	raw_result = adc_start_read_result();
-	
-	temp = calculate_acc(raw_result);
-	
-	return temp;
-	
+#ifdef CONF_PMM_ENABLE
+	/* Entered from the main loop once the stack is ready, see SLEEP_COORD_Idle() */
+	appSleepScale = BATTERY_GetPolicy()->sleepMultiplier;
+#if (DEMO_APP_SAMPLE_ALIGN == 1)
+	SLEEP_COORD_Request(TIME_SYNC_MsToBoundary(app_uptime_ms(), adcWakePlan.sleepTimeMs * appSleepScale,
+	                                           DEMO_APP_SAMPLE_PHASE_MS));
+#else
+	SLEEP_COORD_Request(adcWakePlan.sleepTimeMs * appSleepScale);
+#endif
+#endif
 }
 
-static uint16_t adc_start_read_result(void)
+#ifdef CONF_PMM_ENABLE
+static bool app_stack_ready_to_sleep(void)
 {
-	uint16_t adc_result = 0;
-	
-	adc_start_conversion(&adc_instance);
-	while((adc_get_status(&adc_instance) & ADC_STATUS_RESULT_READY) != 1);
+	static bool deviceResetsForWakeup = false;
 
-	adc_read(&adc_instance, &adc_result);
-	
-	return adc_result;
+	return LORAWAN_ReadyToSleep(deviceResetsForWakeup);
 }
 
-static float calculate_acc(uint16_t raw_code)
+static uint32_t app_next_activity_ms(void)
 {
-	float VADC;      /* Voltage calculation using ADC result for Coarse Temp calculation */
-	
-	
-	
-	//VADC = ((float)raw_code * 10200.0)/4095.0;
-	VADC = ((float)raw_code * 20.0)/4095.0;	
-	return VADC;
+	return SwTimerNextExpiryDuration() / 1000;
 }
 
-static void processSleep(void)
+static bool app_deep_sleep(uint32_t sleepTimeMs)
 {
-#ifdef CONF_PMM_ENABLE
-
-	static bool deviceResetsForWakeup = false;
 	PMM_SleepReq_t sleepReq;
-	
-	sleepReq.sleepTimeMs = 5000;
+
+	sleepReq.sleepTimeMs = sleepTimeMs;
 	sleepReq.pmmWakeupCallback = appWakeup;
 	sleepReq.sleep_mode = CONF_PMM_SLEEPMODE_WHEN_IDLE;
-	
-	
-	if (true == LORAWAN_ReadyToSleep(deviceResetsForWakeup))
+
+	PERIPH_PowerDownIdle();
+	adc_window_arm(true);
+	if (PMM_SLEEP_REQ_DENIED == PMM_Sleep(&sleepReq))
 	{
-		app_resources_uninit();
-		if (PMM_SLEEP_REQ_DENIED == PMM_Sleep(&sleepReq))
-		{
-			HAL_Radio_resources_init();
-			sio2host_init();
-			appTaskState = SLEEP_STATE;
-			appPostTask(DISPLAY_TASK_HANDLER);
-			printf("\r\nsleep_not_ok_1\r\n");
-		}
+		/* Peripherals are powered up again by their next user */
+		adc_window_arm(false);
+		return false;
 	}
-	else
+	return true;
+}
+
+static void app_idle_sleep(uint32_t maxTimeMs)
+{
+	/* Any interrupt ends the idle sleep, the SW timer interrupt bounds it to maxTimeMs */
+	ATOMIC_SECTION_ENTER
+	if (SYSTEM_ReadyToSleep())
 	{
-		printf("\r\nsleep_not_ok_2\r\n");
-		appTaskState = SLEEP_STATE;
-		appPostTask(DISPLAY_TASK_HANDLER);
+		system_set_sleepmode(SYSTEM_SLEEPMODE_IDLE);
+		system_sleep();
 	}
-	
-	#endif
+	ATOMIC_SECTION_EXIT
 }
+#endif
 
 /*********************************************************************//**
 \brief    Initialization the Demo application
@@ -449,6 +981,87 @@ void mote_demo_init(void)
     bool status = false;
     /* Initialize the resources */
     resource_init();
+    /* UART, radio and ADC are all powered by the start-up code */
+    PERIPH_Init(appPeriphOps, PERIPH_MASK_ALL);
+    CONSOLE_Init(appCommands, sizeof(appCommands) / sizeof(appCommands[0]), app_console_notify);
+    /* The start-up code initialized the UART with the sio2host handler */
+    _sercom_set_handler(_sercom_get_sercom_inst_index(USART_HOST), app_console_isr);
+    FRAG_SESSION_Init(APP_NVM_GetOps(), APP_NVM_FRAG_OFFSET, APP_NVM_FRAG_SIZE, app_time_us);
+    TX_POLICY_Init(CONFIRMED == DEMO_APP_TRANSMISSION_TYPE, DEMO_APP_STATUS_PROBE_MIN, DEMO_APP_STATUS_PROBE_MAX);
+#if (DEMO_APP_PAYLOAD_CRYPTO == 1)
+    /* Uplinks are dropped rather than sent in clear without the keys of the
+     * device or if the self test fails */
+    if (!CFG_STORE_PayloadKeysSet())
+    {
+        printf("\r\nPayload keys not provisioned\r\n");
+    }
+    else if (!APP_CRYPTO_Init(CFG_STORE_PayloadEncKey(), CFG_STORE_PayloadMacKey(),
+                              (DEMO_APP_PAYLOAD_CRYPTO_ENGINE == 1) ? AESEncode : NULL))
+    {
+        printf("\r\nPayload crypto self test failed\r\n");
+    }
+#endif
+    EVT_TRACE_Init();
+    BATTERY_Init();
+    TIME_SYNC_Init(DEMO_APP_TIME_SYNC_PERIOD_MS, DEMO_APP_TIME_SYNC_RETRY_MS);
+    {
+        static const ClockPolicy_t clockPolicy = { { DEMO_APP_CLOCK_SHIFTS } };
+
+        CLOCK_POLICY_Init(&clockPolicy, app_clock_set);
+    }
+    APP_TIMER_Init(&appTimerOps);
+    APP_TIMER_Create(&ledTimerId);
+    APP_TIMER_Create(&countdownTimerId);
+    APP_TIMER_Create(&confirmTimerId);
+    APP_TIMER_Create(&uplinkSlotTimerId);
+    APP_TIMER_Create(&classTimerId);
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+    APP_TIMER_Create(&waveTimerId);
+#endif
+    SESSION_CACHE_Init(APP_NVM_GetOps(), APP_NVM_SESSION_OFFSET);
+    FCNT_STORE_Init(APP_NVM_GetOps(), APP_NVM_FCNT_OFFSET, DEMO_APP_FCNT_BLOCK);
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+    WAVE_CAPTURE_Init(DEMO_APP_WAVE_POST_PERIOD_MS, APP_ACC_AXES);
+#endif
+#if (DEMO_APP_ANOMALY_DETECTOR == 1)
+    {
+        static const AnomalyConfig_t anomalyConfig =
+        {
+            DEMO_APP_ANOMALY_SHIFT, DEMO_APP_ANOMALY_Z_Q4, DEMO_APP_ANOMALY_WARMUP, DEMO_APP_ANOMALY_SIGMA_MIN
+        };
+
+        ANOMALY_Init(&anomalyConfig);
+    }
+#endif
+    SESSION_HEALTH_Init(DEMO_APP_HEALTH_NO_ACK_LIMIT, DEMO_APP_REJOIN_RETRY_MIN_MS, DEMO_APP_REJOIN_RETRY_MAX_MS);
+    {
+        static const LinkQualityConfig_t linkConfig =
+        {
+            5, LINK_QUALITY_DB(-20), LINK_QUALITY_MAX_POWERS, { DEMO_APP_LINK_TX_COST },
+            LINK_QUALITY_DB(DEMO_APP_LINK_MARGIN_DB), DEMO_APP_LINK_TARGET_DELIVERY
+        };
+
+        LINK_QUALITY_Init(&linkConfig);
+    }
+    {
+        static const ClassMgrConfig_t classConfig =
+        {
+            DEMO_APP_CLASS_C_WINDOW_MAX_MS, DEMO_APP_CLASS_C_BUDGET_MS, DEMO_APP_CLASS_C_BUDGET_PERIOD_MS,
+            DEMO_APP_MAINTENANCE_WINDOW_MS
+        };
+
+        CLASS_MGR_Init(&classConfig, app_uptime_ms());
+    }
+    UPLINK_SLOT_Init(demoDevEui, DEMO_APP_UPLINK_SLOT_WINDOW_MS, DEMO_APP_UPLINK_JITTER_MS,
+                     DEMO_APP_UPLINK_RESLOT_FAILURES);
+    if (ADC_WAKE_MODE_WINDOW == adcWakePlan.mode)
+    {
+        /* The window monitor keeps converting in standby */
+        PERIPH_Acquire(PERIPH_ADC);
+    }
+#ifdef CONF_PMM_ENABLE
+    SLEEP_COORD_Init(&appSleepOps);
+#endif
 
 	startReceiving = false;
     /* Initialize the LORAWAN Stack */
@@ -464,20 +1077,13 @@ void mote_demo_init(void)
         uint8_t prevChoice = 0xFF;
         PDS_RestoreAll();
         LORAWAN_GetAttr(ISMBAND,NULL,&prevBand);
-        for (uint32_t i = 0; i < sizeof(bandTable) -1; i++)
-        {
-            if(bandTable[i] == prevBand)
-            {
-                prevChoice = i;
-                break;
-            }
-        }
-        memset(rxchar,0,sizeof(rxchar));
-        sio2host_rx(rxchar,10);
+        prevChoice = APP_FORMAT_FindBand(prevBand);
+        /* Keys pressed before the prompt do not count */
+        CONSOLE_TakeKey();
         printf ("Last configured Regional band %s\r\n",bandStrings[prevChoice]);
         printf("Press any key to change band\r\n Continuing in %s in ", bandStrings[prevChoice]);
 
-        SwTimerStart(demoTimerId,MS_TO_US(1000),SW_TIMEOUT_RELATIVE,(void *)demoTimerCb,NULL);
+        APP_TIMER_Start(countdownTimerId, MS_TO_US(1000), MS_TO_US(APP_COUNTDOWN_SLACK_MS), demoTimerCb, NULL);
     }
     else
     {
@@ -500,316 +1106,626 @@ static void demo_handle_evt_rx_data(void *appHandle, appCbParams_t *appdata)
     //Successful transmission
     if((dataLength > 0U) && (NULL != pData))
     {
-        printf("*** Received DL Data ***\n\r");
-        printf("\nFrame Received at port %d\n\r",pData[0]);
-        printf("\nFrame Length - %d\n\r",dataLength);
-        printf("\nAddress - 0x%lx\n\r", devAddress);
-        printf ("\nPayload: ");
+        /* A Class C window can bring downlinks while the UART is off */
+        APP_TRACE("*** Received DL Data ***\n\r");
+        APP_TRACE("\nFrame Received at port %d\n\r",pData[0]);
+        APP_TRACE("\nFrame Length - %d\n\r",dataLength);
+        APP_TRACE("\nAddress - 0x%lx\n\r", devAddress);
+        APP_TRACE("\nPayload: ");
         for (uint8_t i =0; i<dataLength - 1; i++)
         {
-            printf("%x",pData[i+1]);
+            APP_TRACE("%x",pData[i+1]);
+        }
+        APP_TRACE("\r\n*************************\r\n");
+
+        if (DEMO_APP_CMD_FPORT == pData[0])
+        {
+            DlCmdStatus_t cmdStatus = DL_CMD_Handle(&pData[1], dataLength - 1);
+
+            APP_TRACE("Command status: %d\r\n", cmdStatus);
+            if (DL_CMD_OK == cmdStatus)
+            {
+                uint16_t windowS = DL_CMD_TakeClassCWindow();
+
+                if (windowS > 0)
+                {
+                    /* Switched once the transaction is over */
+                    CLASS_MGR_Request(CLASS_MGR_DOWNLINK, (uint32_t)windowS * 1000u, app_uptime_ms());
+                    app_class_update();
+                }
+                adc_window_update();
+                /* Kept for the next boot, the settings in use already changed */
+                if (!CFG_STORE_SaveParams(APP_PARAMS_Get()))
+                {
+                    APP_TRACE("Parameters not saved\r\n");
+                }
+            }
+        }
+        else if (FRAG_SESSION_FPORT == pData[0])
+        {
+            FragStatus_t fragStatus = FRAG_SESSION_GetStatus();
+
+            /* Fragments usually come over the multicast group, setup over unicast */
+            if (fragStatus != FRAG_SESSION_HandleMessage(&pData[1], dataLength - 1))
+            {
+                const FragSessionStats_t *fragStats = FRAG_SESSION_GetStats();
+
+                fragStatus = FRAG_SESSION_GetStatus();
+                APP_TRACE("Fragmentation status: %d\r\n", fragStatus);
+                if (FRAG_STATUS_COMPLETE == fragStatus)
+                {
+                    APP_TRACE("Block of %ld bytes rebuilt, %d lost fragments, %ld us decoding, %ld bytes RAM\r\n",
+                              FRAG_SESSION_BlockLength(), fragStats->lost, fragStats->decodeTimeUs, fragStats->ramBytes);
+                }
+            }
+        }
+    }
+    else
+    {
+        APP_TRACE("Received ACK for Confirmed data\r\n");
+    }
+}
+
+/*********************************************************************//**
+\brief Callback function for the ending of Bidirectional communication of
+       Application data
+ *************************************************************************/
+void demo_appdata_callback(void *appHandle, appCbParams_t *appdata)
+{
+    StackRetStatus_t status = LORAWAN_INVALID_REQUEST;
+
+    if (LORAWAN_EVT_RX_DATA_AVAILABLE == appdata->evt)
+    {
+        status = appdata->param.rxData.status;
+        EVT_TRACE_Record(EVT_TRACE_RX_DATA, (uint8_t)status, app_time_ms());
+        if (LORAWAN_SUCCESS == status)
+        {
+            if (appdata->param.rxData.devAddr != CFG_STORE_McastGroupAddr())
+            {
+                SESSION_CACHE_OnResult(false, true);
+                app_link_sample();
+            }
+            demo_handle_evt_rx_data(appHandle, appdata);
+        }
+        else
+        {
+            if (PERIPH_IsPowered(PERIPH_UART))
+            {
+                APP_FORMAT_PrintRxStatus(status);
+            }
+            app_session_health(status, false);
+        }
+    }
+    else if(LORAWAN_EVT_TRANSACTION_COMPLETE == appdata->evt)
+    {
+        status = appdata->param.transCmpl.status;
+        EVT_TRACE_Record(EVT_TRACE_TX_DONE, (uint8_t)status, app_time_ms());
+        APP_FORMAT_PrintTxStatus(status);
+        printf("\n\r*************************************************\n\r");
+        TX_POLICY_OnResult((LORAWAN_SUCCESS == status) || (LORAWAN_RADIO_SUCCESS == status));
+        UPLINK_SLOT_OnResult((LORAWAN_NO_ACK == status) || (LORAWAN_TX_TIMEOUT == status), app_time_us());
+        app_session_health(status, CONFIRMED == lorawanSendReq.confirmed);
+        if ((CONFIRMED == lorawanSendReq.confirmed) && (LORAWAN_SUCCESS == status))
+        {
+            /* The acknowledgment is a downlink too */
+            app_link_sample();
+        }
+        LINK_QUALITY_OnUplink(CONFIRMED == lorawanSendReq.confirmed, LORAWAN_SUCCESS == status);
+        if (SESSION_CACHE_REJECTED == SESSION_CACHE_OnResult(CONFIRMED == lorawanSendReq.confirmed,
+                                                             (CONFIRMED == lorawanSendReq.confirmed) &&
+                                                             (LORAWAN_SUCCESS == status)))
+        {
+            printf("\nRestored session rejected, joining again\r\n");
+            SESSION_HEALTH_OnEvent(SESSION_HEALTH_REJECTED, app_uptime_ms());
+            rejoinPending = true;
+        }
+        if (timeSyncPending)
+        {
+            uint32_t gpsTime = 0;
+
+            timeSyncPending = false;
+            LORAWAN_GetAttr(DEVICE_GPS_EPOCH_TIME, NULL, &gpsTime);
+            if ((0 != gpsTime) && (gpsTime != timeSyncLastGps))
+            {
+                /* The answer holds whole seconds at the end of the uplink */
+                timeSyncLastGps = gpsTime;
+                TIME_SYNC_Update(app_uptime_ms() - DEMO_APP_TIME_SYNC_RX_DELAY_MS,
+                                 (uint64_t)gpsTime * 1000u + 500u);
+                APP_TRACE("\nNetwork time %lu, drift %ld ppb\r\n", gpsTime, (long)TIME_SYNC_GetStats()->driftPpb);
+            }
+        }
+    }
+
+    APP_TIMER_Stop(ledTimerId);
+    app_tx_end();
+    SLEEP_COORD_Notify();
+    set_LED_data(LED_GREEN,&off);
+    if(status != LORAWAN_SUCCESS)
+    {
+        app_led_on(LED_AMBER);
+    }
+	appTaskState = SLEEP_STATE;
+    appPostTask(DISPLAY_TASK_HANDLER);
+}
+
+/*********************************************************************//*
+\brief Callback function for the ending of Activation procedure
+ ************************************************************************/
+void demo_joindata_callback(StackRetStatus_t status)
+{
+    /* An existing session resumes its counters, an OTAA join starts new ones */
+    bool resume = sessionRestoring || (ACTIVATION_BY_PERSONALIZATION == CFG_STORE_ActivationType());
+
+    /* This is called every time the join process is finished */
+    EVT_TRACE_Record(EVT_TRACE_JOIN, (uint8_t)status, app_time_ms());
+    set_LED_data(LED_GREEN,&off);
+    if (sessionRestoring)
+    {
+        sessionRestoring = false;
+        if (LORAWAN_SUCCESS == status)
+        {
+            /* The activation restarts the counters, continue those of the session */
+            LORAWAN_SetAttr(UPLINK_COUNTER, &sessionRestored.fCntUp);
+            LORAWAN_SetAttr(DOWNLINK_COUNTER, &sessionRestored.fCntDown);
+            SESSION_CACHE_Restored(sessionRestored.band);
+            printf("\nCached session restored\n\r");
+        }
+        else
+        {
+            SESSION_CACHE_Invalidate(sessionRestored.band);
+            rejoinPending = true;
+        }
+    }
+    if(LORAWAN_SUCCESS == status)
+    {
+        uint32_t devAddress;
+        bool mcastEnabled;
+
+        uint32_t offlineMs = SESSION_HEALTH_OfflineMs(app_uptime_ms());
+
+        joined = true;
+        printf("\nJoining Successful\n\r");
+        SESSION_HEALTH_OnJoin(true, app_uptime_ms());
+        if (offlineMs > 0)
+        {
+            printf("\nSession back after %lu ms offline, %lu ms in %u outages\r\n", offlineMs,
+                   SESSION_HEALTH_GetStats()->totalOfflineMs, SESSION_HEALTH_GetStats()->outages);
+        }
+        app_fcnt_track(resume);
+        /* Schedules the maintenance slots */
+        app_class_update();
+        LORAWAN_GetAttr(DEV_ADDR, NULL, &devAddress);
+        LORAWAN_GetAttr(MCAST_ENABLE, NULL, &mcastEnabled);
+
+        if (devAddress != CFG_STORE_McastGroupAddr())
+        {
+            printf("\nDevAddr: 0x%lx\n\r", devAddress);
+        }
+        else if ((devAddress == CFG_STORE_McastGroupAddr()) && (true == mcastEnabled))
+        {
+            printf("\nAddress conflict between Device Address and Multicast group address\n\r");
+        }
+        print_application_config();
+        set_LED_data(LED_GREEN,&on);
+    }
+	else if(LORAWAN_NO_CHANNELS_FOUND == status)
+	{
+		joined = false;
+		set_LED_data(LED_AMBER,&on);
+		printf("\n No Free Channel found");
+	}
+	else if (LORAWAN_MIC_ERROR == status)
+	{
+		joined = false;
+		set_LED_data(LED_AMBER,&on);
+		printf("\n MIC Error");
+	}
+	else if (LORAWAN_TX_TIMEOUT == status)
+	{
+		joined = false;
+		set_LED_data(LED_AMBER,&on);
+		printf("\n Transmission Timeout");
+	}
+    else
+    {
+        joined = false;
+        set_LED_data(LED_AMBER,&on);
+        printf("\nJoining Denied\n\r");
+    }
+    printf("\n\r*******************************************************\n\r");
+    if (!joined)
+    {
+        SESSION_HEALTH_OnJoin(false, app_uptime_ms());
+    }
+    PDS_StoreAll();
+    app_tx_end();
+    SLEEP_COORD_Notify();
+	
+	if (joined && resendPending)
+	{
+		/* The frame held when the session was lost goes first */
+		resendPending = false;
+		memcpy(acc_sen_str, heldReading, sizeof(acc_sen_str));
+		app_schedule_send(resendState);
+	}
+	else
+	{
+		appTaskState = SLEEP_STATE;
+		appPostTask(DISPLAY_TASK_HANDLER);
+	}
+}
+
+void lTimerCb(void *data)
+{
+    APP_TIMER_Start(ledTimerId, MS_TO_US(100), MS_TO_US(APP_LED_BLINK_SLACK_MS), lTimerCb, NULL);
+    set_LED_data(LED_GREEN,&toggle);
+}
+
+#ifdef CONF_PMM_ENABLE
+static void appWakeup(uint32_t sleptDuration)
+{
+	/* Radio and UART stay off until a send or a log needs them */
+	CLOCK_POLICY_SetPhase(CLOCK_PHASE_SAMPLE);
+	adc_window_arm(false);
+	EVT_TRACE_Record(EVT_TRACE_WAKE, adcWindowWake ? 1 : 0, app_time_ms());
+	/* A timed wakeup covers periodsPerWake sample periods, a window wakeup none */
+	if (!adcWindowWake)
+	{
+		counter_status += adcWakePlan.periodsPerWake * appSleepScale;
+	}
+	adcWindowWake = false;
+	appTaskState = READ_STATE;
+	appPostTask(DISPLAY_TASK_HANDLER);
+	APP_TRACE("\r\nsleep_ok %ld ms\r\n", sleptDuration);
+			
+}
+#endif
+
+/*********************************************************************//*
+ \brief      Turns a status LED on unless the battery tier keeps them off
+ \param[in]  led - LED to turn on
+ ************************************************************************/
+static void app_led_on(uint8_t led)
+{
+    if (BATTERY_GetPolicy()->ledEnabled)
+    {
+        set_LED_data(led, &on);
+    }
+}
+
+/*********************************************************************//*
+ \brief      Stores the session of the current band before leaving it
+ ************************************************************************/
+static void app_cache_session(void)
+{
+    SessionCacheEntry_t entry;
+    uint8_t band = 0xFF;
+
+    /* Only an over the air session is restored, see app_restore_session() */
+    if (!joined || (OVER_THE_AIR_ACTIVATION != CFG_STORE_ActivationType()))
+    {
+        return;
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    /* Keys that cannot be read back (secure element) leave nothing to cache */
+    if ((LORAWAN_SUCCESS == LORAWAN_GetAttr(ISMBAND, NULL, &band)) &&
+        (LORAWAN_SUCCESS == LORAWAN_GetAttr(DEV_ADDR, NULL, &entry.devAddr)) &&
+        (LORAWAN_SUCCESS == LORAWAN_GetAttr(NWKS_KEY, NULL, entry.nwkSKey)) &&
+        (LORAWAN_SUCCESS == LORAWAN_GetAttr(APPS_KEY, NULL, entry.appSKey)) &&
+        (LORAWAN_SUCCESS == LORAWAN_GetAttr(UPLINK_COUNTER, NULL, &entry.fCntUp)) &&
+        (LORAWAN_SUCCESS == LORAWAN_GetAttr(DOWNLINK_COUNTER, NULL, &entry.fCntDown)))
+    {
+        entry.band = band;
+        if (!SESSION_CACHE_Store(&entry))
+        {
+            printf("\nSession not cached\r\n");
+        }
+    }
+}
+
+/*********************************************************************//*
+ \brief      Loads the cached session of a band into the stack
+ \param[in]  band - band being joined
+ \return     true if LORAWAN_Join() is to activate it by personalization,
+             false to join over the air as configured
+ ************************************************************************/
+static bool app_restore_session(IsmBand_t band)
+{
+    /* An ABP device always uses the session of its configuration */
+    if (OVER_THE_AIR_ACTIVATION != CFG_STORE_ActivationType())
+    {
+        return false;
+    }
+    /* Missing, corrupted or blank in the flash */
+    if (!SESSION_CACHE_Find((uint8_t)band, &sessionRestored))
+    {
+        return false;
+    }
+
+    if ((LORAWAN_SUCCESS != LORAWAN_SetAttr(DEV_ADDR, &sessionRestored.devAddr)) ||
+        (LORAWAN_SUCCESS != LORAWAN_SetAttr(NWKS_KEY, sessionRestored.nwkSKey)) ||
+        (LORAWAN_SUCCESS != LORAWAN_SetAttr(APPS_KEY, sessionRestored.appSKey)))
+    {
+        /* A partly loaded session is never activated, the join replaces it */
+        printf("\nCached session not loaded, joining\r\n");
+        SESSION_CACHE_Invalidate((uint8_t)band);
+        memset(&sessionRestored, 0, sizeof(sessionRestored));
+        return false;
+    }
+    sessionRestoring = true;
+    return true;
+}
+
+/*********************************************************************//*
+ \brief      Joins the current band again, without the lost session
+ ************************************************************************/
+static void app_rejoin(void)
+{
+    uint8_t band = 0xFF;
+
+    LORAWAN_GetAttr(ISMBAND, NULL, &band);
+    /* The cached copy of a lost session is not restored again */
+    SESSION_CACHE_Invalidate(band);
+    SESSION_HEALTH_Rejoining();
+    joined = false;
+    mote_set_parameters((IsmBand_t)band, APP_FORMAT_FindBand(band));
+}
+
+/*********************************************************************//*
+ \brief      Switches the stack for the class manager, the radio stays
+             powered while the receiver runs continuously in Class C
+ \param[in]  classC - Class C wanted
+ \return     true if the stack switched
+ ************************************************************************/
+static bool app_class_set(bool classC)
+{
+    /* Entering Class C applies the multicast parameters again */
+    if (txResourcesHeld || (LORAWAN_SUCCESS != set_device_type(classC ? CLASS_C : CLASS_A)))
+    {
+        return false;
+    }
+    appClassC = classC;
+    if (classC)
+    {
+        PERIPH_Acquire(PERIPH_RADIO);
+    }
+    else
+    {
+        PERIPH_Release(PERIPH_RADIO);
+    }
+    APP_TRACE("\r\nClass %c, %ld ms of receiver-on credit left\r\n", classC ? 'C' : 'A',
+              (long)CLASS_MGR_GetStats()->creditMs);
+    return true;
+}
+
+static uint32_t app_class_slot_delay(uint64_t nowMs)
+{
+    return TIME_SYNC_MsToBoundary(nowMs, DEMO_APP_MAINTENANCE_PERIOD_MS, DEMO_APP_MAINTENANCE_PHASE_MS);
+}
+
+/*********************************************************************//*
+ \brief      Switches between Class A and a Class C window as the class
+             manager asks and arms the timer of its next decision
+ ************************************************************************/
+static void app_class_update(void)
+{
+    static const ClassMgrOps_t classOps = { app_class_set, app_class_slot_delay };
+    uint32_t nextMs;
+
+    /* A Class C device keeps its class, the windows need a session */
+    if ((CLASS_C == CFG_STORE_Class()) || !joined)
+    {
+        APP_TIMER_Stop(classTimerId);
+        return;
+    }
+
+    nextMs = CLASS_MGR_Run(&classOps, app_uptime_ms());
+    APP_TIMER_Start(classTimerId, MS_TO_US(nextMs), MS_TO_US(APP_CLASS_SLACK_MS), app_class_due, NULL);
+}
+
+static void app_class_due(void *param)
+{
+    app_class_update();
+}
+
+/*********************************************************************//*
+ \brief      Accounts the end of a Class C window ended by a stack reset
+ ************************************************************************/
+static void app_class_reset(void)
+{
+    if (appClassC)
+    {
+        appClassC = false;
+        CLASS_MGR_Switched(false, app_uptime_ms());
+        PERIPH_Release(PERIPH_RADIO);
+    }
+}
+
+/*********************************************************************//*
+ \brief      Feeds the result of a frame to the session monitor
+ \param[in]  status    - status of the send or of the transaction
+ \param[in]  confirmed - the frame asked for an acknowledgment
+ ************************************************************************/
+static void app_session_health(StackRetStatus_t status, bool confirmed)
+{
+    SessionHealthEvent_t event = SESSION_HEALTH_EventOf(status, confirmed);
+
+    if (SESSION_HEALTH_NO_EVENT == event)
+    {
+        return;
+    }
+    if (SESSION_HEALTH_OnEvent(event, app_uptime_ms()))
+    {
+        APP_TRACE("\nSession lost (%d), joining again\r\n", status);
+        rejoinPending = true;
+    }
+    if ((SESSION_HEALTH_TX_OK != event) && !SESSION_HEALTH_IsOnline())
+    {
+        /* An alarm is not replaced by a later status */
+        if (!resendPending || (LARM_STATE == lastSendState) || (LARM_STATE != resendState))
+        {
+            resendState = lastSendState;
+            memcpy(heldReading, acc_sen_str, sizeof(heldReading));
         }
-        printf("\r\n*************************\r\n");
+        resendPending = true;
     }
-    else
+}
+
+/*********************************************************************//*
+ \brief      Feeds the signal of the last received frame to the link
+              quality estimator, once per transaction
+ ************************************************************************/
+static void app_link_sample(void)
+{
+    int16_t rssi = 0;
+    int8_t snr = 0;
+
+    if (!linkSampled && (ERR_NONE == RADIO_GetAttr(PACKET_RSSI_VALUE, &rssi)) &&
+        (ERR_NONE == RADIO_GetAttr(PACKET_SNR, &snr)))
     {
-        printf("Received ACK for Confirmed data\r\n");
+        linkSampled = true;
+        LINK_QUALITY_OnDownlink(rssi, snr);
     }
 }
 
-/*********************************************************************//**
-\brief Callback function for the ending of Bidirectional communication of
-       Application data
- *************************************************************************/
-void demo_appdata_callback(void *appHandle, appCbParams_t *appdata)
+/*********************************************************************//*
+ \brief      Applies the data rate and TX power of the lowest energy that
+              keep the link, unless the network ADR is in charge
+ ************************************************************************/
+static void app_link_adapt(void)
 {
-    StackRetStatus_t status = LORAWAN_INVALID_REQUEST;
+    uint8_t dr = 0;
+    uint8_t txPower = 0;
+    uint8_t currentDr = 0;
+    uint8_t currentTxPower = 0;
+    bool adr = true;
 
-    if (LORAWAN_EVT_RX_DATA_AVAILABLE == appdata->evt)
+    if (!LINK_QUALITY_Recommend(&dr, &txPower))
     {
-        status = appdata->param.rxData.status;
-        switch(status)
-        {
-            case LORAWAN_SUCCESS:
-            {
-                demo_handle_evt_rx_data(appHandle, appdata);
-            }
-            break;
-            case LORAWAN_RADIO_NO_DATA:
-            {
-                printf("\n\rRADIO_NO_DATA \n\r");
-            }
-            break;
-            case LORAWAN_RADIO_DATA_SIZE:
-                printf("\n\rRADIO_DATA_SIZE \n\r");
-            break;
-            case LORAWAN_RADIO_INVALID_REQ:
-                printf("\n\rRADIO_INVALID_REQ \n\r");
-            break;
-            case LORAWAN_RADIO_BUSY:
-                printf("\n\rRADIO_BUSY \n\r");
-            break;
-            case LORAWAN_RADIO_OUT_OF_RANGE:
-                printf("\n\rRADIO_OUT_OF_RANGE \n\r");
-            break;
-            case LORAWAN_RADIO_UNSUPPORTED_ATTR:
-                printf("\n\rRADIO_UNSUPPORTED_ATTR \n\r");
-            break;
-            case LORAWAN_RADIO_CHANNEL_BUSY:
-                printf("\n\rRADIO_CHANNEL_BUSY \n\r");
-            break;
-            case LORAWAN_NWK_NOT_JOINED:
-                printf("\n\rNWK_NOT_JOINED \n\r");
-            break;
-            case LORAWAN_INVALID_PARAMETER:
-                printf("\n\rINVALID_PARAMETER \n\r");
-            break;
-            case LORAWAN_KEYS_NOT_INITIALIZED:
-                printf("\n\rKEYS_NOT_INITIALIZED \n\r");
-            break;
-            case LORAWAN_SILENT_IMMEDIATELY_ACTIVE:
-                printf("\n\rSILENT_IMMEDIATELY_ACTIVE\n\r");
-            break;
-            case LORAWAN_FCNTR_ERROR_REJOIN_NEEDED:
-                printf("\n\rFCNTR_ERROR_REJOIN_NEEDED \n\r");
-            break;
-            case LORAWAN_INVALID_BUFFER_LENGTH:
-                printf("\n\rINVALID_BUFFER_LENGTH \n\r");
-            break;
-            case LORAWAN_MAC_PAUSED :
-                printf("\n\rMAC_PAUSED  \n\r");
-            break;
-            case LORAWAN_NO_CHANNELS_FOUND:
-                printf("\n\rNO_CHANNELS_FOUND_1 \n\r");
-            break;
-            case LORAWAN_BUSY:
-                printf("\n\rBUSY\n\r");
-            break;
-            case LORAWAN_NO_ACK:
-                printf("\n\rNO_ACK \n\r");
-            break;
-            case LORAWAN_NWK_JOIN_IN_PROGRESS:
-                printf("\n\rALREADY JOINING IS IN PROGRESS \n\r");
-            break;
-            case LORAWAN_RESOURCE_UNAVAILABLE:
-                printf("\n\rRESOURCE_UNAVAILABLE \n\r");
-            break;
-            case LORAWAN_INVALID_REQUEST:
-                printf("\n\rINVALID_REQUEST \n\r");
-            break;
-            case LORAWAN_FCNTR_ERROR:
-                printf("\n\rFCNTR_ERROR \n\r");
-            break;
-            case LORAWAN_MIC_ERROR:
-                printf("\n\rMIC_ERROR \n\r");
-            break;
-            case LORAWAN_INVALID_MTYPE:
-                printf("\n\rINVALID_MTYPE \n\r");
-            break;
-            case LORAWAN_MCAST_HDR_INVALID:
-                printf("\n\rMCAST_HDR_INVALID \n\r");
-            break;
-			case LORAWAN_INVALID_PACKET:
-				printf("\n\rINVALID_PACKET \n\r");
-			break;
-            default:
-                printf("UNKNOWN ERROR\n\r");
-            break;
-        }
+        return;
     }
-    else if(LORAWAN_EVT_TRANSACTION_COMPLETE == appdata->evt)
-    {
-        switch(status = appdata->param.transCmpl.status)
-        {
-            case LORAWAN_SUCCESS:
-            {
-                printf("Transmission Success 1\r\n");
-				
-            }
-            break;
-            case LORAWAN_RADIO_SUCCESS:
-            {
-                printf("Transmission Success 2\r\n");
-            }
-            break;
-            case LORAWAN_RADIO_NO_DATA:
-            {
-                printf("\n\rRADIO_NO_DATA \n\r");
-            }
-            break;
-            case LORAWAN_RADIO_DATA_SIZE:
-                printf("\n\rRADIO_DATA_SIZE \n\r");
-            break;
-            case LORAWAN_RADIO_INVALID_REQ:
-                printf("\n\rRADIO_INVALID_REQ \n\r");
-            break;
-            case LORAWAN_RADIO_BUSY:
-                printf("\n\rRADIO_BUSY \n\r");
-            break;
-            case LORAWAN_TX_TIMEOUT:
-                printf("\nTx Timeout\n\r");
-            break;
-            case LORAWAN_RADIO_OUT_OF_RANGE:
-                printf("\n\rRADIO_OUT_OF_RANGE \n\r");
-            break;
-            case LORAWAN_RADIO_UNSUPPORTED_ATTR:
-                printf("\n\rRADIO_UNSUPPORTED_ATTR \n\r");
-            break;
-            case LORAWAN_RADIO_CHANNEL_BUSY:
-                printf("\n\rRADIO_CHANNEL_BUSY \n\r");
-            break;
-            case LORAWAN_NWK_NOT_JOINED:
-                printf("\n\rNWK_NOT_JOINED \n\r");
-            break;
-            case LORAWAN_INVALID_PARAMETER:
-                printf("\n\rINVALID_PARAMETER \n\r");
-            break;
-            case LORAWAN_KEYS_NOT_INITIALIZED:
-                printf("\n\rKEYS_NOT_INITIALIZED \n\r");
-            break;
-            case LORAWAN_SILENT_IMMEDIATELY_ACTIVE:
-                printf("\n\rSILENT_IMMEDIATELY_ACTIVE\n\r");
-            break;
-            case LORAWAN_FCNTR_ERROR_REJOIN_NEEDED:
-                printf("\n\rFCNTR_ERROR_REJOIN_NEEDED \n\r");
-            break;
-            case LORAWAN_INVALID_BUFFER_LENGTH:
-                printf("\n\rINVALID_BUFFER_LENGTH \n\r");
-            break;
-            case LORAWAN_MAC_PAUSED :
-                printf("\n\rMAC_PAUSED  \n\r");
-            break;
-            case LORAWAN_NO_CHANNELS_FOUND:
-                printf("\n\rNO_CHANNELS_FOUND_2 \n\r");
-            break;
-            case LORAWAN_BUSY:
-                printf("\n\rBUSY\n\r");
-            break;
-            case LORAWAN_NO_ACK:
-                printf("\n\rNO_ACK \n\r");
-            break;
-            case LORAWAN_NWK_JOIN_IN_PROGRESS:
-                printf("\n\rALREADY JOINING IS IN PROGRESS \n\r");
-            break;
-            case LORAWAN_RESOURCE_UNAVAILABLE:
-                printf("\n\rRESOURCE_UNAVAILABLE \n\r");
-            break;
-            case LORAWAN_INVALID_REQUEST:
-                printf("\n\rINVALID_REQUEST \n\r");
-            break;
-            case LORAWAN_FCNTR_ERROR:
-                printf("\n\rFCNTR_ERROR \n\r");
-            break;
-            case LORAWAN_MIC_ERROR:
-                printf("\n\rMIC_ERROR \n\r");
-            break;
-            case LORAWAN_INVALID_MTYPE:
-                printf("\n\rINVALID_MTYPE \n\r");
-            break;
-            case LORAWAN_MCAST_HDR_INVALID:
-                printf("\n\rMCAST_HDR_INVALID \n\r");
-            break;
-			case LORAWAN_INVALID_PACKET:
-				printf("\n\rINVALID_PACKET \n\r");
-			break;
-            default:
-                printf("\n\rUNKNOWN ERROR\n\r");
-            break;
 
-                    }
-        printf("\n\r*************************************************\n\r");
+    LORAWAN_GetAttr(CURRENT_DATARATE, NULL, &currentDr);
+    LORAWAN_GetAttr(TX_POWER, NULL, &currentTxPower);
+    if ((dr == currentDr) && (txPower == currentTxPower))
+    {
+        return;
     }
-
-    SwTimerStop(lTimerId);
-    set_LED_data(LED_GREEN,&off);
-    if(status != LORAWAN_SUCCESS)
+    LORAWAN_GetAttr(ADR, NULL, &adr);
+    APP_TRACE("\nLink %d dB SNR: DR%d, TX power %d%s\r\n", LINK_QUALITY_UplinkSnrQ4() / 16, dr, txPower,
+              ((DEMO_APP_LINK_ADAPT == 1) && !adr) ? "" : " (not applied)");
+    if ((DEMO_APP_LINK_ADAPT == 1) && !adr)
     {
-        set_LED_data(LED_AMBER,&on);
+        LORAWAN_SetAttr(CURRENT_DATARATE, &dr);
+        LORAWAN_SetAttr(TX_POWER, &txPower);
     }
-	appTaskState = SLEEP_STATE;
-    appPostTask(DISPLAY_TASK_HANDLER);
 }
 
 /*********************************************************************//*
-\brief Callback function for the ending of Activation procedure
+ \brief      Starts reserving the frame counters of the session in use
+ \param[in]  resume - the session existed before, its stored counters
+                      are resumed if they are ahead of the stack
  ************************************************************************/
-void demo_joindata_callback(StackRetStatus_t status)
+static void app_fcnt_track(bool resume)
 {
-    /* This is called every time the join process is finished */
-    set_LED_data(LED_GREEN,&off);
-    if(LORAWAN_SUCCESS == status)
+    const FcntStoreStats_t *stats = FCNT_STORE_GetStats();
+    uint32_t devAddr = 0;
+    uint32_t fCntUp = 0;
+    uint32_t fCntDown = 0;
+
+    LORAWAN_GetAttr(DEV_ADDR, NULL, &devAddr);
+    LORAWAN_GetAttr(UPLINK_COUNTER, NULL, &fCntUp);
+    LORAWAN_GetAttr(DOWNLINK_COUNTER, NULL, &fCntDown);
+    if (resume && FCNT_STORE_Restore(devAddr, &fCntUp, &fCntDown))
     {
-        uint32_t devAddress;
-        bool mcastEnabled;
+        LORAWAN_SetAttr(UPLINK_COUNTER, &fCntUp);
+        LORAWAN_SetAttr(DOWNLINK_COUNTER, &fCntDown);
+        printf("\nFrame counter resumed at %lu, %lu skipped\r\n", fCntUp, stats->gap);
+    }
+    else if (!FCNT_STORE_Start(devAddr, fCntUp, fCntDown))
+    {
+        printf("\nFrame counter not reserved\r\n");
+    }
+    APP_DIAG_RecordFcnt(stats->writes, stats->uplinks, stats->gap);
+}
 
-        joined = true;
-        printf("\nJoining Successful\n\r");
-        LORAWAN_GetAttr(DEV_ADDR, NULL, &devAddress);
-        LORAWAN_GetAttr(MCAST_ENABLE, NULL, &mcastEnabled);
+/*********************************************************************//*
+ \brief      Reserves the counter of the next uplink in the flash
+ \return     false if the uplink must not be sent
+ ************************************************************************/
+static bool app_fcnt_reserve(void)
+{
+    const FcntStoreStats_t *stats = FCNT_STORE_GetStats();
+    uint32_t fCntUp = 0;
+    uint32_t fCntDown = 0;
+    bool reserved;
+
+    LORAWAN_GetAttr(UPLINK_COUNTER, NULL, &fCntUp);
+    LORAWAN_GetAttr(DOWNLINK_COUNTER, NULL, &fCntDown);
+    reserved = FCNT_STORE_Reserve(fCntUp, fCntDown);
+    APP_DIAG_RecordFcnt(stats->writes, stats->uplinks, stats->gap);
+    return reserved;
+}
 
-        if (devAddress != DEMO_APP_MCAST_GROUP_ADDRESS)
-        {
-            printf("\nDevAddr: 0x%lx\n\r", devAddress);
-        }
-        else if ((devAddress == DEMO_APP_MCAST_GROUP_ADDRESS) && (true == mcastEnabled))
-        {
-            printf("\nAddress conflict between Device Address and Multicast group address\n\r");
-        }
-        print_application_config();
-        set_LED_data(LED_GREEN,&on);
+/*********************************************************************//*
+ \brief      Holds the radio and the UART for a join or a transaction
+ ************************************************************************/
+static void app_tx_begin(void)
+{
+    if (!txResourcesHeld)
+    {
+        /* The stack services the RX windows from its interrupts, at full speed */
+        CLOCK_POLICY_Hold(CLOCK_PHASE_RADIO);
+        PERIPH_Acquire(PERIPH_RADIO);
+        PERIPH_Acquire(PERIPH_UART);
+        txResourcesHeld = true;
     }
-	else if(LORAWAN_NO_CHANNELS_FOUND == status)
-	{
-		joined = false;
-		set_LED_data(LED_AMBER,&on);
-		printf("\n No Free Channel found");
-	}
-	else if (LORAWAN_MIC_ERROR == status)
-	{
-		joined = false;
-		set_LED_data(LED_AMBER,&on);
-		printf("\n MIC Error");
-	}
-	else if (LORAWAN_TX_TIMEOUT == status)
-	{
-		joined = false;
-		set_LED_data(LED_AMBER,&on);
-		printf("\n Transmission Timeout");
-	}
-    else
+}
+
+/*********************************************************************//*
+ \brief      Releases the resources taken by app_tx_begin()
+ ************************************************************************/
+static void app_tx_end(void)
+{
+    if (txResourcesHeld)
     {
-        joined = false;
-        set_LED_data(LED_AMBER,&on);
-        printf("\nJoining Denied\n\r");
+        PERIPH_Release(PERIPH_RADIO);
+        PERIPH_Release(PERIPH_UART);
+        CLOCK_POLICY_Release(CLOCK_PHASE_RADIO);
+        txResourcesHeld = false;
     }
-    printf("\n\r*******************************************************\n\r");
-    PDS_StoreAll();
-	
-	appTaskState = SLEEP_STATE;
-    appPostTask(DISPLAY_TASK_HANDLER);
 }
 
-void lTimerCb(void *data)
+static void app_radio_power_up(void)
 {
-    SwTimerStart(lTimerId,MS_TO_US(100),SW_TIMEOUT_RELATIVE,(void *)lTimerCb,NULL);
-    set_LED_data(LED_GREEN,&toggle);
+    HAL_Radio_resources_init();
 }
 
-#ifdef CONF_PMM_ENABLE
-static void appWakeup(uint32_t sleptDuration)
+static void app_radio_power_down(void)
 {
-	
-	HAL_Radio_resources_init();
-	sio2host_init();
-	appTaskState = READ_STATE;
-	appPostTask(DISPLAY_TASK_HANDLER);
-	printf("\r\nsleep_ok %ld ms\r\n", sleptDuration);
-			
+    /* Disable Transceiver SPI Module */
+    HAL_RadioDeInit();
 }
-#endif
 
-#ifdef CONF_PMM_ENABLE
-static void app_resources_uninit(void)
+static void app_adc_power_up(void)
+{
+    adc_enable(&adc_instance);
+}
+
+static void app_adc_power_down(void)
+{
+    adc_disable(&adc_instance);
+}
+
+static void app_uart_power_up(void)
+{
+    sio2host_init();
+    /* Received bytes go to the console instead of the sio2host buffer */
+    _sercom_set_handler(_sercom_get_sercom_inst_index(USART_HOST), app_console_isr);
+}
+
+static void app_uart_power_down(void)
 {
     /* Disable USART TX and RX Pins */
     struct port_config pin_conf;
@@ -823,10 +1739,7 @@ static void app_resources_uninit(void)
 #endif
     /* Disable UART module */
     sio2host_deinit();
-    /* Disable Transceiver SPI Module */
-    HAL_RadioDeInit();
 }
-#endif
 
 
 /*********************************************************************//*
@@ -837,20 +1750,11 @@ static void app_resources_uninit(void)
 
 void demoTimerCb(void * cnt)
 {
-    uint8_t i = 10;
-    int8_t rxdata = 0;
+    bool rxdata;
     printf("%d..",count);
     count--;
 	startReceiving = false;
-    sio2host_rx(rxchar,10);
-    for(i = 0;i<=10;i++)
-    {
-        if(rxchar[i] != 13 && rxchar[i] != 10)
-        {
-            rxdata = rxchar[i];
-            break;
-        }
-    }
+    rxdata = CONSOLE_TakeKey();
     if(!count)
     {
         printf("\r\n");
@@ -858,7 +1762,7 @@ void demoTimerCb(void * cnt)
 	
     if(count > 0 && (!rxdata))
     {
-        SwTimerStart(demoTimerId,MS_TO_US(1000),SW_TIMEOUT_RELATIVE,(void *)demoTimerCb,NULL);
+        APP_TIMER_Start(countdownTimerId, MS_TO_US(1000), MS_TO_US(APP_COUNTDOWN_SLACK_MS), demoTimerCb, NULL);
     }
 	
     else if(count == 0 && (!rxdata))
@@ -877,6 +1781,211 @@ void demoTimerCb(void * cnt)
 }
 
 
+/*********************************************************************//*
+ \brief      UART receive interrupt, the bytes are handed to the console
+ \param[in]  instance - SERCOM instance, not used
+ ************************************************************************/
+static void app_console_isr(uint8_t instance)
+{
+    SercomUsart *const usart = &(USART_HOST->USART);
+
+    while (usart->INTFLAG.reg & SERCOM_USART_INTFLAG_RXC)
+    {
+        /* Framing and overflow errors are cleared with the data read */
+        usart->STATUS.reg = SERCOM_USART_STATUS_FERR | SERCOM_USART_STATUS_BUFOVF;
+        CONSOLE_RxIsr((uint8_t)usart->DATA.reg);
+    }
+}
+
+static void app_console_notify(void)
+{
+    consolePending = true;
+    SYSTEM_PostTask(APP_TASK_ID);
+}
+
+/*********************************************************************//*
+ \brief      Console command "diag", prints the profiling counters
+ ************************************************************************/
+static bool app_cmd_diag(uint8_t argc, char *argv[])
+{
+    const ClassMgrStats_t *classStats = CLASS_MGR_GetStats();
+
+    APP_DIAG_Print();
+    EVT_TRACE_Print();
+#if (DEMO_APP_WAVE_CAPTURE == 1)
+    printf("Waveforms: %u captured, %u missed, %u fragments sent\r\n", WAVE_CAPTURE_GetStats()->captures,
+           WAVE_CAPTURE_GetStats()->missed, WAVE_CAPTURE_GetStats()->fragments);
+#endif
+#if (DEMO_APP_ANOMALY_DETECTOR == 1)
+    printf("Anomalies: %lu of %lu readings, last z %d/16\r\n", ANOMALY_GetStats()->anomalies,
+           ANOMALY_GetStats()->samples, ANOMALY_GetStats()->lastZQ4);
+#endif
+    printf("Class C: %u windows, %u refused, %lu ms on, %ld ms credit\r\n", classStats->windows,
+           classStats->refused, classStats->receiverOnMs, (long)classStats->creditMs);
+    return true;
+}
+
+/*********************************************************************//*
+ \brief      Console command "set", changes a parameter in the units of
+             the downlink commands: threshold in 1/100, period in seconds
+ ************************************************************************/
+static bool app_cmd_set(uint8_t argc, char *argv[])
+{
+    AppParams_t params = *APP_PARAMS_Get();
+    char *end;
+    unsigned long value = strtoul(argv[2], &end, 0);
+
+    if (('\0' == argv[2][0]) || ('\0' != *end) || (value > UINT16_MAX))
+    {
+        return false;
+    }
+    if (0 == strcmp(argv[1], "threshold"))
+    {
+        params.alarmThreshold = (float)value / 100.0f;
+    }
+    else if (0 == strcmp(argv[1], "period"))
+    {
+        params.samplePeriodMs = (uint32_t)value * 1000u;
+    }
+    else if ((0 == strcmp(argv[1], "confirm")) && (value <= UINT8_MAX))
+    {
+        params.confirmCount = (uint8_t)value;
+    }
+    else if ((0 == strcmp(argv[1], "status")) && (value <= UINT8_MAX))
+    {
+        params.statusPeriods = (uint8_t)value;
+    }
+    else
+    {
+        return false;
+    }
+    if (!APP_PARAMS_Apply(&params))
+    {
+        return false;
+    }
+    adc_window_update();
+    if (!CFG_STORE_SaveParams(APP_PARAMS_Get()))
+    {
+        printf("Parameters not saved\r\n");
+    }
+    return true;
+}
+
+/*********************************************************************//*
+ \brief      Console command "send", sends a status report or an alarm
+             now; refused while joining or during a transaction
+ ************************************************************************/
+static bool app_cmd_send(uint8_t argc, char *argv[])
+{
+    bool alarm = (argc > 1) && (0 == strcmp(argv[1], "alarm"));
+
+    if (((argc > 1) && !alarm) || !joined || (SLEEP_STATE != appTaskState) ||
+        (SLEEP_STATE != appPendingSend) || txResourcesHeld)
+    {
+        return false;
+    }
+#ifdef CONF_PMM_ENABLE
+    /* The sleep of the current period is requested again after the send */
+    SLEEP_COORD_Cancel();
+#endif
+    app_schedule_send(alarm ? LARM_STATE : STATUS_STATE);
+    return true;
+}
+
+/*********************************************************************//*
+ \brief      Console command "class", opens a Class C window
+ ************************************************************************/
+static bool app_cmd_class(uint8_t argc, char *argv[])
+{
+    char *end;
+    unsigned long seconds = strtoul(argv[1], &end, 0);
+
+    if (('\0' == argv[1][0]) || ('\0' != *end) || (0 == seconds) || (seconds > UINT16_MAX) || !joined ||
+        (CLASS_C == CFG_STORE_Class()))
+    {
+        return false;
+    }
+    if (!CLASS_MGR_Request(CLASS_MGR_LOCAL, (uint32_t)seconds * 1000u, app_uptime_ms()))
+    {
+        return false;
+    }
+    app_class_update();
+    return true;
+}
+
+/*********************************************************************//*
+ \brief      Free running microsecond clock of the SW timer module
+ ************************************************************************/
+static uint32_t app_time_us(void)
+{
+    return (uint32_t)SwTimerGetTime();
+}
+
+/*********************************************************************//*
+ \brief      Free running millisecond clock, timestamps of the event trace
+ ************************************************************************/
+static uint32_t app_time_ms(void)
+{
+    return (uint32_t)(SwTimerGetTime() / 1000u);
+}
+
+/*********************************************************************//*
+ \brief      Millisecond clock without wrap, local time of the time sync
+ ************************************************************************/
+static uint64_t app_uptime_ms(void)
+{
+    return SwTimerGetTime() / 1000u;
+}
+
+/*********************************************************************//*
+ \brief      Time base and underlying SW timer of the application timers
+ ************************************************************************/
+static uint64_t app_timer_now(void)
+{
+    return SwTimerGetTime();
+}
+
+static void app_timer_arm(uint32_t delayUs)
+{
+    SwTimerStop(demoTimerId);
+    SwTimerStart(demoTimerId, delayUs, SW_TIMEOUT_RELATIVE, (void *)app_timer_fired, NULL);
+}
+
+static void app_timer_disarm(void)
+{
+    SwTimerStop(demoTimerId);
+}
+
+static void app_timer_fired(void *param)
+{
+    APP_TIMER_Expired();
+}
+
+/*********************************************************************//*
+ \brief      Sets the CPU divider of a clock phase
+ \param[in]  shift - CPUDIV = 1 << shift
+ ************************************************************************/
+static void app_clock_set(uint8_t shift)
+{
+    enum system_main_clock_div div = (enum system_main_clock_div)shift;
+
+    /* CLK_CPU >= CLK_LP >= CLK_BUP must hold before and after every write */
+    if ((1u << shift) > MCLK->CPUDIV.reg)
+    {
+        system_backup_clock_set_divider(div);
+        system_low_power_clock_set_divider(div);
+        system_cpu_clock_set_divider(div);
+    }
+    else
+    {
+        system_cpu_clock_set_divider(div);
+        system_low_power_clock_set_divider(div);
+        system_backup_clock_set_divider(div);
+    }
+    /* delay_ms() counts SysTick cycles of the CPU clock */
+    delay_init();
+}
+
 /*********************************************************************//*
  \brief      App Post Task
  \param[in]  Id of the application to be posted
@@ -898,7 +2007,13 @@ void appPostTask(AppTaskIds_t id)
 
 SYSTEM_TaskStatus_t APP_TaskHandler(void)
 {
+    uint32_t taskStart;
 
+    if (consolePending)
+    {
+        consolePending = false;
+        CONSOLE_Process();
+    }
     if (appTaskFlags)
     {
         for (uint16_t taskId = 0; taskId < APP_TASKS_COUNT; taskId++)
@@ -909,7 +2024,9 @@ SYSTEM_TaskStatus_t APP_TaskHandler(void)
                 appTaskFlags &= ~(1 << taskId);
                 ATOMIC_SECTION_EXIT
 
+                taskStart = app_time_us();
                 appTaskHandlers[taskId]();
+                APP_DIAG_RecordTask((uint8_t)taskId, app_time_us() - taskStart);
 
                 if (appTaskFlags)
                 {
@@ -998,7 +2115,7 @@ StackRetStatus_t set_device_type(EdClass_t ed_class)
 
     status = LORAWAN_SetAttr(EDCLASS, &ed_class);
 
-    if((LORAWAN_SUCCESS == status) && ((CLASS_C | CLASS_B) & ed_class) && (true == DEMO_APP_MCAST_ENABLE))
+    if((LORAWAN_SUCCESS == status) && ((CLASS_C | CLASS_B) & ed_class) && CFG_STORE_McastEnable())
     {
         set_multicast_params();
     }
@@ -1017,52 +2134,50 @@ void set_multicast_params (void)
     LorawanMcastNwkSkey_t mcastNwkSKey;
     LorawanMcastStatus_t  mcastStatus;
 	
-    printf("\n***************Multicast Parameters********************\n\r");
+    /* Applied again on every switch to Class C, the UART may be off.
+       The session keys are not logged */
+    APP_TRACE("\n***************Multicast Parameters********************\n\r");
     
-    dMcastDevAddr.groupId = demoMcastGroupId;
-    mcastAppSKey.groupId  = demoMcastGroupId;
-    mcastNwkSKey.groupId  = demoMcastGroupId;
-    mcastStatus.groupId   = demoMcastGroupId;
+    dMcastDevAddr.groupId = CFG_STORE_McastGroupId();
+    mcastAppSKey.groupId  = CFG_STORE_McastGroupId();
+    mcastNwkSKey.groupId  = CFG_STORE_McastGroupId();
+    mcastStatus.groupId   = CFG_STORE_McastGroupId();
 	
-    memcpy(&(mcastAppSKey.mcastAppSKey), &demoMcastAppsKey,LORAWAN_SESSIONKEY_LENGTH);
-    dMcastDevAddr.mcast_dev_addr = demoMcastDevAddr;
-    memcpy(&(mcastNwkSKey.mcastNwkSKey), &demoMcastNwksKey,LORAWAN_SESSIONKEY_LENGTH);
-    memcpy(&(mcastStatus.status),&demoMcastEnable,sizeof(demoMcastEnable));
+    memcpy(&(mcastAppSKey.mcastAppSKey), CFG_STORE_McastAppSKey(),LORAWAN_SESSIONKEY_LENGTH);
+    dMcastDevAddr.mcast_dev_addr = CFG_STORE_McastGroupAddr();
+    memcpy(&(mcastNwkSKey.mcastNwkSKey), CFG_STORE_McastNwkSKey(),LORAWAN_SESSIONKEY_LENGTH);
+    mcastStatus.status = CFG_STORE_McastEnable();
     
     status = LORAWAN_SetAttr(MCAST_APPS_KEY, &mcastAppSKey);
     if (status == LORAWAN_SUCCESS)
     {
-	    printf("\nMcastAppSessionKey : ");
-	    print_array((uint8_t *)&(mcastAppSKey.mcastAppSKey), LORAWAN_SESSIONKEY_LENGTH);
 	    status = LORAWAN_SetAttr(MCAST_NWKS_KEY, &mcastNwkSKey);
     }
 
     if(status == LORAWAN_SUCCESS)
     {
-	    printf("\nMcastNwkSessionKey : ");
-	    print_array((uint8_t *)&(mcastNwkSKey.mcastNwkSKey), LORAWAN_SESSIONKEY_LENGTH);
 	    status = LORAWAN_SetAttr(MCAST_GROUP_ADDR, &dMcastDevAddr);
     }
     if (status == LORAWAN_SUCCESS)
     {
-	    printf("\nMcastGroupAddr : 0x%lx\n\r", dMcastDevAddr.mcast_dev_addr);
+	    APP_TRACE("\nMcastGroupAddr : 0x%lx\n\r", dMcastDevAddr.mcast_dev_addr);
 	    status = LORAWAN_SetAttr(MCAST_ENABLE, &mcastStatus);
     }
     else
     {
-	    printf("\nMcastGroupAddrStatus : Failed\n\r");
+	    APP_TRACE("\nMcastGroupAddrStatus : Failed\n\r");
     }
 	
     if (status == LORAWAN_SUCCESS)
     {
-	    printf("\nMulticastStatus : Enabled\n\r");
+	    APP_TRACE("\nMulticastStatus : Enabled\n\r");
     }
     else
     {
-	    printf("\nMulticastStatus : Failed\n\r");
+	    APP_TRACE("\nMulticastStatus : Failed\n\r");
     }
 	
-	 printf("\n********************************************************\n\r");
+	 APP_TRACE("\n********************************************************\n\r");
 
 }
 
@@ -1077,7 +2192,21 @@ StackRetStatus_t mote_set_parameters(IsmBand_t ismBand, const uint16_t index)
 {
     StackRetStatus_t status;
     bool joinBackoffEnable = false;
+    app_tx_begin();
+    /* Kept so that coming back to the band needs no join */
+    app_cache_session();
     LORAWAN_Reset(ismBand);
+    /* The reset went back to the configured class */
+    app_class_reset();
+    /* DR0 is SF10 in the US and AU bands, SF12 in the others */
+    if ((ismBand == ISM_NA915) || (ismBand == ISM_AU915))
+    {
+        LINK_QUALITY_Configure(3, LINK_QUALITY_DB(-15), LINK_QUALITY_MAX_POWERS);
+    }
+    else
+    {
+        LINK_QUALITY_Configure(5, LINK_QUALITY_DB(-20), LINK_QUALITY_MAX_POWERS);
+    }
 #if (NA_BAND == 1 || AU_BAND == 1)
 #if (RANDOM_NW_ACQ == 0)
     if ((ismBand == ISM_NA915) || (ismBand == ISM_AU915))
@@ -1089,11 +2218,11 @@ StackRetStatus_t mote_set_parameters(IsmBand_t ismBand, const uint16_t index)
 
         uint8_t allowed_min_125khz_ch,allowed_max_125khz_ch,allowed_500khz_channel;
 
-        allowed_min_125khz_ch = (SUBBAND-1)*MAX_SUBBAND_CHANNELS;
+        allowed_min_125khz_ch = (CFG_STORE_Subband()-1)*MAX_SUBBAND_CHANNELS;
 
-        allowed_max_125khz_ch = ((SUBBAND-1)*MAX_SUBBAND_CHANNELS) + 7 ;
+        allowed_max_125khz_ch = ((CFG_STORE_Subband()-1)*MAX_SUBBAND_CHANNELS) + 7 ;
 
-        allowed_500khz_channel = SUBBAND+63;
+        allowed_500khz_channel = CFG_STORE_Subband()+63;
 
         for (ch_params.channelId = 0; ch_params.channelId < MAX_NA_CHANNELS; ch_params.channelId++)
         {
@@ -1125,34 +2254,59 @@ StackRetStatus_t mote_set_parameters(IsmBand_t ismBand, const uint16_t index)
 #endif
 
     /* Initialize the join parameters for Demo application */
-    status = set_join_parameters(DEMO_APP_ACTIVATION_TYPE);
+    status = set_join_parameters((ActivationType_t)CFG_STORE_ActivationType());
 
     if (LORAWAN_SUCCESS != status)
     {
         printf("\nJoin parameters initialization failed\n\r");
+        app_tx_end();
         return status;
     }
 
     /* Set the device type */
-    status = set_device_type(DEMO_APP_ENDDEVICE_CLASS);
+    status = set_device_type((EdClass_t)CFG_STORE_Class());
 
     if (LORAWAN_SUCCESS != status)
     {
         printf("\nUnsupported Device Type\n\r");
+        app_tx_end();
         return status;
     }
 
+    if (CLASS_C == CFG_STORE_Class())
+    {
+        /* The receiver runs continuously in Class C, keep the radio powered */
+        static bool classCRadioHeld = false;
+        if (!classCRadioHeld)
+        {
+            PERIPH_Acquire(PERIPH_RADIO);
+            classCRadioHeld = true;
+        }
+    }
+
 
-    /* Send Join request for Demo application */
-    status = LORAWAN_Join(DEMO_APP_ACTIVATION_TYPE);
+    /* A session cached for the band activates without a transmission */
+    if (app_restore_session(ismBand))
+    {
+        status = LORAWAN_Join(ACTIVATION_BY_PERSONALIZATION);
+    }
+    else
+    {
+        /* Send Join request for Demo application */
+        status = LORAWAN_Join((ActivationType_t)CFG_STORE_ActivationType());
+    }
+    EVT_TRACE_Record(EVT_TRACE_JOIN_REQ, (uint8_t)status, app_time_ms());
 
-    if (LORAWAN_SUCCESS == status && index < sizeof(bandTable))
+    if (LORAWAN_SUCCESS == status && index < bandCount)
     {
         printf("\nJoin Request Sent for %s\n\r",bandStrings[index]);
     }
     else
     {
         print_stack_status(status);
+        sessionRestoring = false;
+        SESSION_HEALTH_OnJoin(false, app_uptime_ms());
+        app_tx_end();
 		appTaskState = SLEEP_STATE;
 		appPostTask(DISPLAY_TASK_HANDLER);
     }
@@ -1167,13 +2321,7 @@ StackRetStatus_t mote_set_parameters(IsmBand_t ismBand, const uint16_t index)
  ************************************************************************/
 void print_array (uint8_t *array, uint8_t length)
 {
-    printf("0x");
-    for (uint8_t i =0; i < length; i++)
-    {
-        printf("%02x", *array);
-        array++;
-    }
-    printf("\n\r");
+    APP_FORMAT_PrintArray(array, length);
 }
 
 void  print_application_config (void)
@@ -1194,11 +2342,11 @@ void  print_application_config (void)
 
     printf("\nActivationType : ");
 
-    if(DEMO_APP_ACTIVATION_TYPE == OVER_THE_AIR_ACTIVATION)
+    if(CFG_STORE_ActivationType() == OVER_THE_AIR_ACTIVATION)
     {
         printf("OTAA\n\r");
     }
-    else if(DEMO_APP_ACTIVATION_TYPE == ACTIVATION_BY_PERSONALIZATION)
+    else if(CFG_STORE_ActivationType() == ACTIVATION_BY_PERSONALIZATION)
     {
         printf("ABP\n\r");
     }
@@ -1211,10 +2359,10 @@ void  print_application_config (void)
     }
     else if(DEMO_APP_TRANSMISSION_TYPE == UNCONFIRMED)
     {
-        printf("UNCONFIRMED\n\r");
+        printf("ADAPTIVE (alarms confirmed, status probe every %d)\n\r", TX_POLICY_GetStats()->probeInterval);
     }
 
-    printf("\nFPort - %d\n\r", DEMO_APP_FPORT);
+    printf("\nFPort - %d\n\r", CFG_STORE_FPort());
 
     printf("\n*******************************************************\n\r");
 }
@@ -0,0 +1,195 @@
+/**
+* \file  evt_trace.c
+*
+* \brief Compact recorder of the LoRaWAN stack callback events
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "evt_trace.h"
+
+/******************************** MACROS ***************************************/
+#define EVT_TRACE_MAX_DELTA                 0xFFFFu
+#define EVT_TRACE_MAX_GAP_S                 0xFFFFFFuL
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint8_t evtRing[EVT_TRACE_DEPTH][EVT_TRACE_RECORD_LENGTH];
+/* Next record written */
+static uint16_t evtHead = 0;
+static uint16_t evtCount = 0;
+static uint32_t evtLastMs = 0;
+static bool evtStarted = false;
+
+/***************************** FUNCTIONS ***************************************/
+
+static void evt_trace_put(uint8_t kind, uint8_t status, uint16_t delta)
+{
+    uint8_t *record = evtRing[evtHead];
+
+    record[0] = kind;
+    record[1] = status;
+    record[2] = (uint8_t)delta;
+    record[3] = (uint8_t)(delta >> 8);
+
+    evtHead = (uint16_t)((evtHead + 1u) & (EVT_TRACE_DEPTH - 1u));
+    if (evtCount < EVT_TRACE_DEPTH)
+    {
+        evtCount++;
+    }
+}
+
+/* Decodes one record, returns false for a gap record */
+static bool evt_trace_step(const uint8_t *record, bool first, uint32_t *timeMs, EvtTraceEvent_t *event)
+{
+    uint32_t delta = (uint32_t)record[2] | ((uint32_t)record[3] << 8);
+
+    if (EVT_TRACE_GAP == record[0])
+    {
+        /* The first record is the time origin, whatever came before is lost */
+        if (!first)
+        {
+            *timeMs += (delta | ((uint32_t)record[1] << 16)) * 1000u;
+        }
+        return false;
+    }
+
+    if (!first)
+    {
+        *timeMs += delta;
+    }
+    event->kind = (EvtTraceKind_t)record[0];
+    event->status = record[1];
+    event->timeMs = *timeMs;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Clears the trace
+*************************************************************************/
+void EVT_TRACE_Init(void)
+{
+    memset(evtRing, 0, sizeof(evtRing));
+    evtHead = 0;
+    evtCount = 0;
+    evtLastMs = 0;
+    evtStarted = false;
+}
+
+/*********************************************************************//**
+\brief      Appends an event, the oldest one is dropped when full
+\param[in]  kind   - event
+\param[in]  status - StackRetStatus_t or event specific value
+\param[in]  nowMs  - free running millisecond time
+*************************************************************************/
+void EVT_TRACE_Record(EvtTraceKind_t kind, uint8_t status, uint32_t nowMs)
+{
+    uint32_t delta = evtStarted ? (nowMs - evtLastMs) : 0;
+
+    evtStarted = true;
+    evtLastMs = nowMs;
+
+    if (delta > EVT_TRACE_MAX_DELTA)
+    {
+        uint32_t seconds = delta / 1000u;
+
+        if (seconds > EVT_TRACE_MAX_GAP_S)
+        {
+            seconds = EVT_TRACE_MAX_GAP_S;
+        }
+        evt_trace_put(EVT_TRACE_GAP, (uint8_t)(seconds >> 16), (uint16_t)seconds);
+        delta -= seconds * 1000u;
+        if (delta > EVT_TRACE_MAX_DELTA)
+        {
+            delta = EVT_TRACE_MAX_DELTA;
+        }
+    }
+    evt_trace_put((uint8_t)kind, status, (uint16_t)delta);
+}
+
+/*********************************************************************//**
+\brief      Returns the number of records held, gap records included
+*************************************************************************/
+uint16_t EVT_TRACE_Count(void)
+{
+    return evtCount;
+}
+
+/*********************************************************************//**
+\brief      Copies the records, oldest first
+\param[out] buffer    - destination of the trace
+\param[in]  maxLength - size of buffer
+\return     number of bytes written, whole records only
+*************************************************************************/
+uint16_t EVT_TRACE_Export(uint8_t *buffer, uint16_t maxLength)
+{
+    uint16_t records = evtCount;
+    uint16_t index = (uint16_t)((evtHead + EVT_TRACE_DEPTH - evtCount) & (EVT_TRACE_DEPTH - 1u));
+
+    if (records > (maxLength / EVT_TRACE_RECORD_LENGTH))
+    {
+        /* Keep the most recent ones */
+        index = (uint16_t)((index + records - maxLength / EVT_TRACE_RECORD_LENGTH) & (EVT_TRACE_DEPTH - 1u));
+        records = maxLength / EVT_TRACE_RECORD_LENGTH;
+    }
+
+    for (uint16_t i = 0; i < records; i++)
+    {
+        memcpy(&buffer[i * EVT_TRACE_RECORD_LENGTH], evtRing[index], EVT_TRACE_RECORD_LENGTH);
+        index = (uint16_t)((index + 1u) & (EVT_TRACE_DEPTH - 1u));
+    }
+    return (uint16_t)(records * EVT_TRACE_RECORD_LENGTH);
+}
+
+/*********************************************************************//**
+\brief      Feeds an exported trace, in order, to a handler
+\param[in]  trace   - records as returned by EVT_TRACE_Export()
+\param[in]  length  - number of bytes in trace
+\param[in]  handler - called for every event with its timestamp
+\param[in]  param   - passed to handler
+\return     number of events delivered
+
+The timestamps start at 0 with the first record, so the same trace
+always gives the same sequence.
+*************************************************************************/
+uint16_t EVT_TRACE_Replay(const uint8_t *trace, uint16_t length, EvtTraceHandler_t handler, void *param)
+{
+    uint32_t timeMs = 0;
+    uint16_t delivered = 0;
+    EvtTraceEvent_t event;
+
+    for (uint16_t pos = 0; (pos + EVT_TRACE_RECORD_LENGTH) <= length; pos += EVT_TRACE_RECORD_LENGTH)
+    {
+        if (evt_trace_step(&trace[pos], 0 == pos, &timeMs, &event))
+        {
+            if (NULL != handler)
+            {
+                handler(&event, param);
+            }
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+/*********************************************************************//**
+\brief      Prints the decoded trace on the console
+*************************************************************************/
+void EVT_TRACE_Print(void)
+{
+    uint16_t index = (uint16_t)((evtHead + EVT_TRACE_DEPTH - evtCount) & (EVT_TRACE_DEPTH - 1u));
+    uint32_t timeMs = 0;
+    EvtTraceEvent_t event;
+
+    printf("\r\nEvent trace, %d records\r\n", evtCount);
+    for (uint16_t i = 0; i < evtCount; i++)
+    {
+        if (evt_trace_step(evtRing[index], 0 == i, &timeMs, &event))
+        {
+            printf("%10lu ms  event %d  status %d\r\n", (unsigned long)event.timeMs, event.kind, event.status);
+        }
+        index = (uint16_t)((index + 1u) & (EVT_TRACE_DEPTH - 1u));
+    }
+}
@@ -0,0 +1,65 @@
+/**
+* \file  evt_trace.h
+*
+* \brief Compact recorder of the LoRaWAN stack callback events
+*
+* Every event takes 4 bytes in a RAM ring, the oldest are overwritten:
+*   [kind] [status] [time since the previous event, ms, u16 LE]
+* Gaps that do not fit 16 bits are preceded by an EVT_TRACE_GAP record
+* holding the gap in seconds. A trace can be exported as is and decoded
+* back into absolute timestamps, on the device or by a host tool, and
+* replayed in order through a handler.
+*/
+
+#ifndef EVT_TRACE_H_
+#define EVT_TRACE_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Number of records kept, a power of 2 */
+#ifndef EVT_TRACE_DEPTH
+#define EVT_TRACE_DEPTH                     64u
+#endif
+
+#define EVT_TRACE_RECORD_LENGTH             4u
+
+/****************************** TYPES **************************************/
+typedef enum _EvtTraceKind_t
+{
+    EVT_TRACE_GAP = 0,
+    /* Status of LORAWAN_Send() */
+    EVT_TRACE_SEND,
+    /* LORAWAN_EVT_TRANSACTION_COMPLETE */
+    EVT_TRACE_TX_DONE,
+    /* LORAWAN_EVT_RX_DATA_AVAILABLE */
+    EVT_TRACE_RX_DATA,
+    /* demo_joindata_callback() */
+    EVT_TRACE_JOIN,
+    /* Status of LORAWAN_Join() */
+    EVT_TRACE_JOIN_REQ,
+    /* Wakeup from deep sleep, status is 1 for an ADC window wake */
+    EVT_TRACE_WAKE
+} EvtTraceKind_t;
+
+typedef struct _EvtTraceEvent_t
+{
+    EvtTraceKind_t kind;
+    uint8_t status;
+    /* Milliseconds since the first event of the trace */
+    uint32_t timeMs;
+} EvtTraceEvent_t;
+
+typedef void (*EvtTraceHandler_t)(const EvtTraceEvent_t *event, void *param);
+
+/****************************** PROTOTYPES **************************************/
+void EVT_TRACE_Init(void);
+void EVT_TRACE_Record(EvtTraceKind_t kind, uint8_t status, uint32_t nowMs);
+uint16_t EVT_TRACE_Count(void);
+uint16_t EVT_TRACE_Export(uint8_t *buffer, uint16_t maxLength);
+uint16_t EVT_TRACE_Replay(const uint8_t *trace, uint16_t length, EvtTraceHandler_t handler, void *param);
+void EVT_TRACE_Print(void);
+
+#endif /* EVT_TRACE_H_ */
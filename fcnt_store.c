@@ -0,0 +1,274 @@
+/**
+* \file  fcnt_store.c
+*
+* \brief Frame counters of the session kept across resets in blocks
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "fcnt_store.h"
+#include "cfg_store.h"
+
+/******************************** MACROS ***************************************/
+/* Marker, sequence, DevAddr, limit, downlink counter, epoch, CRC (u16) */
+#define FCNT_STORE_RECORD_LENGTH            20u
+/* Has cleared bits: a record whose start was erased by an interrupted
+ * row erase is not taken for valid on a matching CRC */
+#define FCNT_STORE_MARKER                   0xC5u
+#define FCNT_STORE_CRC_OFFSET               (FCNT_STORE_RECORD_LENGTH - 2u)
+#define FCNT_STORE_SLOTS_PER_ROW            (APP_NVM_ROW_SIZE / FCNT_STORE_RECORD_LENGTH)
+#define FCNT_STORE_SLOTS                    (FCNT_STORE_ROWS * FCNT_STORE_SLOTS_PER_ROW)
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const AppNvmOps_t *fcntNvm = NULL;
+static uint32_t fcntNvmOffset = 0;
+static uint32_t fcntBlock = 1;
+/* Slot of the next record */
+static uint16_t fcntNext = 0;
+static uint8_t fcntSequence = 0;
+/* A valid record was found or written */
+static bool fcntRecorded = false;
+static uint32_t fcntDown = 0;
+/* The counters of a session are being reserved */
+static bool fcntTracking = false;
+static FcntStoreStats_t fcntStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t fcnt_get_u32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void fcnt_put_u32(uint8_t *data, uint32_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)(value >> 16);
+    data[3] = (uint8_t)(value >> 24);
+}
+
+/* Offset of a slot, the records do not cross rows */
+static uint32_t fcnt_store_address(uint16_t slot)
+{
+    return fcntNvmOffset + (uint32_t)(slot / FCNT_STORE_SLOTS_PER_ROW) * APP_NVM_ROW_SIZE +
+           (uint32_t)(slot % FCNT_STORE_SLOTS_PER_ROW) * FCNT_STORE_RECORD_LENGTH;
+}
+
+/* True if the slot was never written since its row was erased */
+static bool fcnt_store_blank(const uint8_t *record)
+{
+    for (uint8_t i = 0; i < FCNT_STORE_RECORD_LENGTH; i++)
+    {
+        if (0xFFu != record[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Appends a record, erasing a row when the log enters it */
+static bool fcnt_store_write(uint32_t devAddr, uint32_t epoch, uint32_t limit, uint32_t fCntDown)
+{
+    uint8_t record[FCNT_STORE_RECORD_LENGTH];
+    uint32_t address = fcnt_store_address(fcntNext);
+    uint8_t sequence = (uint8_t)(fcntSequence + 1u);
+    uint16_t crc;
+    bool written;
+
+    if (NULL == fcntNvm)
+    {
+        return false;
+    }
+
+    /* The newest record is in the previous row, it stays intact */
+    if (0 == (fcntNext % FCNT_STORE_SLOTS_PER_ROW))
+    {
+        if (!fcntNvm->erase(address, APP_NVM_ROW_SIZE))
+        {
+            return false;
+        }
+        fcntStats.erases++;
+    }
+
+    record[0] = FCNT_STORE_MARKER;
+    record[1] = sequence;
+    fcnt_put_u32(&record[2], devAddr);
+    fcnt_put_u32(&record[6], limit);
+    fcnt_put_u32(&record[10], fCntDown);
+    fcnt_put_u32(&record[14], epoch);
+    crc = CFG_STORE_Crc16(record, FCNT_STORE_CRC_OFFSET);
+    record[FCNT_STORE_CRC_OFFSET] = (uint8_t)crc;
+    record[FCNT_STORE_CRC_OFFSET + 1u] = (uint8_t)(crc >> 8);
+
+    written = fcntNvm->write(address, record, sizeof(record));
+    /* A failed write may leave the slot partly programmed, never reuse it */
+    fcntNext = (uint16_t)((fcntNext + 1u) % FCNT_STORE_SLOTS);
+    if (!written)
+    {
+        return false;
+    }
+
+    fcntSequence = sequence;
+    fcntRecorded = true;
+    fcntDown = fCntDown;
+    fcntStats.devAddr = devAddr;
+    fcntStats.epoch = epoch;
+    fcntStats.limit = limit;
+    fcntStats.writes++;
+    return true;
+}
+
+/* Writes a new block if the counter reached the reserved limit */
+static bool fcnt_store_reserve(uint32_t fCntUp, uint32_t fCntDown)
+{
+    uint32_t limit;
+
+    if (fCntUp < fcntStats.limit)
+    {
+        return true;
+    }
+
+    limit = ((UINT32_MAX - fCntUp) > fcntBlock) ? (fCntUp + fcntBlock) : UINT32_MAX;
+    return fcnt_store_write(fcntStats.devAddr, fcntStats.epoch, limit, fCntDown);
+}
+
+/*********************************************************************//**
+\brief      Finds the newest record, called once at boot
+\param[in]  nvm       - storage of the records
+\param[in]  nvmOffset - row aligned start of FCNT_STORE_NVM_SIZE bytes
+\param[in]  blockSize - counters reserved by a record: a write every
+                        blockSize uplinks, at most blockSize skipped
+*************************************************************************/
+void FCNT_STORE_Init(const AppNvmOps_t *nvm, uint32_t nvmOffset, uint32_t blockSize)
+{
+    uint8_t record[FCNT_STORE_RECORD_LENGTH];
+    uint16_t newest = 0;
+
+    fcntNvm = nvm;
+    fcntNvmOffset = nvmOffset;
+    fcntBlock = (0 != blockSize) ? blockSize : 1u;
+    fcntSequence = 0;
+    fcntRecorded = false;
+    fcntTracking = false;
+    fcntDown = 0;
+    memset(&fcntStats, 0, sizeof(fcntStats));
+
+    for (uint16_t slot = 0; slot < FCNT_STORE_SLOTS; slot++)
+    {
+        if (!nvm->read(fcnt_store_address(slot), record, sizeof(record)) ||
+            (FCNT_STORE_MARKER != record[0]) ||
+            (CFG_STORE_Crc16(record, FCNT_STORE_CRC_OFFSET) !=
+             (uint16_t)(record[FCNT_STORE_CRC_OFFSET] | (record[FCNT_STORE_CRC_OFFSET + 1u] << 8))))
+        {
+            continue;
+        }
+
+        /* The log holds far fewer records than half the sequence range */
+        if (!fcntRecorded || ((int8_t)(record[1] - fcntSequence) > 0))
+        {
+            fcntRecorded = true;
+            fcntSequence = record[1];
+            newest = slot;
+            fcntStats.devAddr = fcnt_get_u32(&record[2]);
+            fcntStats.limit = fcnt_get_u32(&record[6]);
+            fcntDown = fcnt_get_u32(&record[10]);
+            fcntStats.epoch = fcnt_get_u32(&record[14]);
+        }
+    }
+
+    /* Next blank slot of the row of the newest record, else the next row */
+    fcntNext = 0;
+    if (fcntRecorded)
+    {
+        fcntNext = (uint16_t)(newest + 1u);
+        while ((fcntNext < FCNT_STORE_SLOTS) && (0 != (fcntNext % FCNT_STORE_SLOTS_PER_ROW)) &&
+               (!nvm->read(fcnt_store_address(fcntNext), record, sizeof(record)) ||
+                !fcnt_store_blank(record)))
+        {
+            fcntNext++;
+        }
+        fcntNext %= FCNT_STORE_SLOTS;
+    }
+}
+
+/*********************************************************************//**
+\brief      Resumes the counters of a session restored after a reset
+\param[in]  devAddr  - address of the restored session
+\param[in,out] fCntUp   - next uplink counter known to the stack, raised
+                          to the stored limit
+\param[in,out] fCntDown - downlink counter known to the stack, raised to
+                          the stored one
+\return     false if no record belongs to the session, FCNT_STORE_Start()
+            then keeps the counters of the stack
+*************************************************************************/
+bool FCNT_STORE_Restore(uint32_t devAddr, uint32_t *fCntUp, uint32_t *fCntDown)
+{
+    if (!fcntRecorded || (fcntStats.devAddr != devAddr))
+    {
+        return false;
+    }
+
+    fcntStats.gap = (fcntStats.limit > *fCntUp) ? (fcntStats.limit - *fCntUp) : 0;
+    if (fcntStats.limit > *fCntUp)
+    {
+        *fCntUp = fcntStats.limit;
+    }
+    if (fcntDown > *fCntDown)
+    {
+        *fCntDown = fcntDown;
+    }
+    /* The next block is reserved by the first uplink: a reset loop
+       without uplinks neither skips counters nor wears the flash */
+    fcntTracking = true;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Starts reserving the counters of a new session, after a join
+            or the activation of a cached session, in the next epoch
+\param[in]  devAddr  - address of the session
+\param[in]  fCntUp   - next uplink counter
+\param[in]  fCntDown - downlink counter
+\return     false if the flash could not be written
+*************************************************************************/
+bool FCNT_STORE_Start(uint32_t devAddr, uint32_t fCntUp, uint32_t fCntDown)
+{
+    /* Held in RAM until the first record, no frame is sent before it */
+    fcntStats.devAddr = devAddr;
+    fcntStats.epoch++;
+    fcntStats.limit = fCntUp;
+    fcntStats.gap = 0;
+    fcntTracking = true;
+    return fcnt_store_reserve(fCntUp, fCntDown);
+}
+
+/*********************************************************************//**
+\brief      Called before every uplink, reserves a new block when the
+            counter reaches the limit
+\param[in]  fCntUp   - counter of the uplink
+\param[in]  fCntDown - downlink counter
+\return     false if the counter could not be reserved, the uplink must
+            not be sent as the counter could be used again after a reset
+*************************************************************************/
+bool FCNT_STORE_Reserve(uint32_t fCntUp, uint32_t fCntDown)
+{
+    if (!fcntTracking)
+    {
+        return true;
+    }
+
+    fcntStats.uplinks++;
+    return fcnt_store_reserve(fCntUp, fCntDown);
+}
+
+/*********************************************************************//**
+\brief      Returns the reserved limit, the write cost and the last gap
+*************************************************************************/
+const FcntStoreStats_t *FCNT_STORE_GetStats(void)
+{
+    return &fcntStats;
+}
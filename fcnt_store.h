@@ -0,0 +1,56 @@
+/**
+* \file  fcnt_store.h
+*
+* \brief Frame counters of the session kept across resets in blocks
+*
+* The uplink counter is not written for every uplink. A record reserves
+* the counters below a limit, a new record is appended only when the
+* counter reaches it, one write per block of uplinks. After a reset the
+* counter resumes at the stored limit: counters of the last block may be
+* skipped, at most a block, none is ever reused.
+* The downlink counter is stored along, as seen at the last record; it is
+* restored without skipping ahead so that no valid downlink is refused.
+* Every new session gets the next epoch, stored in its records; it keys
+* the application payload encryption apart from the previous sessions.
+* Erasing the log restarts the epochs, the payload keys must change then.
+* Records are appended to a log of flash rows, a power cut during a write
+* leaves the previous record intact. The module addresses the flash
+* through AppNvmOps_t and also builds on a host.
+*/
+
+#ifndef FCNT_STORE_H_
+#define FCNT_STORE_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_nvm.h"
+
+/****************************** MACROS **************************************/
+/* Rows of the log, the oldest row is erased when the log wraps */
+#define FCNT_STORE_ROWS                     2u
+#define FCNT_STORE_NVM_SIZE                 (FCNT_STORE_ROWS * APP_NVM_ROW_SIZE)
+
+/****************************** TYPES **************************************/
+typedef struct _FcntStoreStats_t
+{
+    /* Session of the counters, its epoch, first counter not reserved */
+    uint32_t devAddr;
+    uint32_t epoch;
+    uint32_t limit;
+    /* Cost: records and row erases since boot, for uplinks reserved */
+    uint32_t writes;
+    uint32_t erases;
+    uint32_t uplinks;
+    /* Counters skipped by the last restore */
+    uint32_t gap;
+} FcntStoreStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void FCNT_STORE_Init(const AppNvmOps_t *nvm, uint32_t nvmOffset, uint32_t blockSize);
+bool FCNT_STORE_Restore(uint32_t devAddr, uint32_t *fCntUp, uint32_t *fCntDown);
+bool FCNT_STORE_Start(uint32_t devAddr, uint32_t fCntUp, uint32_t fCntDown);
+bool FCNT_STORE_Reserve(uint32_t fCntUp, uint32_t fCntDown);
+const FcntStoreStats_t *FCNT_STORE_GetStats(void);
+
+#endif /* FCNT_STORE_H_ */
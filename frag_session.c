@@ -0,0 +1,474 @@
+/**
+* \file  frag_session.c
+*
+* \brief Fragmented data block reassembly with forward error correction
+*
+* Decoding is an online Gaussian elimination over GF(2). The lost uncoded
+* fragments are the unknowns. Each parity fragment has the received uncoded
+* fragments XORed out, is reduced against the equations kept so far and is
+* kept only if it adds a new pivot. Equation payloads live in an NVM scratch
+* area, only their coefficient bits stay in RAM. Once there are as many
+* equations as unknowns, back substitution writes the lost fragments to
+* their place in the block.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "frag_session.h"
+
+/******************************** MACROS ***************************************/
+#define FRAG_NO_ROW                         0xFFu
+#define FRAG_BIT_GET(map, bit)              (((map)[(bit) >> 3] >> ((bit) & 7u)) & 1u)
+#define FRAG_BIT_SET(map, bit)              ((map)[(bit) >> 3] |= (uint8_t)(1u << ((bit) & 7u)))
+
+#if ((FRAG_MAX_REDUNDANCY % 8) != 0) || (FRAG_MAX_REDUNDANCY >= FRAG_NO_ROW)
+#error "FRAG_MAX_REDUNDANCY must be a multiple of 8 below 255"
+#endif
+
+/****************************** TYPES **************************************/
+typedef struct _FragSession_t
+{
+    FragStatus_t status;
+    uint16_t nbFrag;
+    uint8_t fragSize;
+    uint8_t padding;
+    /* The set of lost fragments is fixed by the first parity fragment */
+    bool coding;
+    uint16_t missingCount;
+    uint16_t rowCount;
+    /* Block index of each unknown, ascending */
+    uint16_t missing[FRAG_MAX_REDUNDANCY];
+    uint8_t received[FRAG_MAX_NB_FRAG / 8];
+    /* Coefficients of the kept equations over the unknowns */
+    uint8_t rows[FRAG_MAX_REDUNDANCY][FRAG_MAX_REDUNDANCY / 8];
+    /* Equation holding the pivot of each unknown */
+    uint8_t pivotRow[FRAG_MAX_REDUNDANCY];
+    uint8_t line[FRAG_MAX_NB_FRAG / 8];
+    uint8_t vec[FRAG_MAX_REDUNDANCY / 8];
+    uint8_t acc[FRAG_MAX_SIZE];
+    uint8_t tmp[FRAG_MAX_SIZE];
+} FragSession_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static FragSession_t frag;
+static FragSessionStats_t fragStats;
+static const AppNvmOps_t *fragNvm = NULL;
+static uint32_t fragNvmOffset = 0;
+static uint32_t fragNvmSize = 0;
+static uint32_t fragParityOffset = 0;
+static uint32_t (*fragNowUs)(void) = NULL;
+
+/************************** FUNCTION PROTOTYPES ********************************/
+static FragStatus_t frag_on_coded(uint16_t n, const uint8_t *data);
+static FragStatus_t frag_start_coding(void);
+static FragStatus_t frag_solve(void);
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t frag_prbs23(uint32_t x)
+{
+    uint32_t b0 = x & 1u;
+    uint32_t b1 = (x & 32u) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+/* Parity fragment n (1 based) covers the uncoded fragments set in line */
+static void frag_matrix_line(uint16_t n, uint16_t m, uint8_t *line)
+{
+    uint32_t x = 1u + (1001u * n);
+    uint32_t nm = ((m & (m - 1u)) == 0u) ? 1u : 0u;
+
+    memset(line, 0, (m + 7u) / 8u);
+    for (uint16_t coeff = 0; coeff < (m / 2u); coeff++)
+    {
+        uint32_t r = 1uL << 16;
+
+        while (r >= m)
+        {
+            x = frag_prbs23(x);
+            r = x % (m + nm);
+        }
+        FRAG_BIT_SET(line, r);
+    }
+}
+
+static void frag_xor(uint8_t *dst, const uint8_t *src, uint8_t length)
+{
+    for (uint8_t i = 0; i < length; i++)
+    {
+        dst[i] ^= src[i];
+    }
+}
+
+static bool frag_read_data(uint16_t index, uint8_t *buffer)
+{
+    return fragNvm->read(fragNvmOffset + ((uint32_t)index * frag.fragSize), buffer, frag.fragSize);
+}
+
+static bool frag_write_data(uint16_t index, const uint8_t *buffer)
+{
+    return fragNvm->write(fragNvmOffset + ((uint32_t)index * frag.fragSize), buffer, frag.fragSize);
+}
+
+static bool frag_read_row(uint8_t row, uint8_t *buffer)
+{
+    return fragNvm->read(fragParityOffset + ((uint32_t)row * frag.fragSize), buffer, frag.fragSize);
+}
+
+static bool frag_write_row(uint8_t row, const uint8_t *buffer)
+{
+    return fragNvm->write(fragParityOffset + ((uint32_t)row * frag.fragSize), buffer, frag.fragSize);
+}
+
+/* Position of a block index in the unknowns, binary search */
+static int16_t frag_unknown_of(uint16_t index)
+{
+    int16_t low = 0;
+    int16_t high = (int16_t)frag.missingCount - 1;
+
+    while (low <= high)
+    {
+        int16_t mid = (int16_t)((low + high) / 2);
+
+        if (frag.missing[mid] == index)
+        {
+            return mid;
+        }
+        if (frag.missing[mid] < index)
+        {
+            low = (int16_t)(mid + 1);
+        }
+        else
+        {
+            high = (int16_t)(mid - 1);
+        }
+    }
+    return -1;
+}
+
+/*********************************************************************//**
+\brief      Initializes the decoder
+\param[in]  nvm       - storage of the block and of the parity scratch area
+\param[in]  nvmOffset - row aligned start of the area given to the decoder
+\param[in]  nvmSize   - size of that area
+\param[in]  nowUs     - optional microsecond clock for the decode time
+*************************************************************************/
+void FRAG_SESSION_Init(const AppNvmOps_t *nvm, uint32_t nvmOffset, uint32_t nvmSize,
+                       uint32_t (*nowUs)(void))
+{
+    fragNvm = nvm;
+    fragNvmOffset = nvmOffset;
+    fragNvmSize = nvmSize;
+    fragNowUs = nowUs;
+    memset(&frag, 0, sizeof(frag));
+    memset(&fragStats, 0, sizeof(fragStats));
+    fragStats.ramBytes = sizeof(frag) + sizeof(fragStats);
+}
+
+/*********************************************************************//**
+\brief      Starts a new session, dropping any previous one
+\param[in]  nbFrag   - number of uncoded fragments
+\param[in]  fragSize - payload size of every fragment
+\param[in]  padding  - bytes added to the end of the block to fill the last fragment
+\return     FRAG_STATUS_ONGOING, or the reason the session was refused
+*************************************************************************/
+FragStatus_t FRAG_SESSION_Setup(uint16_t nbFrag, uint8_t fragSize, uint8_t padding)
+{
+    uint32_t dataLength = (uint32_t)nbFrag * fragSize;
+    uint32_t parityOffset = APP_NVM_ROW_ALIGN(dataLength);
+    uint32_t parityLength = (uint32_t)FRAG_MAX_REDUNDANCY * fragSize;
+
+    memset(&frag, 0, sizeof(frag));
+    memset(frag.pivotRow, FRAG_NO_ROW, sizeof(frag.pivotRow));
+    memset(&fragStats, 0, sizeof(fragStats));
+    fragStats.ramBytes = sizeof(frag) + sizeof(fragStats);
+
+    if ((NULL == fragNvm) || (0 == nbFrag) || (nbFrag > FRAG_MAX_NB_FRAG) ||
+        (0 == fragSize) || (fragSize > FRAG_MAX_SIZE) || (padding >= fragSize) ||
+        ((parityOffset + parityLength) > fragNvmSize))
+    {
+        frag.status = FRAG_STATUS_ERR_PARAM;
+        return frag.status;
+    }
+
+    frag.nbFrag = nbFrag;
+    frag.fragSize = fragSize;
+    frag.padding = padding;
+    fragParityOffset = fragNvmOffset + parityOffset;
+
+    if (!fragNvm->erase(fragNvmOffset, parityOffset + APP_NVM_ROW_ALIGN(parityLength)))
+    {
+        frag.status = FRAG_STATUS_ERR_NVM;
+        return frag.status;
+    }
+
+    frag.status = FRAG_STATUS_ONGOING;
+    return frag.status;
+}
+
+/*********************************************************************//**
+\brief      Processes one fragment
+\param[in]  index  - 1..NbFrag for uncoded fragments, above for parity ones
+\param[in]  data   - fragment payload
+\param[in]  length - payload length, must be the session fragment size
+\return     Status of the session after this fragment
+*************************************************************************/
+FragStatus_t FRAG_SESSION_OnFragment(uint16_t index, const uint8_t *data, uint8_t length)
+{
+    if (FRAG_STATUS_ONGOING != frag.status)
+    {
+        return frag.status;
+    }
+    if ((0 == index) || (length != frag.fragSize))
+    {
+        return frag.status;
+    }
+
+    if (index <= frag.nbFrag)
+    {
+        uint16_t pos = index - 1;
+
+        /* Late uncoded fragments are not needed once the unknowns are fixed */
+        if (frag.coding || FRAG_BIT_GET(frag.received, pos))
+        {
+            return frag.status;
+        }
+        if (!frag_write_data(pos, data))
+        {
+            frag.status = FRAG_STATUS_ERR_NVM;
+            return frag.status;
+        }
+        FRAG_BIT_SET(frag.received, pos);
+        fragStats.uncodedReceived++;
+        if (fragStats.uncodedReceived == frag.nbFrag)
+        {
+            frag.status = FRAG_STATUS_COMPLETE;
+        }
+        return frag.status;
+    }
+
+    fragStats.codedReceived++;
+    {
+        uint32_t start = (NULL != fragNowUs) ? fragNowUs() : 0;
+
+        if (!frag.coding)
+        {
+            frag_start_coding();
+        }
+        if (FRAG_STATUS_ONGOING == frag.status)
+        {
+            frag_on_coded(index - frag.nbFrag, data);
+        }
+        if (NULL != fragNowUs)
+        {
+            fragStats.decodeTimeUs += fragNowUs() - start;
+        }
+    }
+    return frag.status;
+}
+
+static FragStatus_t frag_start_coding(void)
+{
+    frag.coding = true;
+    frag.missingCount = 0;
+
+    for (uint16_t i = 0; i < frag.nbFrag; i++)
+    {
+        if (!FRAG_BIT_GET(frag.received, i))
+        {
+            if (frag.missingCount >= FRAG_MAX_REDUNDANCY)
+            {
+                frag.status = FRAG_STATUS_ERR_TOO_MANY_LOST;
+                return frag.status;
+            }
+            frag.missing[frag.missingCount++] = i;
+        }
+    }
+    fragStats.lost = frag.missingCount;
+    return frag.status;
+}
+
+static FragStatus_t frag_on_coded(uint16_t n, const uint8_t *data)
+{
+    uint8_t vecBytes = (uint8_t)((frag.missingCount + 7u) / 8u);
+    bool empty = true;
+    uint16_t pivot = 0;
+
+    frag_matrix_line(n, frag.nbFrag, frag.line);
+    memcpy(frag.acc, data, frag.fragSize);
+    memset(frag.vec, 0, sizeof(frag.vec));
+
+    /* XOR out what is already known, keep the unknown coefficients */
+    for (uint16_t j = 0; j < frag.nbFrag; j++)
+    {
+        if (!FRAG_BIT_GET(frag.line, j))
+        {
+            continue;
+        }
+        if (FRAG_BIT_GET(frag.received, j))
+        {
+            if (!frag_read_data(j, frag.tmp))
+            {
+                frag.status = FRAG_STATUS_ERR_NVM;
+                return frag.status;
+            }
+            frag_xor(frag.acc, frag.tmp, frag.fragSize);
+        }
+        else
+        {
+            FRAG_BIT_SET(frag.vec, (uint16_t)frag_unknown_of(j));
+        }
+    }
+
+    /* Kept equations have no coefficient below their pivot, so one pass is enough */
+    for (uint16_t c = 0; c < frag.missingCount; c++)
+    {
+        uint8_t row = frag.pivotRow[c];
+
+        if (!FRAG_BIT_GET(frag.vec, c) || (FRAG_NO_ROW == row))
+        {
+            continue;
+        }
+        frag_xor(frag.vec, frag.rows[row], vecBytes);
+        if (!frag_read_row(row, frag.tmp))
+        {
+            frag.status = FRAG_STATUS_ERR_NVM;
+            return frag.status;
+        }
+        frag_xor(frag.acc, frag.tmp, frag.fragSize);
+    }
+
+    for (uint16_t c = 0; c < frag.missingCount; c++)
+    {
+        if (FRAG_BIT_GET(frag.vec, c))
+        {
+            pivot = c;
+            empty = false;
+            break;
+        }
+    }
+    if (empty)
+    {
+        /* Linear combination of what is already known */
+        return frag.status;
+    }
+
+    if (!frag_write_row((uint8_t)frag.rowCount, frag.acc))
+    {
+        frag.status = FRAG_STATUS_ERR_NVM;
+        return frag.status;
+    }
+    memcpy(frag.rows[frag.rowCount], frag.vec, vecBytes);
+    frag.pivotRow[pivot] = (uint8_t)frag.rowCount;
+    frag.rowCount++;
+    fragStats.codedUseful++;
+
+    if (frag.rowCount == frag.missingCount)
+    {
+        return frag_solve();
+    }
+    return frag.status;
+}
+
+static FragStatus_t frag_solve(void)
+{
+    /* Highest pivot first, every other unknown of its equation is then solved */
+    for (int16_t c = (int16_t)frag.missingCount - 1; c >= 0; c--)
+    {
+        uint8_t row = frag.pivotRow[c];
+
+        if (!frag_read_row(row, frag.acc))
+        {
+            frag.status = FRAG_STATUS_ERR_NVM;
+            return frag.status;
+        }
+        for (uint16_t j = (uint16_t)(c + 1); j < frag.missingCount; j++)
+        {
+            if (FRAG_BIT_GET(frag.rows[row], j))
+            {
+                if (!frag_read_data(frag.missing[j], frag.tmp))
+                {
+                    frag.status = FRAG_STATUS_ERR_NVM;
+                    return frag.status;
+                }
+                frag_xor(frag.acc, frag.tmp, frag.fragSize);
+            }
+        }
+        if (!frag_write_data(frag.missing[c], frag.acc))
+        {
+            frag.status = FRAG_STATUS_ERR_NVM;
+            return frag.status;
+        }
+        FRAG_BIT_SET(frag.received, frag.missing[c]);
+    }
+
+    frag.status = FRAG_STATUS_COMPLETE;
+    return frag.status;
+}
+
+/*********************************************************************//**
+\brief      Handles a message received on FRAG_SESSION_FPORT
+\param[in]  data   - message, starting with its identifier
+\param[in]  length - message length
+\return     Status of the session after this message
+*************************************************************************/
+FragStatus_t FRAG_SESSION_HandleMessage(const uint8_t *data, uint8_t length)
+{
+    if ((NULL == data) || (0 == length))
+    {
+        return frag.status;
+    }
+
+    switch (data[0])
+    {
+        case FRAG_CID_SESSION_SETUP_REQ:
+            /* FragSession, NbFrag(2), FragSize, Control, Padding, Descriptor(4) */
+            if (length < 11)
+            {
+                return FRAG_STATUS_ERR_PARAM;
+            }
+            return FRAG_SESSION_Setup((uint16_t)(data[2] | ((uint16_t)data[3] << 8)), data[4], data[6]);
+
+        case FRAG_CID_SESSION_DELETE_REQ:
+            memset(&frag, 0, sizeof(frag));
+            return frag.status;
+
+        case FRAG_CID_DATA_FRAGMENT:
+            /* IndexAndN(2): fragment number in bits 13:0 */
+            if (length < 3)
+            {
+                return frag.status;
+            }
+            return FRAG_SESSION_OnFragment((uint16_t)((data[1] | ((uint16_t)data[2] << 8)) & 0x3FFFu),
+                                           &data[3], (uint8_t)(length - 3));
+
+        default:
+            return frag.status;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the status of the current session
+*************************************************************************/
+FragStatus_t FRAG_SESSION_GetStatus(void)
+{
+    return frag.status;
+}
+
+/*********************************************************************//**
+\brief      Returns the length of the rebuilt block, without padding
+*************************************************************************/
+uint32_t FRAG_SESSION_BlockLength(void)
+{
+    return ((uint32_t)frag.nbFrag * frag.fragSize) - frag.padding;
+}
+
+/*********************************************************************//**
+\brief      Returns the reception and decoding counters
+*************************************************************************/
+const FragSessionStats_t *FRAG_SESSION_GetStats(void)
+{
+    return &fragStats;
+}
@@ -0,0 +1,84 @@
+/**
+* \file  frag_session.h
+*
+* \brief Fragmented data block reassembly with forward error correction
+*
+* Receives a data block (configuration table, firmware image) split in
+* fragments, typically over a multicast group. The uncoded fragments
+* 1..NbFrag are followed by parity fragments, each the XOR of a pseudo
+* random half of the uncoded ones (LoRaWAN fragmented data block transport
+* matrix). Any NbFrag - lost + a few parity fragments rebuild the block.
+*
+* The block is written straight to NVM. RAM use is bounded by
+* FRAG_MAX_REDUNDANCY, the number of lost fragments that can be recovered,
+* and not by the size of the block.
+*/
+
+#ifndef FRAG_SESSION_H_
+#define FRAG_SESSION_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_nvm.h"
+
+/****************************** MACROS **************************************/
+/* Largest number of uncoded fragments of a block */
+#ifndef FRAG_MAX_NB_FRAG
+#define FRAG_MAX_NB_FRAG                    512u
+#endif
+
+/* Largest fragment payload */
+#ifndef FRAG_MAX_SIZE
+#define FRAG_MAX_SIZE                       64u
+#endif
+
+/* Largest number of lost uncoded fragments that can be recovered, multiple of 8 */
+#ifndef FRAG_MAX_REDUNDANCY
+#define FRAG_MAX_REDUNDANCY                 48u
+#endif
+
+/* Application port of the fragmentation messages */
+#define FRAG_SESSION_FPORT                  201
+
+/* Fragmentation message identifiers */
+#define FRAG_CID_SESSION_SETUP_REQ          0x02
+#define FRAG_CID_SESSION_DELETE_REQ         0x03
+#define FRAG_CID_DATA_FRAGMENT              0x08
+
+/****************************** TYPES **************************************/
+typedef enum _FragStatus_t
+{
+    FRAG_STATUS_IDLE = 0,
+    FRAG_STATUS_ONGOING,
+    FRAG_STATUS_COMPLETE,
+    FRAG_STATUS_ERR_PARAM,
+    FRAG_STATUS_ERR_NVM,
+    FRAG_STATUS_ERR_TOO_MANY_LOST
+} FragStatus_t;
+
+typedef struct _FragSessionStats_t
+{
+    uint16_t uncodedReceived;
+    uint16_t codedReceived;
+    /* Parity fragments that added a new equation */
+    uint16_t codedUseful;
+    /* Uncoded fragments missing when the parity fragments started */
+    uint16_t lost;
+    /* Time spent processing parity fragments and solving */
+    uint32_t decodeTimeUs;
+    /* Static RAM of the decoder */
+    uint32_t ramBytes;
+} FragSessionStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void FRAG_SESSION_Init(const AppNvmOps_t *nvm, uint32_t nvmOffset, uint32_t nvmSize,
+                       uint32_t (*nowUs)(void));
+FragStatus_t FRAG_SESSION_Setup(uint16_t nbFrag, uint8_t fragSize, uint8_t padding);
+FragStatus_t FRAG_SESSION_OnFragment(uint16_t index, const uint8_t *data, uint8_t length);
+FragStatus_t FRAG_SESSION_HandleMessage(const uint8_t *data, uint8_t length);
+FragStatus_t FRAG_SESSION_GetStatus(void);
+uint32_t FRAG_SESSION_BlockLength(void);
+const FragSessionStats_t *FRAG_SESSION_GetStats(void);
+
+#endif /* FRAG_SESSION_H_ */
@@ -0,0 +1,198 @@
+/**
+* \file  link_quality.c
+*
+* \brief Link quality of the gateway interactions and the data rate and
+*        TX power they allow
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "link_quality.h"
+
+/******************************** MACROS ***************************************/
+/* Smoothing of the RSSI and SNR (1/4) and of the delivery ratio (1/8) */
+#define LINK_QUALITY_SIGNAL_SHIFT           2u
+#define LINK_QUALITY_DELIVERY_SHIFT         3u
+/* Extra margin added by a lost acknowledgment, removed by a delivery */
+#define LINK_QUALITY_LOSS_STEP_Q4           LINK_QUALITY_DB(2)
+#define LINK_QUALITY_DELIVERY_STEP_Q4       LINK_QUALITY_DB(0.25)
+#define LINK_QUALITY_EXTRA_MAX_Q4           LINK_QUALITY_DB(12)
+/* Above this SNR the demodulator saturates, the RSSI tells more */
+#define LINK_QUALITY_SNR_SATURATION_Q4      LINK_QUALITY_DB(5)
+/* Extra margin a new setting needs over the current one: the smoothed SNR
+   of a marginal or fading link wanders across the thresholds */
+#define LINK_QUALITY_HYSTERESIS_Q4          LINK_QUALITY_DB(1.5)
+
+/************************** GLOBAL VARIABLES ***********************************/
+static LinkQualityConfig_t linkConfig;
+static LinkQualityStats_t linkStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+static int16_t link_quality_smooth(int16_t average, int16_t sample)
+{
+    return (int16_t)(average + ((sample - average) / (1 << LINK_QUALITY_SIGNAL_SHIFT)));
+}
+
+/*********************************************************************//**
+\brief      Initializes the estimator, nothing is recommended before the
+            first downlink
+\param[in]  config - band limits, TX costs and delivery target
+*************************************************************************/
+void LINK_QUALITY_Init(const LinkQualityConfig_t *config)
+{
+    linkConfig = *config;
+    if (linkConfig.powerCount > LINK_QUALITY_MAX_POWERS)
+    {
+        linkConfig.powerCount = LINK_QUALITY_MAX_POWERS;
+    }
+    memset(&linkStats, 0, sizeof(linkStats));
+    linkStats.deliveryRatio = 1000u;
+}
+
+/*********************************************************************//**
+\brief      Sets the data rates and TX powers of the band in use, the
+            measurements are kept
+\param[in]  maxDr         - fastest data rate
+\param[in]  snrFloorDr0Q4 - demodulation floor of DR0
+\param[in]  powerCount    - number of TX power indexes
+*************************************************************************/
+void LINK_QUALITY_Configure(uint8_t maxDr, int16_t snrFloorDr0Q4, uint8_t powerCount)
+{
+    linkConfig.maxDr = maxDr;
+    linkConfig.snrFloorDr0Q4 = snrFloorDr0Q4;
+    linkConfig.powerCount = (powerCount > LINK_QUALITY_MAX_POWERS) ? LINK_QUALITY_MAX_POWERS : powerCount;
+}
+
+/*********************************************************************//**
+\brief      Takes the signal of a received downlink into account
+\param[in]  rssi - dBm
+\param[in]  snr  - dB
+*************************************************************************/
+void LINK_QUALITY_OnDownlink(int16_t rssi, int8_t snr)
+{
+    if (0 == linkStats.downlinks)
+    {
+        linkStats.rssiQ4 = LINK_QUALITY_DB(rssi);
+        linkStats.snrQ4 = LINK_QUALITY_DB(snr);
+    }
+    else
+    {
+        linkStats.rssiQ4 = link_quality_smooth(linkStats.rssiQ4, LINK_QUALITY_DB(rssi));
+        linkStats.snrQ4 = link_quality_smooth(linkStats.snrQ4, LINK_QUALITY_DB(snr));
+    }
+    linkStats.downlinks++;
+}
+
+/*********************************************************************//**
+\brief      Takes the outcome of an uplink into account
+\param[in]  confirmed - the uplink asked for an acknowledgment
+\param[in]  delivered - the acknowledgment was received
+*************************************************************************/
+void LINK_QUALITY_OnUplink(bool confirmed, bool delivered)
+{
+    if (!confirmed)
+    {
+        return;
+    }
+
+    linkStats.confirmed++;
+    if (delivered)
+    {
+        linkStats.delivered++;
+        linkStats.deliveryRatio += (1000u - linkStats.deliveryRatio) >> LINK_QUALITY_DELIVERY_SHIFT;
+        if (linkStats.deliveryRatio >= linkConfig.targetDelivery)
+        {
+            linkStats.extraMarginQ4 = (linkStats.extraMarginQ4 > LINK_QUALITY_DELIVERY_STEP_Q4) ?
+                                      (int16_t)(linkStats.extraMarginQ4 - LINK_QUALITY_DELIVERY_STEP_Q4) : 0;
+        }
+    }
+    else
+    {
+        linkStats.deliveryRatio -= linkStats.deliveryRatio >> LINK_QUALITY_DELIVERY_SHIFT;
+        linkStats.extraMarginQ4 = ((linkStats.extraMarginQ4 + LINK_QUALITY_LOSS_STEP_Q4) < LINK_QUALITY_EXTRA_MAX_Q4) ?
+                                  (int16_t)(linkStats.extraMarginQ4 + LINK_QUALITY_LOSS_STEP_Q4) :
+                                  LINK_QUALITY_EXTRA_MAX_Q4;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the estimated SNR of the uplinks at the highest power
+*************************************************************************/
+int16_t LINK_QUALITY_UplinkSnrQ4(void)
+{
+    int16_t rssiSnrQ4 = (int16_t)(linkStats.rssiQ4 - LINK_QUALITY_DB(LINK_QUALITY_NOISE_FLOOR_DBM));
+
+    if ((linkStats.snrQ4 >= LINK_QUALITY_SNR_SATURATION_Q4) && (rssiSnrQ4 > linkStats.snrQ4))
+    {
+        return rssiSnrQ4;
+    }
+    return linkStats.snrQ4;
+}
+
+/*********************************************************************//**
+\brief      Selects the data rate and TX power of the lowest energy per
+            frame that keep the margin, a change needs the hysteresis on
+            top
+\param[out] dr      - data rate
+\param[out] txPower - TX power index
+\return     false before the first downlink, nothing is known yet
+*************************************************************************/
+bool LINK_QUALITY_Recommend(uint8_t *dr, uint8_t *txPower)
+{
+    int16_t snrQ4 = LINK_QUALITY_UplinkSnrQ4();
+    int16_t requiredQ4 = (int16_t)(linkConfig.marginQ4 + linkStats.extraMarginQ4);
+    uint32_t bestCost = UINT32_MAX;
+    uint8_t currentDr = linkStats.dr;
+    uint8_t currentTxPower = linkStats.txPower;
+
+    if ((0 == linkStats.downlinks) || (0 == linkConfig.powerCount))
+    {
+        return false;
+    }
+
+    /* Nothing fits: the most robust setting */
+    linkStats.dr = 0;
+    linkStats.txPower = 0;
+    /* Faster rates first, they win ties: less time on air, fewer collisions */
+    for (uint8_t step = 0; step <= linkConfig.maxDr; step++)
+    {
+        uint8_t rate = (uint8_t)(linkConfig.maxDr - step);
+        int16_t floorQ4 = (int16_t)(linkConfig.snrFloorDr0Q4 + rate * LINK_QUALITY_DR_STEP_Q4);
+
+        for (uint8_t power = 0; power < linkConfig.powerCount; power++)
+        {
+            int16_t marginQ4 = (int16_t)(snrQ4 - power * LINK_QUALITY_POWER_STEP_Q4 - floorQ4);
+            uint32_t cost = (uint32_t)linkConfig.txCost[power] << step;
+
+            if ((0u != linkStats.changes) && ((rate != currentDr) || (power != currentTxPower)))
+            {
+                marginQ4 = (int16_t)(marginQ4 - LINK_QUALITY_HYSTERESIS_Q4);
+            }
+            if ((marginQ4 >= requiredQ4) && (cost < bestCost))
+            {
+                bestCost = cost;
+                linkStats.dr = rate;
+                linkStats.txPower = power;
+            }
+        }
+    }
+
+    if ((0u == linkStats.changes) || (linkStats.dr != currentDr) || (linkStats.txPower != currentTxPower))
+    {
+        linkStats.changes++;
+    }
+    *dr = linkStats.dr;
+    *txPower = linkStats.txPower;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Returns the smoothed signal, the delivery statistics and the
+            last recommendation
+*************************************************************************/
+const LinkQualityStats_t *LINK_QUALITY_GetStats(void)
+{
+    return &linkStats;
+}
@@ -0,0 +1,86 @@
+/**
+* \file  link_quality.h
+*
+* \brief Link quality of the gateway interactions and the data rate and
+*        TX power they allow
+*
+* Every downlink, acknowledgments included, updates a smoothed RSSI and
+* SNR. The downlink SNR stands for the SNR of the uplinks at the gateway;
+* close to the gateway the SNR saturates and the RSSI above the noise
+* floor is used instead. The delivery ratio of the confirmed uplinks
+* adjusts an extra margin: a lost acknowledgment raises it, deliveries
+* above the target lower it slowly.
+* The recommendation is the data rate and TX power of the lowest energy
+* per frame, time on air times TX current, whose margin above the
+* demodulation floor covers the installation margin plus the extra one;
+* leaving the current setting takes a little more, so that a fading link
+* does not flap between two.
+* It complements the network ADR of devices that rarely get a
+* LinkADRReq. The module does not touch the hardware and also builds on
+* a host.
+*/
+
+#ifndef LINK_QUALITY_H_
+#define LINK_QUALITY_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Fixed point dB values are in 1/16 dB */
+#define LINK_QUALITY_DB(db)                 ((int16_t)((db) * 16))
+
+#define LINK_QUALITY_MAX_POWERS             8u
+
+/* Demodulation floor step between two data rates (one spreading factor) */
+#define LINK_QUALITY_DR_STEP_Q4             LINK_QUALITY_DB(2.5)
+/* Output power step between two TX power indexes */
+#define LINK_QUALITY_POWER_STEP_Q4          LINK_QUALITY_DB(2)
+
+/* Noise floor of a 125 kHz channel: -174 dBm/Hz + 51 dB + 6 dB NF */
+#define LINK_QUALITY_NOISE_FLOOR_DBM        (-117)
+
+/****************************** TYPES **************************************/
+typedef struct _LinkQualityConfig_t
+{
+    /* Fastest data rate, every step down doubles the time on air */
+    uint8_t maxDr;
+    /* Demodulation floor of DR0, LINK_QUALITY_DR_STEP_Q4 lower per step */
+    int16_t snrFloorDr0Q4;
+    /* TX power indexes, 0 the highest, LINK_QUALITY_POWER_STEP_Q4 apart */
+    uint8_t powerCount;
+    /* Relative TX current of every power index */
+    uint8_t txCost[LINK_QUALITY_MAX_POWERS];
+    /* Margin kept above the floor for fading and uplink/downlink asymmetry */
+    int16_t marginQ4;
+    /* Delivery ratio of the confirmed uplinks to keep, per mille */
+    uint16_t targetDelivery;
+} LinkQualityConfig_t;
+
+typedef struct _LinkQualityStats_t
+{
+    int16_t rssiQ4;
+    int16_t snrQ4;
+    uint32_t downlinks;
+    uint32_t confirmed;
+    uint32_t delivered;
+    /* Smoothed delivery ratio, per mille */
+    uint16_t deliveryRatio;
+    int16_t extraMarginQ4;
+    /* Last recommendation and number of changes, the first one included */
+    uint8_t dr;
+    uint8_t txPower;
+    uint32_t changes;
+} LinkQualityStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void LINK_QUALITY_Init(const LinkQualityConfig_t *config);
+void LINK_QUALITY_Configure(uint8_t maxDr, int16_t snrFloorDr0Q4, uint8_t powerCount);
+void LINK_QUALITY_OnDownlink(int16_t rssi, int8_t snr);
+void LINK_QUALITY_OnUplink(bool confirmed, bool delivered);
+bool LINK_QUALITY_Recommend(uint8_t *dr, uint8_t *txPower);
+int16_t LINK_QUALITY_UplinkSnrQ4(void);
+const LinkQualityStats_t *LINK_QUALITY_GetStats(void);
+
+#endif /* LINK_QUALITY_H_ */
@@ -37,6 +37,7 @@
  
 /****************************** INCLUDES **************************************/
 #include "asf.h"
+#include <string.h>
 #include "system_low_power.h"
 #include "radio_driver_hal.h"
 #include "lorawan.h"
@@ -50,6 +51,16 @@
 #include "conf_app.h"
 #include "sw_timer.h"
 #include "adc.h"
+#include "adc_window.h"
+#include "sleep_coord.h"
+#include "app_params.h"
+#include "app_nvm.h"
+#include "cfg_store.h"
+#include "app_diag.h"
+#include "events.h"
+#include "periph_mgr.h"
+#include "dma.h"
+#include "adc_scan.h"
 #ifdef CONF_PMM_ENABLE
 #include "pmm.h"
 #include  "conf_pmm.h"
@@ -68,6 +79,8 @@
 /************************** Macro definition ***********************************/
 /* Button debounce time in ms */
 #define APP_DEBOUNCE_TIME       50
+/* Enabling the ADC and starting the DMA, in the scan time model */
+#define ADC_SCAN_STARTUP_US     50
 /************************** Global variables ***********************************/
 //float acc_val=0;
 //static char acc_sen_str[25];
@@ -77,22 +90,41 @@ bool factory_reset = false;
 bool bandSelected = false;
 uint32_t longPress = 0;
 uint8_t demoTimerId = 0xFF;
-uint8_t lTimerId = 0xFF;
 extern bool certAppEnabled;
 #ifdef CONF_PMM_ENABLE
 bool deviceResetsForWakeup = false;
 #endif
 
 struct adc_module adc_instance;
+AdcWakePlan_t adcWakePlan;
+volatile bool adcWindowWake = false;
+static struct events_resource adc_event_resource;
+static bool adcRtcEventAllocated = false;
+static uint8_t adcRtcEvent = 0;
+static struct dma_resource adc_dma_resource;
+COMPILER_ALIGNED(16) static DmacDescriptor adc_dma_descriptor SECTION_DMAC_DESCRIPTOR;
+static AdcScanPlan_t adcScanPlan;
+static AdcScanCal_t adcScanCal;
+static uint32_t adcScanTimeoutUs;
+static volatile bool adcScanDone = false;
 
 //struct adc_config conf_adc;
 /************************** Extern variables ***********************************/
+/* Stack bounds from the linker script */
+extern uint32_t _sstack;
+extern uint32_t _estack;
 
 /************************** Function Prototypes ********************************/
 static void driver_init(void);
+static void app_config_load(void);
+static void stack_paint(void);
 //static uint16_t adc_start_read_result(void);
 
 static void ADC_start(void);
+static void adc_window_apply(void);
+static void adc_window_cb(struct adc_module *const module);
+static void adc_scan_init(uint8_t sampleLength);
+static void adc_scan_dma_cb(struct dma_resource *const resource);
 //static void get_adc_resource_data(uint8_t * data);
 //static void get_adc_data(uint8_t *data);
 //static double acc_sensor_value(int type);
@@ -107,9 +139,18 @@ static void assertHandler(SystemAssertLevel_t level, uint16_t code);
 
 /****************************** FUNCTIONS **************************************/
 
+/* Paints the stack below the current frame for the high-water mark */
+static void stack_paint(void)
+{
+    uint32_t *sp = (uint32_t *)__get_MSP();
+
+    APP_DIAG_StackInit(&_sstack, &_estack, sp - APP_DIAG_STACK_MARGIN_WORDS);
+}
+
 static void print_reset_causes(void)
 {
     enum system_reset_cause rcause = system_get_reset_cause();
+    APP_DIAG_Init((uint8_t)rcause);
     printf("Last reset cause: ");
     if(rcause & (1 << 6)) {
         printf("System Reset Request\r\n");
@@ -147,7 +188,11 @@ static void assertHandler(SystemAssertLevel_t level, uint16_t code)
  */
 int main(void)
 {
-	
+    uint64_t loopStart;
+
+    /* Before anything else uses the stack */
+    stack_paint();
+
     /* System Initialization */
     system_init();
     /* Initialize the delay driver */
@@ -171,9 +216,11 @@ int main(void)
     /* Initialize demo application */
     Stack_Init();
 
+    /* Underlying timer of the application timer service */
     SwTimerCreate(&demoTimerId);
-    SwTimerCreate(&lTimerId);
 
+	APP_PARAMS_Init();
+	app_config_load();
 	ADC_start();
     
 	mote_demo_init();
@@ -183,7 +230,13 @@ int main(void)
 	
     while (1)
     {
+        loopStart = SwTimerGetTime();
         SYSTEM_RunTasks();
+        APP_DIAG_RecordLoop((uint32_t)(SwTimerGetTime() - loopStart));
+#ifdef CONF_PMM_ENABLE
+        /* Deep sleep once the stack is ready, idle sleep until then */
+        SLEEP_COORD_Idle();
+#endif
     }
 }
 
@@ -199,12 +252,279 @@ static void ADC_start(void)
 	conf_adc.positive_input =  ADC_POSITIVE_INPUT_PIN6;
 	conf_adc.negative_input = ADC_NEGATIVE_INPUT_GND;
 	conf_adc.sample_length = 63;
-	
+
+	const AppParams_t *params = APP_PARAMS_Get();
+
+	ADC_WINDOW_Plan(DEMO_APP_ADC_WAKE_MODE, app_alarm_level(), params->samplePeriodMs,
+					params->statusPeriods, DEMO_APP_ADC_WINDOW_RTC_HZ, &adcWakePlan);
+
+	if (ADC_WAKE_MODE_WINDOW == DEMO_APP_ADC_WAKE_MODE)
+	{
+		/* Conversions are started by the RTC in standby, GCLK_GENERATOR_2 must run in standby.
+		 * Also set up while the plan polls, adc_window_update() may switch to the window later */
+		conf_adc.run_in_standby = true;
+		conf_adc.on_demand = true;
+	}
+
 	adc_init(&adc_instance, ADC, &conf_adc);
+	adc_scan_init(conf_adc.sample_length);
+
+	if (ADC_WAKE_MODE_WINDOW == DEMO_APP_ADC_WAKE_MODE)
+	{
+		adc_register_callback(&adc_instance, adc_window_cb, ADC_CALLBACK_WINDOW);
+		adc_window_apply();
+	}
 
 	adc_enable(&adc_instance);
 }
 
+/* Applies the wake plan to the RTC event, the ADC event input and the window comparator */
+static void adc_window_apply(void)
+{
+	bool window = (ADC_WAKE_MODE_WINDOW == adcWakePlan.mode);
+
+	if (!adcRtcEventAllocated || (adcRtcEvent != adcWakePlan.rtcEvent))
+	{
+		struct events_config conf_ev;
+
+		if (adcRtcEventAllocated)
+		{
+			RTC->MODE0.EVCTRL.reg &= ~RTC_MODE0_EVCTRL_PEREO(1 << adcRtcEvent);
+			events_detach_user(&adc_event_resource, EVSYS_ID_USER_ADC_START);
+			events_release(&adc_event_resource);
+		}
+
+		events_get_config_defaults(&conf_ev);
+		conf_ev.generator = EVSYS_ID_GEN_RTC_PER_0 + adcWakePlan.rtcEvent;
+		conf_ev.path = EVENTS_PATH_ASYNCHRONOUS;
+		conf_ev.edge_detect = EVENTS_EDGE_DETECT_NONE;
+		events_allocate(&adc_event_resource, &conf_ev);
+		events_attach_user(&adc_event_resource, EVSYS_ID_USER_ADC_START);
+		adcRtcEvent = adcWakePlan.rtcEvent;
+		adcRtcEventAllocated = true;
+	}
+
+	if (window)
+	{
+		RTC->MODE0.EVCTRL.reg |= RTC_MODE0_EVCTRL_PEREO(1 << adcRtcEvent);
+		ADC->EVCTRL.reg |= ADC_EVCTRL_STARTEI;
+		adc_set_window_mode(&adc_instance, ADC_WINDOW_MODE_ABOVE_LOWER, adcWakePlan.windowLimit, 0);
+	}
+	else
+	{
+		/* Polling converts on demand, the RTC stops waking the ADC */
+		RTC->MODE0.EVCTRL.reg &= ~RTC_MODE0_EVCTRL_PEREO(1 << adcRtcEvent);
+		ADC->EVCTRL.reg &= ~ADC_EVCTRL_STARTEI;
+		adc_set_window_mode(&adc_instance, ADC_WINDOW_MODE_DISABLE, 0, 0);
+	}
+}
+
+/* Window monitor hit while sleeping, the reading is confirmed after wakeup */
+static void adc_window_cb(struct adc_module *const module)
+{
+	adc_disable_callback(module, ADC_CALLBACK_WINDOW);
+	adcWindowWake = true;
+#ifdef CONF_PMM_ENABLE
+	PMM_Wakeup();
+#endif
+}
+
+/* Enables the window monitor interrupt before sleep and disables it while awake */
+void adc_window_arm(bool enable)
+{
+	if (ADC_WAKE_MODE_WINDOW != adcWakePlan.mode)
+	{
+		return;
+	}
+
+	if (enable)
+	{
+		adcWindowWake = false;
+		adc_clear_status(&adc_instance, ADC_STATUS_WINDOW);
+		adc_enable_callback(&adc_instance, ADC_CALLBACK_WINDOW);
+	}
+	else
+	{
+		adc_disable_callback(&adc_instance, ADC_CALLBACK_WINDOW);
+	}
+}
+
+/* Sets up the input sequencer, its DMA channel and the conversion of the results */
+static void adc_scan_init(uint8_t sampleLength)
+{
+	static const uint8_t inputs[ADC_SCAN_SIGNAL_COUNT] =
+	{
+		DEMO_APP_ADC_SCAN_ACC_X,
+		DEMO_APP_ADC_SCAN_ACC_Y,
+		DEMO_APP_ADC_SCAN_ACC_Z,
+		DEMO_APP_ADC_SCAN_VBAT,
+		DEMO_APP_ADC_SCAN_TEMP
+	};
+	struct dma_resource_config conf_dma;
+	AdcScanTiming_t timing;
+	uint32_t activeUs;
+
+	if (!ADC_SCAN_Plan(inputs, &adcScanPlan))
+	{
+		/* Nothing is converted, adc_scan_run() fails */
+		printf("\r\nInvalid ADC scan inputs\r\n");
+	}
+
+	adcScanCal.vrefMv = DEMO_APP_ADC_VREF_MV;
+	adcScanCal.vbatDivider = DEMO_APP_ADC_VBAT_DIVIDER;
+	if (ADC_SCAN_INPUT_NONE != DEMO_APP_ADC_SCAN_TEMP)
+	{
+		uint32_t tempLog[2];
+
+		SUPC->VREF.reg |= SUPC_VREF_TSEN;
+		/* Temperature log row: room and hot temperatures with their codes at 1.0 V */
+		memcpy(tempLog, (const void *)NVMCTRL_TEMP_LOG, sizeof(tempLog));
+		adcScanCal.roomTempDeci = (int16_t)((tempLog[0] & 0xFF) * 10 + ((tempLog[0] >> 8) & 0x0F));
+		adcScanCal.hotTempDeci = (int16_t)(((tempLog[0] >> 12) & 0xFF) * 10 + ((tempLog[0] >> 20) & 0x0F));
+		adcScanCal.roomMv = (uint16_t)(((tempLog[1] >> 8) & 0xFFF) * 1000u / 4095u);
+		adcScanCal.hotMv = (uint16_t)(((tempLog[1] >> 20) & 0xFFF) * 1000u / 4095u);
+	}
+
+	/* Bound the wait on the modelled scan time */
+	timing.adcClockHz = system_gclk_gen_get_hz(GCLK_GENERATOR_2) / 2;
+	timing.sampleLength = sampleLength;
+	timing.resolutionBits = 12;
+	timing.startupUs = ADC_SCAN_STARTUP_US;
+	activeUs = ADC_SCAN_ActiveTimeUs(&timing, adcScanPlan.count);
+	adcScanTimeoutUs = 2 * activeUs + ADC_SCAN_STARTUP_US;
+
+	dma_get_config_defaults(&conf_dma);
+	conf_dma.peripheral_trigger = ADC_DMAC_ID_RESRDY;
+	conf_dma.trigger_action = DMA_TRIGGER_ACTION_BEAT;
+	dma_allocate(&adc_dma_resource, &conf_dma);
+	dma_add_descriptor(&adc_dma_resource, &adc_dma_descriptor);
+	dma_register_callback(&adc_dma_resource, adc_scan_dma_cb, DMA_CALLBACK_TRANSFER_DONE);
+	dma_enable_callback(&adc_dma_resource, DMA_CALLBACK_TRANSFER_DONE);
+
+	printf("\r\nADC scan: %d inputs, %ld us\r\n", adcScanPlan.count, activeUs);
+}
+
+static void adc_scan_dma_cb(struct dma_resource *const resource)
+{
+	(void)resource;
+	adcScanDone = true;
+}
+
+/* Converts every scan input back to back, the ADC must be enabled */
+bool adc_scan_run(AdcScanResult_t *result)
+{
+	uint16_t codes[ADC_SCAN_SIGNAL_COUNT];
+	struct dma_descriptor_config conf_desc;
+	uint64_t start;
+
+	if (0 == adcScanPlan.count)
+	{
+		return false;
+	}
+
+	dma_descriptor_get_config_defaults(&conf_desc);
+	conf_desc.beat_size = DMA_BEAT_SIZE_HWORD;
+	conf_desc.src_increment_enable = false;
+	conf_desc.dst_increment_enable = true;
+	conf_desc.block_transfer_count = adcScanPlan.count;
+	conf_desc.source_address = (uint32_t)(uintptr_t)&ADC->RESULT.reg;
+	/* The DMA takes the end address of an incrementing destination */
+	conf_desc.destination_address = (uint32_t)(uintptr_t)codes + adcScanPlan.count * sizeof(codes[0]);
+	dma_descriptor_create(&adc_dma_descriptor, &conf_desc);
+
+	adcScanDone = false;
+	dma_start_transfer_job(&adc_dma_resource);
+
+	/* Keep the RTC events of the window monitor out of the sequence */
+	ADC->EVCTRL.reg &= ~ADC_EVCTRL_STARTEI;
+	ADC->SEQCTRL.reg = adcScanPlan.seqMask;
+	while (adc_is_syncing(&adc_instance))
+	{
+	}
+	adc_start_conversion(&adc_instance);
+
+	start = SwTimerGetTime();
+	while (!adcScanDone && ((SwTimerGetTime() - start) < adcScanTimeoutUs))
+	{
+	}
+
+	ADC->SEQCTRL.reg = 0;
+	/* The sequencer leaves MUXPOS on its last input, the window monitor and
+	 * the single conversions read the accelerometer again */
+	adc_set_positive_input(&adc_instance, ADC_POSITIVE_INPUT_PIN6);
+	if (ADC_WAKE_MODE_WINDOW == adcWakePlan.mode)
+	{
+		ADC->EVCTRL.reg |= ADC_EVCTRL_STARTEI;
+	}
+
+	if (!adcScanDone)
+	{
+		dma_abort_job(&adc_dma_resource);
+		return false;
+	}
+
+	ADC_SCAN_Convert(&adcScanPlan, codes, &adcScanCal, result);
+	return true;
+}
+
+/* Plans the wakeups again after the runtime parameters or the learned alarm level changed */
+void adc_window_update(void)
+{
+	const AppParams_t *params = APP_PARAMS_Get();
+	AdcWakeMode_t previous = adcWakePlan.mode;
+
+	/* Planned from the configured mode, a fallback to polling ends as soon as the
+	 * window can watch the threshold again */
+	ADC_WINDOW_Plan(DEMO_APP_ADC_WAKE_MODE, app_alarm_level(), params->samplePeriodMs,
+					params->statusPeriods, DEMO_APP_ADC_WINDOW_RTC_HZ, &adcWakePlan);
+	if (ADC_WAKE_MODE_WINDOW != DEMO_APP_ADC_WAKE_MODE)
+	{
+		return;
+	}
+
+	adc_window_apply();
+	if (previous == adcWakePlan.mode)
+	{
+		return;
+	}
+	if (ADC_WAKE_MODE_WINDOW == adcWakePlan.mode)
+	{
+		/* The window monitor keeps converting in standby */
+		PERIPH_Acquire(PERIPH_ADC);
+	}
+	else
+	{
+		adc_disable_callback(&adc_instance, ADC_CALLBACK_WINDOW);
+		PERIPH_Release(PERIPH_ADC);
+	}
+}
+
+
+/* Loads the site configuration, conf_app.h provides the defaults */
+static void app_config_load(void)
+{
+	static const char *const sources[] = { "defaults", "loaded", "migrated" };
+	static const uint8_t mcastNwkSKey[CFG_STORE_KEY_LENGTH] = DEMO_APP_MCAST_NWK_SESSION_KEY;
+	static const uint8_t mcastAppSKey[CFG_STORE_KEY_LENGTH] = DEMO_APP_MCAST_APP_SESSION_KEY;
+	CfgValues_t defaults;
+	CfgStoreSource_t source;
+
+	memset(&defaults, 0, sizeof(defaults));
+	defaults.fport = DEMO_APP_FPORT;
+	defaults.edClass = DEMO_APP_ENDDEVICE_CLASS;
+	defaults.activationType = DEMO_APP_ACTIVATION_TYPE;
+	defaults.subband = SUBBAND;
+	defaults.params = *APP_PARAMS_Get();
+	defaults.mcastEnable = DEMO_APP_MCAST_ENABLE;
+	defaults.mcastGroupId = DEMO_APP_MCAST_GROUPID;
+	defaults.mcastGroupAddr = DEMO_APP_MCAST_GROUP_ADDRESS;
+	memcpy(defaults.mcastNwkSKey, mcastNwkSKey, CFG_STORE_KEY_LENGTH);
+	memcpy(defaults.mcastAppSKey, mcastAppSKey, CFG_STORE_KEY_LENGTH);
+
+	source = CFG_STORE_Load(APP_NVM_GetOps(), APP_NVM_CFG_OFFSET, &defaults);
+	APP_PARAMS_Apply(CFG_STORE_Params());
+	printf("Configuration: %s\r\n", sources[source]);
+}
 
 /* Initializes all the hardware and software modules used for Stack operation */
 static void driver_init(void)
@@ -222,6 +542,8 @@ static void driver_init(void)
     /* PDS Module Init */
     PDS_Init();
 #endif
+	/* Application data storage in flash */
+	APP_NVM_Init();
 	/* Initializes the Security modules */
 	sal_status = SAL_Init();
 	
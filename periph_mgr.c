@@ -0,0 +1,107 @@
+/**
+* \file  periph_mgr.c
+*
+* \brief Reference counted power management of the application peripherals
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "periph_mgr.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const PeriphOps_t *periphOps = NULL;
+static uint8_t periphRefs[PERIPH_COUNT];
+static uint8_t periphPowered = 0;
+static PeriphStats_t periphStats[PERIPH_COUNT];
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Initializes the peripheral manager
+\param[in]  ops         - power up/down hooks, one entry per PeriphId_t
+\param[in]  poweredMask - peripherals already powered by the start-up code
+*************************************************************************/
+void PERIPH_Init(const PeriphOps_t *ops, uint8_t poweredMask)
+{
+    periphOps = ops;
+    periphPowered = poweredMask & PERIPH_MASK_ALL;
+    memset(periphRefs, 0, sizeof(periphRefs));
+    memset(periphStats, 0, sizeof(periphStats));
+}
+
+/*********************************************************************//**
+\brief      Takes a reference, powering the peripheral up if needed
+\param[in]  id - peripheral to use
+*************************************************************************/
+void PERIPH_Acquire(PeriphId_t id)
+{
+    if (id >= PERIPH_COUNT)
+    {
+        return;
+    }
+
+    if (!(periphPowered & PERIPH_MASK(id)))
+    {
+        if ((NULL != periphOps) && (NULL != periphOps[id].powerUp))
+        {
+            periphOps[id].powerUp();
+        }
+        periphPowered |= PERIPH_MASK(id);
+        periphStats[id].powerUps++;
+    }
+
+    if (periphRefs[id] < UINT8_MAX)
+    {
+        periphRefs[id]++;
+    }
+}
+
+/*********************************************************************//**
+\brief      Drops a reference. The peripheral stays powered until the
+            next PERIPH_PowerDownIdle()
+\param[in]  id - peripheral no longer used
+*************************************************************************/
+void PERIPH_Release(PeriphId_t id)
+{
+    if ((id < PERIPH_COUNT) && (periphRefs[id] > 0))
+    {
+        periphRefs[id]--;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns true if the peripheral is currently powered
+*************************************************************************/
+bool PERIPH_IsPowered(PeriphId_t id)
+{
+    return (id < PERIPH_COUNT) && (periphPowered & PERIPH_MASK(id));
+}
+
+/*********************************************************************//**
+\brief      Powers down every peripheral nobody holds, called before sleep
+*************************************************************************/
+void PERIPH_PowerDownIdle(void)
+{
+    for (uint8_t id = 0; id < PERIPH_COUNT; id++)
+    {
+        if ((0 == periphRefs[id]) && (periphPowered & PERIPH_MASK(id)))
+        {
+            if ((NULL != periphOps) && (NULL != periphOps[id].powerDown))
+            {
+                periphOps[id].powerDown();
+            }
+            periphPowered &= ~PERIPH_MASK(id);
+            periphStats[id].powerDowns++;
+        }
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the power up/down counters of a peripheral
+*************************************************************************/
+const PeriphStats_t *PERIPH_GetStats(PeriphId_t id)
+{
+    return (id < PERIPH_COUNT) ? &periphStats[id] : NULL;
+}
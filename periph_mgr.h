@@ -0,0 +1,51 @@
+/**
+* \file  periph_mgr.h
+*
+* \brief Reference counted power management of the application peripherals
+*
+* A peripheral is powered up by its first user and is only powered down
+* by PERIPH_PowerDownIdle() before sleep, once nobody holds it any more.
+* Wakeups that only sample then never touch the radio or the UART.
+*/
+
+#ifndef PERIPH_MGR_H_
+#define PERIPH_MGR_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** TYPES **************************************/
+typedef enum _PeriphId_t
+{
+    PERIPH_RADIO = 0,
+    PERIPH_UART,
+    PERIPH_ADC,
+    PERIPH_COUNT
+} PeriphId_t;
+
+typedef struct _PeriphOps_t
+{
+    void (*powerUp)(void);
+    void (*powerDown)(void);
+} PeriphOps_t;
+
+typedef struct _PeriphStats_t
+{
+    uint32_t powerUps;
+    uint32_t powerDowns;
+} PeriphStats_t;
+
+/****************************** MACROS **************************************/
+#define PERIPH_MASK(id)                     (1u << (id))
+#define PERIPH_MASK_ALL                     ((1u << PERIPH_COUNT) - 1u)
+
+/****************************** PROTOTYPES **************************************/
+void PERIPH_Init(const PeriphOps_t *ops, uint8_t poweredMask);
+void PERIPH_Acquire(PeriphId_t id);
+void PERIPH_Release(PeriphId_t id);
+bool PERIPH_IsPowered(PeriphId_t id);
+void PERIPH_PowerDownIdle(void);
+const PeriphStats_t *PERIPH_GetStats(PeriphId_t id);
+
+#endif /* PERIPH_MGR_H_ */
@@ -0,0 +1,236 @@
+/**
+* \file  session_cache.c
+*
+* \brief Last session of every regional band, kept in the application flash
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "session_cache.h"
+#include "cfg_store.h"
+
+/******************************** MACROS ***************************************/
+#define SESSION_CACHE_MAGIC                 0x5E55u
+#define SESSION_CACHE_HEADER_LENGTH         4u
+#define SESSION_CACHE_RECORD_LENGTH         (SESSION_CACHE_HEADER_LENGTH + sizeof(SessionCacheEntry_t) + 2u)
+#define SESSION_CACHE_NO_ROW                0xFFu
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const AppNvmOps_t *cacheNvm = NULL;
+static uint32_t cacheNvmOffset = 0;
+static bool cacheProbation = false;
+static uint8_t cacheProbationBand = 0;
+static uint8_t cacheProbationFailures = 0;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* A session the stack can use: a DevAddr and keys that are not blank */
+static bool session_cache_usable(const SessionCacheEntry_t *entry)
+{
+    uint8_t nwkOr = 0;
+    uint8_t nwkAnd = 0xFF;
+    uint8_t appOr = 0;
+    uint8_t appAnd = 0xFF;
+
+    for (uint8_t i = 0; i < SESSION_CACHE_KEY_LENGTH; i++)
+    {
+        nwkOr |= entry->nwkSKey[i];
+        nwkAnd &= entry->nwkSKey[i];
+        appOr |= entry->appSKey[i];
+        appAnd &= entry->appSKey[i];
+    }
+    return (0u != entry->devAddr) && (UINT32_MAX != entry->devAddr) && (0u != nwkOr) && (0xFFu != nwkAnd) &&
+           (0u != appOr) && (0xFFu != appAnd);
+}
+
+/* Reads the entry of a row, returns false for an empty, corrupted or unusable row */
+static bool session_cache_read(uint8_t row, SessionCacheEntry_t *entry, uint16_t *sequence)
+{
+    uint8_t record[SESSION_CACHE_RECORD_LENGTH];
+    const uint16_t crcOffset = SESSION_CACHE_RECORD_LENGTH - 2u;
+
+    if ((NULL == cacheNvm) ||
+        !cacheNvm->read(cacheNvmOffset + row * APP_NVM_ROW_SIZE, record, sizeof(record)) ||
+        (SESSION_CACHE_MAGIC != (uint16_t)(record[0] | (record[1] << 8))) ||
+        (CFG_STORE_Crc16(record, crcOffset) != (uint16_t)(record[crcOffset] | (record[crcOffset + 1u] << 8))))
+    {
+        return false;
+    }
+
+    *sequence = (uint16_t)(record[2] | (record[3] << 8));
+    memcpy(entry, &record[SESSION_CACHE_HEADER_LENGTH], sizeof(*entry));
+    return session_cache_usable(entry);
+}
+
+/* Row holding a band, SESSION_CACHE_NO_ROW if none */
+static uint8_t session_cache_row_of(uint8_t band, SessionCacheEntry_t *entry)
+{
+    SessionCacheEntry_t candidate;
+    uint16_t sequence;
+
+    for (uint8_t row = 0; row < SESSION_CACHE_ENTRIES; row++)
+    {
+        if (session_cache_read(row, &candidate, &sequence) && (candidate.band == band))
+        {
+            if (NULL != entry)
+            {
+                *entry = candidate;
+            }
+            return row;
+        }
+    }
+    return SESSION_CACHE_NO_ROW;
+}
+
+/*********************************************************************//**
+\brief      Initializes the cache
+\param[in]  nvm       - storage of the entries
+\param[in]  nvmOffset - row aligned start of SESSION_CACHE_NVM_SIZE bytes
+*************************************************************************/
+void SESSION_CACHE_Init(const AppNvmOps_t *nvm, uint32_t nvmOffset)
+{
+    cacheNvm = nvm;
+    cacheNvmOffset = nvmOffset;
+    cacheProbation = false;
+    cacheProbationFailures = 0;
+}
+
+/*********************************************************************//**
+\brief      Stores the session of a band, replacing the entry of the same
+            band or else the least recently stored one
+\param[in]  entry - session to keep
+\return     false if the session is blank or the flash could not be written
+*************************************************************************/
+bool SESSION_CACHE_Store(const SessionCacheEntry_t *entry)
+{
+    uint8_t record[SESSION_CACHE_RECORD_LENGTH];
+    const uint16_t crcOffset = SESSION_CACHE_RECORD_LENGTH - 2u;
+    SessionCacheEntry_t other;
+    uint16_t sequence;
+    uint16_t newest = 0;
+    uint16_t oldest = 0;
+    uint8_t target = session_cache_row_of(entry->band, NULL);
+    uint8_t empty = SESSION_CACHE_NO_ROW;
+    uint8_t leastRecent = 0;
+    bool any = false;
+
+    if ((NULL == cacheNvm) || !session_cache_usable(entry))
+    {
+        return false;
+    }
+
+    for (uint8_t row = 0; row < SESSION_CACHE_ENTRIES; row++)
+    {
+        if (!session_cache_read(row, &other, &sequence))
+        {
+            if (SESSION_CACHE_NO_ROW == empty)
+            {
+                empty = row;
+            }
+            continue;
+        }
+        if (!any || ((int16_t)(sequence - newest) > 0))
+        {
+            newest = sequence;
+        }
+        if (!any || ((int16_t)(sequence - oldest) < 0))
+        {
+            oldest = sequence;
+            leastRecent = row;
+        }
+        any = true;
+    }
+    if (SESSION_CACHE_NO_ROW == target)
+    {
+        target = (SESSION_CACHE_NO_ROW != empty) ? empty : leastRecent;
+    }
+
+    sequence = (uint16_t)(newest + 1u);
+    record[0] = (uint8_t)SESSION_CACHE_MAGIC;
+    record[1] = (uint8_t)(SESSION_CACHE_MAGIC >> 8);
+    record[2] = (uint8_t)sequence;
+    record[3] = (uint8_t)(sequence >> 8);
+    memcpy(&record[SESSION_CACHE_HEADER_LENGTH], entry, sizeof(*entry));
+    sequence = CFG_STORE_Crc16(record, crcOffset);
+    record[crcOffset] = (uint8_t)sequence;
+    record[crcOffset + 1u] = (uint8_t)(sequence >> 8);
+
+    return cacheNvm->erase(cacheNvmOffset + target * APP_NVM_ROW_SIZE, APP_NVM_ROW_SIZE) &&
+           cacheNvm->write(cacheNvmOffset + target * APP_NVM_ROW_SIZE, record, sizeof(record));
+}
+
+/*********************************************************************//**
+\brief      Looks the session of a band up
+\param[in]  band  - IsmBand_t
+\param[out] entry - stored session, untouched if none
+\return     false if the band has no valid entry: missing, corrupted, or
+            with a blank DevAddr or key
+*************************************************************************/
+bool SESSION_CACHE_Find(uint8_t band, SessionCacheEntry_t *entry)
+{
+    return SESSION_CACHE_NO_ROW != session_cache_row_of(band, entry);
+}
+
+/*********************************************************************//**
+\brief      Discards the session of a band
+\param[in]  band - IsmBand_t
+*************************************************************************/
+void SESSION_CACHE_Invalidate(uint8_t band)
+{
+    uint8_t row = session_cache_row_of(band, NULL);
+
+    if (SESSION_CACHE_NO_ROW != row)
+    {
+        cacheNvm->erase(cacheNvmOffset + row * APP_NVM_ROW_SIZE, APP_NVM_ROW_SIZE);
+    }
+}
+
+/*********************************************************************//**
+\brief      Puts the session just restored for a band on probation
+\param[in]  band - IsmBand_t
+*************************************************************************/
+void SESSION_CACHE_Restored(uint8_t band)
+{
+    cacheProbation = true;
+    cacheProbationBand = band;
+    cacheProbationFailures = 0;
+}
+
+/*********************************************************************//**
+\brief      Returns true while uplinks should be confirmed to check a
+            restored session
+*************************************************************************/
+bool SESSION_CACHE_InProbation(void)
+{
+    return cacheProbation;
+}
+
+/*********************************************************************//**
+\brief      Takes the outcome of a transaction into account
+\param[in]  confirmed    - the uplink asked for an acknowledgment
+\param[in]  acknowledged - the network acknowledged or answered it
+\return     verdict on the restored session, the entry is discarded when
+            the session is rejected
+*************************************************************************/
+SessionCacheVerdict_t SESSION_CACHE_OnResult(bool confirmed, bool acknowledged)
+{
+    if (!cacheProbation)
+    {
+        return SESSION_CACHE_NONE;
+    }
+
+    if (acknowledged)
+    {
+        cacheProbation = false;
+        return SESSION_CACHE_ACCEPTED;
+    }
+    if (confirmed && (++cacheProbationFailures >= SESSION_CACHE_PROBATION_FAILURES))
+    {
+        cacheProbation = false;
+        SESSION_CACHE_Invalidate(cacheProbationBand);
+        return SESSION_CACHE_REJECTED;
+    }
+    return SESSION_CACHE_PROBATION;
+}
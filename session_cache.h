@@ -0,0 +1,65 @@
+/**
+* \file  session_cache.h
+*
+* \brief Last session of every regional band, kept in the application flash
+*
+* When the device leaves a band its session (DevAddr, session keys and
+* frame counters) is stored, one flash row per band. Coming back to the
+* band restores it without a join transmission. A restored session is on
+* probation until the network acknowledges a confirmed uplink; repeated
+* failures mean the network dropped it, the entry is then discarded and
+* the device joins again. Entries with a blank DevAddr or key are neither
+* stored nor returned.
+* The module addresses the flash through AppNvmOps_t and also builds on
+* a host.
+*/
+
+#ifndef SESSION_CACHE_H_
+#define SESSION_CACHE_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_nvm.h"
+
+/****************************** MACROS **************************************/
+/* Number of bands kept, one row each */
+#define SESSION_CACHE_ENTRIES               4u
+#define SESSION_CACHE_NVM_SIZE              (SESSION_CACHE_ENTRIES * APP_NVM_ROW_SIZE)
+/* Confirmed uplinks without acknowledgment that reject a restored session */
+#define SESSION_CACHE_PROBATION_FAILURES    3u
+#define SESSION_CACHE_KEY_LENGTH            16u
+
+/****************************** TYPES **************************************/
+typedef struct _SessionCacheEntry_t
+{
+    uint32_t devAddr;
+    uint32_t fCntUp;
+    uint32_t fCntDown;
+    uint8_t nwkSKey[SESSION_CACHE_KEY_LENGTH];
+    uint8_t appSKey[SESSION_CACHE_KEY_LENGTH];
+    /* IsmBand_t */
+    uint8_t band;
+} SessionCacheEntry_t;
+
+typedef enum _SessionCacheVerdict_t
+{
+    /* No restored session under probation */
+    SESSION_CACHE_NONE = 0,
+    SESSION_CACHE_PROBATION,
+    /* The network acknowledged the restored session */
+    SESSION_CACHE_ACCEPTED,
+    /* The network does not know the session, join again */
+    SESSION_CACHE_REJECTED
+} SessionCacheVerdict_t;
+
+/****************************** PROTOTYPES **************************************/
+void SESSION_CACHE_Init(const AppNvmOps_t *nvm, uint32_t nvmOffset);
+bool SESSION_CACHE_Store(const SessionCacheEntry_t *entry);
+bool SESSION_CACHE_Find(uint8_t band, SessionCacheEntry_t *entry);
+void SESSION_CACHE_Invalidate(uint8_t band);
+void SESSION_CACHE_Restored(uint8_t band);
+bool SESSION_CACHE_InProbation(void);
+SessionCacheVerdict_t SESSION_CACHE_OnResult(bool confirmed, bool acknowledged);
+
+#endif /* SESSION_CACHE_H_ */
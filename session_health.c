@@ -0,0 +1,216 @@
+/**
+* \file  session_health.c
+*
+* \brief Detection of a lost session and pacing of the rejoins
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "session_health.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint8_t healthNoAckLimit;
+static uint32_t healthRetryMinMs;
+static uint32_t healthRetryMaxMs;
+static uint32_t healthBackoffMs;
+static bool healthOnline = false;
+/* Offline since a loss, as opposed to not joined yet */
+static bool healthOutage = false;
+static uint64_t healthOfflineSinceMs = 0;
+/* A rejoin is to be attempted from healthNextAttemptMs */
+static bool healthArmed = false;
+static uint64_t healthNextAttemptMs = 0;
+static SessionHealthStats_t healthStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Initializes the monitor, the device is not joined yet
+\param[in]  noAckLimit - consecutive confirmed uplinks without
+                         acknowledgment that mean the session is lost,
+                         0 never does
+\param[in]  retryMinMs - delay after the first failed rejoin, doubled by
+                         every further failure
+\param[in]  retryMaxMs - longest delay between two rejoins
+*************************************************************************/
+void SESSION_HEALTH_Init(uint8_t noAckLimit, uint32_t retryMinMs, uint32_t retryMaxMs)
+{
+    healthNoAckLimit = noAckLimit;
+    healthRetryMinMs = retryMinMs;
+    healthRetryMaxMs = (retryMaxMs > retryMinMs) ? retryMaxMs : retryMinMs;
+    healthBackoffMs = healthRetryMinMs;
+    healthOnline = false;
+    healthOutage = false;
+    healthArmed = false;
+    memset(&healthStats, 0, sizeof(healthStats));
+}
+
+/*********************************************************************//**
+\brief      Maps the status of a send or of a transaction to the event of
+            the monitor
+\param[in]  status    - status returned or reported by the stack
+\param[in]  confirmed - the frame asked for an acknowledgment, only then
+                        NO_ACK counts
+\return     event to pass to SESSION_HEALTH_OnEvent(), SESSION_HEALTH_NO_EVENT
+            for a status that says nothing about the session
+*************************************************************************/
+SessionHealthEvent_t SESSION_HEALTH_EventOf(StackRetStatus_t status, bool confirmed)
+{
+    switch (status)
+    {
+        case LORAWAN_SUCCESS:
+        case LORAWAN_RADIO_SUCCESS:
+            return SESSION_HEALTH_TX_OK;
+        case LORAWAN_NO_ACK:
+            return confirmed ? SESSION_HEALTH_TX_NO_ACK : SESSION_HEALTH_NO_EVENT;
+        case LORAWAN_NWK_NOT_JOINED:
+            return SESSION_HEALTH_NOT_JOINED;
+        case LORAWAN_FCNTR_ERROR_REJOIN_NEEDED:
+            return SESSION_HEALTH_FCNT_EXHAUSTED;
+        default:
+            return SESSION_HEALTH_NO_EVENT;
+    }
+}
+
+/*********************************************************************//**
+\brief      Takes the outcome of an uplink or a session check into account
+\param[in]  event - outcome
+\param[in]  nowMs - uptime
+\return     true if the session was just declared lost, the caller keeps
+            the pending data and rejoins right away
+*************************************************************************/
+bool SESSION_HEALTH_OnEvent(SessionHealthEvent_t event, uint64_t nowMs)
+{
+    switch (event)
+    {
+        case SESSION_HEALTH_TX_OK:
+            healthStats.noAckRun = 0;
+            return false;
+
+        case SESSION_HEALTH_TX_NO_ACK:
+            if (healthStats.noAckRun < UINT8_MAX)
+            {
+                healthStats.noAckRun++;
+            }
+            if ((0 == healthNoAckLimit) || (healthStats.noAckRun < healthNoAckLimit))
+            {
+                return false;
+            }
+            break;
+
+        case SESSION_HEALTH_NO_EVENT:
+            return false;
+
+        default:
+            break;
+    }
+
+    /* A loss already being recovered is not counted again */
+    if (!healthOnline)
+    {
+        return false;
+    }
+
+    healthOnline = false;
+    healthOutage = true;
+    healthOfflineSinceMs = nowMs;
+    healthStats.lastCause = (uint8_t)event;
+    healthStats.noAckRun = 0;
+    if (healthStats.outages < UINT16_MAX)
+    {
+        healthStats.outages++;
+    }
+    healthBackoffMs = healthRetryMinMs;
+    healthArmed = true;
+    healthNextAttemptMs = nowMs;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Takes the result of a join into account
+\param[in]  success - the device is joined
+\param[in]  nowMs   - uptime
+*************************************************************************/
+void SESSION_HEALTH_OnJoin(bool success, uint64_t nowMs)
+{
+    uint64_t offlineMs;
+
+    if (!success)
+    {
+        healthOnline = false;
+        healthArmed = true;
+        healthNextAttemptMs = nowMs + healthBackoffMs;
+        healthBackoffMs = ((healthBackoffMs * 2u) < healthRetryMaxMs) ? (healthBackoffMs * 2u) : healthRetryMaxMs;
+        return;
+    }
+
+    if (healthOutage)
+    {
+        offlineMs = nowMs - healthOfflineSinceMs;
+        healthStats.lastOfflineMs = (offlineMs > UINT32_MAX) ? UINT32_MAX : (uint32_t)offlineMs;
+        if (healthStats.lastOfflineMs > healthStats.longestOfflineMs)
+        {
+            healthStats.longestOfflineMs = healthStats.lastOfflineMs;
+        }
+        healthStats.totalOfflineMs = ((UINT32_MAX - healthStats.totalOfflineMs) > healthStats.lastOfflineMs) ?
+                                     (healthStats.totalOfflineMs + healthStats.lastOfflineMs) : UINT32_MAX;
+        healthOutage = false;
+    }
+    healthOnline = true;
+    healthArmed = false;
+    healthBackoffMs = healthRetryMinMs;
+    healthStats.noAckRun = 0;
+}
+
+/*********************************************************************//**
+\brief      Returns true when a rejoin is to be attempted
+\param[in]  nowMs - uptime
+*************************************************************************/
+bool SESSION_HEALTH_RejoinDue(uint64_t nowMs)
+{
+    return healthArmed && !healthOnline && (nowMs >= healthNextAttemptMs);
+}
+
+/*********************************************************************//**
+\brief      Called when a rejoin starts, the next one waits for its result
+*************************************************************************/
+void SESSION_HEALTH_Rejoining(void)
+{
+    healthArmed = false;
+    if (healthStats.rejoins < UINT16_MAX)
+    {
+        healthStats.rejoins++;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns true while the session is usable
+*************************************************************************/
+bool SESSION_HEALTH_IsOnline(void)
+{
+    return healthOnline;
+}
+
+/*********************************************************************//**
+\brief      Returns the duration of the ongoing outage, 0 if none
+\param[in]  nowMs - uptime
+*************************************************************************/
+uint32_t SESSION_HEALTH_OfflineMs(uint64_t nowMs)
+{
+    uint64_t offlineMs = nowMs - healthOfflineSinceMs;
+
+    if (!healthOutage)
+    {
+        return 0;
+    }
+    return (offlineMs > UINT32_MAX) ? UINT32_MAX : (uint32_t)offlineMs;
+}
+
+/*********************************************************************//**
+\brief      Returns the outage and rejoin counters
+*************************************************************************/
+const SessionHealthStats_t *SESSION_HEALTH_GetStats(void)
+{
+    return &healthStats;
+}
@@ -0,0 +1,68 @@
+/**
+* \file  session_health.h
+*
+* \brief Detection of a lost session and pacing of the rejoins
+*
+* The session is declared lost when the stack refuses a frame because the
+* device is not joined or the frame counter is exhausted, or after a run
+* of confirmed uplinks without acknowledgment. A loss asks for an
+* immediate rejoin; failed joins are retried with an exponential backoff
+* so that a device out of coverage does not drain its battery. The time
+* spent offline is accounted from the loss to the next successful join.
+* The module does not touch the hardware and also builds on a host, with
+* the stack status codes of the host stand-in when APP_HOST_BUILD is
+* defined.
+*/
+
+#ifndef SESSION_HEALTH_H_
+#define SESSION_HEALTH_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef APP_HOST_BUILD
+#include "stack_status.h"
+#else
+#include "lorawan.h"
+#endif
+
+/****************************** TYPES **************************************/
+typedef enum _SessionHealthEvent_t
+{
+    /* Frame sent, acknowledged if it was confirmed */
+    SESSION_HEALTH_TX_OK = 0,
+    /* Confirmed frame without acknowledgment */
+    SESSION_HEALTH_TX_NO_ACK,
+    /* NWK_NOT_JOINED or FCNTR_ERROR_REJOIN_NEEDED */
+    SESSION_HEALTH_NOT_JOINED,
+    SESSION_HEALTH_FCNT_EXHAUSTED,
+    /* The network rejected a restored session */
+    SESSION_HEALTH_REJECTED,
+    /* Status that says nothing about the session */
+    SESSION_HEALTH_NO_EVENT
+} SessionHealthEvent_t;
+
+typedef struct _SessionHealthStats_t
+{
+    uint16_t outages;
+    uint16_t rejoins;
+    /* Event that caused the last outage */
+    uint8_t lastCause;
+    uint8_t noAckRun;
+    uint32_t lastOfflineMs;
+    uint32_t longestOfflineMs;
+    uint32_t totalOfflineMs;
+} SessionHealthStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void SESSION_HEALTH_Init(uint8_t noAckLimit, uint32_t retryMinMs, uint32_t retryMaxMs);
+SessionHealthEvent_t SESSION_HEALTH_EventOf(StackRetStatus_t status, bool confirmed);
+bool SESSION_HEALTH_OnEvent(SessionHealthEvent_t event, uint64_t nowMs);
+void SESSION_HEALTH_OnJoin(bool success, uint64_t nowMs);
+bool SESSION_HEALTH_RejoinDue(uint64_t nowMs);
+void SESSION_HEALTH_Rejoining(void);
+bool SESSION_HEALTH_IsOnline(void);
+uint32_t SESSION_HEALTH_OfflineMs(uint64_t nowMs);
+const SessionHealthStats_t *SESSION_HEALTH_GetStats(void);
+
+#endif /* SESSION_HEALTH_H_ */
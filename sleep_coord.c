@@ -0,0 +1,125 @@
+/**
+* \file  sleep_coord.c
+*
+* \brief Sleep coordinator of the application
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "sleep_coord.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const SleepCoordOps_t *sleepOps = NULL;
+static SleepCoordStats_t sleepStats;
+static volatile bool sleepPending = false;
+static volatile bool checkReady = false;
+static uint32_t pendingSleepTimeMs = 0;
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Initializes the sleep coordinator
+\param[in]  ops - platform hooks used to query the stack and to sleep
+*************************************************************************/
+void SLEEP_COORD_Init(const SleepCoordOps_t *ops)
+{
+    sleepOps = ops;
+    sleepPending = false;
+    checkReady = false;
+    pendingSleepTimeMs = 0;
+    memset(&sleepStats, 0, sizeof(sleepStats));
+}
+
+/*********************************************************************//**
+\brief      Requests a deep sleep as soon as the stack allows it
+\param[in]  sleepTimeMs - requested deep sleep duration
+*************************************************************************/
+void SLEEP_COORD_Request(uint32_t sleepTimeMs)
+{
+    pendingSleepTimeMs = sleepTimeMs;
+    sleepPending = true;
+    checkReady = true;
+}
+
+/*********************************************************************//**
+\brief      Drops a pending deep sleep request
+*************************************************************************/
+void SLEEP_COORD_Cancel(void)
+{
+    sleepPending = false;
+}
+
+/*********************************************************************//**
+\brief      Tells the coordinator that the stack may have become sleep ready
+*************************************************************************/
+void SLEEP_COORD_Notify(void)
+{
+    checkReady = true;
+}
+
+/*********************************************************************//**
+\brief      Returns true while a deep sleep request is waiting
+*************************************************************************/
+bool SLEEP_COORD_IsPending(void)
+{
+    return sleepPending;
+}
+
+/*********************************************************************//**
+\brief      Called from the main loop once all the posted tasks have run.
+            Enters the pending deep sleep when the stack is ready, else
+            waits in idle sleep until the next interrupt.
+*************************************************************************/
+void SLEEP_COORD_Idle(void)
+{
+    uint32_t nextMs;
+
+    if (NULL == sleepOps)
+    {
+        return;
+    }
+
+    sleepStats.loopIterations++;
+
+    if (sleepPending && checkReady)
+    {
+        checkReady = false;
+        sleepStats.readyChecks++;
+
+        if (sleepOps->stackReadyToSleep())
+        {
+            sleepPending = false;
+            if (sleepOps->deepSleep(pendingSleepTimeMs))
+            {
+                sleepStats.deepSleeps++;
+                return;
+            }
+            sleepStats.deepSleepDenied++;
+            sleepPending = true;
+        }
+    }
+
+    nextMs = sleepOps->nextActivityMs();
+    if (0 == nextMs)
+    {
+        /* Stack work is already due, let the task loop run it */
+        checkReady = true;
+        return;
+    }
+
+    sleepStats.idleSleeps++;
+    sleepOps->idleSleep(nextMs);
+
+    /* The interrupt that ended the idle sleep may have changed the stack state */
+    checkReady = true;
+}
+
+/*********************************************************************//**
+\brief      Returns the loop and sleep counters
+*************************************************************************/
+const SleepCoordStats_t *SLEEP_COORD_GetStats(void)
+{
+    return &sleepStats;
+}
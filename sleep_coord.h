@@ -0,0 +1,49 @@
+/**
+* \file  sleep_coord.h
+*
+* \brief Sleep coordinator of the application
+*
+* Holds a pending deep sleep request until the LoRaWAN stack is ready for
+* it. In the meantime the CPU waits in a shallow idle sleep instead of
+* spinning through the task loop.
+*/
+
+#ifndef SLEEP_COORD_H_
+#define SLEEP_COORD_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** TYPES **************************************/
+typedef struct _SleepCoordOps_t
+{
+    /* Returns true when the stack allows a deep sleep */
+    bool (*stackReadyToSleep)(void);
+    /* Time in ms until the stack needs the CPU again */
+    uint32_t (*nextActivityMs)(void);
+    /* Enters deep sleep, returns false when the request was denied */
+    bool (*deepSleep)(uint32_t sleepTimeMs);
+    /* Halts the CPU until the next interrupt, at most maxTimeMs */
+    void (*idleSleep)(uint32_t maxTimeMs);
+} SleepCoordOps_t;
+
+typedef struct _SleepCoordStats_t
+{
+    uint32_t loopIterations;
+    uint32_t readyChecks;
+    uint32_t idleSleeps;
+    uint32_t deepSleeps;
+    uint32_t deepSleepDenied;
+} SleepCoordStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void SLEEP_COORD_Init(const SleepCoordOps_t *ops);
+void SLEEP_COORD_Request(uint32_t sleepTimeMs);
+void SLEEP_COORD_Cancel(void);
+void SLEEP_COORD_Notify(void);
+bool SLEEP_COORD_IsPending(void);
+void SLEEP_COORD_Idle(void);
+const SleepCoordStats_t *SLEEP_COORD_GetStats(void);
+
+#endif /* SLEEP_COORD_H_ */
@@ -0,0 +1,167 @@
+/**
+* \file  bench.c
+*
+* \brief Timing and CPU counters of the host benchmarks
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "bench.h"
+
+/****************************** MACROS **************************************/
+/* Untimed runs before the measurement */
+#define BENCH_WARMUP_DIVIDER                10u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static int benchCycles = -1;
+static int benchInstructions = -1;
+
+/***************************** FUNCTIONS ***************************************/
+
+static int bench_counter_open(uint64_t config, int group)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = (group < 0) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static int64_t bench_counter_read(int fd)
+{
+    uint64_t value;
+
+    if ((fd < 0) || (read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value)))
+    {
+        return -1;
+    }
+    return (int64_t)value;
+}
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*********************************************************************//**
+\brief      Opens the CPU counters, the measurements fall back to the
+            wall time alone when they are not available
+*************************************************************************/
+void BENCH_Init(void)
+{
+    benchCycles = bench_counter_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+    benchInstructions = bench_counter_open(PERF_COUNT_HW_INSTRUCTIONS, benchCycles);
+    if (benchCycles < 0)
+    {
+        /* Instructions alone, if the cycles are not exposed */
+        benchInstructions = bench_counter_open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    }
+}
+
+/*********************************************************************//**
+\brief      Measures an operation
+\param[in]  op         - operation, called iterations times
+\param[in]  param      - passed to op
+\param[in]  iterations - runs measured
+\param[out] result     - averages per run, -1 for a missing counter
+*************************************************************************/
+void BENCH_Run(BenchOp_t op, void *param, uint32_t iterations, BenchResult_t *result)
+{
+    int leader = (benchCycles >= 0) ? benchCycles : benchInstructions;
+    int64_t cycles;
+    int64_t instructions;
+    uint64_t startNs;
+    uint64_t endNs;
+
+    for (uint32_t i = 0; i < (iterations / BENCH_WARMUP_DIVIDER); i++)
+    {
+        op(param);
+    }
+
+    if (leader >= 0)
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    startNs = bench_now_ns();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        op(param);
+    }
+    endNs = bench_now_ns();
+    if (leader >= 0)
+    {
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    cycles = bench_counter_read(benchCycles);
+    instructions = bench_counter_read(benchInstructions);
+    result->ns = (double)(endNs - startNs) / iterations;
+    result->cycles = (cycles >= 0) ? (double)cycles / iterations : -1.0;
+    result->instructions = (instructions >= 0) ? (double)instructions / iterations : -1.0;
+}
+
+/*********************************************************************//**
+\brief      Prints a result as one JSON object
+\param[in]  bench  - benchmark name
+\param[in]  op     - operation name
+\param[in]  result - measurement
+\param[in]  extra  - further "key":value members, or NULL
+*************************************************************************/
+void BENCH_Print(const char *bench, const char *op, const BenchResult_t *result, const char *extra)
+{
+    printf("{\"bench\":\"%s\",\"op\":\"%s\",\"ns_per_op\":%.1f", bench, op, result->ns);
+    if (result->cycles >= 0.0)
+    {
+        printf(",\"cycles_per_op\":%.1f", result->cycles);
+    }
+    else
+    {
+        printf(",\"cycles_per_op\":null");
+    }
+    if (result->instructions >= 0.0)
+    {
+        printf(",\"instructions_per_op\":%.1f", result->instructions);
+    }
+    else
+    {
+        printf(",\"instructions_per_op\":null");
+    }
+    if (NULL != extra)
+    {
+        printf(",%s", extra);
+    }
+    printf("}\n");
+}
+
+/*********************************************************************//**
+\brief      Closes the CPU counters
+*************************************************************************/
+void BENCH_Close(void)
+{
+    if (benchInstructions >= 0)
+    {
+        close(benchInstructions);
+    }
+    if (benchCycles >= 0)
+    {
+        close(benchCycles);
+    }
+    benchCycles = -1;
+    benchInstructions = -1;
+}
@@ -0,0 +1,37 @@
+/**
+* \file  bench.h
+*
+* \brief Timing and CPU counters of the host benchmarks
+*
+* A measurement reports the wall time and, where the kernel allows it, the
+* cycles and instructions counted by perf_event_open() in user space. The
+* counters read -1 when they are not available (perf_event_paranoid above
+* 2, no PMU in a virtual machine). Results are printed one JSON object
+* per line.
+*/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** TYPES **************************************/
+typedef struct _BenchResult_t
+{
+    /* Per operation */
+    double ns;
+    double cycles;
+    double instructions;
+} BenchResult_t;
+
+typedef void (*BenchOp_t)(void *param);
+
+/****************************** PROTOTYPES **************************************/
+void BENCH_Init(void);
+void BENCH_Run(BenchOp_t op, void *param, uint32_t iterations, BenchResult_t *result);
+void BENCH_Print(const char *bench, const char *op, const BenchResult_t *result, const char *extra);
+void BENCH_Close(void);
+
+#endif /* BENCH_H_ */
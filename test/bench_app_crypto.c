@@ -0,0 +1,129 @@
+/**
+* \file  bench_app_crypto.c
+*
+* \brief Cost of the application payload encryption on the software
+*        cipher: time, cycles and bytes per cycle on the host, and the
+*        energy per frame on the device estimated from it
+*
+* The device cycles are estimated: from the host instruction count of a
+* frame scaled by BENCH_TARGET_CYCLES_PER_INSN when the CPU counters are
+* available, Thumb code of the Cortex-M0+ taking more instructions and
+* cycles than x86-64 for the same C, else from the AES blocks of the frame
+* times BENCH_TARGET_CYCLES_PER_BLOCK, counted from the code: about 11 GF
+* multiplications of 8 steps per S-box, 16 S-boxes and 16 multiplications
+* per round. Override both with -D once measured on the board. The energy
+* follows the clock policy model, with the crypto phase at the divider of
+* DEMO_APP_CLOCK_SHIFTS.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "app_crypto.h"
+#include "clock_policy.h"
+#include "conf_app.h"
+
+/****************************** MACROS **************************************/
+#define BENCH_ITERATIONS                    2000u
+
+#ifndef BENCH_TARGET_CYCLES_PER_INSN
+#define BENCH_TARGET_CYCLES_PER_INSN        2.0
+#endif
+#ifndef BENCH_TARGET_CYCLES_PER_BLOCK
+#define BENCH_TARGET_CYCLES_PER_BLOCK       180000.0
+#endif
+
+/****************************** TYPES **************************************/
+typedef struct _BenchFrame_t
+{
+    uint8_t length;
+    uint32_t fCnt;
+    uint8_t buffer[64];
+} BenchFrame_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* SAM R34 at 48 MHz and 3.3 V, typical currents of the datasheet */
+static const ClockPowerModel_t benchPowerModel = { 48000000u, 3300u, 100u, 40u, 5u };
+
+/* Bench keys, a device holds the ones derived for its DevEUI */
+static const uint8_t benchEncKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x5A, 0x1C, 0x93, 0x07, 0xE2, 0x4B, 0xD8, 0x61, 0x3F, 0xA6, 0x0D, 0x72, 0xC5, 0x19, 0x8E, 0x34
+};
+static const uint8_t benchMacKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x83, 0xD4, 0x2E, 0x6B, 0x17, 0xF0, 0x59, 0xAC, 0x46, 0x0B, 0xE7, 0x92, 0x3D, 0xC8, 0x75, 0x1A
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+static void bench_seal(void *param)
+{
+    BenchFrame_t *frame = param;
+
+    APP_CRYPTO_Seal(frame->buffer, frame->length, sizeof(frame->buffer), APP_CRYPTO_UPLINK, 0x260B1234u, 1,
+                    frame->fCnt++);
+}
+
+static void bench_block(void *param)
+{
+    APP_CRYPTO_Encrypt(benchEncKey, param);
+}
+
+/* AES blocks of a frame: key stream, CMAC prefix, data and subkey */
+static uint32_t bench_blocks(uint8_t length)
+{
+    return ((length + APP_CRYPTO_BLOCK_LENGTH - 1u) / APP_CRYPTO_BLOCK_LENGTH) +
+           ((APP_CRYPTO_BLOCK_LENGTH + 1u + length + APP_CRYPTO_BLOCK_LENGTH - 1u) / APP_CRYPTO_BLOCK_LENGTH) + 1u;
+}
+
+int main(void)
+{
+    static const ClockPolicy_t policy = { { DEMO_APP_CLOCK_SHIFTS } };
+    static const uint8_t lengths[] = { 11, 24, 32, 51 };
+    uint8_t block[APP_CRYPTO_BLOCK_LENGTH] = { 0 };
+    BenchResult_t result;
+    char extra[256];
+
+    APP_CRYPTO_Init(benchEncKey, benchMacKey, NULL);
+    BENCH_Init();
+
+    /* Key expansion and one block, as APP_CRYPTO_Encrypt() does */
+    BENCH_Run(bench_block, block, BENCH_ITERATIONS, &result);
+    BENCH_Print("app_crypto", "expand_and_encrypt_block", &result, NULL);
+
+    for (uint8_t i = 0; i < sizeof(lengths); i++)
+    {
+        BenchFrame_t frame = { lengths[i], 0, { 0 } };
+        ClockPhaseLoad_t load[CLOCK_PHASE_COUNT];
+        double targetCycles;
+        int written;
+
+        BENCH_Run(bench_seal, &frame, BENCH_ITERATIONS, &result);
+        written = snprintf(extra, sizeof(extra), "\"payload_bytes\":%u,\"aes_blocks\":%lu", lengths[i],
+                           (unsigned long)bench_blocks(lengths[i]));
+        if (result.cycles > 0.0)
+        {
+            written += snprintf(&extra[written], sizeof(extra) - written, ",\"bytes_per_cycle\":%.6f",
+                                lengths[i] / result.cycles);
+        }
+        else
+        {
+            written += snprintf(&extra[written], sizeof(extra) - written, ",\"bytes_per_cycle\":null");
+        }
+        targetCycles = (result.instructions > 0.0) ? (result.instructions * BENCH_TARGET_CYCLES_PER_INSN) :
+                       (bench_blocks(lengths[i]) * BENCH_TARGET_CYCLES_PER_BLOCK);
+        memset(load, 0, sizeof(load));
+        load[CLOCK_PHASE_CRYPTO].cycles = (uint32_t)targetCycles;
+        snprintf(&extra[written], sizeof(extra) - written,
+                 ",\"target_basis\":\"%s\",\"target_cycles_est\":%.0f,\"target_bytes_per_cycle_est\":%.6f,"
+                 "\"target_energy_nj_est\":%llu", (result.instructions > 0.0) ? "instructions" : "aes_blocks",
+                 targetCycles, lengths[i] / targetCycles,
+                 (unsigned long long)CLOCK_POLICY_EstimateNj(&policy, &benchPowerModel, load, NULL));
+        BENCH_Print("app_crypto", "seal", &result, extra);
+    }
+
+    BENCH_Close();
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+* \file  bench_app_paths.c
+*
+* \brief Cost of the per-wakeup paths of the application on the host:
+*        ADC code conversion, reading formatting, print_array(), the
+*        stack status switch and the band lookup
+*
+* The conversion and the formatting are those of adc_scan.c, which replaced
+* calculate_acc() and acc_sensor_value(); the float snprintf() that
+* read_adc() used before is measured next to them. print_array(), the
+* status switch of
+* demo_appdata_callback() and the band lookup of processRunRestoreBand()
+* are those of app_format.c. Their output goes to /dev/null while they are
+* measured, the UART is not.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench.h"
+#include "adc_scan.h"
+#include "adc_window.h"
+#include "app_format.h"
+
+/****************************** MACROS **************************************/
+#define BENCH_ITERATIONS                    200000u
+
+/****************************** TYPES **************************************/
+typedef struct _BenchScan_t
+{
+    AdcScanPlan_t plan;
+    AdcScanCal_t cal;
+    AdcScanResult_t result;
+    uint16_t codes[ADC_SCAN_SIGNAL_COUNT];
+    char str[40];
+} BenchScan_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static volatile float benchValue;
+static volatile uint8_t benchChoice;
+static volatile size_t benchFormatted;
+static int benchStdout = -1;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Sends the application printf() to /dev/null */
+static void bench_mute(void)
+{
+    int null = open("/dev/null", O_WRONLY);
+
+    fflush(stdout);
+    benchStdout = dup(STDOUT_FILENO);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+}
+
+static void bench_unmute(void)
+{
+    fflush(stdout);
+    dup2(benchStdout, STDOUT_FILENO);
+    close(benchStdout);
+}
+
+static void bench_code_to_value(void *param)
+{
+    uint16_t *code = param;
+
+    benchValue = ACC_CODE_TO_VALUE(*code);
+    *code = (uint16_t)((*code + 1u) & ACC_ADC_MAX_CODE);
+}
+
+static void bench_scan_convert(void *param)
+{
+    BenchScan_t *scan = param;
+
+    ADC_SCAN_Convert(&scan->plan, scan->codes, &scan->cal, &scan->result);
+    scan->codes[0] = (uint16_t)((scan->codes[0] + 1u) & ACC_ADC_MAX_CODE);
+}
+
+static void bench_acc_peak(void *param)
+{
+    benchValue = ADC_SCAN_AccPeak(&((BenchScan_t *)param)->result);
+}
+
+static void bench_format_payload(void *param)
+{
+    BenchScan_t *scan = param;
+
+    benchFormatted += (size_t)ADC_SCAN_FormatPayload(&scan->result, scan->str, sizeof(scan->str));
+}
+
+/* read_adc() before the scan: snprintf() with the float printf support */
+static void bench_format_float(void *param)
+{
+    BenchScan_t *scan = param;
+
+    benchFormatted += (size_t)snprintf(scan->str, sizeof(scan->str), "%.1fC\n", scan->result.acc[0]);
+}
+
+static void bench_print_array(void *param)
+{
+    APP_FORMAT_PrintArray(param, 16);
+}
+
+static void bench_print_status(void *param)
+{
+    uint8_t *status = param;
+
+    APP_FORMAT_PrintTxStatus((StackRetStatus_t)*status);
+    *status = (uint8_t)((*status + 1u) % STACK_STATUS_COUNT);
+}
+
+static void bench_find_band(void *param)
+{
+    uint8_t *band = param;
+
+    benchChoice = APP_FORMAT_FindBand(*band);
+    /* Listed and not listed bands in turn */
+    *band = (ISM_EU868 == *band) ? 0x02u : ISM_EU868;
+}
+
+int main(void)
+{
+    static const uint8_t inputs[ADC_SCAN_SIGNAL_COUNT] = { 6, 7, 8, 0x1B, 0x18 };
+    static uint8_t key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                               0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+    BenchScan_t scan = { .cal = { 3300u, 4u, 250, 850, 667, 743 } };
+    BenchResult_t result;
+    uint16_t code = 0;
+    uint8_t status = 0;
+    uint8_t band = ISM_EU868;
+    char extra[64];
+
+    ADC_SCAN_Plan(inputs, &scan.plan);
+    for (uint8_t i = 0; i < scan.plan.count; i++)
+    {
+        scan.codes[i] = (uint16_t)(1000u + 617u * i);
+    }
+    ADC_SCAN_Convert(&scan.plan, scan.codes, &scan.cal, &scan.result);
+    BENCH_Init();
+
+    BENCH_Run(bench_code_to_value, &code, BENCH_ITERATIONS, &result);
+    BENCH_Print("app_paths", "acc_code_to_value", &result, NULL);
+
+    snprintf(extra, sizeof(extra), "\"conversions\":%u", scan.plan.count);
+    BENCH_Run(bench_scan_convert, &scan, BENCH_ITERATIONS, &result);
+    BENCH_Print("app_paths", "scan_convert", &result, extra);
+
+    BENCH_Run(bench_acc_peak, &scan, BENCH_ITERATIONS, &result);
+    BENCH_Print("app_paths", "acc_peak", &result, NULL);
+
+    BENCH_Run(bench_format_payload, &scan, BENCH_ITERATIONS, &result);
+    snprintf(extra, sizeof(extra), "\"length\":%u", (unsigned int)strlen(scan.str));
+    BENCH_Print("app_paths", "format_payload", &result, extra);
+
+    BENCH_Run(bench_format_float, &scan, BENCH_ITERATIONS, &result);
+    snprintf(extra, sizeof(extra), "\"length\":%u", (unsigned int)strlen(scan.str));
+    BENCH_Print("app_paths", "format_float", &result, extra);
+
+    bench_mute();
+    BENCH_Run(bench_print_array, key, BENCH_ITERATIONS, &result);
+    bench_unmute();
+    BENCH_Print("app_paths", "print_array", &result, "\"bytes\":16,\"printf_calls\":18");
+
+    bench_mute();
+    BENCH_Run(bench_print_status, &status, BENCH_ITERATIONS, &result);
+    bench_unmute();
+    snprintf(extra, sizeof(extra), "\"statuses\":%u", (unsigned int)STACK_STATUS_COUNT);
+    BENCH_Print("app_paths", "status_switch", &result, extra);
+
+    BENCH_Run(bench_find_band, &band, BENCH_ITERATIONS, &result);
+    snprintf(extra, sizeof(extra), "\"bands\":%u", (unsigned int)(bandCount - 1u));
+    BENCH_Print("app_paths", "band_lookup", &result, extra);
+
+    BENCH_Close();
+    return 0;
+}
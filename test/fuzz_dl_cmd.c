@@ -0,0 +1,53 @@
+/**
+* \file  fuzz_dl_cmd.c
+*
+* \brief Fuzz harness of the downlink command parser
+*
+* Every input is handled as a command frame. Whatever the frame, the
+* parameters in use must stay a valid set, change only when the frame is
+* accepted, and the acknowledgment must report the frame.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dl_cmd.h"
+
+/***************************** FUNCTIONS ***************************************/
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    AppParams_t before;
+    DlCmdStatus_t status;
+    uint8_t ack[DL_CMD_ACK_LENGTH];
+    uint8_t length = (size > UINT8_MAX) ? UINT8_MAX : (uint8_t)size;
+
+    APP_PARAMS_Init();
+    DL_CMD_AckSent();
+    before = *APP_PARAMS_Get();
+
+    status = DL_CMD_Handle(data, length);
+
+    if (!APP_PARAMS_Validate(APP_PARAMS_Get()))
+    {
+        abort();
+    }
+    if ((DL_CMD_OK != status) && (0 != memcmp(&before, APP_PARAMS_Get(), sizeof(before))))
+    {
+        abort();
+    }
+    if (0 == length)
+    {
+        return 0;
+    }
+    if ((DL_CMD_PeekAck(ack, sizeof(ack)) != DL_CMD_ACK_LENGTH) || (ack[0] != data[0]) ||
+        (ack[1] != (uint8_t)status))
+    {
+        abort();
+    }
+    DL_CMD_TakeClassCWindow();
+    DL_CMD_DiagSent();
+    return 0;
+}
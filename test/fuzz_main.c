@@ -0,0 +1,138 @@
+/**
+* \file  fuzz_main.c
+*
+* \brief Stand-alone driver of the fuzz harnesses, for builds without
+*        libFuzzer
+*
+* Usage: fuzz_<name> [runs] [seed files ...]
+* Runs the seed files, then runs random inputs and random mutations of the
+* seeds through LLVMFuzzerTestOneInput(). Build it with the address and
+* undefined behaviour sanitizers so that a memory error stops the run.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/****************************** MACROS **************************************/
+#define FUZZ_MAX_LENGTH                     512u
+#define FUZZ_MAX_SEEDS                      64u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint8_t fuzzSeeds[FUZZ_MAX_SEEDS][FUZZ_MAX_LENGTH];
+static size_t fuzzSeedLengths[FUZZ_MAX_SEEDS];
+static unsigned fuzzSeedCount = 0;
+static uint64_t fuzzState = 0x2545F4914F6CDD1Dull;
+
+/***************************** FUNCTIONS ***************************************/
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint32_t fuzz_random(void)
+{
+    fuzzState ^= fuzzState << 13;
+    fuzzState ^= fuzzState >> 7;
+    fuzzState ^= fuzzState << 17;
+    return (uint32_t)(fuzzState >> 16);
+}
+
+static void fuzz_load(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+
+    if ((NULL == file) || (fuzzSeedCount >= FUZZ_MAX_SEEDS))
+    {
+        if (NULL != file)
+        {
+            fclose(file);
+        }
+        return;
+    }
+    fuzzSeedLengths[fuzzSeedCount] = fread(fuzzSeeds[fuzzSeedCount], 1, FUZZ_MAX_LENGTH, file);
+    fclose(file);
+    LLVMFuzzerTestOneInput(fuzzSeeds[fuzzSeedCount], fuzzSeedLengths[fuzzSeedCount]);
+    fuzzSeedCount++;
+}
+
+/* Flips, replaces, inserts or removes a few bytes of a seed */
+static size_t fuzz_mutate(uint8_t *input)
+{
+    unsigned seed = fuzz_random() % fuzzSeedCount;
+    size_t length = fuzzSeedLengths[seed];
+    unsigned edits = 1u + fuzz_random() % 4u;
+
+    memcpy(input, fuzzSeeds[seed], length);
+    for (unsigned i = 0; i < edits; i++)
+    {
+        size_t pos = (length > 0) ? (fuzz_random() % length) : 0;
+
+        switch (fuzz_random() % 4u)
+        {
+            case 0:
+                if (length > 0)
+                {
+                    input[pos] ^= (uint8_t)(1u << (fuzz_random() % 8u));
+                }
+                break;
+            case 1:
+                if (length > 0)
+                {
+                    input[pos] = (uint8_t)fuzz_random();
+                }
+                break;
+            case 2:
+                if (length < FUZZ_MAX_LENGTH)
+                {
+                    memmove(&input[pos + 1], &input[pos], length - pos);
+                    input[pos] = (uint8_t)fuzz_random();
+                    length++;
+                }
+                break;
+            default:
+                if (length > 0)
+                {
+                    memmove(&input[pos], &input[pos + 1], length - pos - 1);
+                    length--;
+                }
+                break;
+        }
+    }
+    return length;
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t input[FUZZ_MAX_LENGTH];
+    unsigned long runs = 100000;
+
+    if (argc > 1)
+    {
+        runs = strtoul(argv[1], NULL, 0);
+    }
+    for (int i = 2; i < argc; i++)
+    {
+        fuzz_load(argv[i]);
+    }
+
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        size_t length;
+
+        if ((fuzzSeedCount > 0) && (fuzz_random() & 1u))
+        {
+            length = fuzz_mutate(input);
+        }
+        else
+        {
+            length = fuzz_random() % 64u;
+            for (size_t i = 0; i < length; i++)
+            {
+                input[i] = (uint8_t)fuzz_random();
+            }
+        }
+        LLVMFuzzerTestOneInput(input, length);
+    }
+    printf("%s: %lu runs, %u seeds\n", argv[0], runs, fuzzSeedCount);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+* \file  nvm_ram.c
+*
+* \brief RAM stand-in of the application flash for the host tests
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "nvm_ram.h"
+
+/************************** FUNCTION PROTOTYPES ********************************/
+static bool nvm_ram_read(uint32_t offset, uint8_t *data, uint16_t length);
+static bool nvm_ram_write(uint32_t offset, const uint8_t *data, uint16_t length);
+static bool nvm_ram_erase(uint32_t offset, uint32_t length);
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const AppNvmOps_t nvmRamOps =
+{
+    nvm_ram_read,
+    nvm_ram_write,
+    nvm_ram_erase
+};
+
+static uint8_t nvmRam[NVM_RAM_SIZE];
+static uint32_t nvmRamCutLeft = NVM_RAM_NO_CUT;
+static bool nvmRamCut = false;
+static NvmRamStats_t nvmRamStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Erases the whole area and returns its operations
+*************************************************************************/
+const AppNvmOps_t *NVM_RAM_Init(void)
+{
+    memset(nvmRam, 0xFF, sizeof(nvmRam));
+    memset(&nvmRamStats, 0, sizeof(nvmRamStats));
+    nvmRamCutLeft = NVM_RAM_NO_CUT;
+    nvmRamCut = false;
+    return &nvmRamOps;
+}
+
+/*********************************************************************//**
+\brief      Cuts the power once bytes more bytes were programmed: the write
+            in progress stops there and every later write or erase fails
+            until the next NVM_RAM_CutAfter()
+\param[in]  bytes - programmed bytes before the cut, NVM_RAM_NO_CUT for none
+*************************************************************************/
+void NVM_RAM_CutAfter(uint32_t bytes)
+{
+    nvmRamCutLeft = bytes;
+    nvmRamCut = false;
+}
+
+/*********************************************************************//**
+\brief      Returns true once the planned power cut happened
+*************************************************************************/
+bool NVM_RAM_PowerCut(void)
+{
+    return nvmRamCut;
+}
+
+/*********************************************************************//**
+\brief      Returns the stored bytes, to inspect or corrupt them
+*************************************************************************/
+uint8_t *NVM_RAM_Data(void)
+{
+    return nvmRam;
+}
+
+/*********************************************************************//**
+\brief      Returns the operation counters
+*************************************************************************/
+const NvmRamStats_t *NVM_RAM_GetStats(void)
+{
+    return &nvmRamStats;
+}
+
+static bool nvm_ram_read(uint32_t offset, uint8_t *data, uint16_t length)
+{
+    if ((offset + length) > NVM_RAM_SIZE)
+    {
+        return false;
+    }
+    memcpy(data, &nvmRam[offset], length);
+    nvmRamStats.reads++;
+    return true;
+}
+
+static bool nvm_ram_write(uint32_t offset, const uint8_t *data, uint16_t length)
+{
+    if (nvmRamCut || ((offset + length) > NVM_RAM_SIZE))
+    {
+        return false;
+    }
+
+    nvmRamStats.writes++;
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (0 == nvmRamCutLeft)
+        {
+            nvmRamCut = true;
+            return false;
+        }
+        if (NVM_RAM_NO_CUT != nvmRamCutLeft)
+        {
+            nvmRamCutLeft--;
+        }
+        if ((nvmRam[offset + i] & data[i]) != data[i])
+        {
+            nvmRamStats.overwrites++;
+        }
+        /* Programming only clears bits */
+        nvmRam[offset + i] &= data[i];
+        nvmRamStats.bytesWritten++;
+    }
+    return true;
+}
+
+static bool nvm_ram_erase(uint32_t offset, uint32_t length)
+{
+    if (nvmRamCut || ((offset % APP_NVM_ROW_SIZE) != 0) || ((length % APP_NVM_ROW_SIZE) != 0) ||
+        ((offset + length) > NVM_RAM_SIZE))
+    {
+        return false;
+    }
+    memset(&nvmRam[offset], 0xFF, length);
+    nvmRamStats.erases++;
+    return true;
+}
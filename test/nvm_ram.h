@@ -0,0 +1,43 @@
+/**
+* \file  nvm_ram.h
+*
+* \brief RAM stand-in of the application flash for the host tests
+*
+* Behaves like the flash behind AppNvmOps_t: erased bytes read 0xFF,
+* programming can only clear bits and erases work on whole rows. A power
+* cut can be injected after a number of programmed bytes.
+*/
+
+#ifndef NVM_RAM_H_
+#define NVM_RAM_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_nvm.h"
+
+/****************************** MACROS **************************************/
+#define NVM_RAM_SIZE                        0x10000u
+
+/* No power cut planned */
+#define NVM_RAM_NO_CUT                      UINT32_MAX
+
+/****************************** TYPES **************************************/
+typedef struct _NvmRamStats_t
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t erases;
+    uint32_t bytesWritten;
+    /* Programmed bytes that tried to set a cleared bit */
+    uint32_t overwrites;
+} NvmRamStats_t;
+
+/****************************** PROTOTYPES **************************************/
+const AppNvmOps_t *NVM_RAM_Init(void);
+void NVM_RAM_CutAfter(uint32_t bytes);
+bool NVM_RAM_PowerCut(void);
+uint8_t *NVM_RAM_Data(void);
+const NvmRamStats_t *NVM_RAM_GetStats(void);
+
+#endif /* NVM_RAM_H_ */
@@ -0,0 +1,218 @@
+/**
+* \file  sim_adc_wake.c
+*
+* \brief Wakeups per day of the polling and the window monitor modes
+*
+* Replays one day of a synthetic accelerometer signal through both wake
+* modes as planned by ADC_WINDOW_Plan(): polling reads the ADC every sample
+* period, the window monitor converts on the RTC event and wakes the CPU
+* on a crossing or for the status reports. An alarm is confirmed by
+* further readings one second apart, as read_adc() does. Prints one CSV
+* line per asset, sample period and mode.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "adc_window.h"
+
+/****************************** MACROS **************************************/
+#define SIM_DAY_MS                          86400000ull
+#define SIM_RTC_HZ                          1024u
+#define SIM_THRESHOLD                       1.0f
+#define SIM_STATUS_PERIODS                  3u
+#define SIM_CONFIRM_COUNT                   5u
+#define SIM_CONFIRM_MS                      1000u
+/* Awake to send a confirmed alarm before the window is armed again */
+#define SIM_ALARM_BUSY_MS                   3000u
+
+/****************************** TYPES **************************************/
+typedef struct _SimAsset_t
+{
+    const char *name;
+    /* Normal level and noise, unit of ACC_CODE_TO_VALUE() */
+    float level;
+    float noise;
+    /* Events of eventMs raising the level by eventLevel */
+    uint16_t eventsPerDay;
+    uint32_t eventMs;
+    float eventLevel;
+} SimAsset_t;
+
+typedef struct _SimResult_t
+{
+    uint32_t wakeups;
+    uint32_t conversions;
+    uint32_t alarms;
+    uint32_t falseAlarms;
+    uint16_t eventsDetected;
+} SimResult_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const SimAsset_t simAssets[] =
+{
+    { "quiet", 0.3f, 0.05f, 4, 60000, 2.0f },
+    { "noisy", 0.8f, 0.15f, 4, 60000, 2.0f },
+    { "transient", 0.3f, 0.05f, 48, 8000, 2.0f }
+};
+
+static const uint32_t simSamplePeriods[] = { 1000, 5000, 30000 };
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Event in progress at tMs, -1 if none */
+static int32_t sim_event(const SimAsset_t *asset, uint64_t tMs)
+{
+    uint64_t spacing = SIM_DAY_MS / asset->eventsPerDay;
+    uint64_t index = tMs / spacing;
+    /* Each event starts somewhere in the first half of its slot */
+    uint64_t startMs = index * spacing + ((index * 7919u * 1000u) % (spacing / 2u));
+
+    return ((tMs >= startMs) && (tMs < (startMs + asset->eventMs))) ? (int32_t)index : -1;
+}
+
+/* Reproducible noise of about one standard deviation, function of the time */
+static float sim_noise(uint64_t tMs)
+{
+    uint64_t x = tMs + 0x9E3779B97F4A7C15ull;
+    float sum = 0.0f;
+
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    /* Sum of 4 uniforms of 16 bits, variance 4/12 */
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        sum += (float)((x >> (16u * i)) & 0xFFFFu) / 65535.0f - 0.5f;
+    }
+    return sum * 1.7320508f;
+}
+
+/* ADC code of the signal at tMs */
+static uint16_t sim_code(const SimAsset_t *asset, uint64_t tMs)
+{
+    float value = asset->level + asset->noise * sim_noise(tMs);
+    float code;
+
+    if (sim_event(asset, tMs) >= 0)
+    {
+        value += asset->eventLevel;
+    }
+    code = value * (float)ACC_ADC_MAX_CODE / ACC_ADC_FULL_SCALE + 0.5f;
+    if (code < 0.0f)
+    {
+        return 0;
+    }
+    return (code > (float)ACC_ADC_MAX_CODE) ? ACC_ADC_MAX_CODE : (uint16_t)code;
+}
+
+/* read_adc() at tMs and its confirmation readings, returns when it is done */
+static uint64_t sim_read(const SimAsset_t *asset, const AdcWakePlan_t *plan, uint64_t tMs, SimResult_t *result,
+                         uint8_t *detected)
+{
+    uint8_t count = 0;
+
+    result->conversions++;
+    while (sim_code(asset, tMs) > plan->windowLimit)
+    {
+        count++;
+        if (count >= SIM_CONFIRM_COUNT)
+        {
+            int32_t event = sim_event(asset, tMs);
+
+            result->alarms++;
+            if (event < 0)
+            {
+                result->falseAlarms++;
+            }
+            else if (!detected[event])
+            {
+                detected[event] = 1;
+                result->eventsDetected++;
+            }
+            return tMs + SIM_ALARM_BUSY_MS;
+        }
+        /* Every confirmation reading is a wakeup of its own */
+        tMs += SIM_CONFIRM_MS;
+        result->wakeups++;
+        result->conversions++;
+    }
+    return tMs;
+}
+
+static void sim_poll(const SimAsset_t *asset, const AdcWakePlan_t *plan, SimResult_t *result, uint8_t *detected)
+{
+    uint64_t tMs = 0;
+
+    while (tMs < SIM_DAY_MS)
+    {
+        result->wakeups++;
+        tMs = sim_read(asset, plan, tMs, result, detected) + plan->sleepTimeMs;
+    }
+}
+
+static void sim_window(const SimAsset_t *asset, const AdcWakePlan_t *plan, SimResult_t *result, uint8_t *detected)
+{
+    uint64_t periodUs = ((uint64_t)8u << plan->rtcEvent) * 1000000u / SIM_RTC_HZ;
+    uint64_t awakeUntilMs = 0;
+    uint64_t timedMs = plan->sleepTimeMs;
+
+    for (uint64_t tUs = 0; tUs < (SIM_DAY_MS * 1000u); tUs += periodUs)
+    {
+        uint64_t tMs = tUs / 1000u;
+
+        while (timedMs <= tMs)
+        {
+            /* Status wakeup, the sleep restarts after it */
+            result->wakeups++;
+            awakeUntilMs = sim_read(asset, plan, timedMs, result, detected);
+            timedMs = awakeUntilMs + plan->sleepTimeMs;
+        }
+
+        /* The comparator converts in standby and is only armed while asleep */
+        result->conversions++;
+        if ((tMs >= awakeUntilMs) && (sim_code(asset, tMs) > plan->windowLimit))
+        {
+            result->wakeups++;
+            awakeUntilMs = sim_read(asset, plan, tMs, result, detected);
+            timedMs = awakeUntilMs + plan->sleepTimeMs;
+        }
+    }
+}
+
+int main(void)
+{
+    printf("asset,sample_ms,mode,wakeups_per_day,conversions_per_day,alarms,false_alarms,events,events_detected\n");
+
+    for (uint8_t a = 0; a < sizeof(simAssets) / sizeof(simAssets[0]); a++)
+    {
+        const SimAsset_t *asset = &simAssets[a];
+
+        for (uint8_t p = 0; p < sizeof(simSamplePeriods) / sizeof(simSamplePeriods[0]); p++)
+        {
+            for (uint8_t m = 0; m < 2; m++)
+            {
+                AdcWakeMode_t mode = m ? ADC_WAKE_MODE_WINDOW : ADC_WAKE_MODE_POLL;
+                SimResult_t result = { 0 };
+                uint8_t detected[256] = { 0 };
+                AdcWakePlan_t plan;
+
+                ADC_WINDOW_Plan(mode, SIM_THRESHOLD, simSamplePeriods[p], SIM_STATUS_PERIODS, SIM_RTC_HZ, &plan);
+                if (ADC_WAKE_MODE_WINDOW == plan.mode)
+                {
+                    sim_window(asset, &plan, &result, detected);
+                }
+                else
+                {
+                    sim_poll(asset, &plan, &result, detected);
+                }
+                printf("%s,%lu,%s,%lu,%lu,%lu,%lu,%u,%u\n", asset->name, (unsigned long)simSamplePeriods[p],
+                       m ? "window" : "poll", (unsigned long)result.wakeups, (unsigned long)result.conversions,
+                       (unsigned long)result.alarms, (unsigned long)result.falseAlarms, asset->eventsPerDay,
+                       result.eventsDetected);
+            }
+        }
+    }
+    return 0;
+}
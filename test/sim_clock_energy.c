@@ -0,0 +1,95 @@
+/**
+* \file  sim_clock_energy.c
+*
+* \brief Energy and duration of every application phase of one wakeup
+*        under several CPU clock policies
+*
+* The load of every phase is estimated from the code: the task loop and
+* the stack servicing in idle, the three ADC conversions of the sample,
+* the formatting and the UART transmission of the log lines, the AES
+* blocks of the payload seal and the SPI transfers of the radio. The
+* energy follows the clock policy model with the currents of the SAM R34
+* datasheet. Prints one CSV line per policy and phase, then the total of
+* the policy per wakeup and per day.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include "clock_policy.h"
+#include "conf_app.h"
+
+/****************************** MACROS **************************************/
+#define SIM_WAKEUPS_PER_DAY                 5760u
+
+/****************************** TYPES **************************************/
+typedef struct _SimPolicy_t
+{
+    const char *name;
+    ClockPolicy_t policy;
+} SimPolicy_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* SAM R34 at 48 MHz and 3.3 V */
+static const ClockPowerModel_t simModel = { 48000000u, 3300u, 100u, 40u, 5u };
+
+/* Work of one wakeup: cycles, then the wait on a peripheral in us */
+static const ClockPhaseLoad_t simLoad[CLOCK_PHASE_COUNT] =
+{
+    /* Task loop passes and stack servicing until the sleep is allowed */
+    { 12000u, 4000u },
+    /* Three conversions of 25 us and their scaling */
+    { 20000u, 76u },
+    /* About 100 characters formatted and sent at 115200 baud */
+    { 150000u, 8700u },
+    /* Four AES blocks of the software cipher */
+    { 720000u, 0 },
+    /* Frame build and the SPI transfers of the transceiver */
+    { 60000u, 3000u }
+};
+
+static const SimPolicy_t simPolicies[] =
+{
+    { "full_speed", { { 0, 0, 0, 0, 0 } } },
+    { "default", { { DEMO_APP_CLOCK_SHIFTS } } },
+    { "all_slow", { { 3, 3, 3, 3, 3 } } },
+    { "aggressive", { { 7, 4, 3, 0, 0 } } }
+};
+
+static const char * const simPhaseNames[CLOCK_PHASE_COUNT] = { "idle", "sample", "log", "crypto", "radio" };
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Duration of a phase in us at its divider */
+static uint64_t sim_phase_us(const ClockPolicy_t *policy, uint8_t phase)
+{
+    uint8_t shift = (policy->shift[phase] > CLOCK_POLICY_MAX_SHIFT) ? CLOCK_POLICY_MAX_SHIFT : policy->shift[phase];
+    uint32_t cpuHz = simModel.mainClockHz >> shift;
+
+    return ((uint64_t)simLoad[phase].cycles * 1000000u + cpuHz - 1u) / cpuHz + simLoad[phase].waitUs;
+}
+
+int main(void)
+{
+    printf("policy,phase,shift,duration_us,energy_nj\n");
+    for (uint8_t p = 0; p < sizeof(simPolicies) / sizeof(simPolicies[0]); p++)
+    {
+        const SimPolicy_t *sim = &simPolicies[p];
+        uint64_t phaseNj[CLOCK_PHASE_COUNT];
+        uint64_t totalNj = CLOCK_POLICY_EstimateNj(&sim->policy, &simModel, simLoad, phaseNj);
+        uint64_t totalUs = 0;
+
+        for (uint8_t phase = 0; phase < CLOCK_PHASE_COUNT; phase++)
+        {
+            uint64_t us = sim_phase_us(&sim->policy, phase);
+
+            totalUs += us;
+            printf("%s,%s,%u,%llu,%llu\n", sim->name, simPhaseNames[phase], sim->policy.shift[phase],
+                   (unsigned long long)us, (unsigned long long)phaseNj[phase]);
+        }
+        printf("%s,total,,%llu,%llu\n", sim->name, (unsigned long long)totalUs, (unsigned long long)totalNj);
+        printf("%s,per_day_mj,,,%llu\n", sim->name,
+               (unsigned long long)((totalNj * SIM_WAKEUPS_PER_DAY) / 1000000u));
+    }
+    return 0;
+}
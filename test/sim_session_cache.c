@@ -0,0 +1,191 @@
+/**
+* \file  sim_session_cache.c
+*
+* \brief Join transmissions of a device moving between bands, with and
+*        without the session cache
+*
+* A device goes back and forth between SIM_BANDS regional bands and sends
+* SIM_UPLINKS_PER_VISIT uplinks in every visit. The simulated stack joins
+* over the air, a join request or accept being lost like any frame, or
+* activates a cached session at once. The simulated network forgets the
+* session of a band with a probability per visit, e.g. after a purge of
+* idle devices: a restored session it does not know is never
+* acknowledged. Confirmed uplinks are acknowledged unless the uplink or
+* the acknowledgment is lost. The application follows enddevice_demo.c:
+* uplinks are confirmed while a restored session is on probation, a
+* rejected session joins again. Prints one CSV line per scenario and mode.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nvm_ram.h"
+#include "session_cache.h"
+
+/****************************** MACROS **************************************/
+#define SIM_CACHE_OFFSET                    0xC200u
+#define SIM_BANDS                           3u
+#define SIM_VISITS                          2000u
+#define SIM_UPLINKS_PER_VISIT               50u
+/* Join requests before the stack backs off, as in LORAWAN_Join() retries */
+#define SIM_JOIN_TRIES                      8u
+
+/****************************** TYPES **************************************/
+typedef struct _SimScenario_t
+{
+    const char *name;
+    /* Frame loss and sessions forgotten per visit, per mille */
+    uint16_t lossPermille;
+    uint16_t forgetPermille;
+} SimScenario_t;
+
+typedef struct _SimResult_t
+{
+    uint32_t joinRequests;
+    uint32_t restores;
+    uint32_t rejections;
+    /* Rejections of a session the network still knew */
+    uint32_t falseRejections;
+    uint32_t confirmedUplinks;
+    /* Uplinks sent on a session the network forgot */
+    uint32_t deadUplinks;
+} SimResult_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const SimScenario_t simScenarios[] =
+{
+    { "clean", 10, 0 },
+    { "lossy", 200, 0 },
+    { "purged", 10, 200 },
+    { "lossy_purged", 200, 200 },
+    { "very_lossy", 400, 50 }
+};
+
+static uint32_t simRandom;
+static uint32_t simDevAddr;
+/* Session the network knows for every band, 0 for none */
+static uint32_t simNetworkSession[SIM_BANDS];
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t sim_random(void)
+{
+    simRandom = simRandom * 1103515245u + 12345u;
+    return simRandom >> 8;
+}
+
+static bool sim_lost(uint16_t permille)
+{
+    return (sim_random() % 1000u) < permille;
+}
+
+static SessionCacheEntry_t sim_entry(uint8_t band, uint32_t devAddr)
+{
+    SessionCacheEntry_t entry;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.band = band;
+    entry.devAddr = devAddr;
+    entry.fCntUp = 1;
+    for (uint8_t i = 0; i < SESSION_CACHE_KEY_LENGTH; i++)
+    {
+        entry.nwkSKey[i] = (uint8_t)(devAddr + i);
+        entry.appSKey[i] = (uint8_t)(devAddr >> 8) + i;
+    }
+    return entry;
+}
+
+/* Joins over the air until a join accept arrives, returns the DevAddr */
+static uint32_t sim_join(uint8_t band, const SimScenario_t *scenario, SimResult_t *result)
+{
+    while (true)
+    {
+        for (uint8_t tries = 0; tries < SIM_JOIN_TRIES; tries++)
+        {
+            result->joinRequests++;
+            if (!sim_lost(scenario->lossPermille) && !sim_lost(scenario->lossPermille))
+            {
+                simNetworkSession[band] = ++simDevAddr;
+                return simDevAddr;
+            }
+        }
+    }
+}
+
+static void sim_visit(uint8_t band, bool cache, const SimScenario_t *scenario, SimResult_t *result)
+{
+    SessionCacheEntry_t entry;
+    uint32_t session = 0;
+
+    /* The network purges the session while the device is away */
+    if (sim_lost(scenario->forgetPermille))
+    {
+        simNetworkSession[band] = 0;
+    }
+
+    if (cache && SESSION_CACHE_Find(band, &entry))
+    {
+        session = entry.devAddr;
+        SESSION_CACHE_Restored(band);
+        result->restores++;
+    }
+    else
+    {
+        session = sim_join(band, scenario, result);
+    }
+
+    for (uint16_t uplink = 0; uplink < SIM_UPLINKS_PER_VISIT; uplink++)
+    {
+        bool known = (simNetworkSession[band] == session);
+        bool confirmed = SESSION_CACHE_InProbation();
+        bool delivered = known && !sim_lost(scenario->lossPermille);
+        bool acknowledged = confirmed && delivered && !sim_lost(scenario->lossPermille);
+
+        result->confirmedUplinks += confirmed ? 1u : 0u;
+        result->deadUplinks += known ? 0u : 1u;
+        if (SESSION_CACHE_REJECTED == SESSION_CACHE_OnResult(confirmed, acknowledged))
+        {
+            result->rejections++;
+            result->falseRejections += known ? 1u : 0u;
+            session = sim_join(band, scenario, result);
+        }
+    }
+
+    /* Leaving the band, its session is kept */
+    if (cache)
+    {
+        entry = sim_entry(band, session);
+        SESSION_CACHE_Store(&entry);
+    }
+}
+
+int main(void)
+{
+    printf("scenario,loss_permille,forget_permille,cache,join_requests_per_visit,restores,rejections,"
+           "false_rejections,confirmed_uplinks_per_visit,dead_uplinks_per_visit\n");
+    for (uint8_t s = 0; s < sizeof(simScenarios) / sizeof(simScenarios[0]); s++)
+    {
+        for (uint8_t cache = 0; cache < 2u; cache++)
+        {
+            const SimScenario_t *scenario = &simScenarios[s];
+            SimResult_t result = { 0 };
+
+            simRandom = 7u + s;
+            simDevAddr = 0x26000000u;
+            memset(simNetworkSession, 0, sizeof(simNetworkSession));
+            SESSION_CACHE_Init(NVM_RAM_Init(), SIM_CACHE_OFFSET);
+            for (uint16_t visit = 0; visit < SIM_VISITS; visit++)
+            {
+                sim_visit((uint8_t)(visit % SIM_BANDS), 0u != cache, scenario, &result);
+            }
+            printf("%s,%u,%u,%u,%.3f,%lu,%lu,%lu,%.3f,%.3f\n", scenario->name, scenario->lossPermille,
+                   scenario->forgetPermille, cache, (double)result.joinRequests / SIM_VISITS,
+                   (unsigned long)result.restores, (unsigned long)result.rejections,
+                   (unsigned long)result.falseRejections, (double)result.confirmedUplinks / SIM_VISITS,
+                   (double)result.deadUplinks / SIM_VISITS);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+* \file  sim_sleep_loop.c
+*
+* \brief Task loop iterations and awake time while the stack finishes a
+*        transaction, with the SLEEP_STATE repost loop and with the sleep
+*        coordinator
+*
+* After an uplink the stack still has to open the two receive windows
+* before it allows a deep sleep. The repost loop runs the task loop at full
+* clock until then. The coordinator sleeps in idle until the next stack
+* activity and checks again when the stack wakes it. Times are in us on a
+* virtual clock; prints one CSV line per transaction and per day.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sleep_coord.h"
+
+/****************************** MACROS **************************************/
+/* One pass of the task loop with the SLEEP_STATE task and its trace */
+#define SIM_LOOP_US                         60u
+/* Radio interrupt and the stack task it posts */
+#define SIM_STACK_EVENT_US                  400u
+#define SIM_UPLINKS_PER_DAY                 5760u
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* TX done, RX1 open and close, RX2 open and close, from the end of the uplink */
+static const uint32_t simStackEventsUs[] = { 0, 1000000, 1030000, 2000000, 2030000 };
+#define SIM_STACK_EVENTS                    (sizeof(simStackEventsUs) / sizeof(simStackEventsUs[0]))
+
+static uint64_t simNowUs;
+static uint64_t simAwakeUs;
+static uint8_t simNextEvent;
+static bool simDeepSlept;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Runs the stack events due by now */
+static void sim_stack_run(void)
+{
+    while ((simNextEvent < SIM_STACK_EVENTS) && (simStackEventsUs[simNextEvent] <= simNowUs))
+    {
+        simNextEvent++;
+        simNowUs += SIM_STACK_EVENT_US;
+        simAwakeUs += SIM_STACK_EVENT_US;
+        if (SIM_STACK_EVENTS == simNextEvent)
+        {
+            /* The transaction is complete, the application is told */
+            SLEEP_COORD_Notify();
+        }
+    }
+}
+
+static bool sim_stack_ready(void)
+{
+    return SIM_STACK_EVENTS == simNextEvent;
+}
+
+static uint32_t sim_next_activity_ms(void)
+{
+    if (SIM_STACK_EVENTS == simNextEvent)
+    {
+        return UINT32_MAX;
+    }
+    if (simStackEventsUs[simNextEvent] <= simNowUs)
+    {
+        return 0;
+    }
+    return (uint32_t)((simStackEventsUs[simNextEvent] - simNowUs + 999u) / 1000u);
+}
+
+static bool sim_deep_sleep(uint32_t sleepTimeMs)
+{
+    (void)sleepTimeMs;
+    simDeepSlept = true;
+    return true;
+}
+
+/* Halted until the next stack interrupt */
+static void sim_idle_sleep(uint32_t maxTimeMs)
+{
+    uint64_t wakeUs = simNowUs + (uint64_t)maxTimeMs * 1000u;
+
+    if ((simNextEvent < SIM_STACK_EVENTS) && (simStackEventsUs[simNextEvent] < wakeUs))
+    {
+        wakeUs = simStackEventsUs[simNextEvent];
+    }
+    simNowUs = wakeUs;
+    sim_stack_run();
+}
+
+static const SleepCoordOps_t simOps =
+{
+    sim_stack_ready,
+    sim_next_activity_ms,
+    sim_deep_sleep,
+    sim_idle_sleep
+};
+
+/* processSleep() posting SLEEP_STATE again until the stack is ready */
+static uint32_t sim_repost_loop(void)
+{
+    uint32_t iterations = 0;
+
+    simNowUs = 0;
+    simAwakeUs = 0;
+    simNextEvent = 0;
+    while (true)
+    {
+        iterations++;
+        simNowUs += SIM_LOOP_US;
+        simAwakeUs += SIM_LOOP_US;
+        sim_stack_run();
+        if (sim_stack_ready())
+        {
+            return iterations;
+        }
+    }
+}
+
+static uint32_t sim_coordinator(void)
+{
+    uint32_t iterations = 0;
+
+    simNowUs = 0;
+    simAwakeUs = 0;
+    simNextEvent = 0;
+    simDeepSlept = false;
+    SLEEP_COORD_Init(&simOps);
+    SLEEP_COORD_Request(5000);
+    while (!simDeepSlept)
+    {
+        iterations++;
+        simNowUs += SIM_LOOP_US;
+        simAwakeUs += SIM_LOOP_US;
+        sim_stack_run();
+        SLEEP_COORD_Idle();
+    }
+    return iterations;
+}
+
+static void sim_print(const char *mode, uint32_t iterations)
+{
+    printf("%s,%lu,%llu,%llu,%llu,%llu\n", mode, (unsigned long)iterations, (unsigned long long)simNowUs,
+           (unsigned long long)simAwakeUs, (unsigned long long)iterations * SIM_UPLINKS_PER_DAY,
+           (unsigned long long)simAwakeUs * SIM_UPLINKS_PER_DAY / 1000u);
+}
+
+int main(void)
+{
+    printf("mode,loop_iterations,elapsed_us,awake_us,loop_iterations_per_day,awake_ms_per_day\n");
+    sim_print("repost", sim_repost_loop());
+    sim_print("coordinator", sim_coordinator());
+    return 0;
+}
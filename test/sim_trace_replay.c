@@ -0,0 +1,362 @@
+/**
+* \file  sim_trace_replay.c
+*
+* \brief Replays event traces of the stack callbacks through the uplink
+*        policy, the uplink slots and the session health monitor
+*
+*   sim_trace_replay [trace...]
+*
+* A trace file holds the records of EVT_TRACE_Export() or the lines
+* printed by EVT_TRACE_Print() on the console. Without files, synthetic
+* traces of the field issues are recorded with EVT_TRACE_Record() and
+* replayed: a RADIO_BUSY storm, a chain of NO_ACK and a series of denied
+* joins. The events are fed in order to the modules as
+* demo_appdata_callback() and demo_joindata_callback() do, and the
+* rejoins the application would start are counted at every event as its
+* sleep state does, so a trace always gives the same result. Prints one
+* CSV line per trace with the reaction of the application: wakeups,
+* uplinks, failures, rejoins, slots drawn again, offline time, time the
+* radio was held between a request and its completion, LoRa airtime at
+* SF9 and the probe interval the uplink policy ends with.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "stack_status.h"
+#include "conf_app.h"
+#include "evt_trace.h"
+#include "session_health.h"
+#include "tx_policy.h"
+#include "uplink_slot.h"
+
+/****************************** MACROS **************************************/
+#define SIM_MAX_TRACE                       (EVT_TRACE_DEPTH * EVT_TRACE_RECORD_LENGTH)
+#define SIM_SF                              9u
+/* MAC header, FHDR, FPort and MIC around the application payload */
+#define SIM_MAC_OVERHEAD                    13u
+#define SIM_PAYLOAD                         11u
+#define SIM_JOIN_REQUEST                    23u
+#define SIM_STATUS_PERIOD_MS                300000u
+
+/****************************** TYPES **************************************/
+typedef struct _SimReplay_t
+{
+    uint32_t events;
+    uint32_t durationMs;
+    uint32_t wakeups;
+    uint32_t uplinks;
+    uint32_t sendRefused;
+    uint32_t txOk;
+    uint32_t txFailed;
+    uint32_t noAck;
+    uint32_t radioBusy;
+    uint32_t joinRequests;
+    uint32_t joinsDenied;
+    uint32_t rejoinsDue;
+    uint32_t holdMs;
+    double airtimeMs;
+    /* Replay state */
+    bool confirmed;
+    bool rejoinPending;
+    bool holding;
+    uint32_t holdSinceMs;
+} SimReplay_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint8_t simTrace[SIM_MAX_TRACE];
+static const uint8_t simDevEui[8] = { 0x00, 0x04, 0xA3, 0x0B, 0x00, 0x1E, 0x25, 0x71 };
+
+/***************************** FUNCTIONS ***************************************/
+
+/* LoRa time on air in ms, 125 kHz, CR 4/5, explicit header, CRC on */
+static double sim_airtime_ms(uint8_t length, uint8_t sf)
+{
+    double symbolMs = (double)(1u << sf) / 125.0;
+    bool lowRate = sf >= 11u;
+    double payloadSymbols = ceil((8.0 * length - 4.0 * sf + 28.0 + 16.0) / (4.0 * (sf - (lowRate ? 2 : 0)))) * 5.0;
+
+    if (payloadSymbols < 0.0)
+    {
+        payloadSymbols = 0.0;
+    }
+    return (12.25 + 8.0 + payloadSymbols) * symbolMs;
+}
+
+static void sim_init(SimReplay_t *replay)
+{
+    memset(replay, 0, sizeof(*replay));
+    TX_POLICY_Init(CONFIRMED == DEMO_APP_TRANSMISSION_TYPE, DEMO_APP_STATUS_PROBE_MIN, DEMO_APP_STATUS_PROBE_MAX);
+    SESSION_HEALTH_Init(DEMO_APP_HEALTH_NO_ACK_LIMIT, DEMO_APP_REJOIN_RETRY_MIN_MS, DEMO_APP_REJOIN_RETRY_MAX_MS);
+    UPLINK_SLOT_Init(simDevEui, DEMO_APP_UPLINK_SLOT_WINDOW_MS, DEMO_APP_UPLINK_JITTER_MS,
+                     DEMO_APP_UPLINK_RESLOT_FAILURES);
+}
+
+static void sim_hold(SimReplay_t *replay, bool start, uint32_t nowMs)
+{
+    if (replay->holding)
+    {
+        replay->holdMs += nowMs - replay->holdSinceMs;
+    }
+    replay->holding = start;
+    replay->holdSinceMs = nowMs;
+}
+
+/* app_session_health() of the application */
+static void sim_session_health(SimReplay_t *replay, uint8_t status, bool confirmed, uint32_t nowMs)
+{
+    if (SESSION_HEALTH_OnEvent(SESSION_HEALTH_EventOf((StackRetStatus_t)status, confirmed), nowMs))
+    {
+        replay->rejoinPending = true;
+    }
+}
+
+static void sim_event(const EvtTraceEvent_t *event, void *param)
+{
+    SimReplay_t *replay = param;
+    uint8_t status = event->status;
+
+    replay->events++;
+    replay->durationMs = event->timeMs;
+    /* The sleep state starts the rejoins that are due */
+    if (replay->rejoinPending || SESSION_HEALTH_RejoinDue(event->timeMs))
+    {
+        replay->rejoinPending = false;
+        replay->rejoinsDue++;
+        SESSION_HEALTH_Rejoining();
+    }
+
+    switch (event->kind)
+    {
+        case EVT_TRACE_WAKE:
+            replay->wakeups++;
+            break;
+        case EVT_TRACE_SEND:
+            if (LORAWAN_SUCCESS == status)
+            {
+                replay->confirmed = TX_POLICY_Select(TX_FRAME_STATUS);
+                TX_POLICY_OnSent(TX_FRAME_STATUS, replay->confirmed);
+                replay->uplinks++;
+                replay->airtimeMs += sim_airtime_ms(SIM_MAC_OVERHEAD + SIM_PAYLOAD, SIM_SF);
+                sim_hold(replay, true, event->timeMs);
+            }
+            else
+            {
+                replay->sendRefused++;
+                sim_session_health(replay, status, false, event->timeMs);
+            }
+            break;
+        case EVT_TRACE_TX_DONE:
+            sim_hold(replay, false, event->timeMs);
+            if ((LORAWAN_SUCCESS == status) || (LORAWAN_RADIO_SUCCESS == status))
+            {
+                replay->txOk++;
+            }
+            else
+            {
+                replay->txFailed++;
+            }
+            replay->noAck += (LORAWAN_NO_ACK == status) ? 1u : 0u;
+            replay->radioBusy += (LORAWAN_RADIO_BUSY == status) ? 1u : 0u;
+            TX_POLICY_OnResult((LORAWAN_SUCCESS == status) || (LORAWAN_RADIO_SUCCESS == status));
+            UPLINK_SLOT_OnResult((LORAWAN_NO_ACK == status) || (LORAWAN_TX_TIMEOUT == status), event->timeMs);
+            /* Only a confirmed frame can miss its acknowledgment */
+            sim_session_health(replay, status, replay->confirmed || (LORAWAN_NO_ACK == status), event->timeMs);
+            break;
+        case EVT_TRACE_RX_DATA:
+            replay->radioBusy += (LORAWAN_RADIO_BUSY == status) ? 1u : 0u;
+            if (LORAWAN_SUCCESS != status)
+            {
+                sim_session_health(replay, status, false, event->timeMs);
+            }
+            break;
+        case EVT_TRACE_JOIN_REQ:
+            replay->joinRequests++;
+            if (LORAWAN_SUCCESS == status)
+            {
+                replay->airtimeMs += sim_airtime_ms(SIM_JOIN_REQUEST, SIM_SF);
+                sim_hold(replay, true, event->timeMs);
+            }
+            else
+            {
+                SESSION_HEALTH_OnJoin(false, event->timeMs);
+            }
+            break;
+        case EVT_TRACE_JOIN:
+            sim_hold(replay, false, event->timeMs);
+            replay->joinsDenied += (LORAWAN_SUCCESS != status) ? 1u : 0u;
+            SESSION_HEALTH_OnJoin(LORAWAN_SUCCESS == status, event->timeMs);
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_print(const char *name, const SimReplay_t *replay)
+{
+    uint32_t offlineMs = SESSION_HEALTH_GetStats()->totalOfflineMs + SESSION_HEALTH_OfflineMs(replay->durationMs);
+
+    printf("%s,%lu,%.1f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%u,%lu,%u,%.1f,%lu,%.0f,%u\n", name,
+           (unsigned long)replay->events, replay->durationMs / 1000.0, (unsigned long)replay->wakeups,
+           (unsigned long)replay->uplinks, (unsigned long)replay->sendRefused, (unsigned long)replay->txOk,
+           (unsigned long)replay->txFailed, (unsigned long)replay->noAck, (unsigned long)replay->radioBusy,
+           (unsigned long)replay->joinRequests, (unsigned long)replay->joinsDenied,
+           SESSION_HEALTH_GetStats()->outages, (unsigned long)replay->rejoinsDue, UPLINK_SLOT_GetStats()->reslots,
+           offlineMs / 1000.0, (unsigned long)replay->holdMs, replay->airtimeMs,
+           TX_POLICY_GetStats()->probeInterval);
+}
+
+/* Wakeup and status uplink of one period, the outcome of the transaction given */
+static uint32_t sim_record_uplink(uint32_t nowMs, uint8_t sendStatus, uint8_t txStatus)
+{
+    EVT_TRACE_Record(EVT_TRACE_WAKE, 0, nowMs);
+    EVT_TRACE_Record(EVT_TRACE_SEND, sendStatus, nowMs + 40u);
+    if (LORAWAN_SUCCESS == sendStatus)
+    {
+        EVT_TRACE_Record(EVT_TRACE_TX_DONE, txStatus, nowMs + 2300u);
+    }
+    return nowMs + SIM_STATUS_PERIOD_MS;
+}
+
+static uint32_t sim_record_join(uint32_t nowMs, uint8_t status)
+{
+    EVT_TRACE_Record(EVT_TRACE_JOIN_REQ, LORAWAN_SUCCESS, nowMs);
+    EVT_TRACE_Record(EVT_TRACE_JOIN, status, nowMs + 6100u);
+    return nowMs + 6100u;
+}
+
+/* Joined, then a run of status uplinks with the given failures in the middle */
+static void sim_record_busy_storm(void)
+{
+    uint32_t nowMs = sim_record_join(0, LORAWAN_SUCCESS);
+
+    for (uint8_t i = 0; i < 24u; i++)
+    {
+        bool storm = (i >= 6u) && (i < 14u);
+
+        nowMs = sim_record_uplink(nowMs, LORAWAN_SUCCESS, LORAWAN_SUCCESS);
+        /* Every reading of the storm meets a busy radio, some sends are refused */
+        if (storm)
+        {
+            EVT_TRACE_Record(EVT_TRACE_RX_DATA, LORAWAN_RADIO_BUSY, nowMs - 1000u);
+            nowMs = sim_record_uplink(nowMs, (i & 1u) ? LORAWAN_BUSY : LORAWAN_SUCCESS, LORAWAN_RADIO_BUSY);
+        }
+    }
+}
+
+static void sim_record_no_ack_chain(void)
+{
+    uint32_t nowMs = sim_record_join(0, LORAWAN_SUCCESS);
+
+    for (uint8_t i = 0; i < 24u; i++)
+    {
+        nowMs = sim_record_uplink(nowMs, LORAWAN_SUCCESS, ((i >= 4u) && (i < 16u)) ? LORAWAN_NO_ACK : LORAWAN_SUCCESS);
+        /* The device rejoined on the fourth loss */
+        if (10u == i)
+        {
+            nowMs = sim_record_join(nowMs, LORAWAN_SUCCESS);
+        }
+    }
+}
+
+static void sim_record_join_denied(void)
+{
+    uint32_t nowMs = 0;
+    uint32_t retryMs = 30000u;
+
+    for (uint8_t i = 0; i < 8u; i++)
+    {
+        nowMs = sim_record_join(nowMs, LORAWAN_NWK_NOT_JOINED) + retryMs;
+        retryMs *= 2u;
+    }
+    nowMs = sim_record_join(nowMs, LORAWAN_SUCCESS);
+    for (uint8_t i = 0; i < 8u; i++)
+    {
+        nowMs = sim_record_uplink(nowMs, LORAWAN_SUCCESS, LORAWAN_SUCCESS);
+    }
+}
+
+static void sim_replay_recorded(const char *name, void (*record)(void))
+{
+    SimReplay_t replay;
+    uint16_t length;
+
+    EVT_TRACE_Init();
+    record();
+    length = EVT_TRACE_Export(simTrace, sizeof(simTrace));
+    sim_init(&replay);
+    EVT_TRACE_Replay(simTrace, length, sim_event, &replay);
+    sim_print(name, &replay);
+}
+
+/* Console lines of EVT_TRACE_Print() or the binary records, false if neither */
+static bool sim_replay_file(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    SimReplay_t replay;
+    size_t length;
+    char line[128];
+    bool text = false;
+
+    if (NULL == file)
+    {
+        return false;
+    }
+    sim_init(&replay);
+    while (NULL != fgets(line, sizeof(line), file))
+    {
+        unsigned long timeMs;
+        unsigned int kind;
+        unsigned int status;
+
+        if (3 == sscanf(line, "%lu ms event %u status %u", &timeMs, &kind, &status))
+        {
+            EvtTraceEvent_t event = { (EvtTraceKind_t)kind, (uint8_t)status, (uint32_t)timeMs };
+
+            text = true;
+            sim_event(&event, &replay);
+        }
+    }
+    if (!text)
+    {
+        rewind(file);
+        length = fread(simTrace, 1, sizeof(simTrace), file);
+        if ((0u == length) || (0u != (length % EVT_TRACE_RECORD_LENGTH)))
+        {
+            fclose(file);
+            return false;
+        }
+        EVT_TRACE_Replay(simTrace, (uint16_t)length, sim_event, &replay);
+    }
+    fclose(file);
+    sim_print(path, &replay);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int result = 0;
+
+    printf("trace,events,duration_s,wakeups,uplinks,send_refused,tx_ok,tx_failed,no_ack,radio_busy,"
+           "join_requests,joins_denied,sessions_lost,rejoins_due,reslots,offline_s,radio_hold_ms,airtime_ms,"
+           "probe_interval\n");
+
+    if (argc < 2)
+    {
+        sim_replay_recorded("radio_busy_storm", sim_record_busy_storm);
+        sim_replay_recorded("no_ack_chain", sim_record_no_ack_chain);
+        sim_replay_recorded("join_denied", sim_record_join_denied);
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (!sim_replay_file(argv[i]))
+        {
+            fprintf(stderr, "%s: not a trace\n", argv[i]);
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,201 @@
+/**
+* \file  sim_tx_policy.c
+*
+* \brief Airtime and delivery of the adaptive uplink policy against the
+*        fixed confirmed and unconfirmed policies
+*
+* One day of status frames and alarms over a link whose uplink and
+* downlink frame loss follows a profile. A confirmed frame is repeated
+* until its ACK arrives or SIM_CONFIRMED_TRIES transmissions were made,
+* an unconfirmed frame is sent once. Airtime is the LoRa time on air of
+* the uplinks and of the ACKs at SF9/125 kHz. Prints one CSV line per
+* link profile and policy.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "tx_policy.h"
+
+/****************************** MACROS **************************************/
+#define SIM_DAY_S                           86400u
+#define SIM_STATUS_PERIOD_S                 300u
+#define SIM_ALARMS_PER_DAY                  24u
+#define SIM_CONFIRMED_TRIES                 4u
+#define SIM_PROBE_MIN                       2u
+#define SIM_PROBE_MAX                       16u
+/* MAC header, FHDR, FPort and MIC around the application payload */
+#define SIM_MAC_OVERHEAD                    13u
+#define SIM_PAYLOAD                         11u
+#define SIM_SF                              9u
+#define SIM_DAYS                            20u
+
+/****************************** TYPES **************************************/
+typedef enum _SimPolicy_t
+{
+    SIM_POLICY_CONFIRMED = 0,
+    SIM_POLICY_UNCONFIRMED,
+    SIM_POLICY_ADAPTIVE,
+    SIM_POLICY_COUNT
+} SimPolicy_t;
+
+typedef struct _SimLink_t
+{
+    const char *name;
+    /* Frame loss in per mille at the start and at the end of the day */
+    uint16_t lossStart;
+    uint16_t lossEnd;
+} SimLink_t;
+
+typedef struct _SimResult_t
+{
+    uint32_t uplinks;
+    uint32_t acks;
+    uint32_t alarmsDelivered;
+    uint32_t alarms;
+    uint32_t statusDelivered;
+    uint32_t status;
+} SimResult_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const SimLink_t simLinks[] =
+{
+    { "good", 20, 20 },
+    { "fair", 100, 100 },
+    { "poor", 300, 300 },
+    { "degrading", 20, 400 }
+};
+
+static const char *const simPolicyNames[SIM_POLICY_COUNT] = { "confirmed", "unconfirmed", "adaptive" };
+
+static uint32_t simRandom;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t sim_random(void)
+{
+    simRandom = simRandom * 1103515245u + 12345u;
+    return simRandom >> 8;
+}
+
+static bool sim_lost(uint16_t lossPermille)
+{
+    return (sim_random() % 1000u) < lossPermille;
+}
+
+/* LoRa time on air in ms, 125 kHz, CR 4/5, explicit header, CRC on */
+static double sim_airtime_ms(uint8_t length, uint8_t sf)
+{
+    double symbolMs = (double)(1u << sf) / 125.0;
+    bool lowRate = sf >= 11u;
+    double payloadSymbols = ceil((8.0 * length - 4.0 * sf + 28.0 + 16.0) / (4.0 * (sf - (lowRate ? 2 : 0)))) * 5.0;
+
+    if (payloadSymbols < 0.0)
+    {
+        payloadSymbols = 0.0;
+    }
+    return (12.25 + 8.0 + payloadSymbols) * symbolMs;
+}
+
+/* Sends one frame, returns true when the network received it */
+static bool sim_send(bool confirmed, uint16_t loss, SimResult_t *result, bool *acked)
+{
+    bool received = false;
+
+    *acked = false;
+    for (uint8_t tries = 0; tries < (confirmed ? SIM_CONFIRMED_TRIES : 1u); tries++)
+    {
+        result->uplinks++;
+        if (sim_lost(loss))
+        {
+            continue;
+        }
+        received = true;
+        if (!confirmed)
+        {
+            break;
+        }
+        result->acks++;
+        if (!sim_lost(loss))
+        {
+            *acked = true;
+            break;
+        }
+    }
+    return received;
+}
+
+static void sim_day(const SimLink_t *link, SimPolicy_t policy, SimResult_t *result)
+{
+    /* Status periods between two alarms */
+    uint32_t alarmSpacing = SIM_DAY_S / SIM_ALARMS_PER_DAY / SIM_STATUS_PERIOD_S;
+
+    TX_POLICY_Init(SIM_POLICY_CONFIRMED == policy, SIM_PROBE_MIN, SIM_PROBE_MAX);
+    for (uint32_t t = 0; t < SIM_DAY_S; t += SIM_STATUS_PERIOD_S)
+    {
+        uint16_t loss = (uint16_t)(link->lossStart + ((int32_t)link->lossEnd - link->lossStart) * (int32_t)t /
+                                   (int32_t)SIM_DAY_S);
+        bool alarm = 0u == ((t / SIM_STATUS_PERIOD_S) % alarmSpacing);
+        TxFrameKind_t kind = alarm ? TX_FRAME_ALARM : TX_FRAME_STATUS;
+        bool confirmed;
+        bool received;
+        bool acked;
+
+        switch (policy)
+        {
+            case SIM_POLICY_CONFIRMED:
+                confirmed = true;
+                break;
+            case SIM_POLICY_UNCONFIRMED:
+                confirmed = false;
+                break;
+            default:
+                confirmed = TX_POLICY_Select(kind);
+                break;
+        }
+        TX_POLICY_OnSent(kind, confirmed);
+        received = sim_send(confirmed, loss, result, &acked);
+        TX_POLICY_OnResult(acked);
+
+        if (alarm)
+        {
+            result->alarms++;
+            result->alarmsDelivered += received ? 1u : 0u;
+        }
+        else
+        {
+            result->status++;
+            result->statusDelivered += received ? 1u : 0u;
+        }
+    }
+}
+
+int main(void)
+{
+    double uplinkMs = sim_airtime_ms(SIM_MAC_OVERHEAD + SIM_PAYLOAD, SIM_SF);
+    double ackMs = sim_airtime_ms(SIM_MAC_OVERHEAD - 1u, SIM_SF);
+
+    printf("link,policy,uplinks_per_day,acks_per_day,uplink_airtime_s,downlink_airtime_s,"
+           "alarm_delivery,status_delivery\n");
+
+    for (uint8_t l = 0; l < sizeof(simLinks) / sizeof(simLinks[0]); l++)
+    {
+        for (uint8_t p = 0; p < SIM_POLICY_COUNT; p++)
+        {
+            SimResult_t result = { 0 };
+
+            simRandom = 2024u + l;
+            for (uint8_t day = 0; day < SIM_DAYS; day++)
+            {
+                sim_day(&simLinks[l], (SimPolicy_t)p, &result);
+            }
+            printf("%s,%s,%.1f,%.1f,%.2f,%.2f,%.4f,%.4f\n", simLinks[l].name, simPolicyNames[p],
+                   (double)result.uplinks / SIM_DAYS, (double)result.acks / SIM_DAYS,
+                   result.uplinks * uplinkMs / 1000.0 / SIM_DAYS, result.acks * ackMs / 1000.0 / SIM_DAYS,
+                   (double)result.alarmsDelivered / result.alarms, (double)result.statusDelivered / result.status);
+        }
+    }
+    return 0;
+}
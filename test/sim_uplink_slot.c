@@ -0,0 +1,226 @@
+/**
+* \file  sim_uplink_slot.c
+*
+* \brief Collisions of a fleet of devices powered on together, with and
+*        without the uplink slots
+*
+* Up to SIM_DEVICES devices of one manufacturing batch, DevEUIs in sequence,
+* start together and sample on the same cadence: every period they all
+* want to send at the same instant. Every uplink goes on one of
+* SIM_CHANNELS channels drawn at random, as the stack does, and is lost
+* when it overlaps another uplink on its channel (pure ALOHA, no capture
+* effect). A lost uplink is reported to the slot module as a NO_ACK, the
+* frames being confirmed. Prints one CSV line per configuration.
+*
+* uplink_slot.c keeps the state of one device: its source is included
+* here so that the state is swapped in and out for every device.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../uplink_slot.c"
+#include "conf_app.h"
+
+/****************************** MACROS **************************************/
+#define SIM_DEVICES                         1000u
+#define SIM_PERIODS                         200u
+/* Last periods, once the reslots settled */
+#define SIM_STEADY_PERIODS                  50u
+#define SIM_CHANNELS                        8u
+/* MAC header, FHDR, FPort and MIC around the 11 byte payload */
+#define SIM_FRAME_LENGTH                    24u
+
+/****************************** TYPES **************************************/
+typedef struct _SimConfig_t
+{
+    const char *name;
+    uint16_t devices;
+    uint32_t windowMs;
+    uint32_t jitterMs;
+    uint8_t reslotFailures;
+} SimConfig_t;
+
+typedef struct _SimDevice_t
+{
+    uint32_t random;
+    UplinkSlotStats_t stats;
+    uint8_t lostInRow;
+} SimDevice_t;
+
+typedef struct _SimUplink_t
+{
+    uint32_t startUs;
+    uint16_t device;
+    uint8_t channel;
+    bool lost;
+} SimUplink_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const SimConfig_t simConfigs[] =
+{
+    /* The defaults of conf_app.h as the fleet grows */
+    { "default", 20, DEMO_APP_UPLINK_SLOT_WINDOW_MS, DEMO_APP_UPLINK_JITTER_MS, DEMO_APP_UPLINK_RESLOT_FAILURES },
+    { "default", 100, DEMO_APP_UPLINK_SLOT_WINDOW_MS, DEMO_APP_UPLINK_JITTER_MS, DEMO_APP_UPLINK_RESLOT_FAILURES },
+    /* A fleet of a thousand devices */
+    { "together", SIM_DEVICES, 0, 0, 0 },
+    { "jitter_only", SIM_DEVICES, 0, DEMO_APP_UPLINK_JITTER_MS, 0 },
+    { "slot", SIM_DEVICES, DEMO_APP_UPLINK_SLOT_WINDOW_MS, DEMO_APP_UPLINK_JITTER_MS, 0 },
+    { "default", SIM_DEVICES, DEMO_APP_UPLINK_SLOT_WINDOW_MS, DEMO_APP_UPLINK_JITTER_MS,
+      DEMO_APP_UPLINK_RESLOT_FAILURES },
+    { "slot_30s", SIM_DEVICES, 30000u, DEMO_APP_UPLINK_JITTER_MS, DEMO_APP_UPLINK_RESLOT_FAILURES },
+    { "slot_120s", SIM_DEVICES, 120000u, DEMO_APP_UPLINK_JITTER_MS, DEMO_APP_UPLINK_RESLOT_FAILURES }
+};
+
+static const uint8_t simSfs[] = { 7, 9 };
+
+static SimDevice_t simDevices[SIM_DEVICES];
+static SimUplink_t simUplinks[SIM_DEVICES];
+static uint32_t simRandom;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t sim_random(void)
+{
+    simRandom = simRandom * 1103515245u + 12345u;
+    return simRandom >> 8;
+}
+
+/* LoRa time on air at 125 kHz, CR 4/5, explicit header and CRC */
+static double sim_airtime_ms(uint8_t length, uint8_t sf)
+{
+    double symbolMs = (double)(1u << sf) / 125.0;
+    bool lowRate = sf >= 11u;
+    double payloadSymbols = ceil((8.0 * length - 4.0 * sf + 28.0 + 16.0) / (4.0 * (sf - (lowRate ? 2 : 0)))) * 5.0;
+
+    if (payloadSymbols < 0.0)
+    {
+        payloadSymbols = 0.0;
+    }
+    return (12.25 + 8.0 + payloadSymbols) * symbolMs;
+}
+
+static void sim_device_load(const SimDevice_t *device)
+{
+    slotRandom = device->random;
+    slotStats = device->stats;
+}
+
+static void sim_device_save(SimDevice_t *device)
+{
+    device->random = slotRandom;
+    device->stats = slotStats;
+}
+
+static int sim_compare_uplinks(const void *a, const void *b)
+{
+    const SimUplink_t *left = a;
+    const SimUplink_t *right = b;
+
+    if (left->channel != right->channel)
+    {
+        return (int)left->channel - (int)right->channel;
+    }
+    return (left->startUs > right->startUs) - (left->startUs < right->startUs);
+}
+
+/* Marks the uplinks overlapping another one on their channel */
+static void sim_collide(uint16_t devices, uint32_t airtimeUs)
+{
+    qsort(simUplinks, devices, sizeof(simUplinks[0]), sim_compare_uplinks);
+    for (uint16_t i = 1; i < devices; i++)
+    {
+        if ((simUplinks[i].channel == simUplinks[i - 1u].channel) &&
+            ((simUplinks[i].startUs - simUplinks[i - 1u].startUs) < airtimeUs))
+        {
+            simUplinks[i].lost = true;
+            simUplinks[i - 1u].lost = true;
+        }
+    }
+}
+
+static void sim_run(const SimConfig_t *config, uint8_t sf)
+{
+    uint32_t airtimeUs = (uint32_t)(sim_airtime_ms(SIM_FRAME_LENGTH, sf) * 1000.0);
+    uint32_t lost = 0;
+    uint32_t steadyLost = 0;
+    uint32_t reslots = 0;
+    uint8_t worstInRow = 0;
+    uint64_t delaySumMs = 0;
+    uint8_t devEui[UPLINK_SLOT_EUI_LENGTH] = { 0x00, 0x04, 0xA3, 0x0B, 0x00, 0x00, 0x00, 0x00 };
+
+    simRandom = 1u;
+    for (uint16_t d = 0; d < config->devices; d++)
+    {
+        devEui[6] = (uint8_t)(d >> 8);
+        devEui[7] = (uint8_t)d;
+        UPLINK_SLOT_Init(devEui, config->windowMs, config->jitterMs, config->reslotFailures);
+        sim_device_save(&simDevices[d]);
+        simDevices[d].lostInRow = 0;
+    }
+
+    for (uint16_t period = 0; period < SIM_PERIODS; period++)
+    {
+        for (uint16_t d = 0; d < config->devices; d++)
+        {
+            uint32_t delayMs;
+
+            sim_device_load(&simDevices[d]);
+            delayMs = UPLINK_SLOT_NextDelayMs();
+            sim_device_save(&simDevices[d]);
+            delaySumMs += delayMs;
+            /* The stack starts the uplink within a millisecond of the request */
+            simUplinks[d].startUs = delayMs * 1000u + (sim_random() % 1000u);
+            simUplinks[d].device = d;
+            simUplinks[d].channel = (uint8_t)(sim_random() % SIM_CHANNELS);
+            simUplinks[d].lost = false;
+        }
+        sim_collide(config->devices, airtimeUs);
+
+        for (uint16_t i = 0; i < config->devices; i++)
+        {
+            SimDevice_t *device = &simDevices[simUplinks[i].device];
+
+            sim_device_load(device);
+            UPLINK_SLOT_OnResult(simUplinks[i].lost, sim_random());
+            sim_device_save(device);
+            if (simUplinks[i].lost)
+            {
+                lost++;
+                steadyLost += (period >= (SIM_PERIODS - SIM_STEADY_PERIODS)) ? 1u : 0u;
+                device->lostInRow++;
+                worstInRow = (device->lostInRow > worstInRow) ? device->lostInRow : worstInRow;
+            }
+            else
+            {
+                device->lostInRow = 0;
+            }
+        }
+    }
+
+    for (uint16_t d = 0; d < config->devices; d++)
+    {
+        reslots += simDevices[d].stats.reslots;
+    }
+    printf("%s,%u,%u,%lu,%lu,%u,%.2f,%.4f,%.4f,%.1f,%lu,%u\n", config->name, config->devices, sf,
+           (unsigned long)config->windowMs,
+           (unsigned long)config->jitterMs, config->reslotFailures, airtimeUs / 1000.0,
+           (double)lost / ((double)config->devices * SIM_PERIODS),
+           (double)steadyLost / ((double)config->devices * SIM_STEADY_PERIODS),
+           (double)delaySumMs / ((double)config->devices * SIM_PERIODS), (unsigned long)reslots, worstInRow);
+}
+
+int main(void)
+{
+    printf("config,devices,sf,window_ms,jitter_ms,reslot_failures,airtime_ms,loss_rate,steady_loss_rate,mean_delay_ms,"
+           "reslots,worst_losses_in_row\n");
+    for (uint8_t s = 0; s < sizeof(simSfs); s++)
+    {
+        for (uint8_t c = 0; c < sizeof(simConfigs) / sizeof(simConfigs[0]); c++)
+        {
+            sim_run(&simConfigs[c], simSfs[s]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+* \file  stack_status.h
+*
+* \brief Status codes, message types and band identifiers of the LoRaWAN
+*        stack for the host programs
+*
+* The stack headers do not build on a host: the modules shared with the
+* device include this file instead of lorawan.h when APP_HOST_BUILD is
+* defined. The status values follow StackRetStatus_t of lorawan.h, check
+* them when the stack is upgraded.
+*/
+
+#ifndef STACK_STATUS_H_
+#define STACK_STATUS_H_
+
+/****************************** TYPES **************************************/
+typedef enum _StackRetStatus_t
+{
+    LORAWAN_RADIO_SUCCESS = 0,
+    LORAWAN_RADIO_NO_DATA,
+    LORAWAN_RADIO_DATA_SIZE,
+    LORAWAN_RADIO_INVALID_REQ,
+    LORAWAN_RADIO_BUSY,
+    LORAWAN_RADIO_OUT_OF_RANGE,
+    LORAWAN_RADIO_UNSUPPORTED_ATTR,
+    LORAWAN_RADIO_CHANNEL_BUSY,
+    LORAWAN_SUCCESS,
+    LORAWAN_NWK_NOT_JOINED,
+    LORAWAN_INVALID_PARAMETER,
+    LORAWAN_KEYS_NOT_INITIALIZED,
+    LORAWAN_SILENT_IMMEDIATELY_ACTIVE,
+    LORAWAN_FCNTR_ERROR_REJOIN_NEEDED,
+    LORAWAN_INVALID_BUFFER_LENGTH,
+    LORAWAN_MAC_PAUSED,
+    LORAWAN_NO_CHANNELS_FOUND,
+    LORAWAN_INVALID_REQUEST,
+    LORAWAN_NWK_JOIN_IN_PROGRESS,
+    LORAWAN_RESOURCE_UNAVAILABLE,
+    LORAWAN_BUSY,
+    LORAWAN_NO_ACK,
+    LORAWAN_TX_TIMEOUT,
+    LORAWAN_FCNTR_ERROR,
+    LORAWAN_MIC_ERROR,
+    LORAWAN_INVALID_MTYPE,
+    LORAWAN_MCAST_HDR_INVALID,
+    LORAWAN_INVALID_PACKET
+} StackRetStatus_t;
+
+/* Number of statuses above */
+#define STACK_STATUS_COUNT                  (LORAWAN_INVALID_PACKET + 1)
+
+/* Message types of conf_app.h */
+typedef enum _TransmissionType_t
+{
+    LORAWAN_UNCNF = 0,
+    LORAWAN_CNF
+} TransmissionType_t;
+
+/* Band of the start-up menu; on the host any value but 0xFF, the reset
+   choices, will do */
+#define ISM_EU868                           0x05u
+
+#endif /* STACK_STATUS_H_ */
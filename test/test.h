@@ -0,0 +1,72 @@
+/**
+* \file  test.h
+*
+* \brief Minimal assertion helpers of the host tests
+*
+* Every test program is a single translation unit: the checks count into
+* the static counters below and TEST_END() returns the exit status.
+*/
+
+#ifndef TEST_H_
+#define TEST_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/************************** GLOBAL VARIABLES ***********************************/
+static unsigned testChecks = 0;
+static unsigned testFailures = 0;
+static const char *testName = "";
+
+/****************************** MACROS **************************************/
+#define TEST_ASSERT(cond) \
+    do \
+    { \
+        testChecks++; \
+        if (!(cond)) \
+        { \
+            testFailures++; \
+            printf("%s:%d: %s: %s\n", __FILE__, __LINE__, testName, #cond); \
+        } \
+    } while (0)
+
+#define TEST_ASSERT_EQ(actual, expected) \
+    do \
+    { \
+        long long testActual = (long long)(actual); \
+        long long testExpected = (long long)(expected); \
+        testChecks++; \
+        if (testActual != testExpected) \
+        { \
+            testFailures++; \
+            printf("%s:%d: %s: %s is %lld, expected %lld\n", __FILE__, __LINE__, testName, #actual, \
+                   testActual, testExpected); \
+        } \
+    } while (0)
+
+#define TEST_ASSERT_MEM(actual, expected, length) \
+    do \
+    { \
+        testChecks++; \
+        if (0 != memcmp((actual), (expected), (length))) \
+        { \
+            testFailures++; \
+            printf("%s:%d: %s: %s differs from %s\n", __FILE__, __LINE__, testName, #actual, #expected); \
+        } \
+    } while (0)
+
+#define TEST_RUN(test) \
+    do \
+    { \
+        testName = #test; \
+        test(); \
+    } while (0)
+
+/* Prints the summary, the value is the exit status of main() */
+#define TEST_END() \
+    (printf("%s: %u checks, %u failures\n", __FILE__, testChecks, testFailures), (0 == testFailures) ? 0 : 1)
+
+#endif /* TEST_H_ */
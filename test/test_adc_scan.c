@@ -0,0 +1,288 @@
+/**
+* \file  test_adc_scan.c
+*
+* \brief Host tests of the multi-channel ADC scan
+*
+* A stand-in of the ADC sequencer converts the inputs of SEQCTRL from the
+* lowest MUXPOS up, counting ADC clock cycles as the SAM R34 does: the
+* sampling of SAMPLEN + 1 cycles then one cycle per result bit, the
+* results going to the DMA one beat each. The active time it measures is
+* checked against ADC_SCAN_ActiveTimeUs(), which bounds the wait of
+* adc_scan_run().
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "adc_scan.h"
+#include "adc_window.h"
+
+/****************************** MACROS **************************************/
+#define TEST_MUXPOS_PIN6                    0x06u
+#define TEST_MUXPOS_PIN7                    0x07u
+#define TEST_MUXPOS_PIN8                    0x08u
+#define TEST_MUXPOS_VBAT                    0x1Bu
+#define TEST_MUXPOS_TEMP                    0x18u
+
+/****************************** TYPES **************************************/
+typedef struct _TestAdc_t
+{
+    /* Registers */
+    uint32_t seqCtrl;
+    uint8_t muxPos;
+    /* Code converted on every MUXPOS */
+    uint16_t input[ADC_SCAN_SEQ_INPUTS];
+    /* DMA destination */
+    uint16_t dma[ADC_SCAN_SEQ_INPUTS];
+    uint8_t beats;
+    uint64_t cycles;
+} TestAdc_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const uint8_t testInputs[ADC_SCAN_SIGNAL_COUNT] =
+{
+    TEST_MUXPOS_PIN6, TEST_MUXPOS_PIN7, TEST_MUXPOS_PIN8, TEST_MUXPOS_VBAT, TEST_MUXPOS_TEMP
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Sequence of SEQCTRL, MUXPOS stays on the last input converted */
+static void adc_standin_scan(TestAdc_t *adc, const AdcScanTiming_t *timing)
+{
+    adc->beats = 0;
+    adc->cycles = 0;
+    for (uint8_t input = 0; input < ADC_SCAN_SEQ_INPUTS; input++)
+    {
+        if (adc->seqCtrl & (1uL << input))
+        {
+            adc->muxPos = input;
+            adc->cycles += (uint64_t)timing->sampleLength + 1u + timing->resolutionBits;
+            adc->dma[adc->beats++] = adc->input[input];
+        }
+    }
+}
+
+/* One conversion of the input selected by MUXPOS */
+static uint16_t adc_standin_single(const TestAdc_t *adc)
+{
+    return adc->input[adc->muxPos];
+}
+
+static uint32_t adc_standin_us(const TestAdc_t *adc, const AdcScanTiming_t *timing)
+{
+    return timing->startupUs + (uint32_t)((adc->cycles * 1000000u + timing->adcClockHz - 1u) / timing->adcClockHz);
+}
+
+static void test_plan_order(void)
+{
+    static const uint8_t shuffled[ADC_SCAN_SIGNAL_COUNT] = { 0x10, 0x02, ADC_SCAN_INPUT_NONE, 0x1F, 0x00 };
+    AdcScanPlan_t plan;
+
+    TEST_ASSERT(ADC_SCAN_Plan(testInputs, &plan));
+    TEST_ASSERT_EQ(plan.count, ADC_SCAN_SIGNAL_COUNT);
+    TEST_ASSERT_EQ(plan.seqMask, (1uL << 6) | (1uL << 7) | (1uL << 8) | (1uL << 0x1B) | (1uL << 0x18));
+    TEST_ASSERT_EQ(plan.order[0], ADC_SCAN_ACC_X);
+    TEST_ASSERT_EQ(plan.order[1], ADC_SCAN_ACC_Y);
+    TEST_ASSERT_EQ(plan.order[2], ADC_SCAN_ACC_Z);
+    TEST_ASSERT_EQ(plan.order[3], ADC_SCAN_TEMP);
+    TEST_ASSERT_EQ(plan.order[4], ADC_SCAN_VBAT);
+
+    /* The sequencer order is the MUXPOS order, not the signal order */
+    TEST_ASSERT(ADC_SCAN_Plan(shuffled, &plan));
+    TEST_ASSERT_EQ(plan.count, 4);
+    TEST_ASSERT_EQ(plan.order[0], ADC_SCAN_TEMP);
+    TEST_ASSERT_EQ(plan.order[1], ADC_SCAN_ACC_Y);
+    TEST_ASSERT_EQ(plan.order[2], ADC_SCAN_ACC_X);
+    TEST_ASSERT_EQ(plan.order[3], ADC_SCAN_VBAT);
+}
+
+static void test_plan_invalid(void)
+{
+    static const uint8_t twice[ADC_SCAN_SIGNAL_COUNT] = { 6, 7, 6, ADC_SCAN_INPUT_NONE, ADC_SCAN_INPUT_NONE };
+    static const uint8_t outOfRange[ADC_SCAN_SIGNAL_COUNT] = { 6, ADC_SCAN_SEQ_INPUTS, 8, 9, 10 };
+    static const uint8_t none[ADC_SCAN_SIGNAL_COUNT] =
+    {
+        ADC_SCAN_INPUT_NONE, ADC_SCAN_INPUT_NONE, ADC_SCAN_INPUT_NONE, ADC_SCAN_INPUT_NONE, ADC_SCAN_INPUT_NONE
+    };
+    AdcScanPlan_t plan;
+
+    TEST_ASSERT(!ADC_SCAN_Plan(twice, &plan));
+    TEST_ASSERT(!ADC_SCAN_Plan(outOfRange, &plan));
+    /* Nothing fitted is a valid but empty scan, adc_scan_run() refuses it */
+    TEST_ASSERT(ADC_SCAN_Plan(none, &plan));
+    TEST_ASSERT_EQ(plan.count, 0);
+    TEST_ASSERT_EQ(plan.seqMask, 0);
+}
+
+/* The modelled active time matches the stand-in for every setup */
+static void test_active_time(void)
+{
+    static const uint32_t clocks[] = { 250000u, 1000000u, 4000000u, 8000000u, 24000000u };
+    static const uint8_t resolutions[] = { 8u, 10u, 12u };
+    AdcScanTiming_t timing = { 0, 0, 12, 50 };
+    AdcScanPlan_t plan;
+    TestAdc_t adc;
+
+    memset(&adc, 0, sizeof(adc));
+    for (uint8_t signals = 1; signals <= ADC_SCAN_SIGNAL_COUNT; signals++)
+    {
+        uint8_t inputs[ADC_SCAN_SIGNAL_COUNT];
+
+        for (uint8_t i = 0; i < ADC_SCAN_SIGNAL_COUNT; i++)
+        {
+            inputs[i] = (i < signals) ? testInputs[i] : ADC_SCAN_INPUT_NONE;
+        }
+        TEST_ASSERT(ADC_SCAN_Plan(inputs, &plan));
+        adc.seqCtrl = plan.seqMask;
+        for (uint8_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++)
+        {
+            for (uint8_t r = 0; r < sizeof(resolutions); r++)
+            {
+                for (uint8_t samplen = 0; samplen < 64u; samplen += 7u)
+                {
+                    timing.adcClockHz = clocks[c];
+                    timing.sampleLength = samplen;
+                    timing.resolutionBits = resolutions[r];
+                    adc_standin_scan(&adc, &timing);
+                    TEST_ASSERT_EQ(adc.beats, plan.count);
+                    TEST_ASSERT_EQ(ADC_SCAN_ActiveTimeUs(&timing, plan.count), adc_standin_us(&adc, &timing));
+                }
+            }
+        }
+    }
+
+    /* Default scan of the application: 2 inputs, 12 bits, 1 MHz, SAMPLEN 0 */
+    timing.adcClockHz = 1000000u;
+    timing.sampleLength = 0;
+    timing.resolutionBits = 12;
+    TEST_ASSERT_EQ(ADC_SCAN_ActiveTimeUs(&timing, 2), 50 + 26);
+    /* A second scan costs the conversions only, not another start-up */
+    TEST_ASSERT_EQ(ADC_SCAN_ActiveTimeUs(&timing, 5) - ADC_SCAN_ActiveTimeUs(&timing, 1), 4 * 13);
+    timing.adcClockHz = 0;
+    TEST_ASSERT_EQ(ADC_SCAN_ActiveTimeUs(&timing, 5), 0);
+}
+
+/* The DMA results in sequencer order land on their signals */
+static void test_convert(void)
+{
+    static const AdcScanCal_t cal = { 2062u, 2u, 250, 850, 667, 743 };
+    AdcScanTiming_t timing = { 1000000u, 0, 12, 50 };
+    AdcScanResult_t result;
+    AdcScanPlan_t plan;
+    TestAdc_t adc;
+
+    memset(&adc, 0, sizeof(adc));
+    adc.input[TEST_MUXPOS_PIN6] = 4095;
+    adc.input[TEST_MUXPOS_PIN7] = 2048;
+    adc.input[TEST_MUXPOS_PIN8] = 100;
+    /* 1500 mV on a divider of 2 */
+    adc.input[TEST_MUXPOS_VBAT] = (uint16_t)(1500u * 4095u / 2062u);
+    /* Half way between the calibration points */
+    adc.input[TEST_MUXPOS_TEMP] = (uint16_t)(705u * 4095u / 2062u + 1u);
+
+    TEST_ASSERT(ADC_SCAN_Plan(testInputs, &plan));
+    adc.seqCtrl = plan.seqMask;
+    adc_standin_scan(&adc, &timing);
+    ADC_SCAN_Convert(&plan, adc.dma, &cal, &result);
+
+    TEST_ASSERT_EQ(result.validMask, 0x1F);
+    TEST_ASSERT_EQ(result.raw[ADC_SCAN_ACC_X], 4095);
+    TEST_ASSERT_EQ(result.raw[ADC_SCAN_ACC_Z], 100);
+    TEST_ASSERT(result.acc[0] == ACC_CODE_TO_VALUE(4095));
+    TEST_ASSERT(result.acc[1] == ACC_CODE_TO_VALUE(2048));
+    TEST_ASSERT(result.acc[2] == ACC_CODE_TO_VALUE(100));
+    TEST_ASSERT(result.vbatMv >= 2998 && result.vbatMv <= 3000);
+    TEST_ASSERT(result.tempDeci >= 548 && result.tempDeci <= 552);
+    TEST_ASSERT(ADC_SCAN_AccPeak(&result) == ACC_CODE_TO_VALUE(4095));
+
+    /* Without calibration the temperature is left at 0 */
+    {
+        AdcScanCal_t noCal = cal;
+
+        noCal.hotMv = noCal.roomMv;
+        ADC_SCAN_Convert(&plan, adc.dma, &noCal, &result);
+        TEST_ASSERT_EQ(result.tempDeci, 0);
+        TEST_ASSERT(result.validMask & (1u << ADC_SCAN_TEMP));
+    }
+}
+
+/* The sequencer leaves MUXPOS on its last input: adc_scan_run() selects
+ * the accelerometer again for the window monitor and single reads */
+static void test_muxpos_after_scan(void)
+{
+    AdcScanTiming_t timing = { 1000000u, 0, 12, 50 };
+    AdcScanPlan_t plan;
+    TestAdc_t adc;
+
+    memset(&adc, 0, sizeof(adc));
+    adc.input[TEST_MUXPOS_PIN6] = 1234;
+    adc.input[TEST_MUXPOS_VBAT] = 3000;
+    adc.muxPos = TEST_MUXPOS_PIN6;
+    TEST_ASSERT(ADC_SCAN_Plan(testInputs, &plan));
+    adc.seqCtrl = plan.seqMask;
+    adc_standin_scan(&adc, &timing);
+    adc.seqCtrl = 0;
+    TEST_ASSERT_EQ(adc.muxPos, TEST_MUXPOS_VBAT);
+    TEST_ASSERT_EQ(adc_standin_single(&adc), 3000);
+
+    adc.muxPos = TEST_MUXPOS_PIN6;
+    TEST_ASSERT_EQ(adc_standin_single(&adc), 1234);
+}
+
+static void test_peak_and_payload(void)
+{
+    AdcScanResult_t result;
+    char str[40];
+    int length;
+
+    memset(&result, 0, sizeof(result));
+    /* Axes that were not converted do not count */
+    result.validMask = (1u << ADC_SCAN_ACC_X) | (1u << ADC_SCAN_ACC_Z);
+    result.acc[0] = 1.25f;
+    result.acc[1] = 9.0f;
+    result.acc[2] = 3.5f;
+    TEST_ASSERT(ADC_SCAN_AccPeak(&result) == 3.5f);
+
+    length = ADC_SCAN_FormatPayload(&result, str, sizeof(str));
+    TEST_ASSERT_EQ(length, 5);
+    TEST_ASSERT(0 == strcmp(str, "3.5C\n"));
+
+    result.validMask |= (1u << ADC_SCAN_VBAT) | (1u << ADC_SCAN_TEMP);
+    result.vbatMv = 3012;
+    result.tempDeci = -45;
+    length = ADC_SCAN_FormatPayload(&result, str, sizeof(str));
+    TEST_ASSERT(0 == strcmp(str, "3.5C 3012mV -4.5T\n"));
+    TEST_ASSERT_EQ(length, (int)strlen(str));
+
+    /* The same digits as the float printf for every 12-bit code */
+    memset(&result, 0, sizeof(result));
+    result.validMask = 1u << ADC_SCAN_ACC_X;
+    for (uint16_t code = 0; code <= ACC_ADC_MAX_CODE; code++)
+    {
+        char expected[16];
+
+        result.acc[0] = ACC_CODE_TO_VALUE(code);
+        snprintf(expected, sizeof(expected), "%.1fC\n", result.acc[0]);
+        ADC_SCAN_FormatPayload(&result, str, sizeof(str));
+        if (0 != strcmp(str, expected))
+        {
+            /* Only a value exactly half way may round the other way */
+            TEST_ASSERT(0 == ((int32_t)(result.acc[0] * 100.0f + 0.5f) % 5));
+        }
+    }
+
+    /* A short buffer truncates like snprintf() */
+    result.acc[0] = 12.5f;
+    TEST_ASSERT_EQ(ADC_SCAN_FormatPayload(&result, str, 4), 6);
+    TEST_ASSERT(0 == strcmp(str, "12."));
+}
+
+int main(void)
+{
+    TEST_RUN(test_plan_order);
+    TEST_RUN(test_plan_invalid);
+    TEST_RUN(test_active_time);
+    TEST_RUN(test_convert);
+    TEST_RUN(test_muxpos_after_scan);
+    TEST_RUN(test_peak_and_payload);
+    return TEST_END();
+}
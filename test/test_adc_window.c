@@ -0,0 +1,120 @@
+/**
+* \file  test_adc_window.c
+*
+* \brief Host tests of the ADC window monitor wake planning
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "adc_window.h"
+
+/***************************** FUNCTIONS ***************************************/
+
+/* "raw > limit" must agree with "value > threshold" on every code */
+static void check_threshold(float threshold)
+{
+    uint16_t limit = ADC_WINDOW_ThresholdToCode(threshold);
+    uint16_t mismatches = 0;
+
+    for (uint16_t code = 0; code <= ACC_ADC_MAX_CODE; code++)
+    {
+        if ((code > limit) != (ACC_CODE_TO_VALUE(code) > threshold))
+        {
+            mismatches++;
+        }
+    }
+    TEST_ASSERT_EQ(mismatches, 0);
+}
+
+static void test_threshold_to_code(void)
+{
+    for (uint32_t i = 0; i <= 21000; i += 7)
+    {
+        check_threshold((float)i / 1000.0f);
+    }
+    /* Exactly on a code and just around it */
+    for (uint16_t code = 0; code <= ACC_ADC_MAX_CODE; code += 13)
+    {
+        float value = ACC_CODE_TO_VALUE(code);
+
+        check_threshold(value);
+        check_threshold(value * 0.99999f);
+        check_threshold(value * 1.00001f);
+    }
+    check_threshold(1.0f);
+
+    TEST_ASSERT_EQ(ADC_WINDOW_ThresholdToCode(-1.0f), 0);
+    TEST_ASSERT_EQ(ADC_WINDOW_ThresholdToCode(ACC_ADC_FULL_SCALE), ACC_ADC_MAX_CODE);
+    TEST_ASSERT_EQ(ADC_WINDOW_ThresholdToCode(1000.0f), ACC_ADC_MAX_CODE);
+}
+
+static void test_rtc_event(void)
+{
+    /* PERn every 2^(n+3) cycles of 1024 Hz: PER7 every second */
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(1000, 1024), 7);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(5000, 1024), 7);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(999, 1024), 6);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(500, 1024), 6);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(16, 1024), 1);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(15, 1024), 0);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(1, 1024), 0);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(0, 1024), 0);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(UINT32_MAX, 1024), 7);
+    /* 32.768 kHz: PER7 every 31.25 ms */
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(5000, 32768), 7);
+    TEST_ASSERT_EQ(ADC_WINDOW_RtcEvent(31, 32768), 6);
+
+    /* Never slower than the sample period */
+    for (uint32_t periodMs = 8; periodMs < 3000; periodMs++)
+    {
+        uint8_t event = ADC_WINDOW_RtcEvent(periodMs, 1024);
+
+        TEST_ASSERT(((8u << event) * 1000u) <= (periodMs * 1024u));
+    }
+}
+
+static void test_plan(void)
+{
+    AdcWakePlan_t plan;
+
+    TEST_ASSERT_EQ(ADC_WINDOW_Plan(ADC_WAKE_MODE_POLL, 1.0f, 5000, 3, 1024, &plan), ADC_WAKE_MODE_POLL);
+    TEST_ASSERT_EQ(plan.sleepTimeMs, 5000);
+    TEST_ASSERT_EQ(plan.periodsPerWake, 1);
+
+    TEST_ASSERT_EQ(ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, 1.0f, 5000, 3, 1024, &plan), ADC_WAKE_MODE_WINDOW);
+    TEST_ASSERT_EQ(plan.sleepTimeMs, 15000);
+    TEST_ASSERT_EQ(plan.periodsPerWake, 3);
+    TEST_ASSERT_EQ(plan.windowLimit, ADC_WINDOW_ThresholdToCode(1.0f));
+    TEST_ASSERT_EQ(plan.rtcEvent, 7);
+
+    ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, 1.0f, 5000, 0, 1024, &plan);
+    TEST_ASSERT_EQ(plan.sleepTimeMs, 5000);
+    TEST_ASSERT_EQ(plan.periodsPerWake, 1);
+}
+
+/* A fallback to polling ends once the threshold can be watched again */
+static void test_plan_fallback_reversible(void)
+{
+    AdcWakePlan_t plan;
+
+    TEST_ASSERT_EQ(ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, -0.5f, 5000, 3, 1024, &plan), ADC_WAKE_MODE_POLL);
+    TEST_ASSERT_EQ(plan.sleepTimeMs, 5000);
+    TEST_ASSERT_EQ(ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, 2.0f, 5000, 3, 1024, &plan), ADC_WAKE_MODE_WINDOW);
+    TEST_ASSERT_EQ(plan.sleepTimeMs, 15000);
+
+    /* The sample period moves the conversion event */
+    ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, 2.0f, 250, 3, 1024, &plan);
+    TEST_ASSERT_EQ(plan.rtcEvent, 5);
+    ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, 2.0f, 2000, 3, 1024, &plan);
+    TEST_ASSERT_EQ(plan.rtcEvent, 7);
+}
+
+int main(void)
+{
+    TEST_RUN(test_threshold_to_code);
+    TEST_RUN(test_rtc_event);
+    TEST_RUN(test_plan);
+    TEST_RUN(test_plan_fallback_reversible);
+    return TEST_END();
+}
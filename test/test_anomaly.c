@@ -0,0 +1,457 @@
+/**
+* \file  test_anomaly.c
+*
+* \brief Host tests of the anomaly detector and its evaluation against
+*        labelled accelerometer traces
+*
+* Every trace lasts a week of 5 s sample periods with labelled events.
+* read_adc() is replayed as the demo runs it: a reading counts towards an
+* alarm when the detector says so, or above the fixed threshold while it
+* learns, and DEMO_APP_ACC_ALARM_CONFIRM_COUNT readings one second apart
+* confirm the alarm. Polling reads every sample period; the window monitor
+* converts on the RTC event, wakes the CPU above the level of
+* app_alarm_level() and for the status wakeups, which keep the baseline
+* learned. An alarm outside an event is a false alarm; the latency runs
+* from the start of an event to its first alarm. The fixed threshold with
+* the window is the reference the detector is compared with.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "anomaly.h"
+#include "adc_window.h"
+
+/****************************** MACROS **************************************/
+#define EVAL_DAYS                           7u
+#define EVAL_DAY_MS                         86400000ull
+#define EVAL_HOUR_MS                        3600000ull
+#define EVAL_SAMPLE_MS                      5000u
+#define EVAL_STATUS_PERIODS                 3u
+#define EVAL_RTC_HZ                         1024u
+#define EVAL_THRESHOLD                      1.0f
+#define EVAL_CONFIRM_COUNT                  5u
+#define EVAL_CONFIRM_MS                     1000u
+/* Awake to send a confirmed alarm before sleeping again */
+#define EVAL_ALARM_BUSY_MS                  3000u
+#define EVAL_MAX_EVENTS                     64u
+
+/* Defaults of conf_app.h */
+#define EVAL_SHIFT                          7u
+#define EVAL_Z_Q4                           64u
+#define EVAL_WARMUP                         60u
+#define EVAL_SIGMA_MIN                      4u
+
+/* As APP_ANOMALY_SCALE of the demo */
+#define EVAL_SCALE                          (4.0f * (float)ACC_ADC_MAX_CODE / ACC_ADC_FULL_SCALE)
+
+/****************************** TYPES **************************************/
+typedef enum _EvalMode_t
+{
+    /* Detector, polling every sample period */
+    EVAL_MODE_POLL = 0,
+    /* Detector, the window watching its learned limit */
+    EVAL_MODE_WINDOW,
+    /* Fixed threshold watched by the window, as before the detector */
+    EVAL_MODE_FIXED,
+    EVAL_MODE_COUNT
+} EvalMode_t;
+
+typedef struct _EvalTrace_t
+{
+    const char *name;
+    /* Level at the start and at the end of the week, noise, unit of ACC_CODE_TO_VALUE() */
+    float level;
+    float endLevel;
+    float noise;
+    /* Level from shiftStart to shiftEnd o'clock, when shiftEnd is not 0 */
+    float shiftLevel;
+    uint8_t shiftStart;
+    uint8_t shiftEnd;
+    /* Events of eventMs raising the level by eventLevel */
+    uint8_t eventsPerDay;
+    uint32_t eventMs;
+    float eventLevel;
+    /* A baseline per hour of the day */
+    bool seasonal;
+    /* Largest false alarms per day of the detector */
+    uint16_t maxFalsePerDay;
+} EvalTrace_t;
+
+typedef struct _EvalResult_t
+{
+    uint32_t wakeups;
+    uint32_t alarms;
+    uint32_t falseAlarms;
+    uint16_t detected;
+    uint64_t latencySumMs;
+    uint64_t worstLatencyMs;
+    bool found[EVAL_MAX_EVENTS];
+} EvalResult_t;
+
+typedef struct _EvalRun_t
+{
+    const EvalTrace_t *trace;
+    EvalMode_t mode;
+    uint16_t windowLimit;
+    EvalResult_t result;
+} EvalRun_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const EvalTrace_t evalTraces[] =
+{
+    /* Pump at a constant level */
+    { "steady", 0.3f, 0.3f, 0.05f, 0.0f, 0, 0, 4, 60000, 1.0f, false, 1 },
+    /* Rough running close to the fixed threshold */
+    { "noisy", 0.8f, 0.8f, 0.15f, 0.0f, 0, 0, 4, 60000, 1.5f, false, 1 },
+    /* Wear raising the level across the fixed threshold */
+    { "drift", 0.3f, 1.3f, 0.05f, 0.0f, 0, 0, 4, 60000, 1.0f, false, 1 },
+    /* Knocks far below the fixed threshold on a quiet asset */
+    { "subtle", 0.2f, 0.2f, 0.02f, 0.0f, 0, 0, 4, 120000, 0.3f, false, 1 },
+    /* Machine running from 8 to 16 o'clock, a baseline per hour */
+    { "shift", 0.2f, 0.2f, 0.05f, 0.9f, 8, 16, 4, 60000, 1.5f, true, 2 }
+};
+
+static const char *const evalModeNames[EVAL_MODE_COUNT] = { "poll", "window", "fixed" };
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Event in progress at tMs, -1 if none. The events of a day start in the
+   first half of their slot, the first slot of the week has none */
+static int32_t eval_event(const EvalTrace_t *trace, uint64_t tMs, uint64_t *startMs)
+{
+    uint64_t spacing = EVAL_DAY_MS / trace->eventsPerDay;
+    uint64_t index = tMs / spacing;
+
+    *startMs = index * spacing + ((index * 7919u * 1000u) % (spacing / 2u));
+    if ((0 == index) || (index >= EVAL_MAX_EVENTS))
+    {
+        return -1;
+    }
+    return ((tMs >= *startMs) && (tMs < (*startMs + trace->eventMs))) ? (int32_t)index : -1;
+}
+
+/* Reproducible noise of about one standard deviation, function of the time */
+static float eval_noise(uint64_t tMs)
+{
+    uint64_t x = tMs + 0x9E3779B97F4A7C15ull;
+    float sum = 0.0f;
+
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    /* Sum of 4 uniforms of 16 bits, variance 4/12 */
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        sum += (float)((x >> (16u * i)) & 0xFFFFu) / 65535.0f - 0.5f;
+    }
+    return sum * 1.7320508f;
+}
+
+/* ADC code of the trace at tMs */
+static uint16_t eval_code(const EvalTrace_t *trace, uint64_t tMs)
+{
+    uint8_t hour = (uint8_t)((tMs / EVAL_HOUR_MS) % 24u);
+    float value = trace->level + (trace->endLevel - trace->level) * (float)tMs / (float)(EVAL_DAYS * EVAL_DAY_MS);
+    float code;
+    uint64_t startMs;
+
+    if ((0 != trace->shiftEnd) && (hour >= trace->shiftStart) && (hour < trace->shiftEnd))
+    {
+        value = trace->shiftLevel;
+    }
+    value += trace->noise * eval_noise(tMs);
+    if (eval_event(trace, tMs, &startMs) >= 0)
+    {
+        value += trace->eventLevel;
+    }
+    code = value * (float)ACC_ADC_MAX_CODE / ACC_ADC_FULL_SCALE + 0.5f;
+    if (code < 0.0f)
+    {
+        return 0;
+    }
+    return (code > (float)ACC_ADC_MAX_CODE) ? ACC_ADC_MAX_CODE : (uint16_t)code;
+}
+
+/* app_acc_alarm() and the update of the window limit after it */
+static bool eval_alarm(EvalRun_t *run, uint16_t code, uint64_t tMs)
+{
+    float value = ACC_CODE_TO_VALUE(code);
+    uint8_t season = run->trace->seasonal ? (uint8_t)((tMs / EVAL_HOUR_MS) % ANOMALY_SEASONS) : ANOMALY_NO_SEASON;
+    AnomalyResult_t result;
+    int16_t limit;
+
+    if (EVAL_MODE_FIXED == run->mode)
+    {
+        return value > EVAL_THRESHOLD;
+    }
+    result = ANOMALY_Update((int16_t)(value * EVAL_SCALE + 0.5f), season);
+    run->windowLimit = ADC_WINDOW_ThresholdToCode(ANOMALY_GetLimit(season, &limit) ?
+                                                  (((float)limit + 0.5f) / EVAL_SCALE) : EVAL_THRESHOLD);
+    if (ANOMALY_LEARNING != result)
+    {
+        return ANOMALY_DETECTED == result;
+    }
+    return value > EVAL_THRESHOLD;
+}
+
+/* read_adc() at tMs and its confirmation readings, returns when it is done */
+static uint64_t eval_read(EvalRun_t *run, uint64_t tMs)
+{
+    uint8_t count = 0;
+
+    run->result.wakeups++;
+    while (eval_alarm(run, eval_code(run->trace, tMs), tMs))
+    {
+        count++;
+        if (count >= EVAL_CONFIRM_COUNT)
+        {
+            uint64_t startMs;
+            int32_t event = eval_event(run->trace, tMs, &startMs);
+
+            run->result.alarms++;
+            if (event < 0)
+            {
+                /* Confirmed just after the end of an event, still caused by it */
+                event = eval_event(run->trace, tMs - EVAL_CONFIRM_COUNT * EVAL_CONFIRM_MS, &startMs);
+            }
+            if (event < 0)
+            {
+                run->result.falseAlarms++;
+            }
+            else if (!run->result.found[event])
+            {
+                run->result.found[event] = true;
+                run->result.detected++;
+                run->result.latencySumMs += tMs - startMs;
+                if ((tMs - startMs) > run->result.worstLatencyMs)
+                {
+                    run->result.worstLatencyMs = tMs - startMs;
+                }
+            }
+            return tMs + EVAL_ALARM_BUSY_MS;
+        }
+        /* Next reading in a second, a wakeup of its own */
+        tMs += EVAL_CONFIRM_MS;
+        run->result.wakeups++;
+    }
+    return tMs;
+}
+
+static void eval_poll(EvalRun_t *run)
+{
+    uint64_t tMs = 0;
+
+    while (tMs < (EVAL_DAYS * EVAL_DAY_MS))
+    {
+        tMs = eval_read(run, tMs) + EVAL_SAMPLE_MS;
+    }
+}
+
+static void eval_window(EvalRun_t *run)
+{
+    AdcWakePlan_t plan;
+    uint64_t periodMs;
+    uint64_t awakeUntilMs = 0;
+    uint64_t timedMs;
+
+    ADC_WINDOW_Plan(ADC_WAKE_MODE_WINDOW, EVAL_THRESHOLD, EVAL_SAMPLE_MS, EVAL_STATUS_PERIODS, EVAL_RTC_HZ, &plan);
+    TEST_ASSERT_EQ(plan.mode, ADC_WAKE_MODE_WINDOW);
+    periodMs = ((uint64_t)8u << plan.rtcEvent) * 1000u / EVAL_RTC_HZ;
+    run->windowLimit = plan.windowLimit;
+    timedMs = plan.sleepTimeMs;
+    for (uint64_t tMs = 0; tMs < (EVAL_DAYS * EVAL_DAY_MS); tMs += periodMs)
+    {
+        while (timedMs <= tMs)
+        {
+            /* Status wakeup, the sleep restarts after it */
+            awakeUntilMs = eval_read(run, timedMs);
+            timedMs = awakeUntilMs + plan.sleepTimeMs;
+        }
+        /* The comparator is only armed while asleep */
+        if ((tMs >= awakeUntilMs) && (eval_code(run->trace, tMs) > run->windowLimit))
+        {
+            awakeUntilMs = eval_read(run, tMs);
+            timedMs = awakeUntilMs + plan.sleepTimeMs;
+        }
+    }
+}
+
+static void eval_run(EvalRun_t *run)
+{
+    static const AnomalyConfig_t config = { EVAL_SHIFT, EVAL_Z_Q4, EVAL_WARMUP, EVAL_SIGMA_MIN };
+
+    ANOMALY_Init(&config);
+    if (EVAL_MODE_POLL == run->mode)
+    {
+        eval_poll(run);
+    }
+    else
+    {
+        eval_window(run);
+    }
+}
+
+/* No limit before the detector is initialized or has learned */
+static void test_limit_learning(void)
+{
+    static const AnomalyConfig_t config = { EVAL_SHIFT, EVAL_Z_Q4, EVAL_WARMUP, EVAL_SIGMA_MIN };
+    int16_t limit = 123;
+
+    TEST_ASSERT(!ANOMALY_GetLimit(ANOMALY_NO_SEASON, &limit));
+    ANOMALY_Init(&config);
+    for (uint16_t i = 0; i < EVAL_WARMUP; i++)
+    {
+        TEST_ASSERT(!ANOMALY_GetLimit(ANOMALY_NO_SEASON, &limit));
+        TEST_ASSERT_EQ(ANOMALY_Update(400, 5), ANOMALY_LEARNING);
+    }
+    TEST_ASSERT_EQ(limit, 123);
+    /* A constant level: the limit is the noise floor above it */
+    TEST_ASSERT(ANOMALY_GetLimit(ANOMALY_NO_SEASON, &limit));
+    TEST_ASSERT_EQ(limit, 400 + (EVAL_Z_Q4 * EVAL_SIGMA_MIN) / 16u);
+    TEST_ASSERT(ANOMALY_GetLimit(5, &limit));
+    TEST_ASSERT_EQ(limit, 400 + (EVAL_Z_Q4 * EVAL_SIGMA_MIN) / 16u);
+    TEST_ASSERT_EQ(ANOMALY_Update(400 + (EVAL_Z_Q4 * EVAL_SIGMA_MIN) / 16u, 5), ANOMALY_NORMAL);
+    TEST_ASSERT_EQ(ANOMALY_Update(401 + (EVAL_Z_Q4 * EVAL_SIGMA_MIN) / 16u, 5), ANOMALY_DETECTED);
+}
+
+/* The limit and ANOMALY_Update() agree on every sample of a wandering level */
+static void test_limit_matches_update(void)
+{
+    static const AnomalyConfig_t configs[] =
+    {
+        { EVAL_SHIFT, EVAL_Z_Q4, EVAL_WARMUP, EVAL_SIGMA_MIN },
+        { 4, 40, 10, 0 },
+        { 10, 100, 200, 50 }
+    };
+    uint32_t seed = 50u;
+    uint32_t mismatches = 0;
+
+    for (uint8_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+    {
+        int32_t level = -8000;
+
+        ANOMALY_Init(&configs[c]);
+        for (uint32_t i = 0; i < 200000u; i++)
+        {
+            uint8_t season = (uint8_t)((i / 500u) % (ANOMALY_SEASONS + 2u));
+            int16_t limit;
+            int32_t sample;
+            bool learned;
+            AnomalyResult_t result;
+
+            seed = seed * 1103515245u + 12345u;
+            level += (int32_t)((seed >> 8) % 9u) - 4;
+            level = (level > 12000) ? 12000 : ((level < -12000) ? -12000 : level);
+            seed = seed * 1103515245u + 12345u;
+            sample = level + (int32_t)((seed >> 8) % 161u) - 80;
+            if (0u == (i % 97u))
+            {
+                /* Events and full scale readings */
+                sample += (int32_t)((seed >> 16) % 5000u);
+            }
+            if (season >= ANOMALY_SEASONS)
+            {
+                season = ANOMALY_NO_SEASON;
+            }
+            learned = ANOMALY_GetLimit(season, &limit);
+            result = ANOMALY_Update((int16_t)((sample > INT16_MAX) ? INT16_MAX : sample), season);
+            if (sample > ANOMALY_SAMPLE_MAX)
+            {
+                sample = ANOMALY_SAMPLE_MAX;
+            }
+            if ((learned != (ANOMALY_LEARNING != result)) ||
+                (learned && ((ANOMALY_DETECTED == result) != (sample > limit))))
+            {
+                mismatches++;
+            }
+        }
+    }
+    TEST_ASSERT_EQ(mismatches, 0);
+}
+
+/* The window wakes on exactly the codes the detector flags, the limit
+   converted as app_alarm_level() does */
+static void test_window_limit(void)
+{
+    uint32_t early = 0;
+    uint32_t missed = 0;
+
+    /* A negative limit leaves polling only, see ADC_WINDOW_Plan() */
+    for (int32_t limit = 0; limit <= ANOMALY_SAMPLE_MAX; limit += 3)
+    {
+        uint16_t windowLimit = ADC_WINDOW_ThresholdToCode(((float)limit + 0.5f) / EVAL_SCALE);
+
+        for (uint16_t code = 0; code <= ACC_ADC_MAX_CODE; code++)
+        {
+            bool detected = (int16_t)(ACC_CODE_TO_VALUE(code) * EVAL_SCALE + 0.5f) > limit;
+
+            if (code > windowLimit)
+            {
+                early += detected ? 0u : 1u;
+            }
+            else
+            {
+                missed += detected ? 1u : 0u;
+            }
+        }
+    }
+    /* Sleeping through an anomaly misses it, waking for a normal reading
+       costs a wakeup */
+    TEST_ASSERT_EQ(missed, 0);
+    TEST_ASSERT_EQ(early, 0);
+}
+
+/* False alarms per day and detection latency on the labelled traces */
+static void test_labelled_traces(void)
+{
+    static EvalRun_t runs[sizeof(evalTraces) / sizeof(evalTraces[0])][EVAL_MODE_COUNT];
+
+    printf("trace,mode,wakeups_per_day,alarms,false_alarms_per_day,events,detected,mean_latency_ms,"
+           "worst_latency_ms\n");
+    for (uint8_t t = 0; t < sizeof(evalTraces) / sizeof(evalTraces[0]); t++)
+    {
+        const EvalTrace_t *trace = &evalTraces[t];
+        uint16_t events = (uint16_t)(EVAL_DAYS * trace->eventsPerDay - 1u);
+
+        testName = trace->name;
+        for (uint8_t m = 0; m < EVAL_MODE_COUNT; m++)
+        {
+            EvalRun_t *run = &runs[t][m];
+            const EvalResult_t *result = &run->result;
+
+            run->trace = trace;
+            run->mode = (EvalMode_t)m;
+            eval_run(run);
+            printf("%s,%s,%lu,%lu,%.2f,%u,%u,%lu,%lu\n", trace->name, evalModeNames[m],
+                   (unsigned long)(result->wakeups / EVAL_DAYS), (unsigned long)result->alarms,
+                   (double)result->falseAlarms / EVAL_DAYS, events, result->detected,
+                   (unsigned long)(result->detected ? (result->latencySumMs / result->detected) : 0u),
+                   (unsigned long)result->worstLatencyMs);
+            if (EVAL_MODE_FIXED == m)
+            {
+                continue;
+            }
+            TEST_ASSERT_EQ(result->detected, events);
+            TEST_ASSERT(result->falseAlarms <= (uint32_t)trace->maxFalsePerDay * EVAL_DAYS);
+            /* A sample period to the first reading, then the confirmations */
+            TEST_ASSERT(result->worstLatencyMs <= (EVAL_SAMPLE_MS + (EVAL_CONFIRM_COUNT - 1u) * EVAL_CONFIRM_MS));
+        }
+        /* The window follows the learned level: far fewer wakeups than
+           polling, as many events found */
+        TEST_ASSERT(runs[t][EVAL_MODE_WINDOW].result.wakeups < runs[t][EVAL_MODE_POLL].result.wakeups / 2u);
+    }
+    testName = "test_labelled_traces";
+
+    /* What the fixed threshold got wrong */
+    TEST_ASSERT(runs[2][EVAL_MODE_FIXED].result.falseAlarms > 100u * runs[2][EVAL_MODE_WINDOW].result.falseAlarms);
+    TEST_ASSERT_EQ(runs[3][EVAL_MODE_FIXED].result.detected, 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_limit_learning);
+    TEST_RUN(test_limit_matches_update);
+    TEST_RUN(test_window_limit);
+    TEST_RUN(test_labelled_traces);
+    return TEST_END();
+}
@@ -0,0 +1,286 @@
+/**
+* \file  test_app_crypto.c
+*
+* \brief Host tests of the application payload encryption on the software
+*        cipher, against the NIST and RFC 4493 vectors
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "app_crypto.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const uint8_t encKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x5A, 0x1C, 0x93, 0x07, 0xE2, 0x4B, 0xD8, 0x61, 0x3F, 0xA6, 0x0D, 0x72, 0xC5, 0x19, 0x8E, 0x34
+};
+static const uint8_t macKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x83, 0xD4, 0x2E, 0x6B, 0x17, 0xF0, 0x59, 0xAC, 0x46, 0x0B, 0xE7, 0x92, 0x3D, 0xC8, 0x75, 0x1A
+};
+
+/* SP 800-38A appendix F and RFC 4493: key and the four plaintext blocks */
+static const uint8_t nistKey[APP_CRYPTO_KEY_LENGTH] =
+{
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+static const uint8_t nistPlain[4 * APP_CRYPTO_BLOCK_LENGTH] =
+{
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+static void setup(void)
+{
+    TEST_ASSERT(APP_CRYPTO_Init(encKey, macKey, NULL));
+}
+
+/* FIPS-197 appendix C.1 */
+static void test_fips197(void)
+{
+    static const uint8_t key[APP_CRYPTO_KEY_LENGTH] =
+    {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static const uint8_t cipher[APP_CRYPTO_BLOCK_LENGTH] =
+    {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    };
+    uint8_t block[APP_CRYPTO_BLOCK_LENGTH] =
+    {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+    };
+
+    setup();
+    APP_CRYPTO_Encrypt(key, block);
+    TEST_ASSERT_MEM(block, cipher, sizeof(block));
+}
+
+/* SP 800-38A F.1.1, ECB-AES128.Encrypt */
+static void test_sp800_38a_ecb(void)
+{
+    static const uint8_t cipher[4 * APP_CRYPTO_BLOCK_LENGTH] =
+    {
+        0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97,
+        0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf,
+        0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88,
+        0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4
+    };
+
+    setup();
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint8_t block[APP_CRYPTO_BLOCK_LENGTH];
+
+        memcpy(block, &nistPlain[i * APP_CRYPTO_BLOCK_LENGTH], sizeof(block));
+        APP_CRYPTO_Encrypt(nistKey, block);
+        TEST_ASSERT_MEM(block, &cipher[i * APP_CRYPTO_BLOCK_LENGTH], sizeof(block));
+    }
+}
+
+/* SP 800-38A F.5.1, CTR-AES128.Encrypt, the key stream of the block cipher */
+static void test_sp800_38a_ctr(void)
+{
+    static const uint8_t cipher[4 * APP_CRYPTO_BLOCK_LENGTH] =
+    {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+    uint8_t counter[APP_CRYPTO_BLOCK_LENGTH] =
+    {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+    uint8_t data[sizeof(nistPlain)];
+
+    setup();
+    memcpy(data, nistPlain, sizeof(data));
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint8_t block[APP_CRYPTO_BLOCK_LENGTH];
+
+        memcpy(block, counter, sizeof(block));
+        APP_CRYPTO_Encrypt(nistKey, block);
+        for (uint8_t j = 0; j < APP_CRYPTO_BLOCK_LENGTH; j++)
+        {
+            data[i * APP_CRYPTO_BLOCK_LENGTH + j] ^= block[j];
+        }
+        /* Big endian increment of the whole block */
+        for (int8_t j = APP_CRYPTO_BLOCK_LENGTH - 1; (j >= 0) && (0 == ++counter[j]); j--)
+        {
+        }
+    }
+    TEST_ASSERT_MEM(data, cipher, sizeof(data));
+}
+
+/* RFC 4493 section 4, the AES-CMAC examples of SP 800-38B */
+static void test_rfc4493_cmac(void)
+{
+    static const uint8_t macs[4][APP_CRYPTO_BLOCK_LENGTH] =
+    {
+        { 0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46 },
+        { 0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c },
+        { 0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27 },
+        { 0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe }
+    };
+    static const uint8_t lengths[4] = { 0, 16, 40, 64 };
+
+    setup();
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint8_t mac[APP_CRYPTO_BLOCK_LENGTH];
+
+        APP_CRYPTO_Cmac(nistKey, nistPlain, lengths[i], mac);
+        TEST_ASSERT_MEM(mac, macs[i], sizeof(mac));
+    }
+    TEST_ASSERT(APP_CRYPTO_SelfTest());
+}
+
+static void test_seal_open(void)
+{
+    static const char reading[] = "X 0.512 Y 0.031 Z 0.998 @1234";
+    uint8_t frame[64];
+    uint8_t length;
+
+    setup();
+    for (uint8_t plain = 0; plain <= 40; plain++)
+    {
+        memcpy(frame, reading, sizeof(reading));
+        memset(&frame[sizeof(reading)], 0xA5, sizeof(frame) - sizeof(reading));
+        length = APP_CRYPTO_Seal(frame, plain, sizeof(frame), APP_CRYPTO_UPLINK, 0x260B1234u, 7, 100u + plain);
+        TEST_ASSERT_EQ(length, plain + APP_CRYPTO_OVERHEAD);
+        TEST_ASSERT_EQ(frame[0], 7);
+        TEST_ASSERT_EQ(APP_CRYPTO_Open(frame, length, APP_CRYPTO_UPLINK, 0x260B1234u, 7, 100u + plain), plain);
+        TEST_ASSERT(0 == memcmp(frame, reading, (plain < sizeof(reading)) ? plain : sizeof(reading)));
+    }
+
+    /* No room for the epoch and the MIC */
+    TEST_ASSERT_EQ(APP_CRYPTO_Seal(frame, 20, 20 + APP_CRYPTO_OVERHEAD - 1u, APP_CRYPTO_UPLINK, 1, 1, 1), 0);
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(frame, APP_CRYPTO_OVERHEAD - 1u, APP_CRYPTO_UPLINK, 1, 1, 1), 0);
+}
+
+/* The same counters in two sessions give different key streams */
+static void test_epoch_separates_sessions(void)
+{
+    uint8_t first[32];
+    uint8_t second[32];
+
+    setup();
+    memset(first, 0, sizeof(first));
+    memset(second, 0, sizeof(second));
+    APP_CRYPTO_Seal(first, 16, sizeof(first), APP_CRYPTO_UPLINK, 0x260B1234u, 1, 0);
+    APP_CRYPTO_Seal(second, 16, sizeof(second), APP_CRYPTO_UPLINK, 0x260B1234u, 2, 0);
+    TEST_ASSERT(0 != memcmp(&first[1], &second[1], 16));
+
+    /* Same low byte of the epoch: still apart, and not opened with the other epoch */
+    memset(second, 0, sizeof(second));
+    APP_CRYPTO_Seal(second, 16, sizeof(second), APP_CRYPTO_UPLINK, 0x260B1234u, 0x101, 0);
+    TEST_ASSERT_EQ(second[0], first[0]);
+    TEST_ASSERT(0 != memcmp(&first[1], &second[1], 16));
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(second, 16 + APP_CRYPTO_OVERHEAD, APP_CRYPTO_UPLINK, 0x260B1234u, 1, 0), 0);
+
+    /* Direction, address and counter are bound as well */
+    memset(second, 0, sizeof(second));
+    APP_CRYPTO_Seal(second, 16, sizeof(second), APP_CRYPTO_DOWNLINK, 0x260B1234u, 1, 0);
+    TEST_ASSERT(0 != memcmp(&first[1], &second[1], 16));
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(first, 16 + APP_CRYPTO_OVERHEAD, APP_CRYPTO_UPLINK, 0x260B1235u, 1, 0), 0);
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(first, 16 + APP_CRYPTO_OVERHEAD, APP_CRYPTO_UPLINK, 0x260B1234u, 1, 1), 0);
+}
+
+/* Two devices on the same DevAddr, epoch and counter, e.g. after the
+   DevAddr was reassigned, get their own key streams and MICs */
+static void test_devices_separated(void)
+{
+    static const uint8_t rootKey[APP_CRYPTO_KEY_LENGTH] =
+    {
+        0x1F, 0x8B, 0x42, 0xD6, 0x7A, 0x03, 0xE5, 0x9C, 0x24, 0xB1, 0x6E, 0x58, 0xF7, 0x0A, 0xC3, 0x91
+    };
+    static const uint8_t devEuiA[APP_CRYPTO_DEV_EUI_LENGTH] = { 0x00, 0x04, 0xA3, 0x0B, 0x00, 0x20, 0x1B, 0x7E };
+    static const uint8_t devEuiB[APP_CRYPTO_DEV_EUI_LENGTH] = { 0x00, 0x04, 0xA3, 0x0B, 0x00, 0x20, 0x1B, 0x7F };
+    uint8_t encA[APP_CRYPTO_KEY_LENGTH], macA[APP_CRYPTO_KEY_LENGTH];
+    uint8_t encB[APP_CRYPTO_KEY_LENGTH], macB[APP_CRYPTO_KEY_LENGTH];
+    uint8_t encNext[APP_CRYPTO_KEY_LENGTH], macNext[APP_CRYPTO_KEY_LENGTH];
+    uint8_t frameA[32];
+    uint8_t frameB[32];
+    uint8_t length;
+
+    TEST_ASSERT(APP_CRYPTO_Init(encKey, macKey, NULL));
+    APP_CRYPTO_DeriveKeys(rootKey, devEuiA, 1, encA, macA);
+    APP_CRYPTO_DeriveKeys(rootKey, devEuiB, 1, encB, macB);
+    APP_CRYPTO_DeriveKeys(rootKey, devEuiA, 2, encNext, macNext);
+    TEST_ASSERT(0 != memcmp(encA, encB, sizeof(encA)));
+    TEST_ASSERT(0 != memcmp(macA, macB, sizeof(macA)));
+    TEST_ASSERT(0 != memcmp(encA, macA, sizeof(encA)));
+    TEST_ASSERT(0 != memcmp(encA, encNext, sizeof(encA)));
+
+    memset(frameA, 0, sizeof(frameA));
+    memset(frameB, 0, sizeof(frameB));
+    TEST_ASSERT(APP_CRYPTO_Init(encA, macA, NULL));
+    length = APP_CRYPTO_Seal(frameA, 16, sizeof(frameA), APP_CRYPTO_UPLINK, 0x260B1234u, 1, 5);
+    TEST_ASSERT(APP_CRYPTO_Init(encB, macB, NULL));
+    TEST_ASSERT_EQ(APP_CRYPTO_Seal(frameB, 16, sizeof(frameB), APP_CRYPTO_UPLINK, 0x260B1234u, 1, 5), length);
+    TEST_ASSERT(0 != memcmp(&frameA[1], &frameB[1], 16));
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(frameA, length, APP_CRYPTO_UPLINK, 0x260B1234u, 1, 5), 0);
+
+    /* Nor with the keys of the next generation of the same device */
+    TEST_ASSERT(APP_CRYPTO_Init(encNext, macNext, NULL));
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(frameA, length, APP_CRYPTO_UPLINK, 0x260B1234u, 1, 5), 0);
+    TEST_ASSERT(APP_CRYPTO_Init(encA, macA, NULL));
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(frameA, length, APP_CRYPTO_UPLINK, 0x260B1234u, 1, 5), 16);
+}
+
+static void test_tampering(void)
+{
+    uint8_t frame[32];
+    uint8_t copy[32];
+    uint8_t length;
+
+    setup();
+    memset(frame, 0x42, sizeof(frame));
+    length = APP_CRYPTO_Seal(frame, 20, sizeof(frame), APP_CRYPTO_UPLINK, 0x01020304u, 3, 99);
+    for (uint8_t i = 0; i < length; i++)
+    {
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            memcpy(copy, frame, sizeof(copy));
+            copy[i] ^= (uint8_t)(1u << bit);
+            TEST_ASSERT_EQ(APP_CRYPTO_Open(copy, length, APP_CRYPTO_UPLINK, 0x01020304u, 3, 99), 0);
+        }
+    }
+    TEST_ASSERT_EQ(APP_CRYPTO_Open(frame, length, APP_CRYPTO_UPLINK, 0x01020304u, 3, 99), 20);
+}
+
+/* A cipher engine failing the self test never lets a frame out in clear */
+static void broken_engine(uint8_t *block, uint8_t *key)
+{
+    (void)key;
+    block[0] ^= 1;
+}
+
+static void test_broken_engine(void)
+{
+    uint8_t frame[32] = { 0 };
+
+    TEST_ASSERT(!APP_CRYPTO_Init(encKey, macKey, broken_engine));
+    TEST_ASSERT_EQ(APP_CRYPTO_Seal(frame, 8, sizeof(frame), APP_CRYPTO_UPLINK, 1, 1, 1), 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_fips197);
+    TEST_RUN(test_sp800_38a_ecb);
+    TEST_RUN(test_sp800_38a_ctr);
+    TEST_RUN(test_rfc4493_cmac);
+    TEST_RUN(test_seal_open);
+    TEST_RUN(test_epoch_separates_sessions);
+    TEST_RUN(test_devices_separated);
+    TEST_RUN(test_tampering);
+    TEST_RUN(test_broken_engine);
+    return TEST_END();
+}
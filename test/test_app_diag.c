@@ -0,0 +1,144 @@
+/**
+* \file  test_app_diag.c
+*
+* \brief Host tests of the stack and scheduling diagnostics, on a stack
+*        stand-in and with made-up task and loop durations
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "app_diag.h"
+
+/****************************** MACROS **************************************/
+#define TEST_STACK_WORDS                    256u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint32_t stack[TEST_STACK_WORDS];
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t get_u32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) | ((uint32_t)buffer[2] << 16) |
+           ((uint32_t)buffer[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+/* Paints the stand-in with the top 32 words live, as at boot */
+static void setup(void)
+{
+    memset(stack, 0, sizeof(stack));
+    APP_DIAG_StackInit(stack, &stack[TEST_STACK_WORDS], &stack[TEST_STACK_WORDS - 32u]);
+    APP_DIAG_Init(0x40);
+}
+
+static void test_stack_high_water(void)
+{
+    setup();
+    TEST_ASSERT_EQ(APP_DIAG_Get()->stackSize, sizeof(stack));
+    TEST_ASSERT_EQ(APP_DIAG_Get()->resetCause, 0x40);
+    TEST_ASSERT_EQ(APP_DIAG_StackUsed(), 32u * 4u);
+
+    /* A deep call, then the stack shrinks back: the mark stays */
+    stack[TEST_STACK_WORDS - 100u] = 0;
+    TEST_ASSERT_EQ(APP_DIAG_StackUsed(), 100u * 4u);
+    stack[TEST_STACK_WORDS - 60u] = 0;
+    TEST_ASSERT_EQ(APP_DIAG_StackUsed(), 100u * 4u);
+
+    /* Overflowed down to the bottom */
+    stack[0] = 0;
+    TEST_ASSERT_EQ(APP_DIAG_StackUsed(), sizeof(stack));
+}
+
+static void test_task_timing(void)
+{
+    setup();
+    APP_DIAG_RecordTask(1, 1000);
+    APP_DIAG_RecordTask(1, 3000);
+    APP_DIAG_RecordTask(1, APP_DIAG_TASK_BUDGET_US);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->task[1].runs, 3);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->task[1].totalUs, 4000u + APP_DIAG_TASK_BUDGET_US);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->task[1].maxUs, APP_DIAG_TASK_BUDGET_US);
+    /* At the budget is not a stall */
+    TEST_ASSERT_EQ(APP_DIAG_Get()->task[1].stalls, 0);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->lastStallUs, 0);
+
+    APP_DIAG_RecordTask(2, 1200000);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->task[2].stalls, 1);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->lastStallId, 2);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->lastStallUs, 1200000);
+
+    /* Unknown tasks are not recorded */
+    APP_DIAG_RecordTask(APP_DIAG_MAX_TASKS, 1200000);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->lastStallId, 2);
+}
+
+static void test_loop_timing(void)
+{
+    setup();
+    APP_DIAG_RecordLoop(10);
+    APP_DIAG_RecordLoop(APP_DIAG_LOOP_BUDGET_US + 1u);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->loop.runs, 2);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->loop.stalls, 1);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->lastStallId, APP_DIAG_LOOP_ID);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->lastStallUs, APP_DIAG_LOOP_BUDGET_US + 1u);
+}
+
+static void test_stall_count_saturates(void)
+{
+    setup();
+    for (uint32_t i = 0; i < 70000u; i++)
+    {
+        APP_DIAG_RecordLoop(APP_DIAG_LOOP_BUDGET_US * 2u);
+    }
+    TEST_ASSERT_EQ(APP_DIAG_Get()->loop.stalls, UINT16_MAX);
+    TEST_ASSERT_EQ(APP_DIAG_Get()->loop.runs, 70000);
+}
+
+static void test_serialize(void)
+{
+    uint8_t record[APP_DIAG_RECORD_LENGTH + 4];
+
+    setup();
+    stack[TEST_STACK_WORDS - 100u] = 0;
+    APP_DIAG_RecordTask(0, 70000);
+    APP_DIAG_RecordTask(3, 90000);
+    APP_DIAG_RecordTask(3, 100);
+    APP_DIAG_RecordLoop(2500000);
+    APP_DIAG_RecordFcnt(12, 1000, 7);
+
+    TEST_ASSERT_EQ(APP_DIAG_Serialize(record, APP_DIAG_RECORD_LENGTH - 1u), 0);
+    memset(record, 0xEE, sizeof(record));
+    TEST_ASSERT_EQ(APP_DIAG_Serialize(record, sizeof(record)), APP_DIAG_RECORD_LENGTH);
+    TEST_ASSERT_EQ(record[0], APP_DIAG_RECORD_VERSION);
+    TEST_ASSERT_EQ(record[1], 0x40);
+    TEST_ASSERT_EQ(get_u16(&record[2]), 400);
+    TEST_ASSERT_EQ(get_u16(&record[4]), sizeof(stack));
+    TEST_ASSERT_EQ(get_u32(&record[6]), 90000);
+    TEST_ASSERT_EQ(get_u32(&record[10]), 2500000);
+    TEST_ASSERT_EQ(get_u16(&record[14]), 2);
+    TEST_ASSERT_EQ(get_u16(&record[16]), 1);
+    TEST_ASSERT_EQ(record[18], APP_DIAG_LOOP_ID);
+    TEST_ASSERT_EQ(record[19] | (record[20] << 8) | (record[21] << 16), 2500);
+    TEST_ASSERT_EQ(get_u16(&record[22]), 12);
+    TEST_ASSERT_EQ(get_u16(&record[24]), 7);
+    /* Nothing written past the record */
+    TEST_ASSERT_EQ(record[APP_DIAG_RECORD_LENGTH], 0xEE);
+
+    APP_DIAG_Print();
+}
+
+int main(void)
+{
+    TEST_RUN(test_stack_high_water);
+    TEST_RUN(test_task_timing);
+    TEST_RUN(test_loop_timing);
+    TEST_RUN(test_stall_count_saturates);
+    TEST_RUN(test_serialize);
+    return TEST_END();
+}
@@ -0,0 +1,270 @@
+/**
+* \file  test_app_timer.c
+*
+* \brief Host tests of the application timer service on a virtual clock,
+*        with the wakeups counted with and without coalescing
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "app_timer.h"
+
+/****************************** MACROS **************************************/
+#define MS_TO_US(ms)                        ((uint32_t)(ms) * 1000u)
+
+/****************************** TYPES **************************************/
+/* Timer restarting itself every period, as the countdown and the LED do */
+typedef struct _TestPeriodic_t
+{
+    uint8_t id;
+    uint32_t periodUs;
+    uint32_t slackUs;
+    uint64_t expiry;
+    uint32_t fired;
+    uint64_t maxLateUs;
+} TestPeriodic_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint64_t clockUs;
+static bool armed;
+static uint64_t armedAtUs;
+static uint32_t arms;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint64_t clock_now(void)
+{
+    return clockUs;
+}
+
+static void clock_arm(uint32_t delayUs)
+{
+    armed = true;
+    armedAtUs = clockUs + delayUs;
+    arms++;
+}
+
+static void clock_disarm(void)
+{
+    armed = false;
+}
+
+static const AppTimerOps_t virtualOps = { clock_now, clock_arm, clock_disarm };
+
+static void setup(void)
+{
+    clockUs = 0;
+    armed = false;
+    arms = 0;
+    APP_TIMER_Init(&virtualOps);
+}
+
+/* Sleeps until the underlying timer expires, false when it is not armed */
+static bool run_next(uint64_t untilUs)
+{
+    if (!armed || (armedAtUs > untilUs))
+    {
+        clockUs = untilUs;
+        return false;
+    }
+    clockUs = armedAtUs;
+    armed = false;
+    APP_TIMER_Expired();
+    return true;
+}
+
+static void periodic_cb(void *param)
+{
+    TestPeriodic_t *timer = param;
+
+    TEST_ASSERT(clockUs >= timer->expiry);
+    if ((clockUs - timer->expiry) > timer->maxLateUs)
+    {
+        timer->maxLateUs = clockUs - timer->expiry;
+    }
+    timer->fired++;
+    timer->expiry = clockUs + timer->periodUs;
+    APP_TIMER_Start(timer->id, timer->periodUs, timer->slackUs, periodic_cb, timer);
+}
+
+static void periodic_start(TestPeriodic_t *timer, uint32_t periodUs, uint32_t slackUs)
+{
+    TEST_ASSERT(APP_TIMER_Create(&timer->id));
+    timer->periodUs = periodUs;
+    timer->slackUs = slackUs;
+    timer->fired = 0;
+    timer->maxLateUs = 0;
+    timer->expiry = clockUs + periodUs;
+    APP_TIMER_Start(timer->id, periodUs, slackUs, periodic_cb, timer);
+}
+
+static void count_cb(void *param)
+{
+    (*(uint32_t *)param)++;
+}
+
+static void test_create_exhausts(void)
+{
+    uint8_t id;
+
+    setup();
+    for (uint8_t i = 0; i < APP_TIMER_COUNT; i++)
+    {
+        TEST_ASSERT(APP_TIMER_Create(&id));
+        TEST_ASSERT_EQ(id, i);
+    }
+    TEST_ASSERT(!APP_TIMER_Create(&id));
+    TEST_ASSERT_EQ(id, APP_TIMER_INVALID_ID);
+    /* Not created or invalid ids are ignored */
+    APP_TIMER_Start(APP_TIMER_INVALID_ID, 1000, 0, count_cb, NULL);
+    TEST_ASSERT(!APP_TIMER_IsRunning(APP_TIMER_INVALID_ID));
+}
+
+static void test_one_shot(void)
+{
+    uint32_t count = 0;
+    uint8_t id;
+
+    setup();
+    APP_TIMER_Create(&id);
+    APP_TIMER_Start(id, MS_TO_US(100), MS_TO_US(10), count_cb, &count);
+    TEST_ASSERT(armed);
+    /* Armed for the expiry + slack */
+    TEST_ASSERT_EQ(armedAtUs, MS_TO_US(110));
+    TEST_ASSERT(APP_TIMER_IsRunning(id));
+    TEST_ASSERT(run_next(UINT64_MAX));
+    TEST_ASSERT_EQ(count, 1);
+    TEST_ASSERT(!APP_TIMER_IsRunning(id));
+    TEST_ASSERT(!armed);
+}
+
+static void test_stop(void)
+{
+    uint32_t count = 0;
+    uint8_t a;
+    uint8_t b;
+
+    setup();
+    APP_TIMER_Create(&a);
+    APP_TIMER_Create(&b);
+    APP_TIMER_Start(a, MS_TO_US(100), 0, count_cb, &count);
+    APP_TIMER_Start(b, MS_TO_US(300), 0, count_cb, &count);
+    APP_TIMER_Stop(a);
+    TEST_ASSERT_EQ(armedAtUs, MS_TO_US(300));
+    APP_TIMER_Stop(b);
+    TEST_ASSERT(!armed);
+    TEST_ASSERT(!run_next(MS_TO_US(1000)));
+    TEST_ASSERT_EQ(count, 0);
+}
+
+/* A timer due within the slack of the earliest one fires in the same wakeup */
+static void test_merge(void)
+{
+    uint32_t count = 0;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+
+    setup();
+    APP_TIMER_Create(&a);
+    APP_TIMER_Create(&b);
+    APP_TIMER_Create(&c);
+    APP_TIMER_Start(a, MS_TO_US(100), MS_TO_US(50), count_cb, &count);
+    APP_TIMER_Start(b, MS_TO_US(140), MS_TO_US(50), count_cb, &count);
+    APP_TIMER_Start(c, MS_TO_US(160), MS_TO_US(50), count_cb, &count);
+    TEST_ASSERT(run_next(UINT64_MAX));
+    TEST_ASSERT_EQ(clockUs, MS_TO_US(150));
+    TEST_ASSERT_EQ(count, 2);
+    TEST_ASSERT(APP_TIMER_IsRunning(c));
+    TEST_ASSERT(run_next(UINT64_MAX));
+    TEST_ASSERT_EQ(count, 3);
+    TEST_ASSERT_EQ(APP_TIMER_GetStats()->wakeups, 2);
+    TEST_ASSERT_EQ(APP_TIMER_GetStats()->fired, 3);
+}
+
+/* An expiry in the past is armed with the shortest delay */
+static void test_min_delay(void)
+{
+    uint32_t count = 0;
+    uint8_t id;
+
+    setup();
+    APP_TIMER_Create(&id);
+    APP_TIMER_Start(id, 0, 0, count_cb, &count);
+    TEST_ASSERT_EQ(armedAtUs, APP_TIMER_MIN_DELAY_US);
+    TEST_ASSERT(run_next(UINT64_MAX));
+    TEST_ASSERT_EQ(count, 1);
+}
+
+/* The underlying timer is armed once per wakeup, not once per restart */
+static void test_restart_from_callback(void)
+{
+    TestPeriodic_t a;
+    TestPeriodic_t b;
+
+    setup();
+    periodic_start(&a, MS_TO_US(1000), 0);
+    periodic_start(&b, MS_TO_US(1000), 0);
+    arms = 0;
+    TEST_ASSERT(run_next(UINT64_MAX));
+    TEST_ASSERT_EQ(a.fired, 1);
+    TEST_ASSERT_EQ(b.fired, 1);
+    TEST_ASSERT_EQ(arms, 1);
+    TEST_ASSERT_EQ(armedAtUs, MS_TO_US(2000));
+}
+
+/* Timers of the demo over ten minutes, returns the wakeups */
+static uint32_t demo_wakeups(bool coalesce, uint64_t *maxLateUs)
+{
+    TestPeriodic_t timers[4];
+    static const uint32_t periodsMs[4] = { 1000, 700, 5030, 7300 };
+    static const uint32_t slacksMs[4] = { 100, 50, 20, 100 };
+
+    setup();
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        periodic_start(&timers[i], MS_TO_US(periodsMs[i]), coalesce ? MS_TO_US(slacksMs[i]) : 0u);
+    }
+    while (run_next(MS_TO_US(600000)))
+    {
+    }
+
+    *maxLateUs = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        /* Never later than its slack, never skipped */
+        TEST_ASSERT(timers[i].maxLateUs <= timers[i].slackUs);
+        TEST_ASSERT(timers[i].fired >= (600000u / (periodsMs[i] + slacksMs[i])));
+        if (timers[i].maxLateUs > *maxLateUs)
+        {
+            *maxLateUs = timers[i].maxLateUs;
+        }
+    }
+    return APP_TIMER_GetStats()->wakeups;
+}
+
+static void test_coalescing_wakeups(void)
+{
+    uint64_t lateUs;
+    uint64_t coalescedLateUs;
+    uint32_t separate = demo_wakeups(false, &lateUs);
+    uint32_t coalesced = demo_wakeups(true, &coalescedLateUs);
+
+    printf("app_timer: 10 min of 4 periodic timers, %lu wakeups without slack, %lu with, max late %lu us\n",
+           (unsigned long)separate, (unsigned long)coalesced, (unsigned long)coalescedLateUs);
+    TEST_ASSERT_EQ(lateUs, 0);
+    TEST_ASSERT(coalesced < separate);
+}
+
+int main(void)
+{
+    TEST_RUN(test_create_exhausts);
+    TEST_RUN(test_one_shot);
+    TEST_RUN(test_stop);
+    TEST_RUN(test_merge);
+    TEST_RUN(test_min_delay);
+    TEST_RUN(test_restart_from_callback);
+    TEST_RUN(test_coalescing_wakeups);
+    return TEST_END();
+}
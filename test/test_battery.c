@@ -0,0 +1,257 @@
+/**
+* \file  test_battery.c
+*
+* \brief Host tests of the battery power tiers against discharge curves
+*
+* Every curve is replayed as one VBAT reading per wakeup from full to
+* empty, with the dips of the radio transmissions on top of some of the
+* readings.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "battery.h"
+
+/****************************** MACROS **************************************/
+#define TEST_READINGS                       2000u
+
+/****************************** TYPES **************************************/
+typedef struct _TestCurve_t
+{
+    const char *name;
+    /* Voltage at 0, 10, ... 100 percent of the discharge time */
+    uint16_t mv[11];
+    /* Dip of the readings taken during a transmission, every sagEvery-th */
+    uint16_t sagMv;
+    uint8_t sagEvery;
+} TestCurve_t;
+
+typedef struct _TestRun_t
+{
+    /* Reading at which every tier was entered first, TEST_READINGS if never */
+    uint16_t entered[BATTERY_TIER_COUNT];
+    uint8_t changes;
+    bool wentUp;
+} TestRun_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const TestCurve_t testCurves[] =
+{
+    /* Two alkaline AA cells, the curve of battery.c */
+    { "alkaline", { 3200, 3020, 2900, 2800, 2700, 2620, 2550, 2480, 2400, 2200, 2000 }, 0, 0 },
+    /* The same cells with the transmissions dipping the supply */
+    { "alkaline_tx", { 3200, 3020, 2900, 2800, 2700, 2620, 2550, 2480, 2400, 2200, 2000 }, 180, 12 },
+    /* Flat curve, then a steep knee */
+    { "flat_knee", { 3150, 3100, 3080, 3060, 3040, 3020, 3000, 2950, 2700, 2300, 2000 }, 120, 5 },
+    /* Cold cells: lower and noisier */
+    { "cold", { 3000, 2820, 2720, 2640, 2560, 2500, 2440, 2360, 2250, 2100, 1950 }, 250, 3 }
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Voltage of the curve after reading i of TEST_READINGS, without the dips */
+static uint16_t curve_mv(const TestCurve_t *curve, uint16_t i)
+{
+    uint32_t position = (uint32_t)i * 1000u / TEST_READINGS;
+    uint8_t step = (uint8_t)(position / 100u);
+    uint32_t fraction = position % 100u;
+
+    if (step >= 10u)
+    {
+        return curve->mv[10];
+    }
+    return (uint16_t)(curve->mv[step] - ((uint32_t)(curve->mv[step] - curve->mv[step + 1u]) * fraction) / 100u);
+}
+
+static uint16_t reading_mv(const TestCurve_t *curve, uint16_t i)
+{
+    uint16_t mv = curve_mv(curve, i);
+
+    if ((0u != curve->sagEvery) && (0u == (i % curve->sagEvery)))
+    {
+        mv = (uint16_t)(mv - curve->sagMv);
+    }
+    return mv;
+}
+
+static void run_curve(const TestCurve_t *curve, TestRun_t *run)
+{
+    BatteryTier_t previous = BATTERY_TIER_NORMAL;
+
+    memset(run, 0, sizeof(*run));
+    for (uint8_t t = 0; t < BATTERY_TIER_COUNT; t++)
+    {
+        run->entered[t] = TEST_READINGS;
+    }
+    run->entered[BATTERY_TIER_NORMAL] = 0;
+
+    BATTERY_Init();
+    for (uint16_t i = 0; i < TEST_READINGS; i++)
+    {
+        BatteryTier_t tier = BATTERY_Update(reading_mv(curve, i));
+
+        if (tier != previous)
+        {
+            run->changes++;
+            run->wentUp |= (tier < previous);
+            if (TEST_READINGS == run->entered[tier])
+            {
+                run->entered[tier] = i;
+            }
+        }
+        TEST_ASSERT_EQ(BATTERY_GetTier(), tier);
+        previous = tier;
+    }
+}
+
+static void test_soc_curve(void)
+{
+    uint8_t previous = 100;
+
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(3600), 100);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(3200), 100);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(2900), 80);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(2800), 70);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(2400), 20);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(2000), 0);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(1500), 0);
+    TEST_ASSERT_EQ(BATTERY_SocFromMv(0), 0);
+
+    /* Never rises as the voltage drops */
+    for (uint16_t mv = 3300; mv >= 1900; mv--)
+    {
+        uint8_t soc = BATTERY_SocFromMv(mv);
+
+        TEST_ASSERT(soc <= previous);
+        previous = soc;
+    }
+}
+
+/* From full to empty every curve goes through the tiers once, in order */
+static void test_discharge_curves(void)
+{
+    for (uint8_t c = 0; c < sizeof(testCurves) / sizeof(testCurves[0]); c++)
+    {
+        const TestCurve_t *curve = &testCurves[c];
+        TestRun_t run;
+
+        testName = curve->name;
+        run_curve(curve, &run);
+        TEST_ASSERT_EQ(run.changes, 2);
+        TEST_ASSERT(!run.wentUp);
+        TEST_ASSERT(run.entered[BATTERY_TIER_SAVE] < run.entered[BATTERY_TIER_CRITICAL]);
+        TEST_ASSERT(run.entered[BATTERY_TIER_CRITICAL] < TEST_READINGS);
+        /* Entered close to the charge of the tier, the dips taking it a little early */
+        TEST_ASSERT(BATTERY_SocFromMv(curve_mv(curve, run.entered[BATTERY_TIER_SAVE])) <=
+                    BATTERY_SAVE_ENTER_SOC + 6u);
+        TEST_ASSERT(BATTERY_SocFromMv(curve_mv(curve, run.entered[BATTERY_TIER_SAVE])) >=
+                    BATTERY_SAVE_ENTER_SOC - 3u);
+        TEST_ASSERT(BATTERY_SocFromMv(curve_mv(curve, run.entered[BATTERY_TIER_CRITICAL])) <=
+                    BATTERY_CRITICAL_ENTER_SOC + 6u);
+        TEST_ASSERT(BATTERY_GetTier() == BATTERY_TIER_CRITICAL);
+        printf("%s: save at reading %u, critical at %u\n", curve->name, run.entered[BATTERY_TIER_SAVE],
+               run.entered[BATTERY_TIER_CRITICAL]);
+    }
+    testName = "test_discharge_curves";
+}
+
+/* One dip, even deep, does not change the tier */
+static void test_single_dip(void)
+{
+    BATTERY_Init();
+    for (uint8_t i = 0; i < 50u; i++)
+    {
+        BATTERY_Update(2700);
+    }
+    TEST_ASSERT_EQ(BATTERY_GetTier(), BATTERY_TIER_NORMAL);
+    TEST_ASSERT_EQ(BATTERY_Update(2100), BATTERY_TIER_NORMAL);
+    TEST_ASSERT_EQ(BATTERY_Update(2700), BATTERY_TIER_NORMAL);
+}
+
+/* A voltage wandering around an entry level does not make the tier flap */
+static void test_hysteresis(void)
+{
+    /* 30 % is 2475 mV on the curve */
+    uint8_t changes = 0;
+    BatteryTier_t previous;
+
+    BATTERY_Init();
+    for (uint8_t i = 0; i < 50u; i++)
+    {
+        BATTERY_Update(2450);
+    }
+    previous = BATTERY_GetTier();
+    TEST_ASSERT_EQ(previous, BATTERY_TIER_SAVE);
+    for (uint16_t i = 0; i < 500u; i++)
+    {
+        BatteryTier_t tier = BATTERY_Update((i & 4u) ? 2440u : 2505u);
+
+        changes += (tier != previous) ? 1u : 0u;
+        previous = tier;
+    }
+    TEST_ASSERT_EQ(changes, 0);
+    TEST_ASSERT_EQ(BATTERY_GetTier(), BATTERY_TIER_SAVE);
+
+    /* Clear of the hysteresis the tier is left */
+    for (uint8_t i = 0; i < 50u; i++)
+    {
+        BATTERY_Update(2560);
+    }
+    TEST_ASSERT_EQ(BATTERY_GetTier(), BATTERY_TIER_NORMAL);
+}
+
+/* New cells bring the device back to the normal tier */
+static void test_battery_swap(void)
+{
+    TestRun_t run;
+
+    run_curve(&testCurves[0], &run);
+    TEST_ASSERT_EQ(BATTERY_GetTier(), BATTERY_TIER_CRITICAL);
+    for (uint8_t i = 0; i < 50u; i++)
+    {
+        BATTERY_Update(3200);
+    }
+    TEST_ASSERT_EQ(BATTERY_GetTier(), BATTERY_TIER_NORMAL);
+    TEST_ASSERT(BATTERY_GetSoc() >= 95u);
+}
+
+/* The policies only get more frugal down the tiers */
+static void test_policies(void)
+{
+    const BatteryPolicy_t *previous = NULL;
+    static const uint16_t levels[BATTERY_TIER_COUNT] = { 3200, 2420, 2100 };
+
+    for (uint8_t t = 0; t < BATTERY_TIER_COUNT; t++)
+    {
+        const BatteryPolicy_t *policy;
+
+        BATTERY_Init();
+        for (uint8_t i = 0; i < 50u; i++)
+        {
+            BATTERY_Update(levels[t]);
+        }
+        TEST_ASSERT_EQ(BATTERY_GetTier(), t);
+        policy = BATTERY_GetPolicy();
+        TEST_ASSERT(policy->sleepMultiplier >= 1u);
+        TEST_ASSERT(policy->statusScale >= 1u);
+        if (NULL != previous)
+        {
+            TEST_ASSERT(policy->sleepMultiplier >= previous->sleepMultiplier);
+            TEST_ASSERT(policy->statusScale >= previous->statusScale);
+            TEST_ASSERT(!policy->ledEnabled || previous->ledEnabled);
+        }
+        previous = policy;
+    }
+    TEST_ASSERT(!previous->ledEnabled);
+}
+
+int main(void)
+{
+    TEST_RUN(test_soc_curve);
+    TEST_RUN(test_discharge_curves);
+    TEST_RUN(test_single_dip);
+    TEST_RUN(test_hysteresis);
+    TEST_RUN(test_battery_swap);
+    TEST_RUN(test_policies);
+    return TEST_END();
+}
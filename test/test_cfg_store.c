@@ -0,0 +1,385 @@
+/**
+* \file  test_cfg_store.c
+*
+* \brief Host tests of the site configuration record on the NVM stand-in
+*
+* The schema 1 record is built byte by byte here, as a device in the field
+* holds it: whatever the schema of a later firmware, this record must keep
+* loading, as CFG_STORE_MIGRATED once a schema 2 is added.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "nvm_ram.h"
+#include "cfg_store.h"
+
+/****************************** MACROS **************************************/
+#define TEST_CFG_OFFSET                     0xC400u
+/* Bytes of the schema 1 fields */
+#define TEST_V1_LENGTH                      84u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const CfgValues_t testDefaults =
+{
+    2, 0, 0, 2, { 5.0f, 60000u, 3, 10 }, false, 0, 0x00000000u, { 0 }, { 0 }, { 0 }, { 0 }
+};
+
+static const AppNvmOps_t *nvm;
+
+/***************************** FUNCTIONS ***************************************/
+
+static void put_u16(uint8_t *data, uint16_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t *data, uint32_t value)
+{
+    put_u16(data, (uint16_t)value);
+    put_u16(&data[2], (uint16_t)(value >> 16));
+}
+
+/* Schema 1 fields of a site, in their stored order */
+static uint8_t build_v1_fields(uint8_t *data, uint8_t fport, uint8_t subband)
+{
+    float threshold = 7.5f;
+    uint8_t *field = data;
+
+    *field++ = fport;
+    /* Class C, ABP */
+    *field++ = 2;
+    *field++ = 1;
+    *field++ = subband;
+    memcpy(field, &threshold, sizeof(threshold));
+    field += 4;
+    put_u32(field, 30000u);
+    field += 4;
+    *field++ = 5;
+    *field++ = 20;
+    *field++ = 1;
+    *field++ = 3;
+    put_u32(field, 0x01FF0042u);
+    field += 4;
+    /* Multicast NwkSKey and AppSKey, payload encryption and MAC keys */
+    for (uint8_t i = 0; i < 4u * CFG_STORE_KEY_LENGTH; i++)
+    {
+        *field++ = (uint8_t)(0xA0u + i);
+    }
+    return (uint8_t)(field - data);
+}
+
+/* Writes a record to a slot of the stand-in as the flash holds it */
+static void write_record(uint8_t slot, uint8_t version, uint16_t sequence, const uint8_t *fields, uint8_t length)
+{
+    uint8_t *row = NVM_RAM_Data() + TEST_CFG_OFFSET + slot * APP_NVM_ROW_SIZE;
+
+    memset(row, 0xFF, APP_NVM_ROW_SIZE);
+    put_u16(&row[0], CFG_STORE_MAGIC);
+    row[2] = version;
+    row[3] = length;
+    put_u16(&row[4], sequence);
+    memcpy(&row[6], fields, length);
+    put_u16(&row[6u + length], CFG_STORE_Crc16(row, (uint16_t)(6u + length)));
+}
+
+static CfgStoreSource_t load(void)
+{
+    return CFG_STORE_Load(nvm, TEST_CFG_OFFSET, &testDefaults);
+}
+
+static void setup(void)
+{
+    nvm = NVM_RAM_Init();
+}
+
+static void assert_site_v1(void)
+{
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), 10);
+    TEST_ASSERT_EQ(CFG_STORE_Class(), 2);
+    TEST_ASSERT_EQ(CFG_STORE_ActivationType(), 1);
+    TEST_ASSERT_EQ(CFG_STORE_Subband(), 2);
+    TEST_ASSERT(7.5f == CFG_STORE_Params()->alarmThreshold);
+    TEST_ASSERT_EQ(CFG_STORE_Params()->samplePeriodMs, 30000);
+    TEST_ASSERT_EQ(CFG_STORE_Params()->confirmCount, 5);
+    TEST_ASSERT_EQ(CFG_STORE_Params()->statusPeriods, 20);
+    TEST_ASSERT(CFG_STORE_McastEnable());
+    TEST_ASSERT_EQ(CFG_STORE_McastGroupId(), 3);
+    TEST_ASSERT_EQ(CFG_STORE_McastGroupAddr(), 0x01FF0042u);
+    TEST_ASSERT_EQ(CFG_STORE_McastNwkSKey()[0], 0xA0);
+    TEST_ASSERT_EQ(CFG_STORE_McastAppSKey()[15], 0xA0 + 31);
+    TEST_ASSERT_EQ(CFG_STORE_PayloadEncKey()[0], 0xA0 + 32);
+    TEST_ASSERT_EQ(CFG_STORE_PayloadMacKey()[15], 0xA0 + 63);
+    TEST_ASSERT(CFG_STORE_PayloadKeysSet());
+}
+
+static bool same_values(const CfgValues_t *a, const CfgValues_t *b)
+{
+    return (a->fport == b->fport) && (a->edClass == b->edClass) && (a->subband == b->subband) &&
+           (a->params.samplePeriodMs == b->params.samplePeriodMs) && (a->mcastEnable == b->mcastEnable) &&
+           (a->mcastGroupAddr == b->mcastGroupAddr) &&
+           (0 == memcmp(a->mcastAppSKey, b->mcastAppSKey, CFG_STORE_KEY_LENGTH)) &&
+           (0 == memcmp(a->payloadEncKey, b->payloadEncKey, CFG_STORE_KEY_LENGTH)) &&
+           (0 == memcmp(a->payloadMacKey, b->payloadMacKey, CFG_STORE_KEY_LENGTH));
+}
+
+static void test_crc(void)
+{
+    TEST_ASSERT_EQ(CFG_STORE_Crc16((const uint8_t *)"123456789", 9), 0x29B1);
+    TEST_ASSERT_EQ(CFG_STORE_Crc16(NULL, 0), 0xFFFF);
+}
+
+static void test_blank(void)
+{
+    setup();
+    TEST_ASSERT_EQ(load(), CFG_STORE_DEFAULTS);
+    TEST_ASSERT(same_values(cfgStoreValues, &testDefaults));
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), 2);
+    TEST_ASSERT(!CFG_STORE_PayloadKeysSet());
+}
+
+/* The layout of schema 1 as the devices in the field hold it */
+static void test_schema1_layout(void)
+{
+    uint8_t fields[96];
+
+    setup();
+    TEST_ASSERT_EQ(build_v1_fields(fields, 10, 2), TEST_V1_LENGTH);
+    write_record(0, 1, 7, fields, TEST_V1_LENGTH);
+    TEST_ASSERT_EQ(load(), (CFG_STORE_VERSION > 1u) ? CFG_STORE_MIGRATED : CFG_STORE_LOADED);
+    assert_site_v1();
+}
+
+/* A record of a newer firmware, after a downgrade: its first fields are used */
+static void test_newer_schema(void)
+{
+    uint8_t fields[96];
+    uint8_t length;
+
+    setup();
+    length = build_v1_fields(fields, 10, 2);
+    memset(&fields[length], 0x5A, 6);
+    write_record(1, CFG_STORE_VERSION + 1u, 3, fields, (uint8_t)(length + 6u));
+    TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+    assert_site_v1();
+
+    /* But not when it lacks one of the current fields */
+    write_record(1, CFG_STORE_VERSION + 1u, 3, fields, (uint8_t)(length - 1u));
+    TEST_ASSERT_EQ(load(), CFG_STORE_DEFAULTS);
+    TEST_ASSERT(same_values(cfgStoreValues, &testDefaults));
+}
+
+/* A record of a known schema holds exactly its fields */
+static void test_wrong_length(void)
+{
+    uint8_t fields[96];
+
+    setup();
+    build_v1_fields(fields, 10, 2);
+    write_record(0, 1, 1, fields, TEST_V1_LENGTH - 1u);
+    TEST_ASSERT_EQ(load(), CFG_STORE_DEFAULTS);
+    write_record(0, 1, 1, fields, TEST_V1_LENGTH + 1u);
+    TEST_ASSERT_EQ(load(), CFG_STORE_DEFAULTS);
+    TEST_ASSERT(same_values(cfgStoreValues, &testDefaults));
+
+    /* Version 0 and a length past the row are not records */
+    write_record(0, 0, 1, fields, TEST_V1_LENGTH);
+    TEST_ASSERT_EQ(load(), CFG_STORE_DEFAULTS);
+    write_record(0, 1, 1, fields, TEST_V1_LENGTH);
+    NVM_RAM_Data()[TEST_CFG_OFFSET + 3] = 0xFF;
+    TEST_ASSERT_EQ(load(), CFG_STORE_DEFAULTS);
+}
+
+/* The newest record wins, the sequence wrapping included */
+static void test_newest_slot(void)
+{
+    uint8_t fields[96];
+
+    setup();
+    build_v1_fields(fields, 10, 2);
+    write_record(0, 1, 5, fields, TEST_V1_LENGTH);
+    build_v1_fields(fields, 11, 2);
+    write_record(1, 1, 6, fields, TEST_V1_LENGTH);
+    load();
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), 11);
+
+    write_record(0, 1, 0, fields, TEST_V1_LENGTH);
+    build_v1_fields(fields, 12, 2);
+    write_record(1, 1, 0xFFFFu, fields, TEST_V1_LENGTH);
+    load();
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), 11);
+
+    /* A corrupted newest record falls back to the other one */
+    NVM_RAM_Data()[TEST_CFG_OFFSET + 10] ^= 0x01;
+    load();
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), 12);
+}
+
+/* Out of range settings take their defaults, the others are kept */
+static void test_sanitize(void)
+{
+    uint8_t fields[96];
+    float nan = 0.0f / 0.0f;
+
+    setup();
+    build_v1_fields(fields, 0, 9);
+    memcpy(&fields[4], &nan, sizeof(nan));
+    fields[14] = 7;
+    write_record(0, 1, 1, fields, TEST_V1_LENGTH);
+    TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), testDefaults.fport);
+    TEST_ASSERT_EQ(CFG_STORE_Subband(), testDefaults.subband);
+    TEST_ASSERT_EQ(CFG_STORE_Params()->samplePeriodMs, testDefaults.params.samplePeriodMs);
+    TEST_ASSERT_EQ(CFG_STORE_Class(), 2);
+    TEST_ASSERT(CFG_STORE_McastEnable());
+
+    build_v1_fields(fields, 224, 2);
+    write_record(0, 1, 1, fields, TEST_V1_LENGTH);
+    load();
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), testDefaults.fport);
+}
+
+/* A save applies at the next boot and alternates the rows */
+static void test_save_and_reload(void)
+{
+    CfgValues_t values = testDefaults;
+
+    setup();
+    load();
+    values.fport = 42;
+    values.mcastEnable = true;
+    values.mcastGroupAddr = 0x12345678u;
+    TEST_ASSERT(CFG_STORE_Save(&values));
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), 2);
+    TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+    TEST_ASSERT(same_values(cfgStoreValues, &values));
+
+    for (uint8_t i = 0; i < 5u; i++)
+    {
+        values.fport = (uint8_t)(50u + i);
+        TEST_ASSERT(CFG_STORE_Save(&values));
+        TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+        TEST_ASSERT_EQ(CFG_STORE_FPort(), 50 + i);
+    }
+    /* Both rows hold a record */
+    TEST_ASSERT_EQ(NVM_RAM_Data()[TEST_CFG_OFFSET + 2], CFG_STORE_VERSION);
+    TEST_ASSERT_EQ(NVM_RAM_Data()[TEST_CFG_OFFSET + APP_NVM_ROW_SIZE + 2], CFG_STORE_VERSION);
+}
+
+/* A schema 1 record rewritten by this firmware keeps its settings */
+static void test_migrate_on_save(void)
+{
+    uint8_t fields[96];
+    CfgValues_t values;
+
+    setup();
+    build_v1_fields(fields, 10, 2);
+    write_record(0, 1, 0xFFFFu, fields, TEST_V1_LENGTH);
+    load();
+    values = *cfgStoreValues;
+    values.params.samplePeriodMs = 120000u;
+    TEST_ASSERT(CFG_STORE_Save(&values));
+    TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+    TEST_ASSERT_EQ(NVM_RAM_Data()[TEST_CFG_OFFSET + APP_NVM_ROW_SIZE + 2], CFG_STORE_VERSION);
+    TEST_ASSERT_EQ(CFG_STORE_Params()->samplePeriodMs, 120000);
+    TEST_ASSERT_EQ(CFG_STORE_McastGroupAddr(), 0x01FF0042u);
+}
+
+/* Cut at every byte of a save: the old or the new record, never the defaults */
+static void test_power_cut(void)
+{
+    CfgValues_t before = testDefaults;
+    CfgValues_t after = testDefaults;
+    uint16_t cuts = 0;
+
+    before.fport = 20;
+    after.fport = 21;
+    after.mcastGroupAddr = 0xCAFE0001u;
+    for (uint32_t cut = 0; cut <= 6u + TEST_V1_LENGTH + 2u; cut++)
+    {
+        bool saved;
+
+        setup();
+        load();
+        TEST_ASSERT(CFG_STORE_Save(&before));
+        load();
+        NVM_RAM_CutAfter(cut);
+        saved = CFG_STORE_Save(&after);
+        TEST_ASSERT_EQ(saved, !NVM_RAM_PowerCut());
+        cuts += saved ? 0u : 1u;
+        NVM_RAM_CutAfter(NVM_RAM_NO_CUT);
+        TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+        TEST_ASSERT(same_values(cfgStoreValues, saved ? &after : &before));
+    }
+    TEST_ASSERT_EQ(cuts, 6u + TEST_V1_LENGTH + 2u);
+}
+
+/* Only two keys of the device are a provisioned set */
+static void test_payload_keys(void)
+{
+    CfgValues_t values = testDefaults;
+
+    setup();
+    load();
+    memset(values.payloadEncKey, 0x3C, CFG_STORE_KEY_LENGTH);
+    TEST_ASSERT(CFG_STORE_Save(&values));
+    load();
+    TEST_ASSERT(!CFG_STORE_PayloadKeysSet());
+
+    memset(values.payloadMacKey, 0xFF, CFG_STORE_KEY_LENGTH);
+    TEST_ASSERT(CFG_STORE_Save(&values));
+    load();
+    TEST_ASSERT(!CFG_STORE_PayloadKeysSet());
+
+    values.payloadMacKey[7] = 0x00;
+    TEST_ASSERT(CFG_STORE_Save(&values));
+    load();
+    TEST_ASSERT(CFG_STORE_PayloadKeysSet());
+    TEST_ASSERT_EQ(CFG_STORE_PayloadEncKey()[15], 0x3C);
+    /* Runtime parameters keep the keys */
+    values.params.confirmCount = 7;
+    TEST_ASSERT(CFG_STORE_SaveParams(&values.params));
+    load();
+    TEST_ASSERT(CFG_STORE_PayloadKeysSet());
+}
+
+/* Runtime parameters are only written when they change */
+static void test_save_params(void)
+{
+    AppParams_t params = testDefaults.params;
+    uint32_t writes;
+
+    setup();
+    load();
+    writes = NVM_RAM_GetStats()->writes;
+    TEST_ASSERT(CFG_STORE_SaveParams(&params));
+    TEST_ASSERT_EQ(NVM_RAM_GetStats()->writes, writes);
+
+    params.confirmCount = 9;
+    TEST_ASSERT(CFG_STORE_SaveParams(&params));
+    TEST_ASSERT(NVM_RAM_GetStats()->writes > writes);
+    writes = NVM_RAM_GetStats()->writes;
+    TEST_ASSERT(CFG_STORE_SaveParams(&params));
+    TEST_ASSERT_EQ(NVM_RAM_GetStats()->writes, writes);
+
+    TEST_ASSERT_EQ(load(), CFG_STORE_LOADED);
+    TEST_ASSERT_EQ(CFG_STORE_Params()->confirmCount, 9);
+    TEST_ASSERT_EQ(CFG_STORE_FPort(), testDefaults.fport);
+}
+
+int main(void)
+{
+    TEST_RUN(test_crc);
+    TEST_RUN(test_blank);
+    TEST_RUN(test_schema1_layout);
+    TEST_RUN(test_newer_schema);
+    TEST_RUN(test_wrong_length);
+    TEST_RUN(test_newest_slot);
+    TEST_RUN(test_sanitize);
+    TEST_RUN(test_save_and_reload);
+    TEST_RUN(test_migrate_on_save);
+    TEST_RUN(test_power_cut);
+    TEST_RUN(test_save_params);
+    TEST_RUN(test_payload_keys);
+    return TEST_END();
+}
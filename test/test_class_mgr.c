@@ -0,0 +1,560 @@
+/**
+* \file  test_class_mgr.c
+*
+* \brief Host tests of the Class C window manager and of its receiver-on
+*        budget against a mock stack
+*
+* The mock stack switches class when the application asks, unless it is
+* busy with a transaction, and falls back to Class A on a reset. As in
+* the demo application, CLASS_MGR_Run() runs on every timer expiry and
+* window request and the timer fires late by up to its slack. The
+* receiver-on time is measured in the mock stack over a month of
+* requests and checked against the budget of every period.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "class_mgr.h"
+
+/****************************** MACROS **************************************/
+#define TEST_MINUTE_MS                      60000ull
+#define TEST_HOUR_MS                        (60u * TEST_MINUTE_MS)
+#define TEST_DAY_MS                         (24u * TEST_HOUR_MS)
+#define TEST_DAYS                           30u
+#define TEST_SLACK_MS                       100u
+/* Receiver on past the budget: timer slack and retries of a busy stack */
+#define TEST_OVERRUN_MS                     10000u
+#define TEST_SLOT_PHASE_MS                  7200000u
+/* Receiver-on intervals kept for the sliding budget check */
+#define TEST_MAX_INTERVALS                  16384u
+
+/****************************** TYPES **************************************/
+typedef struct _TestScenario_t
+{
+    const char *name;
+    /* Mean delay between two window requests, 0 for none */
+    uint32_t requestEveryMs;
+    /* Longest window asked for */
+    uint32_t requestMaxMs;
+    /* Percentage of the class switches refused by a busy stack */
+    uint8_t busyPercent;
+    /* Mean delay between two stack resets, 0 for none */
+    uint32_t resetEveryMs;
+} TestScenario_t;
+
+typedef struct _TestInterval_t
+{
+    uint64_t startMs;
+    uint64_t endMs;
+} TestInterval_t;
+
+typedef struct _TestStack_t
+{
+    bool classC;
+    uint64_t onSinceMs;
+    uint64_t onMs;
+    uint32_t refused;
+    uint32_t resets;
+    uint16_t intervals;
+    TestInterval_t interval[TEST_MAX_INTERVALS];
+} TestStack_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* conf_app.h: 10 min windows, 30 min a day, a 5 min maintenance window a day */
+static const ClassMgrConfig_t testConfig =
+{
+    600000u, 1800000u, 86400000u, 300000u
+};
+
+static const TestScenario_t testScenarios[] =
+{
+    /* Maintenance slots only */
+    { "maintenance", 0, 0, 0, 0 },
+    /* A few multicast sessions a day */
+    { "multicast", 8u * TEST_HOUR_MS, 20u * TEST_MINUTE_MS, 0, 0 },
+    /* Asking for more than the budget all the time */
+    { "hungry", 5u * TEST_MINUTE_MS, 30u * TEST_MINUTE_MS, 0, 0 },
+    /* Half the switches refused by a busy stack */
+    { "busy_stack", 30u * TEST_MINUTE_MS, 15u * TEST_MINUTE_MS, 50, 0 },
+    /* Band changes and rejoins reset the stack */
+    { "resets", 20u * TEST_MINUTE_MS, 15u * TEST_MINUTE_MS, 10, 3u * TEST_HOUR_MS }
+};
+
+static TestStack_t testStack;
+static const TestScenario_t *testScenario;
+static uint64_t testNowMs;
+static uint32_t testSeed;
+/* Stack of test_run() */
+static bool testRunBusy;
+static bool testRunClassC;
+static uint8_t testRunSwitches;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t test_random(void)
+{
+    testSeed = testSeed * 1103515245u + 12345u;
+    return testSeed >> 8;
+}
+
+/* Uniform between 1 and twice the mean */
+static uint64_t test_delay(uint32_t meanMs)
+{
+    return 1u + (uint64_t)test_random() % (2u * (uint64_t)meanMs);
+}
+
+static void stack_on(uint64_t nowMs)
+{
+    testStack.classC = true;
+    testStack.onSinceMs = nowMs;
+}
+
+static void stack_off(uint64_t nowMs)
+{
+    testStack.classC = false;
+    testStack.onMs += nowMs - testStack.onSinceMs;
+    if (testStack.intervals < TEST_MAX_INTERVALS)
+    {
+        testStack.interval[testStack.intervals].startMs = testStack.onSinceMs;
+        testStack.interval[testStack.intervals].endMs = nowMs;
+    }
+    testStack.intervals++;
+}
+
+/* set_device_type() of the application */
+static bool stack_set_class(bool classC)
+{
+    if ((test_random() % 100u) < testScenario->busyPercent)
+    {
+        testStack.refused++;
+        return false;
+    }
+    if (classC)
+    {
+        stack_on(testNowMs);
+    }
+    else
+    {
+        stack_off(testNowMs);
+    }
+    return true;
+}
+
+/* Daily slot at the phase of the demo application */
+static uint32_t test_slot_delay(uint64_t nowMs)
+{
+    uint32_t position = (uint32_t)((nowMs + TEST_DAY_MS - TEST_SLOT_PHASE_MS) % TEST_DAY_MS);
+
+    return (uint32_t)(TEST_DAY_MS - position);
+}
+
+static const ClassMgrOps_t testOps = { stack_set_class, test_slot_delay };
+
+/* app_class_update(), returns the time of the next timer expiry */
+static uint64_t app_class_update(uint64_t nowMs)
+{
+    testNowMs = nowMs;
+    return nowMs + CLASS_MGR_Run(&testOps, nowMs) + (test_random() % (TEST_SLACK_MS + 1u));
+}
+
+/* app_class_reset() after a stack reset */
+static void app_class_reset(uint64_t nowMs)
+{
+    testStack.resets++;
+    if (testStack.classC)
+    {
+        stack_off(nowMs);
+        CLASS_MGR_Switched(false, nowMs);
+    }
+}
+
+static void run_scenario(const TestScenario_t *scenario)
+{
+    uint64_t nowMs = 0;
+    uint64_t endMs = TEST_DAYS * TEST_DAY_MS;
+    uint64_t timerMs;
+    uint64_t requestMs = (0u != scenario->requestEveryMs) ? test_delay(scenario->requestEveryMs) : UINT64_MAX;
+    uint64_t resetMs = (0u != scenario->resetEveryMs) ? test_delay(scenario->resetEveryMs) : UINT64_MAX;
+
+    memset(&testStack, 0, sizeof(testStack));
+    testScenario = scenario;
+    testSeed = 48u;
+    CLASS_MGR_Init(&testConfig, nowMs);
+    timerMs = app_class_update(nowMs);
+
+    while (nowMs < endMs)
+    {
+        nowMs = timerMs;
+        if (requestMs < nowMs)
+        {
+            nowMs = requestMs;
+        }
+        if (resetMs < nowMs)
+        {
+            nowMs = resetMs;
+        }
+        if (nowMs >= endMs)
+        {
+            break;
+        }
+
+        if (nowMs == resetMs)
+        {
+            app_class_reset(nowMs);
+            resetMs = nowMs + test_delay(scenario->resetEveryMs);
+        }
+        else if (nowMs == requestMs)
+        {
+            CLASS_MGR_Request(CLASS_MGR_DOWNLINK, (uint32_t)test_delay(scenario->requestMaxMs / 2u), nowMs);
+            requestMs = nowMs + test_delay(scenario->requestEveryMs);
+            timerMs = app_class_update(nowMs);
+        }
+        else
+        {
+            timerMs = app_class_update(nowMs);
+        }
+    }
+    if (testStack.classC)
+    {
+        stack_off(endMs);
+        CLASS_MGR_Switched(false, endMs);
+    }
+}
+
+/* Most receiver-on time of any budget period, its start on an interval start */
+static uint64_t worst_period_ms(void)
+{
+    uint64_t worst = 0;
+    uint16_t count = (testStack.intervals < TEST_MAX_INTERVALS) ? testStack.intervals : TEST_MAX_INTERVALS;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint64_t endMs = testStack.interval[i].startMs + testConfig.budgetPeriodMs;
+        uint64_t sum = 0;
+
+        for (uint16_t j = i; (j < count) && (testStack.interval[j].startMs < endMs); j++)
+        {
+            sum += ((testStack.interval[j].endMs < endMs) ? testStack.interval[j].endMs : endMs) -
+                   testStack.interval[j].startMs;
+        }
+        worst = (sum > worst) ? sum : worst;
+    }
+    return worst;
+}
+
+static uint64_t longest_interval_ms(void)
+{
+    uint64_t longest = 0;
+    uint16_t count = (testStack.intervals < TEST_MAX_INTERVALS) ? testStack.intervals : TEST_MAX_INTERVALS;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint64_t length = testStack.interval[i].endMs - testStack.interval[i].startMs;
+
+        longest = (length > longest) ? length : longest;
+    }
+    return longest;
+}
+
+static void setup(void)
+{
+    CLASS_MGR_Init(&testConfig, 0);
+}
+
+static void test_grant(void)
+{
+    const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+
+    setup();
+    TEST_ASSERT_EQ(stats->creditMs, 1800000);
+    TEST_ASSERT(!CLASS_MGR_Request(CLASS_MGR_LOCAL, 0, 0));
+    TEST_ASSERT_EQ(stats->refused, 1);
+
+    /* Shortened to the longest window */
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_DOWNLINK, 900000u, 0));
+    TEST_ASSERT_EQ(stats->windows, 1);
+    TEST_ASSERT_EQ(stats->truncated, 1);
+    TEST_ASSERT_EQ(stats->lastTrigger, CLASS_MGR_DOWNLINK);
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(0), 600000);
+
+    /* A shorter request does not shorten the open window */
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 1000u, 1000u));
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(1000u), 599000);
+    TEST_ASSERT_EQ(stats->truncated, 1);
+
+    /* A longer one extends it, up to the longest window from its opening */
+    CLASS_MGR_Init(&testConfig, 0);
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 300000u, 0));
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 400000u, 100000u));
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(100000u), 400000);
+    TEST_ASSERT_EQ(stats->truncated, 0);
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 600000u, 400000u));
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(400000u), 200000);
+    TEST_ASSERT_EQ(stats->truncated, 1);
+    TEST_ASSERT_EQ(stats->windows, 1);
+
+    TEST_ASSERT(CLASS_MGR_Update(599999u));
+    TEST_ASSERT(!CLASS_MGR_Update(600000u));
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 100000u, 600000u));
+    TEST_ASSERT_EQ(stats->windows, 2);
+    TEST_ASSERT(!CLASS_MGR_Update(700000u));
+    /* The stack was never switched: nothing was charged */
+    TEST_ASSERT_EQ(stats->receiverOnMs, 0);
+    TEST_ASSERT_EQ(stats->creditMs, 1800000);
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(700000u), UINT32_MAX);
+}
+
+/* The receiver-on time is charged between the switches, the window is
+   shortened to the credit and closed when it runs out */
+static void test_charge(void)
+{
+    const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+    uint64_t nowMs = 0;
+
+    setup();
+    for (uint8_t i = 0; i < 3u; i++)
+    {
+        TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_DOWNLINK, 600000u, nowMs));
+        TEST_ASSERT(CLASS_MGR_Update(nowMs));
+        CLASS_MGR_Switched(true, nowMs);
+        nowMs += CLASS_MGR_NextEventMs(nowMs);
+        TEST_ASSERT(!CLASS_MGR_Update(nowMs));
+        CLASS_MGR_Switched(false, nowMs);
+        TEST_ASSERT_EQ(stats->lastWindowMs, 600000);
+    }
+    TEST_ASSERT_EQ(stats->receiverOnMs, 1800000);
+    TEST_ASSERT_EQ(stats->creditMs, 0);
+    TEST_ASSERT(!CLASS_MGR_Request(CLASS_MGR_LOCAL, 600000u, nowMs));
+    TEST_ASSERT_EQ(stats->refused, 1);
+
+    /* Given back once the 30 min part of the period holding it is a
+       period old */
+    CLASS_MGR_Update(TEST_DAY_MS + 30u * TEST_MINUTE_MS - 1u);
+    TEST_ASSERT_EQ(stats->creditMs, 0);
+    nowMs = TEST_DAY_MS + 30u * TEST_MINUTE_MS;
+    CLASS_MGR_Update(nowMs);
+    TEST_ASSERT_EQ(stats->creditMs, 1800000);
+
+    /* On for 25 min, a request is shortened to the 5 min left */
+    CLASS_MGR_Switched(true, nowMs);
+    nowMs += 25u * TEST_MINUTE_MS;
+    CLASS_MGR_Switched(false, nowMs);
+    TEST_ASSERT_EQ(stats->creditMs, 300000);
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 600000u, nowMs));
+    TEST_ASSERT_EQ(stats->truncated, 1);
+    CLASS_MGR_Switched(true, nowMs);
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(nowMs), 300000);
+    nowMs += 300000u;
+    TEST_ASSERT(!CLASS_MGR_Update(nowMs));
+    CLASS_MGR_Switched(false, nowMs);
+    TEST_ASSERT_EQ(stats->creditMs, 0);
+}
+
+/* The time used leaves the credit with its part of the period, a window
+   across two parts is split between them */
+static void test_sliding_period(void)
+{
+    const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+    uint32_t wrong = 0;
+
+    setup();
+    /* 20 s across the end of the first part */
+    CLASS_MGR_Switched(true, 1790000u);
+    CLASS_MGR_Switched(false, 1810000u);
+    TEST_ASSERT_EQ(stats->receiverOnMs, 20000);
+    TEST_ASSERT_EQ(stats->creditMs, 1780000);
+    /* Steps of 7001 ms */
+    for (uint64_t nowMs = 1810000u; nowMs < 2u * TEST_DAY_MS; nowMs += 7001u)
+    {
+        int32_t expected = (nowMs < TEST_DAY_MS + 30u * TEST_MINUTE_MS) ? 1780000 :
+                           (nowMs < TEST_DAY_MS + TEST_HOUR_MS) ? 1790000 : 1800000;
+
+        CLASS_MGR_NextEventMs(nowMs);
+        wrong += (stats->creditMs != expected) ? 1u : 0u;
+    }
+    TEST_ASSERT_EQ(wrong, 0);
+
+    /* A long idle time forgets everything */
+    CLASS_MGR_Switched(true, 3u * TEST_DAY_MS);
+    CLASS_MGR_Switched(false, 3u * TEST_DAY_MS + 1000u);
+    TEST_ASSERT_EQ(stats->creditMs, 1799000);
+    CLASS_MGR_Update(40u * TEST_DAY_MS);
+    TEST_ASSERT_EQ(stats->creditMs, 1800000);
+}
+
+/* An overrun of a late switch back counts like the rest of the period */
+static void test_overrun(void)
+{
+    const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+    uint64_t nowMs = 0;
+    uint8_t windows = 0;
+
+    setup();
+    /* Use the whole credit, the stack switching back 20 s late */
+    while (CLASS_MGR_Request(CLASS_MGR_LOCAL, 600000u, nowMs) && (stats->creditMs > 0))
+    {
+        CLASS_MGR_Switched(true, nowMs);
+        nowMs += CLASS_MGR_NextEventMs(nowMs);
+        TEST_ASSERT(!CLASS_MGR_Update(nowMs));
+        TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(nowMs), 0);
+        nowMs += 20000u;
+        CLASS_MGR_Switched(false, nowMs);
+        windows++;
+    }
+    TEST_ASSERT_EQ(windows, 3);
+    TEST_ASSERT_EQ(stats->creditMs, -20000);
+    TEST_ASSERT(!CLASS_MGR_Request(CLASS_MGR_LOCAL, 60000u, nowMs));
+    TEST_ASSERT(!CLASS_MGR_Request(CLASS_MGR_LOCAL, 60000u, TEST_DAY_MS + 30u * TEST_MINUTE_MS - 1u));
+    /* The last 20 s were in the second part, they still count */
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 60000u, TEST_DAY_MS + 30u * TEST_MINUTE_MS));
+    TEST_ASSERT_EQ(stats->creditMs, 1780000);
+}
+
+/* The maintenance slot opens its window, a 0 window disables it */
+static void test_slot(void)
+{
+    ClassMgrConfig_t config = testConfig;
+    const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+
+    setup();
+    TEST_ASSERT(!CLASS_MGR_SlotPending());
+    CLASS_MGR_ScheduleSlot(5000u, 0);
+    TEST_ASSERT(CLASS_MGR_SlotPending());
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(1000u), 4000);
+    /* Replaced by a new schedule */
+    CLASS_MGR_ScheduleSlot(10000u, 1000u);
+    TEST_ASSERT(!CLASS_MGR_Update(10999u));
+    TEST_ASSERT(CLASS_MGR_Update(11000u));
+    TEST_ASSERT(!CLASS_MGR_SlotPending());
+    TEST_ASSERT_EQ(stats->lastTrigger, CLASS_MGR_MAINTENANCE);
+    TEST_ASSERT_EQ(CLASS_MGR_NextEventMs(11000u), 300000);
+
+    config.slotWindowMs = 0;
+    CLASS_MGR_Init(&config, 0);
+    CLASS_MGR_ScheduleSlot(5000u, 0);
+    TEST_ASSERT(!CLASS_MGR_SlotPending());
+}
+
+/* A stack reset back to Class A closes the window */
+static void test_stack_reset(void)
+{
+    const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+
+    setup();
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 60000u, 0));
+    CLASS_MGR_Switched(true, 0);
+    CLASS_MGR_Switched(false, 20000u);
+    TEST_ASSERT_EQ(stats->lastWindowMs, 20000);
+    TEST_ASSERT_EQ(stats->receiverOnMs, 20000);
+    TEST_ASSERT(!CLASS_MGR_Update(20000u));
+    /* Reported twice, charged once */
+    CLASS_MGR_Switched(false, 30000u);
+    TEST_ASSERT_EQ(stats->receiverOnMs, 20000);
+}
+
+static bool run_set_class(bool classC)
+{
+    if (testRunBusy)
+    {
+        return false;
+    }
+    testRunClassC = classC;
+    testRunSwitches++;
+    return true;
+}
+
+static uint32_t run_slot_delay(uint64_t nowMs)
+{
+    return (uint32_t)(10u * TEST_HOUR_MS - nowMs % (10u * TEST_HOUR_MS));
+}
+
+/* CLASS_MGR_Run() schedules the slot, switches the stack, tries a refused
+   switch again and polls at least every hour */
+static void test_run(void)
+{
+    static const ClassMgrOps_t ops = { run_set_class, run_slot_delay };
+
+    setup();
+    testRunBusy = false;
+    testRunClassC = false;
+    testRunSwitches = 0;
+    TEST_ASSERT_EQ(CLASS_MGR_Run(&ops, 0), CLASS_MGR_POLL_MAX_MS);
+    TEST_ASSERT(CLASS_MGR_SlotPending());
+    TEST_ASSERT_EQ(testRunSwitches, 0);
+
+    TEST_ASSERT(CLASS_MGR_Request(CLASS_MGR_LOCAL, 60000u, 1000u));
+    testRunBusy = true;
+    TEST_ASSERT_EQ(CLASS_MGR_Run(&ops, 1000u), CLASS_MGR_RETRY_MS);
+    TEST_ASSERT_EQ(testRunSwitches, 0);
+    testRunBusy = false;
+    TEST_ASSERT_EQ(CLASS_MGR_Run(&ops, 2000u), 59000);
+    TEST_ASSERT(testRunClassC);
+    TEST_ASSERT_EQ(CLASS_MGR_Run(&ops, 61000u), CLASS_MGR_POLL_MAX_MS);
+    TEST_ASSERT(!testRunClassC);
+    TEST_ASSERT_EQ(testRunSwitches, 2);
+    TEST_ASSERT_EQ(CLASS_MGR_GetStats()->receiverOnMs, 59000);
+
+    /* The slot opens its window */
+    TEST_ASSERT_EQ(CLASS_MGR_Run(&ops, 10u * TEST_HOUR_MS), 300000);
+    TEST_ASSERT(testRunClassC);
+    TEST_ASSERT_EQ(CLASS_MGR_GetStats()->lastTrigger, CLASS_MGR_MAINTENANCE);
+}
+
+/* A month of requests through the mock stack stays within the budget */
+static void test_mock_stack(void)
+{
+    uint64_t budget = testConfig.budgetMs;
+
+    for (uint8_t s = 0; s < sizeof(testScenarios) / sizeof(testScenarios[0]); s++)
+    {
+        const TestScenario_t *scenario = &testScenarios[s];
+        const ClassMgrStats_t *stats = CLASS_MGR_GetStats();
+        uint64_t worst;
+        uint64_t longest;
+
+        testName = scenario->name;
+        run_scenario(scenario);
+        worst = worst_period_ms();
+        longest = longest_interval_ms();
+        printf("%s: %u windows, %u refused, receiver on %llu s in %u days (%llu s a day allowed), "
+               "worst day %llu s, longest window %llu s, %u busy, %u resets\n", scenario->name,
+               stats->windows, stats->refused, (unsigned long long)(testStack.onMs / 1000u), TEST_DAYS,
+               (unsigned long long)(budget / 1000u), (unsigned long long)(worst / 1000u),
+               (unsigned long long)(longest / 1000u), testStack.refused, testStack.resets);
+
+        TEST_ASSERT(testStack.intervals <= TEST_MAX_INTERVALS);
+        /* The manager charged what the stack did */
+        TEST_ASSERT_EQ(stats->receiverOnMs, testStack.onMs);
+        /* The budget of every period, a late switch back aside */
+        TEST_ASSERT(worst <= budget + TEST_OVERRUN_MS);
+        TEST_ASSERT(testStack.onMs <= TEST_DAYS * (budget + TEST_OVERRUN_MS));
+        TEST_ASSERT(longest <= testConfig.maxWindowMs + 10000u);
+        /* Every daily maintenance slot got its window */
+        TEST_ASSERT(stats->windows >= TEST_DAYS - 1u);
+        TEST_ASSERT(!testStack.classC);
+    }
+    testName = "test_mock_stack";
+}
+
+/* Asked for more than it can have, the device gets the budget, not less */
+static void test_budget_used(void)
+{
+    run_scenario(&testScenarios[2]);
+    TEST_ASSERT(testStack.onMs >= (uint64_t)TEST_DAYS * testConfig.budgetMs * 95u / 100u);
+    TEST_ASSERT(CLASS_MGR_GetStats()->refused > 0u);
+    TEST_ASSERT(CLASS_MGR_GetStats()->truncated > 0u);
+}
+
+int main(void)
+{
+    TEST_RUN(test_grant);
+    TEST_RUN(test_charge);
+    TEST_RUN(test_sliding_period);
+    TEST_RUN(test_overrun);
+    TEST_RUN(test_slot);
+    TEST_RUN(test_stack_reset);
+    TEST_RUN(test_run);
+    TEST_RUN(test_mock_stack);
+    TEST_RUN(test_budget_used);
+    return TEST_END();
+}
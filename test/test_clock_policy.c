@@ -0,0 +1,201 @@
+/**
+* \file  test_clock_policy.c
+*
+* \brief Host tests of the CPU clock policy and of its energy model
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "clock_policy.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+/* SAM R34 at 48 MHz and 3.3 V */
+static const ClockPowerModel_t testModel = { 48000000u, 3300u, 100u, 40u, 5u };
+
+static uint8_t testShifts[16];
+static uint8_t testSets;
+
+/***************************** FUNCTIONS ***************************************/
+
+static void record_set(uint8_t shift)
+{
+    if (testSets < sizeof(testShifts))
+    {
+        testShifts[testSets] = shift;
+    }
+    testSets++;
+}
+
+static void setup(const ClockPolicy_t *policy)
+{
+    testSets = 0;
+    CLOCK_POLICY_Init(policy, record_set);
+}
+
+static void test_phases(void)
+{
+    static const ClockPolicy_t policy = { { 3, 2, 1, 0, 0 } };
+
+    setup(&policy);
+    /* The idle divider is applied at once */
+    TEST_ASSERT_EQ(testSets, 1);
+    TEST_ASSERT_EQ(testShifts[0], 3);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 3);
+
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_SAMPLE);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 2);
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_LOG);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 1);
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_IDLE);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 3);
+    TEST_ASSERT_EQ(testSets, 4);
+    TEST_ASSERT_EQ(CLOCK_POLICY_Switches(), 4);
+
+    /* No change, no write */
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_IDLE);
+    TEST_ASSERT_EQ(testSets, 4);
+    /* Out of range phases are ignored */
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_COUNT);
+    CLOCK_POLICY_Hold(CLOCK_PHASE_COUNT);
+    CLOCK_POLICY_Release(CLOCK_PHASE_COUNT);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 3);
+    TEST_ASSERT_EQ(testSets, 4);
+}
+
+/* A held phase keeps its faster clock across the state changes */
+static void test_holds(void)
+{
+    static const ClockPolicy_t policy = { { 3, 2, 1, 0, 0 } };
+
+    setup(&policy);
+    CLOCK_POLICY_Hold(CLOCK_PHASE_RADIO);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 0);
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_SAMPLE);
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_IDLE);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 0);
+    TEST_ASSERT_EQ(testSets, 2);
+
+    /* Nested holds, the fastest one wins */
+    CLOCK_POLICY_Hold(CLOCK_PHASE_LOG);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 0);
+    CLOCK_POLICY_Release(CLOCK_PHASE_RADIO);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 1);
+    CLOCK_POLICY_Release(CLOCK_PHASE_LOG);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 3);
+    /* A slower held phase does not slow the current one down */
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_CRYPTO);
+    CLOCK_POLICY_Hold(CLOCK_PHASE_IDLE);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), 0);
+    CLOCK_POLICY_Release(CLOCK_PHASE_IDLE);
+    TEST_ASSERT_EQ(testShifts[testSets - 1u], 0);
+}
+
+static void test_clamp_and_no_callback(void)
+{
+    static const ClockPolicy_t policy = { { 9, 200, 1, 0, 0 } };
+
+    CLOCK_POLICY_Init(&policy, NULL);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), CLOCK_POLICY_MAX_SHIFT);
+    CLOCK_POLICY_SetPhase(CLOCK_PHASE_SAMPLE);
+    TEST_ASSERT_EQ(CLOCK_POLICY_GetShift(), CLOCK_POLICY_MAX_SHIFT);
+    TEST_ASSERT_EQ(CLOCK_POLICY_Switches(), 1);
+}
+
+/* Figures computed by hand from the model */
+static void test_estimate_values(void)
+{
+    static const ClockPolicy_t full = { { 0, 0, 0, 0, 0 } };
+    static const ClockPolicy_t divided = { { 3, 3, 0, 0, 0 } };
+    ClockPhaseLoad_t load[CLOCK_PHASE_COUNT];
+    uint64_t phaseNj[CLOCK_PHASE_COUNT];
+
+    memset(load, 0, sizeof(load));
+    /* 1 ms at 48 MHz, 2020 uA */
+    load[CLOCK_PHASE_SAMPLE].cycles = 48000u;
+    TEST_ASSERT_EQ(CLOCK_POLICY_EstimateNj(&full, &testModel, load, phaseNj), 6666);
+    TEST_ASSERT_EQ(phaseNj[CLOCK_PHASE_SAMPLE], 6666);
+    TEST_ASSERT_EQ(phaseNj[CLOCK_PHASE_IDLE], 0);
+
+    /* 8 ms at 6 MHz, 340 uA, no switch from the idle divider */
+    TEST_ASSERT_EQ(CLOCK_POLICY_EstimateNj(&divided, &testModel, load, phaseNj), 8976);
+
+    /* A wait of 1 ms at 6 MHz: 340 uA */
+    memset(load, 0, sizeof(load));
+    load[CLOCK_PHASE_SAMPLE].waitUs = 1000u;
+    TEST_ASSERT_EQ(CLOCK_POLICY_EstimateNj(&divided, &testModel, load, NULL), 1122);
+
+    /* The same wait at full speed pays the switches in and out: 2 x 5 us at 2020 uA */
+    load[CLOCK_PHASE_SAMPLE].waitUs = 0;
+    load[CLOCK_PHASE_CRYPTO].waitUs = 1000u;
+    TEST_ASSERT_EQ(CLOCK_POLICY_EstimateNj(&divided, &testModel, load, phaseNj), 6666 + 66);
+    TEST_ASSERT_EQ(phaseNj[CLOCK_PHASE_CRYPTO], 6666 + 66);
+}
+
+/* Waiting is cheaper slow, computing is cheaper fast when the base current dominates */
+static void test_estimate_tradeoffs(void)
+{
+    ClockPolicy_t policy = { { 0, 0, 0, 0, 0 } };
+    ClockPhaseLoad_t load[CLOCK_PHASE_COUNT];
+    uint64_t previousWait = UINT64_MAX;
+    uint64_t previousCompute = 0;
+
+    for (uint8_t shift = 0; shift <= CLOCK_POLICY_MAX_SHIFT; shift++)
+    {
+        uint64_t wait;
+        uint64_t compute;
+
+        policy.shift[CLOCK_PHASE_IDLE] = shift;
+        memset(load, 0, sizeof(load));
+        load[CLOCK_PHASE_IDLE].waitUs = 10000u;
+        wait = CLOCK_POLICY_EstimateNj(&policy, &testModel, load, NULL);
+        memset(load, 0, sizeof(load));
+        load[CLOCK_PHASE_IDLE].cycles = 480000u;
+        compute = CLOCK_POLICY_EstimateNj(&policy, &testModel, load, NULL);
+
+        TEST_ASSERT(wait < previousWait);
+        TEST_ASSERT(compute > previousCompute);
+        previousWait = wait;
+        previousCompute = compute;
+    }
+}
+
+/* The phases add up to the total, an empty phase costs nothing */
+static void test_estimate_sum(void)
+{
+    static const ClockPolicy_t policy = { { 3, 2, 1, 0, 0 } };
+    ClockPhaseLoad_t load[CLOCK_PHASE_COUNT] =
+    {
+        { 2000u, 5000u }, { 30000u, 80u }, { 150000u, 8700u }, { 720000u, 0 }, { 0, 0 }
+    };
+    uint64_t phaseNj[CLOCK_PHASE_COUNT];
+    uint64_t sum = 0;
+    uint64_t total = CLOCK_POLICY_EstimateNj(&policy, &testModel, load, phaseNj);
+
+    for (uint8_t phase = 0; phase < CLOCK_PHASE_COUNT; phase++)
+    {
+        sum += phaseNj[phase];
+    }
+    TEST_ASSERT_EQ(sum, total);
+    TEST_ASSERT_EQ(phaseNj[CLOCK_PHASE_RADIO], 0);
+    TEST_ASSERT(phaseNj[CLOCK_PHASE_CRYPTO] > 0);
+
+    /* A model without clock does not divide by zero */
+    {
+        ClockPowerModel_t model = testModel;
+
+        model.mainClockHz = 0;
+        TEST_ASSERT(CLOCK_POLICY_EstimateNj(&policy, &model, load, NULL) > 0);
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_phases);
+    TEST_RUN(test_holds);
+    TEST_RUN(test_clamp_and_no_callback);
+    TEST_RUN(test_estimate_values);
+    TEST_RUN(test_estimate_tradeoffs);
+    TEST_RUN(test_estimate_sum);
+    return TEST_END();
+}
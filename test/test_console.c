@@ -0,0 +1,429 @@
+/**
+* \file  test_console.c
+*
+* \brief Host tests of the console line assembly and command parser
+*
+* The bytes go through CONSOLE_RxIsr() as from the UART interrupt and
+* CONSOLE_Process() runs when the notification asks for it, as the
+* application task does. The table has the shape of the one of the demo
+* application.
+*
+* console.c prints its answers: its source is included here with printf()
+* redirected to a buffer, so that the answers are checked too.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdarg.h>
+#include "test.h"
+
+static int test_printf(const char *format, ...);
+#define printf test_printf
+#include "../console.c"
+#undef printf
+
+/****************************** MACROS **************************************/
+#define TEST_OUTPUT_SIZE                    512u
+/* Bytes received at 115200 bit/s while other tasks run, about 0.7 ms */
+#define TEST_TASK_LATENCY                   8u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static char testOutput[TEST_OUTPUT_SIZE];
+static size_t testOutputLength;
+
+static uint16_t testNotified;
+static bool testPending;
+
+/* Arguments of the last handler call */
+static uint16_t testCalls;
+static uint8_t testArgc;
+static char testArgv[CONSOLE_MAX_ARGS][CONSOLE_LINE_LENGTH + 1u];
+
+static bool test_handler(uint8_t argc, char *argv[]);
+static bool test_refuse(uint8_t argc, char *argv[]);
+
+static const ConsoleCommand_t testCommands[] =
+{
+    { "diag", "", 0, 0, test_handler },
+    { "set", "<threshold|period|confirm|status> <value>", 2, 2, test_handler },
+    { "send", "[alarm]", 0, 1, test_handler },
+    { "class", "<seconds>", 1, 1, test_refuse },
+    { "wide", "<a> <b> <c>", 0, CONSOLE_MAX_ARGS - 1u, test_handler }
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+static int test_printf(const char *format, ...)
+{
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(&testOutput[testOutputLength], TEST_OUTPUT_SIZE - testOutputLength, format, args);
+    va_end(args);
+    if (length > 0)
+    {
+        testOutputLength += (size_t)length;
+        if (testOutputLength >= TEST_OUTPUT_SIZE)
+        {
+            testOutputLength = TEST_OUTPUT_SIZE - 1u;
+        }
+    }
+    return length;
+}
+
+static bool test_handler(uint8_t argc, char *argv[])
+{
+    testCalls++;
+    testArgc = argc;
+    for (uint8_t i = 0; i < argc; i++)
+    {
+        strcpy(testArgv[i], argv[i]);
+    }
+    return true;
+}
+
+static bool test_refuse(uint8_t argc, char *argv[])
+{
+    test_handler(argc, argv);
+    return false;
+}
+
+static void test_notify(void)
+{
+    testNotified++;
+    testPending = true;
+}
+
+static void setup(void)
+{
+    CONSOLE_Init(testCommands, sizeof(testCommands) / sizeof(testCommands[0]), test_notify);
+    testOutputLength = 0;
+    testOutput[0] = '\0';
+    testNotified = 0;
+    testPending = false;
+    testCalls = 0;
+    testArgc = 0;
+}
+
+static void clear_output(void)
+{
+    testOutputLength = 0;
+    testOutput[0] = '\0';
+}
+
+/* Runs the task when it was asked for, as the application does */
+static void run_task(void)
+{
+    if (testPending)
+    {
+        testPending = false;
+        CONSOLE_Process();
+    }
+}
+
+/* Types the bytes one by one, the task running between them when asked */
+static void type_bytes(const char *bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        CONSOLE_RxIsr((uint8_t)bytes[i]);
+        run_task();
+    }
+}
+
+static void type_line(const char *line)
+{
+    type_bytes(line, strlen(line));
+}
+
+/* Received in one burst, the task running TEST_TASK_LATENCY bytes after
+   it was asked for */
+static void paste_line(const char *line)
+{
+    uint8_t wait = 0;
+
+    for (size_t i = 0; line[i] != '\0'; i++)
+    {
+        bool pending = testPending;
+
+        CONSOLE_RxIsr((uint8_t)line[i]);
+        wait = (pending || !testPending) ? wait : TEST_TASK_LATENCY;
+        if (testPending && (0u == --wait))
+        {
+            run_task();
+        }
+    }
+    run_task();
+}
+
+static ConsoleStatus_t execute(const char *line)
+{
+    char copy[CONSOLE_LINE_LENGTH * 2u];
+
+    strcpy(copy, line);
+    return CONSOLE_Execute(copy);
+}
+
+static void test_split(void)
+{
+    setup();
+    TEST_ASSERT_EQ(execute(""), CONSOLE_EMPTY);
+    TEST_ASSERT_EQ(execute("    "), CONSOLE_EMPTY);
+
+    TEST_ASSERT_EQ(execute("set period 60"), CONSOLE_OK);
+    TEST_ASSERT_EQ(testArgc, 3);
+    TEST_ASSERT(0 == strcmp(testArgv[0], "set"));
+    TEST_ASSERT(0 == strcmp(testArgv[1], "period"));
+    TEST_ASSERT(0 == strcmp(testArgv[2], "60"));
+
+    /* Leading, repeated and trailing spaces */
+    TEST_ASSERT_EQ(execute("   set   threshold    2500   "), CONSOLE_OK);
+    TEST_ASSERT_EQ(testArgc, 3);
+    TEST_ASSERT(0 == strcmp(testArgv[1], "threshold"));
+    TEST_ASSERT(0 == strcmp(testArgv[2], "2500"));
+
+    /* As many words as the console takes, then one more */
+    TEST_ASSERT_EQ(execute("wide a b c"), CONSOLE_OK);
+    TEST_ASSERT_EQ(testArgc, CONSOLE_MAX_ARGS);
+    TEST_ASSERT(0 == strcmp(testArgv[3], "c"));
+    testCalls = 0;
+    TEST_ASSERT_EQ(execute("wide a b c d"), CONSOLE_USAGE);
+    TEST_ASSERT_EQ(execute("wide a b c d e f g h"), CONSOLE_USAGE);
+    /* Extra spaces are not words */
+    TEST_ASSERT_EQ(execute("wide a b c    "), CONSOLE_OK);
+    TEST_ASSERT_EQ(testCalls, 1);
+}
+
+static void test_dispatch(void)
+{
+    setup();
+    TEST_ASSERT_EQ(execute("reboot"), CONSOLE_UNKNOWN);
+    /* Names match whole and case sensitive */
+    TEST_ASSERT_EQ(execute("se"), CONSOLE_UNKNOWN);
+    TEST_ASSERT_EQ(execute("sendx"), CONSOLE_UNKNOWN);
+    TEST_ASSERT_EQ(execute("DIAG"), CONSOLE_UNKNOWN);
+    TEST_ASSERT_EQ(testCalls, 0);
+
+    TEST_ASSERT_EQ(execute("diag"), CONSOLE_OK);
+    TEST_ASSERT_EQ(execute("send"), CONSOLE_OK);
+    TEST_ASSERT_EQ(execute("send alarm"), CONSOLE_OK);
+    TEST_ASSERT_EQ(testCalls, 3);
+
+    /* The argument count is checked before the handler, the usage is printed */
+    clear_output();
+    TEST_ASSERT_EQ(execute("diag now"), CONSOLE_USAGE);
+    TEST_ASSERT_EQ(execute("set period"), CONSOLE_USAGE);
+    TEST_ASSERT_EQ(execute("send alarm now"), CONSOLE_USAGE);
+    TEST_ASSERT_EQ(execute("class"), CONSOLE_USAGE);
+    TEST_ASSERT_EQ(testCalls, 3);
+    TEST_ASSERT(NULL != strstr(testOutput, "set <threshold|period|confirm|status> <value>\r\n"));
+    TEST_ASSERT(NULL != strstr(testOutput, "class <seconds>\r\n"));
+
+    /* A handler refusing its arguments */
+    TEST_ASSERT_EQ(execute("class 60"), CONSOLE_FAILED);
+    TEST_ASSERT_EQ(testCalls, 4);
+
+    /* help lists every command with its usage */
+    clear_output();
+    TEST_ASSERT_EQ(execute("help"), CONSOLE_OK);
+    TEST_ASSERT(0 == strncmp(testOutput, "help\r\n", 6));
+    for (uint8_t i = 0; i < sizeof(testCommands) / sizeof(testCommands[0]); i++)
+    {
+        char expected[CONSOLE_LINE_LENGTH * 2u];
+
+        snprintf(expected, sizeof(expected), "%s %s\r\n", testCommands[i].name, testCommands[i].usage);
+        TEST_ASSERT(NULL != strstr(testOutput, expected));
+    }
+
+    /* Without commands only help answers */
+    CONSOLE_Init(NULL, 0, NULL);
+    TEST_ASSERT_EQ(execute("diag"), CONSOLE_UNKNOWN);
+    TEST_ASSERT_EQ(execute("help"), CONSOLE_OK);
+}
+
+/* Lines typed on a terminal, with their answers */
+static void test_lines(void)
+{
+    setup();
+    type_line("set period 60\r");
+    TEST_ASSERT_EQ(testCalls, 1);
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+    TEST_ASSERT_EQ(testNotified, 1);
+
+    /* CR LF: the empty line after the CR is silent */
+    clear_output();
+    type_line("diag\r\n");
+    TEST_ASSERT_EQ(testCalls, 2);
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+    TEST_ASSERT_EQ(testNotified, 3);
+
+    clear_output();
+    type_line("reboot\n");
+    TEST_ASSERT(0 == strcmp(testOutput, "ERR 2\r\n"));
+    clear_output();
+    type_line("class 60\n");
+    TEST_ASSERT(0 == strcmp(testOutput, "ERR 4\r\n"));
+
+    /* Backspace and delete edit the line, not beyond its start */
+    clear_output();
+    type_line("sen\b\bet\x7F\x7F" "end alarm\r");
+    TEST_ASSERT_EQ(testArgc, 2);
+    TEST_ASSERT(0 == strcmp(testArgv[0], "send"));
+    TEST_ASSERT(0 == strcmp(testArgv[1], "alarm"));
+    type_line("\b\b\b\bdiag\r");
+    TEST_ASSERT(0 == strcmp(testArgv[0], "diag"));
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\nOK\r\n"));
+}
+
+/* The longest line runs, one byte more drops it and the next line is clean */
+static void test_line_length(void)
+{
+    char line[CONSOLE_LINE_LENGTH + 3u];
+
+    setup();
+    memset(line, 'x', sizeof(line));
+    memcpy(line, "wide ", 5);
+    line[CONSOLE_LINE_LENGTH] = '\r';
+    type_bytes(line, CONSOLE_LINE_LENGTH + 1u);
+    TEST_ASSERT_EQ(testCalls, 1);
+    TEST_ASSERT_EQ(strlen(testArgv[1]), CONSOLE_LINE_LENGTH - 5u);
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+
+    clear_output();
+    line[CONSOLE_LINE_LENGTH] = 'x';
+    line[CONSOLE_LINE_LENGTH + 1u] = '\r';
+    type_bytes(line, CONSOLE_LINE_LENGTH + 2u);
+    TEST_ASSERT_EQ(testCalls, 1);
+    TEST_ASSERT(0 == strcmp(testOutput, "ERR 5\r\n"));
+
+    /* A backspace does not bring a dropped line back */
+    clear_output();
+    line[CONSOLE_LINE_LENGTH + 1u] = '\b';
+    type_bytes(line, CONSOLE_LINE_LENGTH + 2u);
+    type_line("\r");
+    TEST_ASSERT_EQ(testCalls, 1);
+    TEST_ASSERT(0 == strcmp(testOutput, "ERR 5\r\n"));
+
+    clear_output();
+    type_line("diag\r");
+    TEST_ASSERT_EQ(testCalls, 2);
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+}
+
+/* A line pasted in one burst: the task only runs when it is notified */
+static void test_pasted_lines(void)
+{
+    char line[CONSOLE_LINE_LENGTH + 1u];
+
+    setup();
+    paste_line("set status 5\r\n");
+    TEST_ASSERT_EQ(testCalls, 1);
+    TEST_ASSERT(0 == strcmp(testArgv[2], "5"));
+
+    /* Longer than the receive buffer, within the line length */
+    memset(line, 'y', sizeof(line));
+    memcpy(line, "wide ", 5);
+    line[CONSOLE_LINE_LENGTH - 1u] = '\r';
+    line[CONSOLE_LINE_LENGTH] = '\0';
+    clear_output();
+    paste_line(line);
+    TEST_ASSERT_EQ(testCalls, 2);
+    TEST_ASSERT_EQ(strlen(testArgv[1]), CONSOLE_LINE_LENGTH - 6u);
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+
+    /* Two lines in one burst */
+    clear_output();
+    paste_line("diag\rsend alarm\r");
+    TEST_ASSERT_EQ(testCalls, 4);
+    TEST_ASSERT(0 == strcmp(testArgv[0], "send"));
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\nOK\r\n"));
+}
+
+/* The task late: the receive buffer overflows, the line is dropped, not cut */
+static void test_receive_overflow(void)
+{
+    setup();
+    for (uint8_t i = 0; i < 2u * CONSOLE_RX_BUFFER_SIZE; i++)
+    {
+        CONSOLE_RxIsr((uint8_t)((i < 4u) ? "set "[i] : 'z'));
+    }
+    /* The kept byte takes the line end */
+    CONSOLE_RxIsr('\r');
+    TEST_ASSERT(testNotified > 0u);
+    run_task();
+    TEST_ASSERT_EQ(testCalls, 0);
+    TEST_ASSERT(0 == strcmp(testOutput, "ERR 5\r\n"));
+
+    clear_output();
+    type_line("diag\r");
+    TEST_ASSERT_EQ(testCalls, 1);
+    TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+}
+
+/* A key answering a prompt drops the pending input */
+static void test_take_key(void)
+{
+    setup();
+    TEST_ASSERT(!CONSOLE_TakeKey());
+    /* Line ends are not keys */
+    CONSOLE_RxIsr('\r');
+    TEST_ASSERT(!CONSOLE_TakeKey());
+    run_task();
+
+    CONSOLE_RxIsr('d');
+    CONSOLE_RxIsr('i');
+    TEST_ASSERT(CONSOLE_TakeKey());
+    TEST_ASSERT(!CONSOLE_TakeKey());
+    type_line("ag\r");
+    TEST_ASSERT_EQ(testCalls, 0);
+    TEST_ASSERT(0 == strcmp(testOutput, "ERR 2\r\n"));
+}
+
+/* Random bytes never run a handler with a wrong argument count nor break
+   the next line */
+static void test_random_input(void)
+{
+    uint32_t seed = 47u;
+
+    setup();
+    for (uint16_t round = 0; round < 2000u; round++)
+    {
+        uint8_t length = (uint8_t)(seed % 80u);
+
+        for (uint8_t i = 0; i < length; i++)
+        {
+            static const char alphabet[] = "set diag send class wide alarm 60 \r\n\b\x7F";
+
+            seed = seed * 1103515245u + 12345u;
+            CONSOLE_RxIsr((uint8_t)alphabet[(seed >> 8) % (sizeof(alphabet) - 1u)]);
+            if (0u == ((seed >> 20) & 3u))
+            {
+                run_task();
+            }
+            TEST_ASSERT(testArgc <= CONSOLE_MAX_ARGS);
+        }
+        run_task();
+        CONSOLE_RxIsr('\r');
+        run_task();
+
+        clear_output();
+        testCalls = 0;
+        type_line("diag\r");
+        TEST_ASSERT_EQ(testCalls, 1);
+        TEST_ASSERT(0 == strcmp(testOutput, "OK\r\n"));
+        seed = seed * 1103515245u + 12345u;
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_split);
+    TEST_RUN(test_dispatch);
+    TEST_RUN(test_lines);
+    TEST_RUN(test_line_length);
+    TEST_RUN(test_pasted_lines);
+    TEST_RUN(test_receive_overflow);
+    TEST_RUN(test_take_key);
+    TEST_RUN(test_random_input);
+    return TEST_END();
+}
@@ -0,0 +1,139 @@
+/**
+* \file  test_dl_cmd.c
+*
+* \brief Host tests of the downlink command parser
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "dl_cmd.h"
+#include "conf_app.h"
+
+/***************************** FUNCTIONS ***************************************/
+
+static DlCmdStatus_t parse(const uint8_t *data, uint8_t length, DlCmdRequest_t *req)
+{
+    req->params = *APP_PARAMS_Get();
+    return DL_CMD_Parse(data, length, req);
+}
+
+static void test_parse_all_types(void)
+{
+    static const uint8_t frame[] =
+    {
+        0x2A,
+        DL_CMD_TYPE_ALARM_THRESHOLD, 2, 0x96, 0x00,
+        DL_CMD_TYPE_SAMPLE_PERIOD, 2, 0x3C, 0x00,
+        DL_CMD_TYPE_CONFIRM_COUNT, 1, 7,
+        DL_CMD_TYPE_STATUS_PERIODS, 1, 12,
+        DL_CMD_TYPE_DIAG_REQUEST, 0,
+        DL_CMD_TYPE_CLASS_C_WINDOW, 2, 0x2C, 0x01
+    };
+    DlCmdRequest_t req;
+
+    APP_PARAMS_Init();
+    TEST_ASSERT_EQ(parse(frame, sizeof(frame), &req), DL_CMD_OK);
+    TEST_ASSERT_EQ(req.seq, 0x2A);
+    TEST_ASSERT(req.params.alarmThreshold == 1.5f);
+    TEST_ASSERT_EQ(req.params.samplePeriodMs, 60000);
+    TEST_ASSERT_EQ(req.params.confirmCount, 7);
+    TEST_ASSERT_EQ(req.params.statusPeriods, 12);
+    TEST_ASSERT(req.diagRequest);
+    TEST_ASSERT_EQ(req.classCWindowS, 300);
+    /* Parsing stages only */
+    TEST_ASSERT_EQ(APP_PARAMS_Get()->confirmCount, DEMO_APP_ACC_ALARM_CONFIRM_COUNT);
+}
+
+static void test_parse_errors(void)
+{
+    static const uint8_t headerCut[] = { 1, DL_CMD_TYPE_CONFIRM_COUNT };
+    static const uint8_t valueCut[] = { 1, DL_CMD_TYPE_SAMPLE_PERIOD, 2, 0x3C };
+    static const uint8_t unknown[] = { 1, 0x7F, 0 };
+    static const uint8_t badLength[] = { 1, DL_CMD_TYPE_CONFIRM_COUNT, 2, 3, 0 };
+    static const uint8_t badPeriod[] = { 1, DL_CMD_TYPE_SAMPLE_PERIOD, 2, 0, 0 };
+    static const uint8_t badCount[] = { 1, DL_CMD_TYPE_CONFIRM_COUNT, 1, APP_PARAMS_CONFIRM_COUNT_MAX + 1 };
+    static const uint8_t badThreshold[] = { 1, DL_CMD_TYPE_ALARM_THRESHOLD, 2, 0xFF, 0xFF };
+    static const uint8_t noWindow[] = { 1, DL_CMD_TYPE_CLASS_C_WINDOW, 2, 0, 0 };
+    static const uint8_t seqOnly[] = { 9 };
+    DlCmdRequest_t req;
+
+    APP_PARAMS_Init();
+    TEST_ASSERT_EQ(parse(NULL, 0, &req), DL_CMD_ERR_LENGTH);
+    TEST_ASSERT_EQ(parse(headerCut, sizeof(headerCut), &req), DL_CMD_ERR_LENGTH);
+    TEST_ASSERT_EQ(parse(valueCut, sizeof(valueCut), &req), DL_CMD_ERR_LENGTH);
+    TEST_ASSERT_EQ(parse(unknown, sizeof(unknown), &req), DL_CMD_ERR_TYPE);
+    TEST_ASSERT_EQ(parse(badLength, sizeof(badLength), &req), DL_CMD_ERR_LENGTH);
+    TEST_ASSERT_EQ(parse(badPeriod, sizeof(badPeriod), &req), DL_CMD_ERR_VALUE);
+    TEST_ASSERT_EQ(parse(badCount, sizeof(badCount), &req), DL_CMD_ERR_VALUE);
+    TEST_ASSERT_EQ(parse(badThreshold, sizeof(badThreshold), &req), DL_CMD_ERR_VALUE);
+    TEST_ASSERT_EQ(parse(noWindow, sizeof(noWindow), &req), DL_CMD_ERR_VALUE);
+    TEST_ASSERT_EQ(parse(seqOnly, sizeof(seqOnly), &req), DL_CMD_OK);
+    TEST_ASSERT_EQ(req.seq, 9);
+}
+
+/* One bad TLV rejects the whole frame */
+static void test_handle_is_atomic(void)
+{
+    static const uint8_t frame[] =
+    {
+        5,
+        DL_CMD_TYPE_CONFIRM_COUNT, 1, 2,
+        DL_CMD_TYPE_SAMPLE_PERIOD, 2, 0, 0
+    };
+    AppParams_t before;
+    uint8_t ack[DL_CMD_ACK_LENGTH];
+
+    APP_PARAMS_Init();
+    before = *APP_PARAMS_Get();
+    TEST_ASSERT_EQ(DL_CMD_Handle(frame, sizeof(frame)), DL_CMD_ERR_VALUE);
+    TEST_ASSERT_MEM(APP_PARAMS_Get(), &before, sizeof(before));
+    TEST_ASSERT_EQ(DL_CMD_PeekAck(ack, sizeof(ack)), DL_CMD_ACK_LENGTH);
+    TEST_ASSERT_EQ(ack[0], 5);
+    TEST_ASSERT_EQ(ack[1], DL_CMD_ERR_VALUE);
+    DL_CMD_AckSent();
+}
+
+static void test_handle_applies_and_acks(void)
+{
+    static const uint8_t frame[] =
+    {
+        6,
+        DL_CMD_TYPE_CONFIRM_COUNT, 1, 2,
+        DL_CMD_TYPE_STATUS_PERIODS, 1, 4,
+        DL_CMD_TYPE_DIAG_REQUEST, 0,
+        DL_CMD_TYPE_CLASS_C_WINDOW, 2, 60, 0
+    };
+    uint8_t ack[DL_CMD_ACK_LENGTH];
+
+    APP_PARAMS_Init();
+    TEST_ASSERT_EQ(DL_CMD_Handle(frame, sizeof(frame)), DL_CMD_OK);
+    TEST_ASSERT_EQ(APP_PARAMS_Get()->confirmCount, 2);
+    TEST_ASSERT_EQ(APP_PARAMS_Get()->statusPeriods, 4);
+    TEST_ASSERT(DL_CMD_DiagRequested());
+    DL_CMD_DiagSent();
+    TEST_ASSERT(!DL_CMD_DiagRequested());
+    TEST_ASSERT_EQ(DL_CMD_TakeClassCWindow(), 60);
+    TEST_ASSERT_EQ(DL_CMD_TakeClassCWindow(), 0);
+
+    /* Kept until an uplink carrying it was accepted */
+    TEST_ASSERT_EQ(DL_CMD_PeekAck(ack, 1), 0);
+    TEST_ASSERT_EQ(DL_CMD_PeekAck(ack, sizeof(ack)), DL_CMD_ACK_LENGTH);
+    TEST_ASSERT_EQ(DL_CMD_PeekAck(ack, sizeof(ack)), DL_CMD_ACK_LENGTH);
+    TEST_ASSERT_EQ(ack[0], 6);
+    TEST_ASSERT_EQ(ack[1], DL_CMD_OK);
+    DL_CMD_AckSent();
+    TEST_ASSERT_EQ(DL_CMD_PeekAck(ack, sizeof(ack)), 0);
+
+    TEST_ASSERT_EQ(DL_CMD_Handle(frame, 0), DL_CMD_ERR_LENGTH);
+    TEST_ASSERT_EQ(DL_CMD_PeekAck(ack, sizeof(ack)), 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_parse_all_types);
+    TEST_RUN(test_parse_errors);
+    TEST_RUN(test_handle_is_atomic);
+    TEST_RUN(test_handle_applies_and_acks);
+    return TEST_END();
+}
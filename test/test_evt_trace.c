@@ -0,0 +1,218 @@
+/**
+* \file  test_evt_trace.c
+*
+* \brief Host tests of the stack callback event recorder
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "evt_trace.h"
+
+/****************************** MACROS **************************************/
+#define TEST_MAX_EVENTS                     (EVT_TRACE_DEPTH * 2u)
+
+/****************************** TYPES **************************************/
+typedef struct _TestCapture_t
+{
+    uint16_t count;
+    EvtTraceEvent_t events[TEST_MAX_EVENTS];
+} TestCapture_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint8_t testTrace[EVT_TRACE_DEPTH * EVT_TRACE_RECORD_LENGTH];
+
+/***************************** FUNCTIONS ***************************************/
+
+static void capture(const EvtTraceEvent_t *event, void *param)
+{
+    TestCapture_t *capture = param;
+
+    if (capture->count < TEST_MAX_EVENTS)
+    {
+        capture->events[capture->count] = *event;
+    }
+    capture->count++;
+}
+
+static uint16_t replay(TestCapture_t *result)
+{
+    uint16_t length = EVT_TRACE_Export(testTrace, sizeof(testTrace));
+
+    memset(result, 0, sizeof(*result));
+    return EVT_TRACE_Replay(testTrace, length, capture, result);
+}
+
+static void test_round_trip(void)
+{
+    TestCapture_t result;
+
+    EVT_TRACE_Init();
+    TEST_ASSERT_EQ(EVT_TRACE_Count(), 0);
+    TEST_ASSERT_EQ(EVT_TRACE_Export(testTrace, sizeof(testTrace)), 0);
+
+    EVT_TRACE_Record(EVT_TRACE_JOIN_REQ, 8, 5000);
+    EVT_TRACE_Record(EVT_TRACE_JOIN, 8, 11100);
+    EVT_TRACE_Record(EVT_TRACE_SEND, 8, 11200);
+    EVT_TRACE_Record(EVT_TRACE_TX_DONE, 21, 13500);
+    TEST_ASSERT_EQ(EVT_TRACE_Count(), 4);
+    TEST_ASSERT_EQ(EVT_TRACE_Export(testTrace, sizeof(testTrace)), 4 * EVT_TRACE_RECORD_LENGTH);
+
+    TEST_ASSERT_EQ(replay(&result), 4);
+    TEST_ASSERT_EQ(result.count, 4);
+    /* Times start at the first event */
+    TEST_ASSERT_EQ(result.events[0].kind, EVT_TRACE_JOIN_REQ);
+    TEST_ASSERT_EQ(result.events[0].timeMs, 0);
+    TEST_ASSERT_EQ(result.events[1].kind, EVT_TRACE_JOIN);
+    TEST_ASSERT_EQ(result.events[1].timeMs, 6100);
+    TEST_ASSERT_EQ(result.events[2].timeMs, 6200);
+    TEST_ASSERT_EQ(result.events[3].kind, EVT_TRACE_TX_DONE);
+    TEST_ASSERT_EQ(result.events[3].status, 21);
+    TEST_ASSERT_EQ(result.events[3].timeMs, 8500);
+}
+
+/* The 4-byte record format, little endian delta */
+static void test_record_format(void)
+{
+    static const uint8_t expected[] = { EVT_TRACE_WAKE, 1, 0, 0, EVT_TRACE_SEND, 8, 0x34, 0x12 };
+
+    EVT_TRACE_Init();
+    EVT_TRACE_Record(EVT_TRACE_WAKE, 1, 100);
+    EVT_TRACE_Record(EVT_TRACE_SEND, 8, 100 + 0x1234);
+    TEST_ASSERT_EQ(EVT_TRACE_Export(testTrace, sizeof(testTrace)), sizeof(expected));
+    TEST_ASSERT_MEM(testTrace, expected, sizeof(expected));
+}
+
+/* Long sleeps take a gap record, the timestamps stay exact to the ms */
+static void test_gaps(void)
+{
+    static const uint32_t gaps[] = { 65535u, 65536u, 300000u, 86400000u + 123u, 3000000000u };
+    TestCapture_t result;
+    uint32_t nowMs = 7;
+    uint32_t expectedMs = 0;
+
+    EVT_TRACE_Init();
+    EVT_TRACE_Record(EVT_TRACE_WAKE, 0, nowMs);
+    for (uint8_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++)
+    {
+        nowMs += gaps[i];
+        EVT_TRACE_Record(EVT_TRACE_WAKE, i, nowMs);
+    }
+    /* All but the first gap need a gap record */
+    TEST_ASSERT_EQ(EVT_TRACE_Count(), 1 + 5 + 4);
+    TEST_ASSERT_EQ(replay(&result), 6);
+    for (uint8_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++)
+    {
+        expectedMs += gaps[i];
+        TEST_ASSERT_EQ(result.events[i + 1].status, i);
+        TEST_ASSERT_EQ(result.events[i + 1].timeMs, expectedMs);
+    }
+}
+
+/* The time wraps around at 2^32 ms */
+static void test_time_wrap(void)
+{
+    TestCapture_t result;
+
+    EVT_TRACE_Init();
+    EVT_TRACE_Record(EVT_TRACE_SEND, 8, UINT32_MAX - 99u);
+    EVT_TRACE_Record(EVT_TRACE_TX_DONE, 8, 1900);
+    TEST_ASSERT_EQ(replay(&result), 2);
+    TEST_ASSERT_EQ(result.events[1].timeMs, 2000);
+}
+
+/* A full ring keeps the most recent records */
+static void test_overwrite(void)
+{
+    TestCapture_t result;
+
+    EVT_TRACE_Init();
+    for (uint16_t i = 0; i < EVT_TRACE_DEPTH + 10u; i++)
+    {
+        EVT_TRACE_Record(EVT_TRACE_TX_DONE, (uint8_t)i, 1000u * i);
+    }
+    TEST_ASSERT_EQ(EVT_TRACE_Count(), EVT_TRACE_DEPTH);
+    TEST_ASSERT_EQ(replay(&result), EVT_TRACE_DEPTH);
+    for (uint16_t i = 0; i < EVT_TRACE_DEPTH; i++)
+    {
+        TEST_ASSERT_EQ(result.events[i].status, (uint8_t)(i + 10u));
+        TEST_ASSERT_EQ(result.events[i].timeMs, 1000u * i);
+    }
+}
+
+/* A gap record left first by the overwrite is only the time origin */
+static void test_overwritten_gap_origin(void)
+{
+    TestCapture_t result;
+
+    EVT_TRACE_Init();
+    EVT_TRACE_Record(EVT_TRACE_WAKE, 0, 0);
+    EVT_TRACE_Record(EVT_TRACE_WAKE, 1, 600000);
+    for (uint16_t i = 0; i < EVT_TRACE_DEPTH - 2u; i++)
+    {
+        EVT_TRACE_Record(EVT_TRACE_SEND, 2, 600000 + 10u * (i + 1u));
+    }
+    /* The first event is gone, its gap record opens the ring */
+    TEST_ASSERT_EQ(EVT_TRACE_Export(testTrace, sizeof(testTrace)), sizeof(testTrace));
+    TEST_ASSERT_EQ(testTrace[0], EVT_TRACE_GAP);
+    TEST_ASSERT_EQ(replay(&result), EVT_TRACE_DEPTH - 1u);
+    TEST_ASSERT_EQ(result.events[0].status, 1);
+    TEST_ASSERT_EQ(result.events[0].timeMs, 0);
+    TEST_ASSERT_EQ(result.events[1].timeMs, 10);
+}
+
+/* A short buffer takes the most recent whole records */
+static void test_export_truncated(void)
+{
+    uint8_t buffer[11];
+    TestCapture_t result = { 0 };
+
+    EVT_TRACE_Init();
+    for (uint8_t i = 0; i < 5u; i++)
+    {
+        EVT_TRACE_Record(EVT_TRACE_RX_DATA, i, 50u * i);
+    }
+    TEST_ASSERT_EQ(EVT_TRACE_Export(buffer, sizeof(buffer)), 2 * EVT_TRACE_RECORD_LENGTH);
+    TEST_ASSERT_EQ(buffer[1], 3);
+    TEST_ASSERT_EQ(buffer[5], 4);
+    /* A trailing partial record is ignored */
+    TEST_ASSERT_EQ(EVT_TRACE_Replay(buffer, sizeof(buffer), capture, &result), 2);
+    TEST_ASSERT_EQ(result.events[1].timeMs, 50);
+    TEST_ASSERT_EQ(EVT_TRACE_Replay(buffer, 3, capture, &result), 0);
+}
+
+/* The same trace always replays the same events */
+static void test_replay_deterministic(void)
+{
+    TestCapture_t first;
+    TestCapture_t second;
+    uint32_t nowMs = 12345;
+
+    EVT_TRACE_Init();
+    for (uint16_t i = 0; i < EVT_TRACE_DEPTH; i++)
+    {
+        nowMs += (i % 7u) * 40000u + i;
+        EVT_TRACE_Record((EvtTraceKind_t)(1u + (i % 6u)), (uint8_t)(i * 3u), nowMs);
+    }
+    replay(&first);
+    replay(&second);
+    TEST_ASSERT(first.count > 0);
+    TEST_ASSERT_EQ(first.count, second.count);
+    TEST_ASSERT_MEM(first.events, second.events, first.count * sizeof(EvtTraceEvent_t));
+    /* Without a handler the events are only counted */
+    TEST_ASSERT_EQ(EVT_TRACE_Replay(testTrace, EVT_TRACE_Export(testTrace, sizeof(testTrace)), NULL, NULL),
+                   first.count);
+}
+
+int main(void)
+{
+    TEST_RUN(test_round_trip);
+    TEST_RUN(test_record_format);
+    TEST_RUN(test_gaps);
+    TEST_RUN(test_time_wrap);
+    TEST_RUN(test_overwrite);
+    TEST_RUN(test_overwritten_gap_origin);
+    TEST_RUN(test_export_truncated);
+    TEST_RUN(test_replay_deterministic);
+    return TEST_END();
+}
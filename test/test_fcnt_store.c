@@ -0,0 +1,226 @@
+/**
+* \file  test_fcnt_store.c
+*
+* \brief Host tests of the frame counter persistence on the NVM stand-in
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "nvm_ram.h"
+#include "fcnt_store.h"
+
+/****************************** MACROS **************************************/
+#define TEST_FCNT_OFFSET                    0xC600u
+#define TEST_BLOCK                          16u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const AppNvmOps_t *nvm;
+
+/***************************** FUNCTIONS ***************************************/
+
+static void setup(void)
+{
+    nvm = NVM_RAM_Init();
+    FCNT_STORE_Init(nvm, TEST_FCNT_OFFSET, TEST_BLOCK);
+}
+
+/* Reset: the flash keeps its content */
+static void reboot(void)
+{
+    FCNT_STORE_Init(nvm, TEST_FCNT_OFFSET, TEST_BLOCK);
+}
+
+/* Every join starts a new epoch, a restored session keeps its own */
+static void test_epoch_per_session(void)
+{
+    uint32_t fCntUp = 0;
+    uint32_t fCntDown = 0;
+
+    setup();
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 0);
+    TEST_ASSERT(FCNT_STORE_Start(0x26000001u, 0, 0));
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 1);
+
+    reboot();
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 1);
+    TEST_ASSERT(FCNT_STORE_Restore(0x26000001u, &fCntUp, &fCntDown));
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 1);
+
+    /* A rejoin, even with the same DevAddr and counters from 0 */
+    TEST_ASSERT(FCNT_STORE_Start(0x26000001u, 0, 0));
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 2);
+    reboot();
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 2);
+    TEST_ASSERT(FCNT_STORE_Start(0x26000002u, 0, 0));
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 3);
+}
+
+/* The epoch survives the log wrapping over its rows */
+static void test_epoch_across_wrap(void)
+{
+    setup();
+    TEST_ASSERT(FCNT_STORE_Start(0x26000001u, 0, 0));
+    TEST_ASSERT(FCNT_STORE_Start(0x26000001u, 0, 0));
+    for (uint32_t fCnt = 0; fCnt < 100u * TEST_BLOCK; fCnt++)
+    {
+        TEST_ASSERT(FCNT_STORE_Reserve(fCnt, 0));
+    }
+    TEST_ASSERT(FCNT_STORE_GetStats()->erases > FCNT_STORE_ROWS);
+    reboot();
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 2);
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->limit, 100u * TEST_BLOCK);
+}
+
+/* No record, no frame: a join whose record is lost does not use its epoch */
+static void test_epoch_write_failure(void)
+{
+    setup();
+    NVM_RAM_CutAfter(0);
+    TEST_ASSERT(!FCNT_STORE_Start(0x26000001u, 0, 0));
+    TEST_ASSERT(!FCNT_STORE_Reserve(0, 0));
+    reboot();
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, 0);
+}
+
+/* One record per block of uplinks, a reset skips at most the rest of the block */
+static void test_block_reservation(void)
+{
+    uint32_t fCntUp = 0;
+    uint32_t fCntDown = 0;
+
+    setup();
+    TEST_ASSERT(FCNT_STORE_Start(0x26000001u, 0, 0));
+    for (uint32_t fCnt = 0; fCnt < 1000u; fCnt++)
+    {
+        TEST_ASSERT(FCNT_STORE_Reserve(fCnt, fCnt / 10u));
+    }
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->writes, (1000u + TEST_BLOCK - 1u) / TEST_BLOCK);
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->limit, 1008);
+
+    /* The stack lost its counters: 1000 is next, 1008 is resumed */
+    reboot();
+    TEST_ASSERT(FCNT_STORE_Restore(0x26000001u, &fCntUp, &fCntDown));
+    TEST_ASSERT_EQ(fCntUp, 1008);
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->gap, 1008);
+    /* The downlink counter of the last record, not ahead of it */
+    TEST_ASSERT_EQ(fCntDown, 99);
+
+    /* Counters the stack kept itself are not lowered */
+    fCntUp = 2000u;
+    fCntDown = 500u;
+    reboot();
+    TEST_ASSERT(FCNT_STORE_Restore(0x26000001u, &fCntUp, &fCntDown));
+    TEST_ASSERT_EQ(fCntUp, 2000);
+    TEST_ASSERT_EQ(fCntDown, 500);
+    TEST_ASSERT_EQ(FCNT_STORE_GetStats()->gap, 0);
+
+    /* Another session has nothing to restore */
+    reboot();
+    TEST_ASSERT(!FCNT_STORE_Restore(0x26000002u, &fCntUp, &fCntDown));
+}
+
+/* Random power cuts, during the writes or between them, over many resets:
+   no uplink counter of a session is ever sent twice, a restore skips at
+   most a block and never goes ahead of the downlink counter */
+static void test_random_power_cuts(void)
+{
+    uint32_t seed = 20260u;
+    uint32_t devAddr = 0x26000001u;
+    uint32_t epoch = 0;
+    /* Next counter the stack would use, in RAM, and the highest one sent */
+    uint32_t stackUp = 0;
+    uint32_t nextUnsent = 0;
+    uint32_t down = 0;
+    uint32_t recordedDown = 0;
+    bool session = false;
+    uint32_t sent = 0;
+    uint32_t cuts = 0;
+    uint32_t skipped = 0;
+
+    setup();
+    for (uint16_t life = 0; life < 3000u; life++)
+    {
+        uint16_t uplinks;
+
+        seed = seed * 1103515245u + 12345u;
+        uplinks = (uint16_t)((seed >> 8) % 60u);
+        seed = seed * 1103515245u + 12345u;
+        /* Half of the lives end on a cut within the next records */
+        NVM_RAM_CutAfter((0u != ((seed >> 8) & 1u)) ? ((seed >> 9) % 200u) : NVM_RAM_NO_CUT);
+
+        reboot();
+        /* The stack keeps a stale copy of its counters, or none */
+        stackUp = (0u != (seed & 0x100000u)) ? (nextUnsent / 2u) : 0;
+        if (session && FCNT_STORE_Restore(devAddr, &stackUp, &down))
+        {
+            TEST_ASSERT(stackUp >= nextUnsent);
+            TEST_ASSERT(stackUp - nextUnsent <= TEST_BLOCK);
+            TEST_ASSERT(down >= recordedDown);
+            TEST_ASSERT_EQ(FCNT_STORE_GetStats()->epoch, epoch);
+            skipped += stackUp - nextUnsent;
+        }
+        else if (0u == (life % 500u) || !session)
+        {
+            /* Joined, or joined again: a new session from 0 */
+            devAddr += session ? 1u : 0u;
+            stackUp = 0;
+            nextUnsent = 0;
+            down = 0;
+            recordedDown = 0;
+            session = true;
+            if (!FCNT_STORE_Start(devAddr, 0, 0))
+            {
+                /* Nothing sent until a record holds the session */
+                cuts++;
+                session = false;
+                continue;
+            }
+            epoch = FCNT_STORE_GetStats()->epoch;
+        }
+        else
+        {
+            /* A session always has its record */
+            TEST_ASSERT(false);
+        }
+
+        for (uint16_t i = 0; i < uplinks; i++)
+        {
+            uint32_t limit = FCNT_STORE_GetStats()->limit;
+
+            if (!FCNT_STORE_Reserve(stackUp, down))
+            {
+                cuts++;
+                break;
+            }
+            if (FCNT_STORE_GetStats()->limit != limit)
+            {
+                recordedDown = down;
+            }
+            /* Sent on the air */
+            TEST_ASSERT(stackUp >= nextUnsent);
+            TEST_ASSERT(stackUp < FCNT_STORE_GetStats()->limit);
+            nextUnsent = stackUp + 1u;
+            stackUp++;
+            sent++;
+            if (0u == (i % 7u))
+            {
+                down++;
+            }
+        }
+    }
+    printf("Power cuts: %lu uplinks, %lu cuts, %lu counters skipped\n", (unsigned long)sent, (unsigned long)cuts,
+           (unsigned long)skipped);
+    TEST_ASSERT(cuts > 200u);
+    TEST_ASSERT(sent > 50000u);
+}
+
+int main(void)
+{
+    TEST_RUN(test_epoch_per_session);
+    TEST_RUN(test_epoch_across_wrap);
+    TEST_RUN(test_epoch_write_failure);
+    TEST_RUN(test_block_reservation);
+    TEST_RUN(test_random_power_cuts);
+    return TEST_END();
+}
@@ -0,0 +1,290 @@
+/**
+* \file  test_frag_session.c
+*
+* \brief Host tests of the fragmented block reassembly and its FEC decoder
+*
+* The blocks are encoded here with the parity matrix of the LoRaWAN
+* fragmented data block transport and sent through random loss patterns.
+* Prints the RAM of the decoder, the parity fragments needed and the
+* decode time per loss rate.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdlib.h>
+#include <time.h>
+#include "test.h"
+#include "nvm_ram.h"
+#include "frag_session.h"
+
+/****************************** MACROS **************************************/
+#define TEST_NB_FRAG                        200u
+#define TEST_FRAG_SIZE                      48u
+#define TEST_TRIALS                         40u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint8_t block[FRAG_MAX_NB_FRAG * FRAG_MAX_SIZE];
+static uint32_t testRandom = 12345u;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t test_random(void)
+{
+    testRandom = testRandom * 1103515245u + 12345u;
+    return testRandom >> 8;
+}
+
+static uint32_t now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+}
+
+static uint32_t prbs23(uint32_t x)
+{
+    uint32_t b0 = x & 1u;
+    uint32_t b1 = (x & 32u) >> 5;
+
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+/* Parity fragment n of a block of m uncoded fragments, as sent by the server */
+static void encode_parity(uint16_t n, uint16_t m, uint8_t fragSize, uint8_t *out)
+{
+    uint32_t x = 1u + (1001u * n);
+    uint32_t nm = ((m & (m - 1u)) == 0u) ? 1u : 0u;
+    uint8_t used[FRAG_MAX_NB_FRAG] = { 0 };
+
+    memset(out, 0, fragSize);
+    for (uint16_t coeff = 0; coeff < (m / 2u); coeff++)
+    {
+        uint32_t r = 1uL << 16;
+
+        while (r >= m)
+        {
+            x = prbs23(x);
+            r = x % (m + nm);
+        }
+        used[r] = 1;
+    }
+    for (uint16_t j = 0; j < m; j++)
+    {
+        if (used[j])
+        {
+            for (uint8_t i = 0; i < fragSize; i++)
+            {
+                out[i] ^= block[(uint32_t)j * fragSize + i];
+            }
+        }
+    }
+}
+
+static void fill_block(uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++)
+    {
+        block[i] = (uint8_t)test_random();
+    }
+}
+
+static bool block_matches(uint32_t length)
+{
+    return 0 == memcmp(NVM_RAM_Data(), block, length);
+}
+
+/* Sends the uncoded then the parity fragments, each lost with lossPermille,
+ * returns the parity fragments sent before the block was complete */
+static uint16_t transfer(uint16_t nbFrag, uint8_t fragSize, uint16_t lossPermille, uint16_t maxParity)
+{
+    uint8_t fragment[FRAG_MAX_SIZE];
+    uint16_t parity;
+
+    for (uint16_t index = 1; index <= nbFrag; index++)
+    {
+        if ((test_random() % 1000u) >= lossPermille)
+        {
+            FRAG_SESSION_OnFragment(index, &block[(uint32_t)(index - 1u) * fragSize], fragSize);
+        }
+    }
+    for (parity = 0; (parity < maxParity) && (FRAG_STATUS_ONGOING == FRAG_SESSION_GetStatus()); parity++)
+    {
+        if ((test_random() % 1000u) >= lossPermille)
+        {
+            encode_parity((uint16_t)(parity + 1u), nbFrag, fragSize, fragment);
+            FRAG_SESSION_OnFragment((uint16_t)(nbFrag + parity + 1u), fragment, fragSize);
+        }
+    }
+    return parity;
+}
+
+static void setup(void)
+{
+    FRAG_SESSION_Init(NVM_RAM_Init(), 0, 0xC000u, now_us);
+}
+
+static void test_setup_errors(void)
+{
+    setup();
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(0, 48, 0), FRAG_STATUS_ERR_PARAM);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(FRAG_MAX_NB_FRAG + 1u, 48, 0), FRAG_STATUS_ERR_PARAM);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(10, 0, 0), FRAG_STATUS_ERR_PARAM);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(10, FRAG_MAX_SIZE + 1u, 0), FRAG_STATUS_ERR_PARAM);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(10, 48, 48), FRAG_STATUS_ERR_PARAM);
+    /* Block and parity area larger than the NVM given */
+    FRAG_SESSION_Init(NVM_RAM_Init(), 0, 0x1000u, NULL);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(100, 48, 0), FRAG_STATUS_ERR_PARAM);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(10, 48, 0), FRAG_STATUS_ONGOING);
+}
+
+static void test_without_loss(void)
+{
+    setup();
+    fill_block(TEST_NB_FRAG * TEST_FRAG_SIZE);
+    TEST_ASSERT_EQ(FRAG_SESSION_Setup(TEST_NB_FRAG, TEST_FRAG_SIZE, 5), FRAG_STATUS_ONGOING);
+    TEST_ASSERT_EQ(transfer(TEST_NB_FRAG, TEST_FRAG_SIZE, 0, 0), 0);
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStatus(), FRAG_STATUS_COMPLETE);
+    TEST_ASSERT(block_matches(TEST_NB_FRAG * TEST_FRAG_SIZE));
+    TEST_ASSERT_EQ(FRAG_SESSION_BlockLength(), TEST_NB_FRAG * TEST_FRAG_SIZE - 5u);
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStats()->lost, 0);
+}
+
+/* Recovery through random losses, within and beyond the redundancy */
+static void test_random_loss(void)
+{
+    static const uint16_t lossPermille[] = { 20, 50, 100, 150, 200, 300 };
+
+    printf("frag_session: ram %lu bytes, %u fragments of %u bytes, %u trials per loss rate\n",
+           (unsigned long)FRAG_SESSION_GetStats()->ramBytes, TEST_NB_FRAG, TEST_FRAG_SIZE, TEST_TRIALS);
+    printf("loss_permille,complete,too_many_lost,mean_lost,mean_parity_sent,mean_parity_useful,"
+           "mean_decode_us,max_decode_us\n");
+
+    for (uint8_t l = 0; l < sizeof(lossPermille) / sizeof(lossPermille[0]); l++)
+    {
+        uint32_t complete = 0;
+        uint32_t tooMany = 0;
+        uint32_t lostSum = 0;
+        uint32_t paritySum = 0;
+        uint32_t usefulSum = 0;
+        uint32_t decodeSum = 0;
+        uint32_t decodeMax = 0;
+
+        for (uint16_t trial = 0; trial < TEST_TRIALS; trial++)
+        {
+            const FragSessionStats_t *stats;
+            uint16_t parity;
+
+            setup();
+            fill_block(TEST_NB_FRAG * TEST_FRAG_SIZE);
+            FRAG_SESSION_Setup(TEST_NB_FRAG, TEST_FRAG_SIZE, 0);
+            parity = transfer(TEST_NB_FRAG, TEST_FRAG_SIZE, lossPermille[l], TEST_NB_FRAG);
+            stats = FRAG_SESSION_GetStats();
+
+            if (FRAG_STATUS_COMPLETE == FRAG_SESSION_GetStatus())
+            {
+                TEST_ASSERT(block_matches(TEST_NB_FRAG * TEST_FRAG_SIZE));
+                TEST_ASSERT(stats->lost <= FRAG_MAX_REDUNDANCY);
+                TEST_ASSERT_EQ(stats->codedUseful, stats->lost);
+                complete++;
+                lostSum += stats->lost;
+                paritySum += parity;
+                usefulSum += stats->codedUseful;
+                decodeSum += stats->decodeTimeUs;
+                if (stats->decodeTimeUs > decodeMax)
+                {
+                    decodeMax = stats->decodeTimeUs;
+                }
+            }
+            else
+            {
+                /* Only a loss beyond the redundancy may stop the decoder */
+                TEST_ASSERT_EQ(FRAG_SESSION_GetStatus(), FRAG_STATUS_ERR_TOO_MANY_LOST);
+                tooMany++;
+            }
+        }
+        printf("%u,%lu,%lu,%.1f,%.1f,%.1f,%.0f,%lu\n", lossPermille[l], (unsigned long)complete,
+               (unsigned long)tooMany, complete ? (double)lostSum / complete : 0.0,
+               complete ? (double)paritySum / complete : 0.0, complete ? (double)usefulSum / complete : 0.0,
+               complete ? (double)decodeSum / complete : 0.0, (unsigned long)decodeMax);
+    }
+}
+
+static void test_duplicates_and_late_fragments(void)
+{
+    uint8_t fragment[TEST_FRAG_SIZE];
+
+    setup();
+    fill_block(20u * TEST_FRAG_SIZE);
+    FRAG_SESSION_Setup(20, TEST_FRAG_SIZE, 0);
+    for (uint16_t index = 1; index <= 20; index++)
+    {
+        if ((index != 4) && (index != 17))
+        {
+            FRAG_SESSION_OnFragment(index, &block[(index - 1u) * TEST_FRAG_SIZE], TEST_FRAG_SIZE);
+            FRAG_SESSION_OnFragment(index, &block[(index - 1u) * TEST_FRAG_SIZE], TEST_FRAG_SIZE);
+        }
+    }
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStats()->uncodedReceived, 18);
+    /* Wrong length ignored */
+    encode_parity(1, 20, TEST_FRAG_SIZE, fragment);
+    TEST_ASSERT_EQ(FRAG_SESSION_OnFragment(21, fragment, TEST_FRAG_SIZE - 1u), FRAG_STATUS_ONGOING);
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStats()->codedReceived, 0);
+    FRAG_SESSION_OnFragment(21, fragment, TEST_FRAG_SIZE);
+    /* The unknowns are fixed, a late uncoded fragment is ignored */
+    FRAG_SESSION_OnFragment(4, &block[3u * TEST_FRAG_SIZE], TEST_FRAG_SIZE);
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStats()->uncodedReceived, 18);
+    for (uint16_t n = 2; (n < 20) && (FRAG_STATUS_ONGOING == FRAG_SESSION_GetStatus()); n++)
+    {
+        encode_parity(n, 20, TEST_FRAG_SIZE, fragment);
+        FRAG_SESSION_OnFragment((uint16_t)(20u + n), fragment, TEST_FRAG_SIZE);
+    }
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStatus(), FRAG_STATUS_COMPLETE);
+    TEST_ASSERT(block_matches(20u * TEST_FRAG_SIZE));
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStats()->lost, 2);
+}
+
+static void test_messages(void)
+{
+    uint8_t message[3 + TEST_FRAG_SIZE];
+    const uint8_t setupReq[] = { FRAG_CID_SESSION_SETUP_REQ, 0, 10, 0, TEST_FRAG_SIZE, 0, 3, 0, 0, 0, 0 };
+    const uint8_t deleteReq[] = { FRAG_CID_SESSION_DELETE_REQ, 0 };
+
+    setup();
+    fill_block(10u * TEST_FRAG_SIZE);
+    TEST_ASSERT_EQ(FRAG_SESSION_HandleMessage(setupReq, sizeof(setupReq) - 1u), FRAG_STATUS_ERR_PARAM);
+    TEST_ASSERT_EQ(FRAG_SESSION_HandleMessage(setupReq, sizeof(setupReq)), FRAG_STATUS_ONGOING);
+    for (uint16_t index = 1; index <= 10; index++)
+    {
+        message[0] = FRAG_CID_DATA_FRAGMENT;
+        /* Session number in the top bits of IndexAndN */
+        message[1] = (uint8_t)index;
+        message[2] = (uint8_t)(0x40u | (index >> 8));
+        memcpy(&message[3], &block[(index - 1u) * TEST_FRAG_SIZE], TEST_FRAG_SIZE);
+        FRAG_SESSION_HandleMessage(message, sizeof(message));
+    }
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStatus(), FRAG_STATUS_COMPLETE);
+    TEST_ASSERT_EQ(FRAG_SESSION_BlockLength(), 10u * TEST_FRAG_SIZE - 3u);
+    TEST_ASSERT(block_matches(10u * TEST_FRAG_SIZE));
+    TEST_ASSERT_EQ(FRAG_SESSION_HandleMessage(deleteReq, sizeof(deleteReq)), FRAG_STATUS_IDLE);
+}
+
+static void test_nvm_failure(void)
+{
+    setup();
+    fill_block(10u * TEST_FRAG_SIZE);
+    FRAG_SESSION_Setup(10, TEST_FRAG_SIZE, 0);
+    NVM_RAM_CutAfter(3u * TEST_FRAG_SIZE);
+    transfer(10, TEST_FRAG_SIZE, 0, 0);
+    TEST_ASSERT_EQ(FRAG_SESSION_GetStatus(), FRAG_STATUS_ERR_NVM);
+}
+
+int main(void)
+{
+    TEST_RUN(test_setup_errors);
+    TEST_RUN(test_without_loss);
+    TEST_RUN(test_random_loss);
+    TEST_RUN(test_duplicates_and_late_fragments);
+    TEST_RUN(test_messages);
+    TEST_RUN(test_nvm_failure);
+    return TEST_END();
+}
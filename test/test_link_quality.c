@@ -0,0 +1,441 @@
+/**
+* \file  test_link_quality.c
+*
+* \brief Host tests of the link quality estimator against synthetic link
+*        traces
+*
+* A trace gives the SNR of the uplinks at the gateway at the highest power
+* for every uplink. Every uplink is confirmed and sent with the last
+* recommendation: it is delivered when its SNR, lowered by the TX power
+* steps and by a fast fading draw, stays above the demodulation floor of
+* its data rate. A delivered uplink brings back an acknowledgment whose
+* SNR, saturated like the one of the radio, and RSSI feed the estimator.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "link_quality.h"
+
+/****************************** MACROS **************************************/
+#define TEST_UPLINKS                        2000u
+/* Band of the demo application: DR5 to DR0, floor -20 dB at DR0 */
+#define TEST_MAX_DR                         5u
+#define TEST_FLOOR_DR0_Q4                   LINK_QUALITY_DB(-20)
+/* The radio reports no SNR above this */
+#define TEST_SNR_REPORT_MAX_Q4              LINK_QUALITY_DB(10)
+/* Dropout of the "dropout" trace */
+#define TEST_DROP_START                     800u
+#define TEST_DROP_END                       1000u
+
+/****************************** TYPES **************************************/
+typedef struct _TestTrace_t
+{
+    const char *name;
+    /* SNR of the uplinks at the highest power, dB */
+    int16_t snrDb;
+    /* Slow swing of a triangle of the period, +/- dB, 0 for none */
+    int16_t swingDb;
+    uint16_t period;
+    /* Level during the dropout, 0 for no dropout */
+    int16_t dropSnrDb;
+    /* Fast fading of every frame, +/- dB */
+    uint8_t fadingDb;
+} TestTrace_t;
+
+typedef struct _TestRun_t
+{
+    uint32_t delivered;
+    /* Energy of the frames, TX cost times time on air, and of DR0 at full power */
+    uint64_t energy;
+    uint64_t robustEnergy;
+    uint16_t changes;
+    /* First delivery after the start of the dropout and first return to
+       the setting used before it, TEST_UPLINKS if never */
+    uint16_t dropRecovered;
+    uint16_t settingRegained;
+    uint8_t dr;
+    uint8_t txPower;
+} TestRun_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const LinkQualityConfig_t testConfig =
+{
+    TEST_MAX_DR, TEST_FLOOR_DR0_Q4, LINK_QUALITY_MAX_POWERS, { 100, 80, 64, 52, 43, 36, 31, 27 },
+    LINK_QUALITY_DB(10), 900u
+};
+
+static const TestTrace_t testTraces[] =
+{
+    /* Next to the gateway: the SNR saturates */
+    { "near", 30, 0, 0, 0, 3 },
+    { "good", 8, 0, 0, 0, 3 },
+    /* Slow fading of the seasons or of the traffic around */
+    { "fading", 4, 8, 300, 0, 3 },
+    /* Far from the gateway, the slow rates are needed */
+    { "marginal", -8, 0, 0, 0, 3 },
+    /* A truck parks in front of the device */
+    { "dropout", 8, 0, 0, -8, 3 },
+    /* Multipath: deep fades of every frame */
+    { "multipath", 4, 0, 0, 0, 8 }
+};
+
+static uint32_t testSeed;
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t test_random(void)
+{
+    testSeed = testSeed * 1103515245u + 12345u;
+    return testSeed >> 8;
+}
+
+/* Fast fading, +/- range dB, a sum of two draws to favour the small ones */
+static int16_t test_fading_q4(uint8_t range)
+{
+    int32_t span = LINK_QUALITY_DB(range) + 1;
+    int32_t draw = (int32_t)(test_random() % (uint32_t)span) + (int32_t)(test_random() % (uint32_t)span);
+
+    return (int16_t)(draw - LINK_QUALITY_DB(range));
+}
+
+/* SNR of the uplinks at the highest power for uplink i */
+static int16_t trace_snr_q4(const TestTrace_t *trace, uint16_t i)
+{
+    int32_t snrQ4 = LINK_QUALITY_DB(trace->snrDb);
+
+    if (0u != trace->period)
+    {
+        int32_t position = i % trace->period;
+        int32_t half = trace->period / 2;
+        int32_t triangle = (position < half) ? position : (trace->period - position);
+
+        snrQ4 += (LINK_QUALITY_DB(trace->swingDb) * (4 * triangle - trace->period)) / trace->period;
+    }
+    if ((0 != trace->dropSnrDb) && (i >= TEST_DROP_START) && (i < TEST_DROP_END))
+    {
+        snrQ4 = LINK_QUALITY_DB(trace->dropSnrDb);
+    }
+    return (int16_t)snrQ4;
+}
+
+static int16_t floor_q4(uint8_t dr)
+{
+    return (int16_t)(TEST_FLOOR_DR0_Q4 + dr * LINK_QUALITY_DR_STEP_Q4);
+}
+
+static void run_trace(const TestTrace_t *trace, TestRun_t *run)
+{
+    uint8_t beforeDr = 0;
+    uint8_t beforeTxPower = 0;
+
+    memset(run, 0, sizeof(*run));
+    run->dropRecovered = TEST_UPLINKS;
+    run->settingRegained = TEST_UPLINKS;
+    testSeed = 2026u;
+    LINK_QUALITY_Init(&testConfig);
+
+    for (uint16_t i = 0; i < TEST_UPLINKS; i++)
+    {
+        int16_t snrQ4 = trace_snr_q4(trace, i);
+        int16_t frameQ4 = (int16_t)(snrQ4 + test_fading_q4(trace->fadingDb));
+        bool delivered = ((frameQ4 - run->txPower * LINK_QUALITY_POWER_STEP_Q4) >= floor_q4(run->dr));
+        uint8_t dr = run->dr;
+        uint8_t txPower = run->txPower;
+
+        run->energy += (uint64_t)testConfig.txCost[run->txPower] << (TEST_MAX_DR - run->dr);
+        run->robustEnergy += (uint64_t)testConfig.txCost[0] << TEST_MAX_DR;
+        if (delivered)
+        {
+            int16_t reportQ4 = (frameQ4 < TEST_SNR_REPORT_MAX_Q4) ? frameQ4 : TEST_SNR_REPORT_MAX_Q4;
+
+            run->delivered++;
+            if ((TEST_UPLINKS == run->dropRecovered) && (i >= TEST_DROP_START))
+            {
+                run->dropRecovered = i;
+            }
+            LINK_QUALITY_OnDownlink((int16_t)((frameQ4 / 16) + LINK_QUALITY_NOISE_FLOOR_DBM), (int8_t)(reportQ4 / 16));
+        }
+        LINK_QUALITY_OnUplink(true, delivered);
+
+        if (LINK_QUALITY_Recommend(&dr, &txPower))
+        {
+            TEST_ASSERT(dr <= TEST_MAX_DR);
+            TEST_ASSERT(txPower < LINK_QUALITY_MAX_POWERS);
+            if ((dr != run->dr) || (txPower != run->txPower))
+            {
+                run->changes++;
+            }
+            run->dr = dr;
+            run->txPower = txPower;
+        }
+        else
+        {
+            /* Nothing known before the first acknowledgment */
+            TEST_ASSERT_EQ(run->delivered, 0);
+        }
+
+        if (TEST_DROP_START == i + 1u)
+        {
+            beforeDr = run->dr;
+            beforeTxPower = run->txPower;
+        }
+        if ((TEST_UPLINKS == run->settingRegained) && (i >= TEST_DROP_END) && (run->dr == beforeDr) &&
+            (run->txPower == beforeTxPower))
+        {
+            run->settingRegained = i;
+        }
+    }
+}
+
+/* Recommendations computed by hand */
+static void test_recommend_values(void)
+{
+    uint8_t dr = 0xFFu;
+    uint8_t txPower = 0xFFu;
+
+    LINK_QUALITY_Init(&testConfig);
+    TEST_ASSERT(!LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 0xFFu);
+
+    /* 5 dB: DR5 keeps 12.5 dB at full power, one power step less still fits */
+    LINK_QUALITY_OnDownlink(-112, 5);
+    TEST_ASSERT_EQ(LINK_QUALITY_UplinkSnrQ4(), LINK_QUALITY_DB(5));
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 5);
+    TEST_ASSERT_EQ(txPower, 1);
+
+    /* 2 dB: DR5 misses the margin, DR4 one power step down is the cheapest */
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-115, 2);
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 4);
+    TEST_ASSERT_EQ(txPower, 1);
+
+    /* 0 dB: DR5 misses the margin, DR4 at full power is cheaper than DR3 at a lower power */
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-117, 0);
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 4);
+    TEST_ASSERT_EQ(txPower, 0);
+
+    /* Below every floor plus the margin: the most robust setting */
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-130, -15);
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 0);
+    TEST_ASSERT_EQ(txPower, 0);
+
+    /* Saturated SNR: the RSSI, 37 dB above the noise floor, is used */
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-80, 8);
+    TEST_ASSERT_EQ(LINK_QUALITY_UplinkSnrQ4(), LINK_QUALITY_DB(37));
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 5);
+    TEST_ASSERT_EQ(txPower, 7);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->dr, 5);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->txPower, 7);
+
+    /* Unsaturated SNR: a high RSSI, interference, is not trusted */
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-80, 3);
+    TEST_ASSERT_EQ(LINK_QUALITY_UplinkSnrQ4(), LINK_QUALITY_DB(3));
+}
+
+/* A new setting needs 1.5 dB more than the current one */
+static void test_hysteresis(void)
+{
+    uint8_t dr = 0;
+    uint8_t txPower = 0;
+
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-112, 5);
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(txPower, 1);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->changes, 1);
+
+    /* About 6.8 dB: 10.3 dB at power 2 would do, not enough for a change */
+    for (uint8_t i = 0; i < 20u; i++)
+    {
+        LINK_QUALITY_OnDownlink(-110, 7);
+        TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+        TEST_ASSERT_EQ(txPower, 1);
+    }
+    /* About 8.8 dB: 12.3 dB at power 2 */
+    for (uint8_t i = 0; i < 20u; i++)
+    {
+        LINK_QUALITY_OnDownlink(-108, 9);
+        LINK_QUALITY_Recommend(&dr, &txPower);
+    }
+    TEST_ASSERT_EQ(dr, 5);
+    TEST_ASSERT_EQ(txPower, 2);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->changes, 2);
+    /* Back to about 7.2 dB: power 2 keeps its 10 dB, it stays */
+    for (uint8_t i = 0; i < 20u; i++)
+    {
+        LINK_QUALITY_OnDownlink(-110, 7);
+        TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+        TEST_ASSERT_EQ(txPower, 2);
+    }
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->changes, 2);
+}
+
+/* The first downlink is taken as is, the next ones by a quarter */
+static void test_smoothing(void)
+{
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-100, -4);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->snrQ4, LINK_QUALITY_DB(-4));
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->rssiQ4, LINK_QUALITY_DB(-100));
+    LINK_QUALITY_OnDownlink(-80, 4);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->snrQ4, LINK_QUALITY_DB(-2));
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->rssiQ4, LINK_QUALITY_DB(-95));
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->downlinks, 2);
+}
+
+/* A lost acknowledgment adds 2 dB, deliveries above the target remove 0.25 dB */
+static void test_delivery_margin(void)
+{
+    const LinkQualityStats_t *stats = LINK_QUALITY_GetStats();
+
+    LINK_QUALITY_Init(&testConfig);
+    TEST_ASSERT_EQ(stats->deliveryRatio, 1000);
+    LINK_QUALITY_OnUplink(false, false);
+    TEST_ASSERT_EQ(stats->confirmed, 0);
+    TEST_ASSERT_EQ(stats->extraMarginQ4, 0);
+
+    LINK_QUALITY_OnUplink(true, false);
+    TEST_ASSERT_EQ(stats->deliveryRatio, 875);
+    TEST_ASSERT_EQ(stats->extraMarginQ4, LINK_QUALITY_DB(2));
+    /* 890 is still below the target */
+    LINK_QUALITY_OnUplink(true, true);
+    TEST_ASSERT_EQ(stats->deliveryRatio, 890);
+    TEST_ASSERT_EQ(stats->extraMarginQ4, LINK_QUALITY_DB(2));
+    LINK_QUALITY_OnUplink(true, true);
+    TEST_ASSERT_EQ(stats->deliveryRatio, 903);
+    TEST_ASSERT_EQ(stats->extraMarginQ4, LINK_QUALITY_DB(1.75));
+    TEST_ASSERT_EQ(stats->confirmed, 3);
+    TEST_ASSERT_EQ(stats->delivered, 2);
+
+    /* Bounded both ways */
+    for (uint8_t i = 0; i < 20u; i++)
+    {
+        LINK_QUALITY_OnUplink(true, false);
+    }
+    TEST_ASSERT_EQ(stats->extraMarginQ4, LINK_QUALITY_DB(12));
+    for (uint16_t i = 0; i < 200u; i++)
+    {
+        LINK_QUALITY_OnUplink(true, true);
+    }
+    TEST_ASSERT_EQ(stats->extraMarginQ4, 0);
+    TEST_ASSERT(stats->deliveryRatio > 990u);
+}
+
+/* The losses make the recommendation more robust without any downlink */
+static void test_losses_raise_margin(void)
+{
+    uint8_t dr = 0;
+    uint8_t txPower = 0;
+
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-117, 0);
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    TEST_ASSERT_EQ(dr, 4);
+    for (uint8_t i = 0; i < 6u; i++)
+    {
+        uint8_t previousDr = dr;
+
+        LINK_QUALITY_OnUplink(true, false);
+        TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+        TEST_ASSERT(dr <= previousDr);
+    }
+    /* 10 + 12 dB above 0 dB: nothing fits, the most robust setting */
+    TEST_ASSERT_EQ(dr, 0);
+    TEST_ASSERT_EQ(txPower, 0);
+}
+
+/* The band change keeps the measurements */
+static void test_configure(void)
+{
+    uint8_t dr = 0;
+    uint8_t txPower = 0;
+
+    LINK_QUALITY_Init(&testConfig);
+    LINK_QUALITY_OnDownlink(-117, 0);
+    LINK_QUALITY_Configure(3, LINK_QUALITY_DB(-15), 20);
+    TEST_ASSERT(LINK_QUALITY_Recommend(&dr, &txPower));
+    /* DR3 floor -7.5 dB misses the margin, DR2 at full power keeps it */
+    TEST_ASSERT_EQ(dr, 2);
+    TEST_ASSERT_EQ(txPower, 0);
+    TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->downlinks, 1);
+
+    LINK_QUALITY_Configure(3, LINK_QUALITY_DB(-15), 0);
+    TEST_ASSERT(!LINK_QUALITY_Recommend(&dr, &txPower));
+}
+
+/* The traces keep the delivery target at a fraction of the energy of DR0 */
+static void test_traces(void)
+{
+    for (uint8_t t = 0; t < sizeof(testTraces) / sizeof(testTraces[0]); t++)
+    {
+        const TestTrace_t *trace = &testTraces[t];
+        TestRun_t run;
+        uint32_t energyPercent;
+
+        testName = trace->name;
+        run_trace(trace, &run);
+        energyPercent = (uint32_t)((run.energy * 100u) / run.robustEnergy);
+        printf("%s: delivered %u/%u, energy %u %% of DR0, %u changes, DR%u power %u\n", trace->name,
+               run.delivered, TEST_UPLINKS, energyPercent, run.changes, run.dr, run.txPower);
+
+        TEST_ASSERT(run.delivered * 1000u >= TEST_UPLINKS * testConfig.targetDelivery);
+        if (0 != trace->dropSnrDb)
+        {
+            printf("%s: delivery back %u uplinks into the dropout, setting regained %u uplinks after it\n",
+                   trace->name, run.dropRecovered - TEST_DROP_START, run.settingRegained - TEST_DROP_END);
+            /* A few losses raise the margin enough to get through */
+            TEST_ASSERT(run.dropRecovered < TEST_DROP_START + 10u);
+            /* The extra margin decays: the efficient setting comes back */
+            TEST_ASSERT(run.settingRegained < TEST_DROP_END + 100u);
+        }
+        TEST_ASSERT_EQ(LINK_QUALITY_GetStats()->changes, run.changes);
+        /* No flapping: a steady link settles, deep fades of every frame
+           move the setting at most every 5 uplinks */
+        if ((0u == trace->period) && (trace->fadingDb <= 3u))
+        {
+            TEST_ASSERT(run.changes < TEST_UPLINKS / 20u);
+        }
+        TEST_ASSERT(run.changes < TEST_UPLINKS / 5u);
+    }
+    testName = "test_traces";
+}
+
+/* The stronger the link, the cheaper the frames */
+static void test_energy_order(void)
+{
+    TestRun_t near;
+    TestRun_t good;
+    TestRun_t marginal;
+
+    run_trace(&testTraces[0], &near);
+    run_trace(&testTraces[1], &good);
+    run_trace(&testTraces[3], &marginal);
+    TEST_ASSERT(near.energy < good.energy);
+    TEST_ASSERT(good.energy < marginal.energy);
+    TEST_ASSERT(marginal.energy < marginal.robustEnergy);
+    TEST_ASSERT(near.dr == TEST_MAX_DR);
+    TEST_ASSERT(near.txPower > 0u);
+    TEST_ASSERT(marginal.dr < good.dr);
+}
+
+int main(void)
+{
+    TEST_RUN(test_recommend_values);
+    TEST_RUN(test_hysteresis);
+    TEST_RUN(test_smoothing);
+    TEST_RUN(test_delivery_margin);
+    TEST_RUN(test_losses_raise_margin);
+    TEST_RUN(test_configure);
+    TEST_RUN(test_traces);
+    TEST_RUN(test_energy_order);
+    return TEST_END();
+}
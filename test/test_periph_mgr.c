@@ -0,0 +1,171 @@
+/**
+* \file  test_periph_mgr.c
+*
+* \brief Host tests of the peripheral manager, with instrumented power
+*        up/down stand-ins counting the calls per wakeup cycle
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "periph_mgr.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint32_t inits[PERIPH_COUNT];
+static uint32_t deinits[PERIPH_COUNT];
+
+/***************************** FUNCTIONS ***************************************/
+
+static void radio_init(void)
+{
+    inits[PERIPH_RADIO]++;
+}
+
+static void radio_deinit(void)
+{
+    deinits[PERIPH_RADIO]++;
+}
+
+static void uart_init(void)
+{
+    inits[PERIPH_UART]++;
+}
+
+static void uart_deinit(void)
+{
+    deinits[PERIPH_UART]++;
+}
+
+static void adc_init(void)
+{
+    inits[PERIPH_ADC]++;
+}
+
+static void adc_deinit(void)
+{
+    deinits[PERIPH_ADC]++;
+}
+
+static const PeriphOps_t countingOps[PERIPH_COUNT] =
+{
+    { radio_init, radio_deinit },
+    { uart_init, uart_deinit },
+    { adc_init, adc_deinit }
+};
+
+static void setup(uint8_t poweredMask)
+{
+    memset(inits, 0, sizeof(inits));
+    memset(deinits, 0, sizeof(deinits));
+    PERIPH_Init(countingOps, poweredMask);
+}
+
+/* Wakeup that reads the ADC and goes back to sleep */
+static void sample_cycle(void)
+{
+    PERIPH_Acquire(PERIPH_ADC);
+    PERIPH_Release(PERIPH_ADC);
+    PERIPH_PowerDownIdle();
+}
+
+/* Wakeup that samples, logs and transmits */
+static void uplink_cycle(void)
+{
+    PERIPH_Acquire(PERIPH_ADC);
+    PERIPH_Release(PERIPH_ADC);
+    PERIPH_Acquire(PERIPH_UART);
+    PERIPH_Acquire(PERIPH_RADIO);
+    PERIPH_Release(PERIPH_UART);
+    PERIPH_Release(PERIPH_RADIO);
+    PERIPH_PowerDownIdle();
+}
+
+static void test_sample_cycles_leave_radio_and_uart_alone(void)
+{
+    setup(PERIPH_MASK_ALL);
+    /* The first sleep powers down what the start-up code left on */
+    sample_cycle();
+    TEST_ASSERT_EQ(deinits[PERIPH_RADIO], 1);
+    TEST_ASSERT_EQ(deinits[PERIPH_UART], 1);
+
+    for (uint8_t cycle = 0; cycle < 100; cycle++)
+    {
+        sample_cycle();
+    }
+    TEST_ASSERT_EQ(inits[PERIPH_RADIO], 0);
+    TEST_ASSERT_EQ(inits[PERIPH_UART], 0);
+    TEST_ASSERT_EQ(deinits[PERIPH_RADIO], 1);
+    TEST_ASSERT_EQ(deinits[PERIPH_UART], 1);
+    /* One power up and down of the ADC per cycle */
+    TEST_ASSERT_EQ(inits[PERIPH_ADC], 100);
+    TEST_ASSERT_EQ(deinits[PERIPH_ADC], 101);
+    TEST_ASSERT(!PERIPH_IsPowered(PERIPH_ADC));
+}
+
+static void test_uplink_cycle_powers_each_once(void)
+{
+    setup(0);
+    uplink_cycle();
+    for (uint8_t id = 0; id < PERIPH_COUNT; id++)
+    {
+        TEST_ASSERT_EQ(inits[id], 1);
+        TEST_ASSERT_EQ(deinits[id], 1);
+        TEST_ASSERT_EQ(PERIPH_GetStats((PeriphId_t)id)->powerUps, 1);
+        TEST_ASSERT_EQ(PERIPH_GetStats((PeriphId_t)id)->powerDowns, 1);
+    }
+}
+
+static void test_nested_users(void)
+{
+    setup(0);
+    PERIPH_Acquire(PERIPH_RADIO);
+    PERIPH_Acquire(PERIPH_RADIO);
+    TEST_ASSERT_EQ(inits[PERIPH_RADIO], 1);
+    PERIPH_Release(PERIPH_RADIO);
+    PERIPH_PowerDownIdle();
+    TEST_ASSERT(PERIPH_IsPowered(PERIPH_RADIO));
+    PERIPH_Release(PERIPH_RADIO);
+    /* Only powered down before sleep */
+    TEST_ASSERT(PERIPH_IsPowered(PERIPH_RADIO));
+    PERIPH_PowerDownIdle();
+    TEST_ASSERT(!PERIPH_IsPowered(PERIPH_RADIO));
+    TEST_ASSERT_EQ(deinits[PERIPH_RADIO], 1);
+
+    /* An extra release does not underflow */
+    PERIPH_Release(PERIPH_RADIO);
+    PERIPH_Acquire(PERIPH_RADIO);
+    PERIPH_PowerDownIdle();
+    TEST_ASSERT(PERIPH_IsPowered(PERIPH_RADIO));
+}
+
+/* A hold across sleep, the ADC window monitor for instance */
+static void test_held_across_sleep(void)
+{
+    setup(0);
+    PERIPH_Acquire(PERIPH_ADC);
+    for (uint8_t cycle = 0; cycle < 10; cycle++)
+    {
+        sample_cycle();
+    }
+    TEST_ASSERT_EQ(inits[PERIPH_ADC], 1);
+    TEST_ASSERT_EQ(deinits[PERIPH_ADC], 0);
+}
+
+static void test_invalid_id(void)
+{
+    setup(0);
+    PERIPH_Acquire(PERIPH_COUNT);
+    PERIPH_Release(PERIPH_COUNT);
+    TEST_ASSERT(!PERIPH_IsPowered(PERIPH_COUNT));
+    TEST_ASSERT(NULL == PERIPH_GetStats(PERIPH_COUNT));
+}
+
+int main(void)
+{
+    TEST_RUN(test_sample_cycles_leave_radio_and_uart_alone);
+    TEST_RUN(test_uplink_cycle_powers_each_once);
+    TEST_RUN(test_nested_users);
+    TEST_RUN(test_held_across_sleep);
+    TEST_RUN(test_invalid_id);
+    return TEST_END();
+}
@@ -0,0 +1,190 @@
+/**
+* \file  test_session_cache.c
+*
+* \brief Host tests of the per-band session cache
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "nvm_ram.h"
+#include "cfg_store.h"
+#include "session_cache.h"
+
+/****************************** MACROS **************************************/
+#define TEST_CACHE_OFFSET                   0xC200u
+
+/***************************** FUNCTIONS ***************************************/
+
+static SessionCacheEntry_t make_entry(uint8_t band, uint32_t devAddr)
+{
+    SessionCacheEntry_t entry;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.band = band;
+    entry.devAddr = devAddr;
+    entry.fCntUp = 100u + band;
+    entry.fCntDown = 7;
+    for (uint8_t i = 0; i < SESSION_CACHE_KEY_LENGTH; i++)
+    {
+        entry.nwkSKey[i] = (uint8_t)(0x10u + i + band);
+        entry.appSKey[i] = (uint8_t)(0x80u + i + band);
+    }
+    return entry;
+}
+
+static void setup(void)
+{
+    SESSION_CACHE_Init(NVM_RAM_Init(), TEST_CACHE_OFFSET);
+}
+
+static void test_store_and_find(void)
+{
+    SessionCacheEntry_t entry = make_entry(2, 0x26011234u);
+    SessionCacheEntry_t found;
+
+    setup();
+    TEST_ASSERT(!SESSION_CACHE_Find(2, &found));
+    TEST_ASSERT(SESSION_CACHE_Store(&entry));
+    TEST_ASSERT(SESSION_CACHE_Find(2, &found));
+    TEST_ASSERT_MEM(&found, &entry, sizeof(entry));
+    TEST_ASSERT(!SESSION_CACHE_Find(3, &found));
+
+    SESSION_CACHE_Invalidate(2);
+    TEST_ASSERT(!SESSION_CACHE_Find(2, &found));
+}
+
+/* A session without DevAddr or keys is neither kept nor restored */
+static void test_blank_session_refused(void)
+{
+    SessionCacheEntry_t entry = make_entry(1, 0);
+    SessionCacheEntry_t found;
+
+    setup();
+    TEST_ASSERT(!SESSION_CACHE_Store(&entry));
+    entry = make_entry(1, UINT32_MAX);
+    TEST_ASSERT(!SESSION_CACHE_Store(&entry));
+    entry = make_entry(1, 0x26011234u);
+    memset(entry.nwkSKey, 0, sizeof(entry.nwkSKey));
+    TEST_ASSERT(!SESSION_CACHE_Store(&entry));
+    entry = make_entry(1, 0x26011234u);
+    memset(entry.appSKey, 0xFF, sizeof(entry.appSKey));
+    TEST_ASSERT(!SESSION_CACHE_Store(&entry));
+    TEST_ASSERT_EQ(NVM_RAM_GetStats()->writes, 0);
+    TEST_ASSERT(!SESSION_CACHE_Find(1, &found));
+}
+
+/* A record with a valid CRC around a zeroed session is not returned */
+static void test_zeroed_record_not_found(void)
+{
+    uint8_t record[4 + sizeof(SessionCacheEntry_t) + 2];
+    SessionCacheEntry_t zeroed;
+    SessionCacheEntry_t found = make_entry(9, 0x11111111u);
+    SessionCacheEntry_t untouched = found;
+    uint16_t crc;
+
+    setup();
+    memset(&zeroed, 0, sizeof(zeroed));
+    zeroed.band = 5;
+    record[0] = 0x55;
+    record[1] = 0x5E;
+    record[2] = 1;
+    record[3] = 0;
+    memcpy(&record[4], &zeroed, sizeof(zeroed));
+    crc = CFG_STORE_Crc16(record, sizeof(record) - 2u);
+    record[sizeof(record) - 2u] = (uint8_t)crc;
+    record[sizeof(record) - 1u] = (uint8_t)(crc >> 8);
+    memcpy(&NVM_RAM_Data()[TEST_CACHE_OFFSET], record, sizeof(record));
+
+    TEST_ASSERT(!SESSION_CACHE_Find(5, &found));
+    TEST_ASSERT_MEM(&found, &untouched, sizeof(found));
+}
+
+static void test_corrupted_record_not_found(void)
+{
+    SessionCacheEntry_t entry = make_entry(4, 0x26015678u);
+    SessionCacheEntry_t found;
+
+    setup();
+    TEST_ASSERT(SESSION_CACHE_Store(&entry));
+    /* One bit of the key flips in the flash */
+    NVM_RAM_Data()[TEST_CACHE_OFFSET + 4u + 12u] ^= 0x04u;
+    TEST_ASSERT(!SESSION_CACHE_Find(4, &found));
+
+    /* A store interrupted by a power cut leaves no entry behind */
+    setup();
+    NVM_RAM_CutAfter(20);
+    TEST_ASSERT(!SESSION_CACHE_Store(&entry));
+    NVM_RAM_CutAfter(NVM_RAM_NO_CUT);
+    TEST_ASSERT(!SESSION_CACHE_Find(4, &found));
+}
+
+/* A restored session is confirmed by one acknowledgment */
+static void test_probation_accepted(void)
+{
+    SessionCacheEntry_t entry = make_entry(1, 0x26010001u);
+    SessionCacheEntry_t found;
+
+    setup();
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, true), SESSION_CACHE_NONE);
+    TEST_ASSERT(SESSION_CACHE_Store(&entry));
+    SESSION_CACHE_Restored(1);
+    TEST_ASSERT(SESSION_CACHE_InProbation());
+    /* Unconfirmed uplinks prove nothing either way */
+    for (uint8_t i = 0; i < 10u; i++)
+    {
+        TEST_ASSERT_EQ(SESSION_CACHE_OnResult(false, false), SESSION_CACHE_PROBATION);
+    }
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, false), SESSION_CACHE_PROBATION);
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, true), SESSION_CACHE_ACCEPTED);
+    TEST_ASSERT(!SESSION_CACHE_InProbation());
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, false), SESSION_CACHE_NONE);
+    TEST_ASSERT(SESSION_CACHE_Find(1, &found));
+
+    /* Any downlink on the session accepts it as well */
+    SESSION_CACHE_Restored(1);
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(false, true), SESSION_CACHE_ACCEPTED);
+}
+
+/* Unacknowledged confirmed uplinks reject the session and drop its entry only */
+static void test_probation_rejected(void)
+{
+    SessionCacheEntry_t first = make_entry(1, 0x26010001u);
+    SessionCacheEntry_t second = make_entry(2, 0x26010002u);
+    SessionCacheEntry_t found;
+
+    setup();
+    TEST_ASSERT(SESSION_CACHE_Store(&first));
+    TEST_ASSERT(SESSION_CACHE_Store(&second));
+    SESSION_CACHE_Restored(2);
+    for (uint8_t i = 1; i < SESSION_CACHE_PROBATION_FAILURES; i++)
+    {
+        TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, false), SESSION_CACHE_PROBATION);
+    }
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, false), SESSION_CACHE_REJECTED);
+    TEST_ASSERT(!SESSION_CACHE_InProbation());
+    TEST_ASSERT(!SESSION_CACHE_Find(2, &found));
+    TEST_ASSERT(SESSION_CACHE_Find(1, &found));
+
+    /* A new restore starts the count again */
+    TEST_ASSERT(SESSION_CACHE_Store(&second));
+    SESSION_CACHE_Restored(2);
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, false), SESSION_CACHE_PROBATION);
+    SESSION_CACHE_Restored(2);
+    for (uint8_t i = 1; i < SESSION_CACHE_PROBATION_FAILURES; i++)
+    {
+        TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, false), SESSION_CACHE_PROBATION);
+    }
+    TEST_ASSERT_EQ(SESSION_CACHE_OnResult(true, true), SESSION_CACHE_ACCEPTED);
+}
+
+int main(void)
+{
+    TEST_RUN(test_store_and_find);
+    TEST_RUN(test_blank_session_refused);
+    TEST_RUN(test_zeroed_record_not_found);
+    TEST_RUN(test_corrupted_record_not_found);
+    TEST_RUN(test_probation_accepted);
+    TEST_RUN(test_probation_rejected);
+    return TEST_END();
+}
@@ -0,0 +1,387 @@
+/**
+* \file  test_session_health.c
+*
+* \brief Host tests of the lost session detection and of the rejoin
+*        pacing against a mock stack with failure injection
+*
+* The mock stack answers the uplinks and joins with the statuses of the
+* real one: NO_ACK when the network is out of reach, NWK_NOT_JOINED once
+* it dropped the session, FCNTR_ERROR_REJOIN_NEEDED when the counter is
+* exhausted, and transient radio errors on demand. The statuses reach the
+* monitor through SESSION_HEALTH_EventOf(), as in app_session_health() of
+* enddevice_demo.c.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "stack_status.h"
+#include "conf_app.h"
+#include "session_health.h"
+
+/****************************** MACROS **************************************/
+#define TEST_UPLINK_PERIOD_MS               60000u
+
+/****************************** TYPES **************************************/
+typedef struct _MockStack_t
+{
+    bool joined;
+    /* The network answers */
+    bool reachable;
+    /* Next statuses of LORAWAN_Send() to inject instead of the normal one */
+    StackRetStatus_t inject[8];
+    uint8_t injectCount;
+    uint32_t fCntUp;
+    uint32_t fCntMax;
+    uint32_t joinRequests;
+} MockStack_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static MockStack_t mock;
+static uint64_t nowMs;
+static uint32_t rejoinStarts;
+
+/***************************** FUNCTIONS ***************************************/
+
+static void mock_reset(void)
+{
+    memset(&mock, 0, sizeof(mock));
+    mock.joined = true;
+    mock.reachable = true;
+    mock.fCntMax = UINT32_MAX;
+    nowMs = 0;
+    rejoinStarts = 0;
+    SESSION_HEALTH_Init(DEMO_APP_HEALTH_NO_ACK_LIMIT, DEMO_APP_REJOIN_RETRY_MIN_MS, DEMO_APP_REJOIN_RETRY_MAX_MS);
+    SESSION_HEALTH_OnJoin(true, nowMs);
+}
+
+static void mock_inject(StackRetStatus_t status)
+{
+    if (mock.injectCount < (sizeof(mock.inject) / sizeof(mock.inject[0])))
+    {
+        mock.inject[mock.injectCount++] = status;
+    }
+}
+
+static StackRetStatus_t mock_send(bool confirmed)
+{
+    if (0u != mock.injectCount)
+    {
+        StackRetStatus_t status = mock.inject[0];
+
+        mock.injectCount--;
+        memmove(&mock.inject[0], &mock.inject[1], mock.injectCount * sizeof(mock.inject[0]));
+        return status;
+    }
+    if (!mock.joined)
+    {
+        return LORAWAN_NWK_NOT_JOINED;
+    }
+    if (mock.fCntUp >= mock.fCntMax)
+    {
+        return LORAWAN_FCNTR_ERROR_REJOIN_NEEDED;
+    }
+    mock.fCntUp++;
+    return (confirmed && !mock.reachable) ? LORAWAN_NO_ACK : LORAWAN_SUCCESS;
+}
+
+static bool mock_join(void)
+{
+    mock.joinRequests++;
+    if (mock.reachable)
+    {
+        mock.joined = true;
+        mock.fCntUp = 0;
+    }
+    return mock.reachable;
+}
+
+/* As app_session_health() of enddevice_demo.c, true when the session was just lost */
+static bool app_health(StackRetStatus_t status, bool confirmed)
+{
+    return SESSION_HEALTH_OnEvent(SESSION_HEALTH_EventOf(status, confirmed), nowMs);
+}
+
+/* One uplink period of the application: rejoin when due, else send */
+static bool app_period(bool confirmed)
+{
+    bool lost = false;
+
+    if (SESSION_HEALTH_RejoinDue(nowMs))
+    {
+        SESSION_HEALTH_Rejoining();
+        rejoinStarts++;
+        SESSION_HEALTH_OnJoin(mock_join(), nowMs);
+    }
+    else if (SESSION_HEALTH_IsOnline())
+    {
+        lost = app_health(mock_send(confirmed), confirmed);
+    }
+    nowMs += TEST_UPLINK_PERIOD_MS;
+    return lost;
+}
+
+/* Only the statuses about the session are events, NO_ACK only for a confirmed frame */
+static void test_event_of(void)
+{
+    for (uint8_t status = 0; status < STACK_STATUS_COUNT; status++)
+    {
+        SessionHealthEvent_t unconfirmed = SESSION_HEALTH_EventOf((StackRetStatus_t)status, false);
+        SessionHealthEvent_t confirmed = SESSION_HEALTH_EventOf((StackRetStatus_t)status, true);
+
+        switch (status)
+        {
+            case LORAWAN_SUCCESS:
+            case LORAWAN_RADIO_SUCCESS:
+                TEST_ASSERT_EQ(unconfirmed, SESSION_HEALTH_TX_OK);
+                TEST_ASSERT_EQ(confirmed, SESSION_HEALTH_TX_OK);
+                break;
+            case LORAWAN_NO_ACK:
+                TEST_ASSERT_EQ(unconfirmed, SESSION_HEALTH_NO_EVENT);
+                TEST_ASSERT_EQ(confirmed, SESSION_HEALTH_TX_NO_ACK);
+                break;
+            case LORAWAN_NWK_NOT_JOINED:
+                TEST_ASSERT_EQ(unconfirmed, SESSION_HEALTH_NOT_JOINED);
+                TEST_ASSERT_EQ(confirmed, SESSION_HEALTH_NOT_JOINED);
+                break;
+            case LORAWAN_FCNTR_ERROR_REJOIN_NEEDED:
+                TEST_ASSERT_EQ(unconfirmed, SESSION_HEALTH_FCNT_EXHAUSTED);
+                TEST_ASSERT_EQ(confirmed, SESSION_HEALTH_FCNT_EXHAUSTED);
+                break;
+            default:
+                TEST_ASSERT_EQ(unconfirmed, SESSION_HEALTH_NO_EVENT);
+                TEST_ASSERT_EQ(confirmed, SESSION_HEALTH_NO_EVENT);
+                break;
+        }
+    }
+
+    /* No event neither loses the session nor breaks a NO_ACK run */
+    SESSION_HEALTH_Init(2, DEMO_APP_REJOIN_RETRY_MIN_MS, DEMO_APP_REJOIN_RETRY_MAX_MS);
+    SESSION_HEALTH_OnJoin(true, 0);
+    TEST_ASSERT(!SESSION_HEALTH_OnEvent(SESSION_HEALTH_TX_NO_ACK, 1000));
+    TEST_ASSERT(!SESSION_HEALTH_OnEvent(SESSION_HEALTH_NO_EVENT, 2000));
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->noAckRun, 1);
+    TEST_ASSERT(SESSION_HEALTH_IsOnline());
+    TEST_ASSERT(SESSION_HEALTH_OnEvent(SESSION_HEALTH_TX_NO_ACK, 3000));
+}
+
+/* A run of NO_ACK below the limit is tolerated, the limit loses the session */
+static void test_no_ack_run(void)
+{
+    mock_reset();
+    mock.reachable = false;
+    for (uint8_t i = 1; i < DEMO_APP_HEALTH_NO_ACK_LIMIT; i++)
+    {
+        TEST_ASSERT(!app_period(true));
+    }
+    mock.reachable = true;
+    TEST_ASSERT(!app_period(true));
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->noAckRun, 0);
+
+    mock.reachable = false;
+    for (uint8_t i = 1; i < DEMO_APP_HEALTH_NO_ACK_LIMIT; i++)
+    {
+        TEST_ASSERT(!app_period(true));
+    }
+    TEST_ASSERT(app_period(true));
+    TEST_ASSERT(!SESSION_HEALTH_IsOnline());
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->lastCause, SESSION_HEALTH_TX_NO_ACK);
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->outages, 1);
+    /* The rejoin is immediate */
+    TEST_ASSERT(SESSION_HEALTH_RejoinDue(nowMs));
+}
+
+/* Unconfirmed uplinks never learn about the network */
+static void test_unconfirmed_no_ack(void)
+{
+    mock_reset();
+    for (uint8_t i = 0; i < 3u * DEMO_APP_HEALTH_NO_ACK_LIMIT; i++)
+    {
+        mock_inject(LORAWAN_NO_ACK);
+        TEST_ASSERT(!app_period(false));
+    }
+    TEST_ASSERT(SESSION_HEALTH_IsOnline());
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->noAckRun, 0);
+}
+
+/* Transient errors of the stack and radio are not a lost session */
+static void test_transient_errors(void)
+{
+    mock_reset();
+    for (uint8_t status = 0; status < STACK_STATUS_COUNT; status++)
+    {
+        if ((LORAWAN_NWK_NOT_JOINED == status) || (LORAWAN_FCNTR_ERROR_REJOIN_NEEDED == status) ||
+            (LORAWAN_NO_ACK == status))
+        {
+            continue;
+        }
+        for (uint8_t i = 0; i < 2u * DEMO_APP_HEALTH_NO_ACK_LIMIT; i++)
+        {
+            mock_inject((StackRetStatus_t)status);
+            TEST_ASSERT(!app_period(true));
+        }
+    }
+    TEST_ASSERT(SESSION_HEALTH_IsOnline());
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->outages, 0);
+
+    /* Between two NO_ACK they neither reset nor extend the run */
+    mock_inject(LORAWAN_NO_ACK);
+    mock_inject(LORAWAN_RADIO_BUSY);
+    mock_inject(LORAWAN_NO_ACK);
+    mock_inject(LORAWAN_TX_TIMEOUT);
+    for (uint8_t i = 0; i < 4u; i++)
+    {
+        app_period(true);
+    }
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->noAckRun, 2);
+}
+
+/* The network forgetting the session or the counter running out: lost at once */
+static void test_immediate_loss(void)
+{
+    mock_reset();
+    mock.joined = false;
+    TEST_ASSERT(app_period(false));
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->lastCause, SESSION_HEALTH_NOT_JOINED);
+    /* Rejoined in the next period */
+    app_period(false);
+    TEST_ASSERT(SESSION_HEALTH_IsOnline());
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->lastOfflineMs, TEST_UPLINK_PERIOD_MS);
+
+    mock.fCntMax = 5;
+    for (uint8_t i = 0; i < 5u; i++)
+    {
+        TEST_ASSERT(!app_period(false));
+    }
+    TEST_ASSERT(app_period(false));
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->lastCause, SESSION_HEALTH_FCNT_EXHAUSTED);
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->outages, 2);
+
+    /* Further failures of the same outage are not counted again */
+    TEST_ASSERT(!SESSION_HEALTH_OnEvent(SESSION_HEALTH_NOT_JOINED, nowMs));
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->outages, 2);
+}
+
+/* Out of coverage: rejoins back off from the minimum to the maximum delay */
+static void test_backoff(void)
+{
+    uint64_t lastAttemptMs = 0;
+    uint64_t expectedMs = DEMO_APP_REJOIN_RETRY_MIN_MS;
+    uint64_t lostMs;
+    uint32_t attempts = 0;
+
+    mock_reset();
+    mock.reachable = false;
+    mock.joined = false;
+    TEST_ASSERT(app_period(true));
+    lostMs = nowMs;
+
+    /* Ten hours, a period of a second to see the attempts */
+    while (nowMs < (lostMs + 10u * 3600000u))
+    {
+        if (SESSION_HEALTH_RejoinDue(nowMs))
+        {
+            if (0u != attempts)
+            {
+                TEST_ASSERT_EQ(nowMs - lastAttemptMs, expectedMs);
+                expectedMs = (2u * expectedMs < DEMO_APP_REJOIN_RETRY_MAX_MS) ? 2u * expectedMs :
+                             DEMO_APP_REJOIN_RETRY_MAX_MS;
+            }
+            lastAttemptMs = nowMs;
+            attempts++;
+            SESSION_HEALTH_Rejoining();
+            /* No second attempt before the result */
+            TEST_ASSERT(!SESSION_HEALTH_RejoinDue(nowMs));
+            SESSION_HEALTH_OnJoin(mock_join(), nowMs);
+        }
+        nowMs += 1000u;
+    }
+    printf("Out of coverage 10 h: %lu join attempts\n", (unsigned long)attempts);
+    TEST_ASSERT(attempts <= 20u);
+    TEST_ASSERT(attempts >= 12u);
+    TEST_ASSERT_EQ(attempts, SESSION_HEALTH_GetStats()->rejoins);
+
+    /* Back in coverage: joined at the next attempt, the backoff starts over */
+    mock.reachable = true;
+    while (!SESSION_HEALTH_IsOnline())
+    {
+        app_period(true);
+    }
+    TEST_ASSERT(SESSION_HEALTH_GetStats()->lastOfflineMs >= 10u * 3600000u);
+    TEST_ASSERT(SESSION_HEALTH_GetStats()->lastOfflineMs <= 11u * 3600000u);
+    mock.joined = false;
+    TEST_ASSERT(app_period(true));
+    mock.reachable = false;
+    app_period(true);
+    TEST_ASSERT(!SESSION_HEALTH_RejoinDue(nowMs + DEMO_APP_REJOIN_RETRY_MIN_MS - TEST_UPLINK_PERIOD_MS - 1u));
+    TEST_ASSERT(SESSION_HEALTH_RejoinDue(nowMs + DEMO_APP_REJOIN_RETRY_MIN_MS - TEST_UPLINK_PERIOD_MS));
+}
+
+/* A month of random failures: the accounting matches what the mock injected */
+static void test_random_failures(void)
+{
+    uint32_t seed = 4242u;
+    uint64_t offlineMs = 0;
+    uint64_t lostAtMs = 0;
+    uint16_t outages = 0;
+    bool online = true;
+
+    mock_reset();
+    for (uint32_t period = 0; period < 30u * 1440u; period++)
+    {
+        uint32_t draw;
+        bool confirmed;
+
+        seed = seed * 1103515245u + 12345u;
+        draw = (seed >> 8) % 10000u;
+        confirmed = 0u != (seed & 0x80000000u);
+        if (draw < 5u)
+        {
+            /* The network purges the session */
+            mock.joined = false;
+        }
+        else if (draw < 10u)
+        {
+            mock.reachable = !mock.reachable;
+        }
+        else if (draw < 300u)
+        {
+            mock_inject((draw & 1u) ? LORAWAN_RADIO_BUSY : LORAWAN_TX_TIMEOUT);
+        }
+
+        if (app_period(confirmed))
+        {
+            outages++;
+            lostAtMs = nowMs - TEST_UPLINK_PERIOD_MS;
+        }
+        /* Never asked to rejoin while online */
+        TEST_ASSERT(!SESSION_HEALTH_IsOnline() || !SESSION_HEALTH_RejoinDue(nowMs));
+        if (online && !SESSION_HEALTH_IsOnline())
+        {
+            online = false;
+        }
+        else if (!online && SESSION_HEALTH_IsOnline())
+        {
+            online = true;
+            offlineMs += (nowMs - TEST_UPLINK_PERIOD_MS) - lostAtMs;
+        }
+    }
+    printf("Random failures: %u outages, %lu join requests, %lu s offline\n", outages,
+           (unsigned long)mock.joinRequests, (unsigned long)(offlineMs / 1000u));
+    TEST_ASSERT(outages > 10u);
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->outages, outages);
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->rejoins, rejoinStarts);
+    TEST_ASSERT_EQ(mock.joinRequests, rejoinStarts);
+    TEST_ASSERT_EQ(SESSION_HEALTH_GetStats()->totalOfflineMs, offlineMs);
+}
+
+int main(void)
+{
+    TEST_RUN(test_event_of);
+    TEST_RUN(test_no_ack_run);
+    TEST_RUN(test_unconfirmed_no_ack);
+    TEST_RUN(test_transient_errors);
+    TEST_RUN(test_immediate_loss);
+    TEST_RUN(test_backoff);
+    TEST_RUN(test_random_failures);
+    return TEST_END();
+}
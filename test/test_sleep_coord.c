@@ -0,0 +1,155 @@
+/**
+* \file  test_sleep_coord.c
+*
+* \brief Host tests of the sleep coordinator
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "sleep_coord.h"
+
+/************************** GLOBAL VARIABLES ***********************************/
+static bool stackReady = false;
+static bool denyDeepSleep = false;
+static uint32_t nextActivityMs = 100;
+static uint32_t readyCalls = 0;
+static uint32_t deepSleepMs = 0;
+static uint32_t idleSleepMs = 0;
+
+/***************************** FUNCTIONS ***************************************/
+
+static bool fake_stack_ready(void)
+{
+    readyCalls++;
+    return stackReady;
+}
+
+static uint32_t fake_next_activity_ms(void)
+{
+    return nextActivityMs;
+}
+
+static bool fake_deep_sleep(uint32_t sleepTimeMs)
+{
+    deepSleepMs = sleepTimeMs;
+    return !denyDeepSleep;
+}
+
+static void fake_idle_sleep(uint32_t maxTimeMs)
+{
+    idleSleepMs = maxTimeMs;
+}
+
+static const SleepCoordOps_t fakeOps =
+{
+    fake_stack_ready,
+    fake_next_activity_ms,
+    fake_deep_sleep,
+    fake_idle_sleep
+};
+
+static void setup(void)
+{
+    stackReady = false;
+    denyDeepSleep = false;
+    nextActivityMs = 100;
+    readyCalls = 0;
+    deepSleepMs = 0;
+    idleSleepMs = 0;
+    SLEEP_COORD_Init(&fakeOps);
+}
+
+static void test_idle_without_request(void)
+{
+    setup();
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(readyCalls, 0);
+    TEST_ASSERT_EQ(idleSleepMs, 100);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->idleSleeps, 1);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->deepSleeps, 0);
+}
+
+static void test_deep_sleep_when_ready(void)
+{
+    setup();
+    stackReady = true;
+    SLEEP_COORD_Request(5000);
+    TEST_ASSERT(SLEEP_COORD_IsPending());
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(deepSleepMs, 5000);
+    TEST_ASSERT(!SLEEP_COORD_IsPending());
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->deepSleeps, 1);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->idleSleeps, 0);
+}
+
+/* A busy stack costs one check per wakeup, not one per loop iteration */
+static void test_waits_in_idle_sleep(void)
+{
+    setup();
+    SLEEP_COORD_Request(5000);
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(readyCalls, 1);
+    TEST_ASSERT_EQ(idleSleepMs, 100);
+    TEST_ASSERT(SLEEP_COORD_IsPending());
+
+    stackReady = true;
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(readyCalls, 2);
+    TEST_ASSERT_EQ(deepSleepMs, 5000);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->deepSleeps, 1);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->idleSleeps, 1);
+}
+
+static void test_denied_sleep_is_retried(void)
+{
+    setup();
+    stackReady = true;
+    denyDeepSleep = true;
+    SLEEP_COORD_Request(2000);
+    SLEEP_COORD_Idle();
+    TEST_ASSERT(SLEEP_COORD_IsPending());
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->deepSleepDenied, 1);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->idleSleeps, 1);
+
+    denyDeepSleep = false;
+    SLEEP_COORD_Idle();
+    TEST_ASSERT(!SLEEP_COORD_IsPending());
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->deepSleeps, 1);
+}
+
+static void test_due_activity_skips_idle(void)
+{
+    setup();
+    nextActivityMs = 0;
+    SLEEP_COORD_Request(2000);
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->idleSleeps, 0);
+    /* Checked again on the next pass */
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(readyCalls, 2);
+}
+
+static void test_notify_and_cancel(void)
+{
+    setup();
+    SLEEP_COORD_Request(2000);
+    SLEEP_COORD_Cancel();
+    stackReady = true;
+    SLEEP_COORD_Notify();
+    SLEEP_COORD_Idle();
+    TEST_ASSERT_EQ(readyCalls, 0);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->deepSleeps, 0);
+    TEST_ASSERT_EQ(SLEEP_COORD_GetStats()->loopIterations, 1);
+}
+
+int main(void)
+{
+    TEST_RUN(test_idle_without_request);
+    TEST_RUN(test_deep_sleep_when_ready);
+    TEST_RUN(test_waits_in_idle_sleep);
+    TEST_RUN(test_denied_sleep_is_retried);
+    TEST_RUN(test_due_activity_skips_idle);
+    TEST_RUN(test_notify_and_cancel);
+    return TEST_END();
+}
@@ -0,0 +1,270 @@
+/**
+* \file  test_time_sync.c
+*
+* \brief Host tests of the network time synchronisation against simulated
+*        crystal drift
+*
+* The local clock is a crystal off by a drift that can wander with the
+* temperature. The network answers carry the true time rounded to the
+* 1/256 s of DeviceTimeAns plus a delivery jitter. Between two answers the
+* network time of TIME_SYNC_Now() is compared with the true time.
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "time_sync.h"
+
+/****************************** MACROS **************************************/
+#define TEST_PERIOD_MS                      7200000u
+#define TEST_RETRY_MS                       60000u
+/* GPS epoch of the first answer, somewhere in 2026 */
+#define TEST_EPOCH_MS                       1450000000000ull
+
+/****************************** TYPES **************************************/
+typedef struct _TestCrystal_t
+{
+    const char *name;
+    /* Mean drift and swing of a daily temperature cycle, ppb */
+    int32_t driftPpb;
+    int32_t swingPpb;
+    /* Delivery jitter of the answers, +/- ms */
+    uint16_t jitterMs;
+    /* One answer in lostEvery is lost, 0 for none */
+    uint8_t lostEvery;
+    /* Largest error allowed once the drift is learnt, ms */
+    uint16_t maxErrorMs;
+} TestCrystal_t;
+
+typedef struct _TestClock_t
+{
+    /* True (network) time and local time, in us to keep the drift */
+    int64_t trueUs;
+    int64_t localUs;
+    uint32_t seed;
+} TestClock_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const TestCrystal_t testCrystals[] =
+{
+    { "ideal", 0, 0, 0, 0, 10 },
+    { "fast_20ppm", 20000, 0, 8, 0, 30 },
+    { "slow_40ppm", -40000, 0, 8, 0, 30 },
+    { "temperature", 15000, 10000, 8, 0, 150 },
+    { "lossy", 30000, 0, 20, 3, 60 },
+    { "limit", TIME_SYNC_MAX_DRIFT_PPB, 0, 4, 0, 30 }
+};
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t test_random(TestClock_t *clock)
+{
+    clock->seed = clock->seed * 1103515245u + 12345u;
+    return clock->seed >> 8;
+}
+
+/* Drift of the crystal at a true time, a sine of one day made of lines */
+static int64_t test_drift_ppb(const TestCrystal_t *crystal, int64_t trueUs)
+{
+    int64_t dayUs = 86400000000ll;
+    int64_t position = trueUs % dayUs;
+    int64_t half = dayUs / 2;
+    int64_t triangle = (position < half) ? position : (dayUs - position);
+
+    return crystal->driftPpb + (crystal->swingPpb * (4 * triangle - dayUs)) / dayUs;
+}
+
+/* Advances the true time by steps of 10 s, the local clock following the crystal */
+static void test_advance(const TestCrystal_t *crystal, TestClock_t *clock, int64_t us)
+{
+    while (us > 0)
+    {
+        int64_t step = (us > 10000000) ? 10000000 : us;
+
+        clock->localUs += step + (step * test_drift_ppb(crystal, clock->trueUs)) / 1000000000ll;
+        clock->trueUs += step;
+        us -= step;
+    }
+}
+
+static uint64_t test_local_ms(const TestClock_t *clock)
+{
+    return (uint64_t)(clock->localUs / 1000);
+}
+
+static uint64_t test_network_ms(const TestClock_t *clock)
+{
+    return TEST_EPOCH_MS + (uint64_t)(clock->trueUs / 1000);
+}
+
+/* Answer of the network: rounded to 1/256 s, late or early by the jitter */
+static uint64_t test_answer_ms(const TestCrystal_t *crystal, TestClock_t *clock)
+{
+    uint64_t network = test_network_ms(clock);
+    int32_t jitter = 0;
+
+    network = ((network * 256u + 500u) / 1000u) * 1000u / 256u;
+    if (0u != crystal->jitterMs)
+    {
+        jitter = (int32_t)(test_random(clock) % (2u * crystal->jitterMs + 1u)) - crystal->jitterMs;
+    }
+    return (uint64_t)((int64_t)network + jitter);
+}
+
+static int64_t test_error_ms(const TestClock_t *clock)
+{
+    uint64_t networkMs;
+
+    TEST_ASSERT(TIME_SYNC_Now(test_local_ms(clock), &networkMs));
+    return (int64_t)networkMs - (int64_t)test_network_ms(clock);
+}
+
+static int64_t test_abs(int64_t value)
+{
+    return (value < 0) ? -value : value;
+}
+
+/* Ten days of answers every two hours, the error checked every ten minutes
+   and compared with the offset of the last answer taken as it is */
+static void test_drift_tracking(void)
+{
+    for (uint8_t c = 0; c < sizeof(testCrystals) / sizeof(testCrystals[0]); c++)
+    {
+        const TestCrystal_t *crystal = &testCrystals[c];
+        TestClock_t clock = { 0, 0, 12345u + c };
+        int64_t worstMs = 0;
+        int64_t offsetOnlyMs = 0;
+        int64_t lastOffsetMs = 0;
+        uint16_t answers = 0;
+
+        testName = crystal->name;
+        TIME_SYNC_Init(TEST_PERIOD_MS, TEST_RETRY_MS);
+        for (uint16_t period = 0; period < 120u; period++)
+        {
+            bool lost = (0u != crystal->lostEvery) && (period > 1u) && (0u == (period % crystal->lostEvery));
+            uint8_t steps = 0;
+
+            TIME_SYNC_Requested(test_local_ms(&clock));
+            if (!lost)
+            {
+                uint64_t answer = test_answer_ms(crystal, &clock);
+
+                TIME_SYNC_Update(test_local_ms(&clock), answer);
+                lastOffsetMs = (int64_t)answer - (int64_t)test_local_ms(&clock);
+                answers++;
+            }
+            do
+            {
+                test_advance(crystal, &clock, 600000000ll);
+                steps++;
+                /* The drift is learnt from the second answer on, give it a day */
+                if (period >= 12u)
+                {
+                    int64_t error = test_abs(test_error_ms(&clock));
+                    int64_t offsetOnly = test_abs((int64_t)test_local_ms(&clock) + lastOffsetMs -
+                                                  (int64_t)test_network_ms(&clock));
+
+                    worstMs = (error > worstMs) ? error : worstMs;
+                    offsetOnlyMs = (offsetOnly > offsetOnlyMs) ? offsetOnly : offsetOnlyMs;
+                }
+            } while (!TIME_SYNC_RequestDue(test_local_ms(&clock)));
+            /* Two hours of the local clock, whatever its drift */
+            TEST_ASSERT((steps == 12u) || (steps == 13u));
+        }
+
+        printf("%s: drift %ld ppb learnt %ld ppb, worst error %ld ms, %ld ms with the offset only\n",
+               crystal->name, (long)crystal->driftPpb, (long)TIME_SYNC_GetStats()->driftPpb, (long)worstMs,
+               (long)offsetOnlyMs);
+        TEST_ASSERT(worstMs <= crystal->maxErrorMs);
+        TEST_ASSERT(worstMs <= offsetOnlyMs);
+        /* The offset of network minus local time drifts the opposite way of the crystal */
+        TEST_ASSERT(test_abs(TIME_SYNC_GetStats()->driftPpb + test_drift_ppb(crystal, clock.trueUs)) <=
+                    crystal->swingPpb + 5000);
+        TEST_ASSERT_EQ(TIME_SYNC_GetStats()->answers, answers);
+        TEST_ASSERT_EQ(TIME_SYNC_GetStats()->restarts, 0);
+    }
+    testName = "test_drift_tracking";
+}
+
+/* Before the first answer: retried quickly and no time */
+static void test_unsynced(void)
+{
+    uint64_t networkMs = 0;
+
+    TIME_SYNC_Init(TEST_PERIOD_MS, TEST_RETRY_MS);
+    TEST_ASSERT(!TIME_SYNC_IsSynced());
+    TEST_ASSERT(!TIME_SYNC_Now(1000, &networkMs));
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(1000, 60000, 0), 60000);
+    TEST_ASSERT(TIME_SYNC_RequestDue(0));
+    TIME_SYNC_Requested(1000);
+    TEST_ASSERT(!TIME_SYNC_RequestDue(1000 + TEST_RETRY_MS - 1u));
+    TEST_ASSERT(TIME_SYNC_RequestDue(1000 + TEST_RETRY_MS));
+
+    /* Synchronised, the long period applies */
+    TIME_SYNC_Update(2000, TEST_EPOCH_MS);
+    TEST_ASSERT(TIME_SYNC_IsSynced());
+    TIME_SYNC_Requested(2000);
+    TEST_ASSERT(!TIME_SYNC_RequestDue(2000 + TEST_RETRY_MS));
+    TEST_ASSERT(TIME_SYNC_RequestDue(2000 + TEST_PERIOD_MS));
+    TEST_ASSERT(TIME_SYNC_Now(3000, &networkMs));
+    TEST_ASSERT_EQ(networkMs, TEST_EPOCH_MS + 1000u);
+}
+
+/* Answers too close together move the offset only */
+static void test_short_interval(void)
+{
+    TIME_SYNC_Init(TEST_PERIOD_MS, TEST_RETRY_MS);
+    TIME_SYNC_Update(0, TEST_EPOCH_MS);
+    TIME_SYNC_Update(TIME_SYNC_MIN_DRIFT_INTERVAL_MS - 1u, TEST_EPOCH_MS + TIME_SYNC_MIN_DRIFT_INTERVAL_MS + 99u);
+    TEST_ASSERT_EQ(TIME_SYNC_GetStats()->driftPpb, 0);
+    TEST_ASSERT_EQ(TIME_SYNC_GetStats()->lastResidualMs, 100);
+}
+
+/* A jump of the network time restarts, the drift is learnt again */
+static void test_step(void)
+{
+    uint64_t networkMs;
+
+    TIME_SYNC_Init(TEST_PERIOD_MS, TEST_RETRY_MS);
+    TIME_SYNC_Update(0, TEST_EPOCH_MS);
+    TIME_SYNC_Update(TEST_PERIOD_MS, TEST_EPOCH_MS + TEST_PERIOD_MS - 72u);
+    TEST_ASSERT(TIME_SYNC_GetStats()->driftPpb < -9000);
+    TIME_SYNC_Update(2u * TEST_PERIOD_MS, TEST_EPOCH_MS + 2u * TEST_PERIOD_MS + TIME_SYNC_MAX_STEP_MS + 1000u);
+    TEST_ASSERT_EQ(TIME_SYNC_GetStats()->restarts, 1);
+    TEST_ASSERT_EQ(TIME_SYNC_GetStats()->driftPpb, 0);
+    TEST_ASSERT(TIME_SYNC_Now(2u * TEST_PERIOD_MS, &networkMs));
+    TEST_ASSERT_EQ(networkMs, TEST_EPOCH_MS + 2u * TEST_PERIOD_MS + TIME_SYNC_MAX_STEP_MS + 1000u);
+}
+
+/* An absurd drift is clamped */
+static void test_drift_clamp(void)
+{
+    TIME_SYNC_Init(TEST_PERIOD_MS, TEST_RETRY_MS);
+    TIME_SYNC_Update(0, TEST_EPOCH_MS);
+    TIME_SYNC_Update(TIME_SYNC_MIN_DRIFT_INTERVAL_MS, TEST_EPOCH_MS + TIME_SYNC_MIN_DRIFT_INTERVAL_MS + 9000u);
+    TEST_ASSERT_EQ(TIME_SYNC_GetStats()->driftPpb, TIME_SYNC_MAX_DRIFT_PPB);
+}
+
+/* Devices with the same phase wake at the same network time */
+static void test_boundary(void)
+{
+    TIME_SYNC_Init(TEST_PERIOD_MS, TEST_RETRY_MS);
+    /* Network time 1000 ms past a minute at local time 0 */
+    TIME_SYNC_Update(0, 60000u * 1000u + 1000u);
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(0, 60000, 0), 59000);
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(0, 60000, 5000), 4000);
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(0, 60000, 1000), 60000);
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(0, 60000, 61000), 60000);
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(59000, 60000, 0), 60000);
+    TEST_ASSERT_EQ(TIME_SYNC_MsToBoundary(0, 0, 0), 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_drift_tracking);
+    TEST_RUN(test_unsynced);
+    TEST_RUN(test_short_interval);
+    TEST_RUN(test_step);
+    TEST_RUN(test_drift_clamp);
+    TEST_RUN(test_boundary);
+    return TEST_END();
+}
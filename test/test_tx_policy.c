@@ -0,0 +1,140 @@
+/**
+* \file  test_tx_policy.c
+*
+* \brief Host tests of the confirmed/unconfirmed uplink policy
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include "test.h"
+#include "tx_policy.h"
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Sends a status frame as the application does, returns its type */
+static bool send_status(bool acked)
+{
+    bool confirmed = TX_POLICY_Select(TX_FRAME_STATUS);
+
+    TX_POLICY_OnSent(TX_FRAME_STATUS, confirmed);
+    TX_POLICY_OnResult(acked);
+    return confirmed;
+}
+
+/* Status frames sent up to and including the next probe */
+static uint8_t frames_to_probe(bool acked)
+{
+    uint8_t frames = 1;
+
+    while (!send_status(acked))
+    {
+        frames++;
+    }
+    return frames;
+}
+
+static void test_alarms_confirmed(void)
+{
+    TX_POLICY_Init(false, 2, 16);
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        TEST_ASSERT(TX_POLICY_Select(TX_FRAME_ALARM));
+        TX_POLICY_OnSent(TX_FRAME_ALARM, true);
+        TX_POLICY_OnResult(true);
+    }
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->confirmedSent, 10);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->acked, 10);
+}
+
+static void test_fixed_confirmed(void)
+{
+    TX_POLICY_Init(true, 2, 16);
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        TEST_ASSERT(send_status(true));
+    }
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->unconfirmedSent, 0);
+}
+
+static void test_probe_interval_grows(void)
+{
+    TX_POLICY_Init(false, 2, 16);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 2);
+    TEST_ASSERT_EQ(frames_to_probe(true), 2);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 4);
+    TEST_ASSERT_EQ(frames_to_probe(true), 4);
+    TEST_ASSERT_EQ(frames_to_probe(true), 8);
+    TEST_ASSERT_EQ(frames_to_probe(true), 16);
+    /* Held at the maximum */
+    TEST_ASSERT_EQ(frames_to_probe(true), 16);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 16);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->ackRate, 1000);
+}
+
+static void test_probe_interval_shrinks(void)
+{
+    TX_POLICY_Init(false, 2, 16);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        frames_to_probe(true);
+    }
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 16);
+
+    /* One lost ACK stays between the thresholds */
+    frames_to_probe(false);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->ackRate, 875);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 16);
+    frames_to_probe(false);
+    TEST_ASSERT(TX_POLICY_GetStats()->ackRate < TX_POLICY_ACK_RATE_LOW);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 8);
+    frames_to_probe(false);
+    frames_to_probe(false);
+    frames_to_probe(false);
+    /* Held at the minimum */
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 2);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->notAcked, 5);
+}
+
+/* Alarms feed the ACK rate and reset nothing of the status count */
+static void test_alarm_between_status(void)
+{
+    TX_POLICY_Init(false, 4, 16);
+    TEST_ASSERT(!send_status(true));
+    TEST_ASSERT(!send_status(true));
+    TX_POLICY_OnSent(TX_FRAME_ALARM, true);
+    TX_POLICY_OnResult(false);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->notAcked, 1);
+    TEST_ASSERT(!send_status(true));
+    TEST_ASSERT(send_status(true));
+}
+
+/* A result with no confirmed frame pending is not counted */
+static void test_result_without_confirmed(void)
+{
+    TX_POLICY_Init(false, 4, 16);
+    send_status(false);
+    TX_POLICY_OnResult(false);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->notAcked, 0);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->ackRate, 1000);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->unconfirmedSent, 1);
+}
+
+static void test_bad_limits(void)
+{
+    TX_POLICY_Init(false, 0, 0);
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 1);
+    TEST_ASSERT(send_status(true));
+    TEST_ASSERT_EQ(TX_POLICY_GetStats()->probeInterval, 1);
+}
+
+int main(void)
+{
+    TEST_RUN(test_alarms_confirmed);
+    TEST_RUN(test_fixed_confirmed);
+    TEST_RUN(test_probe_interval_grows);
+    TEST_RUN(test_probe_interval_shrinks);
+    TEST_RUN(test_alarm_between_status);
+    TEST_RUN(test_result_without_confirmed);
+    TEST_RUN(test_bad_limits);
+    return TEST_END();
+}
@@ -0,0 +1,379 @@
+/**
+* \file  test_wave_capture.c
+*
+* \brief Host tests of the alarm waveform capture: frame counts, fragments
+*        and compression ratio on synthetic accelerometer signals
+*
+* The signals are 12-bit ADC codes around mid scale: sensor noise at rest,
+* a running machine, an impact ringing down and full scale noise, which
+* the Rice code shortens the least. Every capture goes through the
+* fragments and is rebuilt as the backend does, then compared with the
+* frames fed in.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <math.h>
+#include "test.h"
+#include "wave_capture.h"
+
+/****************************** MACROS **************************************/
+#define TEST_MID_CODE                       2048
+#define TEST_MAX_CODE                       4095
+#define TEST_WAKE_PERIOD_MS                 30000u
+#define TEST_POST_PERIOD_MS                 20u
+#define TEST_PI                             3.14159265358979
+
+/****************************** TYPES **************************************/
+typedef enum _TestSignal_t
+{
+    TEST_SIGNAL_REST = 0,
+    TEST_SIGNAL_MACHINE,
+    TEST_SIGNAL_IMPACT,
+    TEST_SIGNAL_NOISE,
+    TEST_SIGNAL_COUNT
+} TestSignal_t;
+
+typedef struct _TestRatio_t
+{
+    const char *name;
+    /* Largest capture length, per mille of the raw one */
+    uint16_t maxPerMille;
+} TestRatio_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static const TestRatio_t testRatios[TEST_SIGNAL_COUNT] =
+{
+    { "rest", 400 },
+    { "machine", 800 },
+    { "impact", 800 },
+    { "noise", 900 }
+};
+
+static uint32_t testSeed;
+static uint16_t testFrames[WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS];
+
+/***************************** FUNCTIONS ***************************************/
+
+static uint32_t test_random(void)
+{
+    testSeed = testSeed * 1103515245u + 12345u;
+    return testSeed >> 8;
+}
+
+/* +/- range codes */
+static int32_t test_noise(int32_t range)
+{
+    return (int32_t)(test_random() % (uint32_t)(2 * range + 1)) - range;
+}
+
+static uint16_t test_clip(int32_t code)
+{
+    return (uint16_t)((code < 0) ? 0 : ((code > TEST_MAX_CODE) ? TEST_MAX_CODE : code));
+}
+
+/* Sample of frame n of an axis, frame 0 the first post-trigger one. The
+   wakeup frames are too far apart to follow the vibration: only their
+   level is kept */
+static uint16_t signal_sample(TestSignal_t signal, uint8_t axis, int32_t n)
+{
+    double phase = 2.0 * TEST_PI * (double)n * (double)(axis + 1u) / 9.0;
+
+    switch (signal)
+    {
+        case TEST_SIGNAL_REST:
+            return test_clip(TEST_MID_CODE + 16 * axis + test_noise(3));
+        case TEST_SIGNAL_MACHINE:
+            return test_clip((int32_t)(TEST_MID_CODE + ((n < 0) ? 0 : 300.0 * sin(phase))) + test_noise(6));
+        case TEST_SIGNAL_IMPACT:
+            return test_clip((int32_t)(TEST_MID_CODE + ((n < 0) ? 0 : 1500.0 * exp(-n / 6.0) * sin(phase))) +
+                             test_noise(3));
+        default:
+            return (uint16_t)(test_random() % (TEST_MAX_CODE + 1u));
+    }
+}
+
+/* Feeds wakeFrames frames, triggers, feeds the post-trigger frames and
+   returns the frames fed into the capture in testFrames, oldest first */
+static uint8_t run_capture(TestSignal_t signal, uint8_t channels, uint16_t wakeFrames)
+{
+    uint16_t frame[WAVE_CAPTURE_CHANNELS];
+    uint8_t pre = (wakeFrames < WAVE_CAPTURE_PRE_FRAMES) ? (uint8_t)wakeFrames : WAVE_CAPTURE_PRE_FRAMES;
+    uint8_t count = 0;
+
+    WAVE_CAPTURE_Init(TEST_POST_PERIOD_MS, channels);
+    for (uint16_t i = 0; i < wakeFrames; i++)
+    {
+        for (uint8_t axis = 0; axis < channels; axis++)
+        {
+            frame[axis] = signal_sample(signal, axis, -1 - (int32_t)(wakeFrames - 1u - i));
+        }
+        WAVE_CAPTURE_Add(frame, TEST_WAKE_PERIOD_MS);
+        if ((wakeFrames - i) <= pre)
+        {
+            memcpy(&testFrames[count * channels], frame, channels * sizeof(frame[0]));
+            count++;
+        }
+    }
+    TEST_ASSERT(WAVE_CAPTURE_Trigger());
+    TEST_ASSERT(WAVE_CAPTURE_Capturing());
+    for (uint8_t n = 0; n < WAVE_CAPTURE_POST_FRAMES; n++)
+    {
+        TEST_ASSERT(WAVE_CAPTURE_Capturing());
+        for (uint8_t axis = 0; axis < channels; axis++)
+        {
+            frame[axis] = signal_sample(signal, axis, n);
+        }
+        WAVE_CAPTURE_Add(frame, TEST_POST_PERIOD_MS);
+        memcpy(&testFrames[count * channels], frame, channels * sizeof(frame[0]));
+        count++;
+    }
+    TEST_ASSERT(!WAVE_CAPTURE_Capturing());
+    TEST_ASSERT(WAVE_CAPTURE_UploadPending());
+    return count;
+}
+
+/* Sends every fragment, reassembles them and rebuilds the capture */
+static void check_upload(uint8_t channels, uint8_t pre, uint8_t frames)
+{
+    static uint8_t capture[WAVE_CAPTURE_MAX_LENGTH + WAVE_CAPTURE_FRAGMENT_DATA];
+    static uint16_t samples[WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS];
+    const WaveCaptureStats_t *stats = WAVE_CAPTURE_GetStats();
+    uint8_t fragment[WAVE_CAPTURE_FRAGMENT_LENGTH + 8u];
+    uint16_t length = 0;
+    uint8_t sent = 0;
+    uint8_t expected = (uint8_t)((stats->length + WAVE_CAPTURE_FRAGMENT_DATA - 1u) / WAVE_CAPTURE_FRAGMENT_DATA);
+    WaveCaptureInfo_t info;
+
+    TEST_ASSERT_EQ(stats->rawLength, WAVE_CAPTURE_HEADER_LENGTH + frames * channels * 2u);
+    TEST_ASSERT(stats->length <= stats->rawLength);
+    /* Too small a buffer gets nothing */
+    TEST_ASSERT_EQ(WAVE_CAPTURE_PeekFragment(fragment, WAVE_CAPTURE_FRAGMENT_LENGTH - 1u), 0);
+    while (WAVE_CAPTURE_UploadPending())
+    {
+        uint8_t fragmentLength = WAVE_CAPTURE_PeekFragment(fragment, sizeof(fragment));
+
+        TEST_ASSERT(fragmentLength > WAVE_CAPTURE_FRAGMENT_HEADER);
+        TEST_ASSERT(fragmentLength <= WAVE_CAPTURE_FRAGMENT_LENGTH);
+        TEST_ASSERT_EQ(fragment[1], sent);
+        TEST_ASSERT_EQ(fragment[2], expected);
+        /* Peeking again gives the same fragment, until it is sent */
+        TEST_ASSERT_EQ(WAVE_CAPTURE_PeekFragment(fragment, sizeof(fragment)), fragmentLength);
+        memcpy(&capture[length], &fragment[WAVE_CAPTURE_FRAGMENT_HEADER], fragmentLength - WAVE_CAPTURE_FRAGMENT_HEADER);
+        length = (uint16_t)(length + fragmentLength - WAVE_CAPTURE_FRAGMENT_HEADER);
+        WAVE_CAPTURE_FragmentSent();
+        sent++;
+        if (sent > expected)
+        {
+            break;
+        }
+    }
+    TEST_ASSERT_EQ(sent, expected);
+    TEST_ASSERT_EQ(length, stats->length);
+    TEST_ASSERT_EQ(WAVE_CAPTURE_PeekFragment(fragment, sizeof(fragment)), 0);
+
+    TEST_ASSERT(WAVE_CAPTURE_Decode(capture, length, &info, samples, sizeof(samples) / sizeof(samples[0])));
+    TEST_ASSERT_EQ(info.channels, channels);
+    TEST_ASSERT_EQ(info.preFrames, pre);
+    TEST_ASSERT_EQ(info.postFrames, WAVE_CAPTURE_POST_FRAMES);
+    TEST_ASSERT_EQ(info.prePeriodMs, (pre > 0) ? TEST_WAKE_PERIOD_MS : 0);
+    TEST_ASSERT_EQ(info.postPeriodMs, TEST_POST_PERIOD_MS);
+    TEST_ASSERT_MEM(samples, testFrames, frames * channels * sizeof(samples[0]));
+
+    /* Truncated, the capture is refused */
+    for (uint16_t cut = 0; cut < length; cut += (WAVE_CAPTURE_FRAGMENT_DATA / 2u))
+    {
+        TEST_ASSERT(!WAVE_CAPTURE_Decode(capture, cut, &info, samples, sizeof(samples) / sizeof(samples[0])));
+    }
+}
+
+/* Pre-trigger frames: none, a partial ring and a ring that wrapped */
+static void test_frame_counts(void)
+{
+    static const uint16_t wakes[] = { 0, 1, 10, WAVE_CAPTURE_PRE_FRAMES - 1u, WAVE_CAPTURE_PRE_FRAMES, 100, 1000 };
+
+    testSeed = 49u;
+    for (uint8_t channels = 1; channels <= WAVE_CAPTURE_CHANNELS; channels++)
+    {
+        for (uint8_t w = 0; w < sizeof(wakes) / sizeof(wakes[0]); w++)
+        {
+            uint8_t pre = (wakes[w] < WAVE_CAPTURE_PRE_FRAMES) ? (uint8_t)wakes[w] : WAVE_CAPTURE_PRE_FRAMES;
+            uint8_t frames = run_capture(TEST_SIGNAL_MACHINE, channels, wakes[w]);
+
+            TEST_ASSERT_EQ(frames, pre + WAVE_CAPTURE_POST_FRAMES);
+            TEST_ASSERT_EQ(WAVE_CAPTURE_GetStats()->captures, 1);
+            check_upload(channels, pre, frames);
+            TEST_ASSERT(!WAVE_CAPTURE_UploadPending());
+        }
+    }
+}
+
+/* A trigger during the post-trigger frames or the upload is missed, the
+   ring starts over after a capture */
+static void test_missed_and_next(void)
+{
+    uint16_t frame[WAVE_CAPTURE_CHANNELS] = { 1, 2, 3 };
+    const WaveCaptureStats_t *stats = WAVE_CAPTURE_GetStats();
+    uint8_t frames;
+
+    testSeed = 49u;
+    frames = run_capture(TEST_SIGNAL_REST, 3, 40);
+    TEST_ASSERT(!WAVE_CAPTURE_Trigger());
+    TEST_ASSERT_EQ(stats->missed, 1);
+    /* Wakeup frames during the upload go into the next ring */
+    for (uint8_t i = 0; i < 5u; i++)
+    {
+        WAVE_CAPTURE_Add(frame, TEST_WAKE_PERIOD_MS);
+    }
+    check_upload(3, WAVE_CAPTURE_PRE_FRAMES, frames);
+
+    TEST_ASSERT(WAVE_CAPTURE_Trigger());
+    TEST_ASSERT(!WAVE_CAPTURE_Trigger());
+    TEST_ASSERT_EQ(stats->missed, 2);
+    for (uint8_t i = 0; i < WAVE_CAPTURE_POST_FRAMES; i++)
+    {
+        WAVE_CAPTURE_Add(frame, TEST_POST_PERIOD_MS);
+    }
+    TEST_ASSERT_EQ(stats->captures, 2);
+    TEST_ASSERT_EQ(stats->rawLength, WAVE_CAPTURE_HEADER_LENGTH + (5u + WAVE_CAPTURE_POST_FRAMES) * 3u * 2u);
+}
+
+/* A capture whose scans failed is dropped, the next one is taken */
+static void test_abort(void)
+{
+    uint16_t frame[WAVE_CAPTURE_CHANNELS] = { 100, 200, 300 };
+    const WaveCaptureStats_t *stats = WAVE_CAPTURE_GetStats();
+
+    WAVE_CAPTURE_Init(TEST_POST_PERIOD_MS, 2);
+    WAVE_CAPTURE_Add(frame, TEST_WAKE_PERIOD_MS);
+    WAVE_CAPTURE_Abort();
+    TEST_ASSERT_EQ(stats->missed, 0);
+    TEST_ASSERT(WAVE_CAPTURE_Trigger());
+    WAVE_CAPTURE_Add(frame, TEST_POST_PERIOD_MS);
+    WAVE_CAPTURE_Abort();
+    TEST_ASSERT_EQ(stats->missed, 1);
+    TEST_ASSERT(!WAVE_CAPTURE_Capturing());
+    TEST_ASSERT(!WAVE_CAPTURE_UploadPending());
+    /* The wakeup frames after the abort are not post-trigger frames */
+    WAVE_CAPTURE_Add(frame, TEST_WAKE_PERIOD_MS);
+    TEST_ASSERT_EQ(stats->captures, 0);
+    TEST_ASSERT(WAVE_CAPTURE_Trigger());
+    for (uint8_t i = 0; i < WAVE_CAPTURE_POST_FRAMES; i++)
+    {
+        WAVE_CAPTURE_Add(frame, TEST_POST_PERIOD_MS);
+    }
+    TEST_ASSERT_EQ(stats->captures, 1);
+    TEST_ASSERT_EQ(stats->rawLength, WAVE_CAPTURE_HEADER_LENGTH + (1u + WAVE_CAPTURE_POST_FRAMES) * 2u * 2u);
+}
+
+/* Without a fitted axis nothing is captured */
+static void test_no_channel(void)
+{
+    uint16_t frame[WAVE_CAPTURE_CHANNELS] = { 0 };
+
+    WAVE_CAPTURE_Init(TEST_POST_PERIOD_MS, 0);
+    WAVE_CAPTURE_Add(frame, TEST_WAKE_PERIOD_MS);
+    TEST_ASSERT(!WAVE_CAPTURE_Trigger());
+    TEST_ASSERT(!WAVE_CAPTURE_Capturing());
+    TEST_ASSERT_EQ(WAVE_CAPTURE_GetStats()->missed, 0);
+
+    /* More channels than a frame holds are capped */
+    WAVE_CAPTURE_Init(TEST_POST_PERIOD_MS, 7);
+    TEST_ASSERT(WAVE_CAPTURE_Trigger());
+    for (uint8_t i = 0; i < WAVE_CAPTURE_POST_FRAMES; i++)
+    {
+        WAVE_CAPTURE_Add(frame, TEST_POST_PERIOD_MS);
+    }
+    TEST_ASSERT_EQ(WAVE_CAPTURE_GetStats()->rawLength,
+                   WAVE_CAPTURE_HEADER_LENGTH + WAVE_CAPTURE_POST_FRAMES * WAVE_CAPTURE_CHANNELS * 2u);
+}
+
+/* Compression ratio and number of uplinks of every signal */
+static void test_compression(void)
+{
+    for (uint8_t signal = 0; signal < TEST_SIGNAL_COUNT; signal++)
+    {
+        for (uint8_t channels = 1; channels <= WAVE_CAPTURE_CHANNELS; channels++)
+        {
+            const WaveCaptureStats_t *stats = WAVE_CAPTURE_GetStats();
+            uint8_t frames;
+            uint16_t perMille;
+            uint16_t rawFragments;
+            uint16_t fragments;
+
+            testName = testRatios[signal].name;
+            testSeed = 49u + channels;
+            frames = run_capture((TestSignal_t)signal, channels, 200);
+            perMille = (uint16_t)((stats->length * 1000u) / stats->rawLength);
+            fragments = (uint16_t)((stats->length + WAVE_CAPTURE_FRAGMENT_DATA - 1u) / WAVE_CAPTURE_FRAGMENT_DATA);
+            rawFragments = (uint16_t)((stats->rawLength + WAVE_CAPTURE_FRAGMENT_DATA - 1u) /
+                                      WAVE_CAPTURE_FRAGMENT_DATA);
+            printf("%s, %u axes: %u bytes for %u raw (%u per mille), %u fragments for %u\n",
+                   testRatios[signal].name, channels, stats->length, stats->rawLength, perMille, fragments,
+                   rawFragments);
+
+            TEST_ASSERT(perMille <= testRatios[signal].maxPerMille);
+            TEST_ASSERT(fragments <= rawFragments);
+            check_upload(channels, WAVE_CAPTURE_PRE_FRAMES, frames);
+        }
+    }
+    testName = "test_compression";
+}
+
+/* Samples the Rice code cannot shorten go raw, at the raw length. 12-bit
+   codes always gain a little, 16-bit noise does not */
+static void test_raw_fallback(void)
+{
+    static uint16_t samples[WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS];
+    static uint16_t decoded[WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS];
+    uint8_t out[WAVE_CAPTURE_MAX_LENGTH];
+    WaveCaptureInfo_t info = { 0, WAVE_CAPTURE_CHANNELS, WAVE_CAPTURE_PRE_FRAMES, WAVE_CAPTURE_POST_FRAMES,
+                               TEST_WAKE_PERIOD_MS, TEST_POST_PERIOD_MS };
+    WaveCaptureInfo_t decodedInfo;
+
+    testSeed = 7u;
+    for (uint16_t i = 0; i < (WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS); i++)
+    {
+        samples[i] = (uint16_t)test_random();
+    }
+    TEST_ASSERT_EQ(WAVE_CAPTURE_Encode(&info, samples, out, sizeof(out)), WAVE_CAPTURE_MAX_LENGTH);
+    TEST_ASSERT_EQ(out[0], WAVE_CAPTURE_FORMAT_RAW);
+    TEST_ASSERT(WAVE_CAPTURE_Decode(out, WAVE_CAPTURE_MAX_LENGTH, &decodedInfo, decoded,
+                                    sizeof(decoded) / sizeof(decoded[0])));
+    TEST_ASSERT_EQ(decodedInfo.format, WAVE_CAPTURE_FORMAT_RAW);
+    TEST_ASSERT_MEM(decoded, samples, sizeof(samples));
+    /* Fewer samples than the header announces */
+    TEST_ASSERT_EQ(WAVE_CAPTURE_Decode(out, WAVE_CAPTURE_MAX_LENGTH, &decodedInfo, decoded,
+                                       WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS - 1u), false);
+}
+
+/* Encode into buffers too small, the Rice code still used when it fits */
+static void test_encode_limits(void)
+{
+    static uint16_t samples[WAVE_CAPTURE_FRAMES];
+    uint8_t out[WAVE_CAPTURE_MAX_LENGTH];
+    WaveCaptureInfo_t info = { 0, 1, 0, WAVE_CAPTURE_FRAMES, 0, TEST_POST_PERIOD_MS };
+    uint16_t length;
+
+    for (uint8_t i = 0; i < WAVE_CAPTURE_FRAMES; i++)
+    {
+        samples[i] = (uint16_t)(TEST_MID_CODE + (i & 1u));
+    }
+    length = WAVE_CAPTURE_Encode(&info, samples, out, sizeof(out));
+    TEST_ASSERT_EQ(out[0], WAVE_CAPTURE_FORMAT_RICE);
+    TEST_ASSERT(length < (WAVE_CAPTURE_HEADER_LENGTH + 2u * WAVE_CAPTURE_FRAMES) / 3u);
+    TEST_ASSERT_EQ(WAVE_CAPTURE_Encode(&info, samples, out, length), length);
+    TEST_ASSERT_EQ(WAVE_CAPTURE_Encode(&info, samples, out, (uint16_t)(length - 1u)), 0);
+    TEST_ASSERT_EQ(WAVE_CAPTURE_Encode(&info, samples, out, WAVE_CAPTURE_HEADER_LENGTH - 1u), 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_frame_counts);
+    TEST_RUN(test_missed_and_next);
+    TEST_RUN(test_abort);
+    TEST_RUN(test_no_channel);
+    TEST_RUN(test_compression);
+    TEST_RUN(test_raw_fallback);
+    TEST_RUN(test_encode_limits);
+    return TEST_END();
+}
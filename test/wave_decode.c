@@ -0,0 +1,229 @@
+/**
+* \file  wave_decode.c
+*
+* \brief Rebuilds the waveforms of the alarms from the uplinks of their
+*        fragments
+*
+* Reads the payloads received on DEMO_APP_WAVE_FPORT, one per line in hex
+* as the network server consoles print them, from a file or the standard
+* input; empty lines and lines starting with '#' are skipped. The
+* fragments of a capture are reassembled, a new capture id drops an
+* incomplete one. Every complete capture is printed as CSV: capture id,
+* frame, time in ms from the trigger scan and one column per channel.
+*
+*   wave_decode [payloads.txt]
+*
+* The exit status is 1 if a capture could not be rebuilt.
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "wave_capture.h"
+
+/****************************** MACROS **************************************/
+#define DECODE_LINE_LENGTH                  256u
+#define DECODE_MAX_FRAGMENTS                ((WAVE_CAPTURE_MAX_LENGTH + WAVE_CAPTURE_FRAGMENT_DATA - 1u) / \
+                                             WAVE_CAPTURE_FRAGMENT_DATA)
+
+/****************************** TYPES **************************************/
+typedef struct _DecodeCapture_t
+{
+    bool started;
+    uint8_t id;
+    uint8_t count;
+    uint8_t received;
+    bool have[DECODE_MAX_FRAGMENTS];
+    uint16_t length;
+    uint8_t data[DECODE_MAX_FRAGMENTS * WAVE_CAPTURE_FRAGMENT_DATA];
+} DecodeCapture_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static DecodeCapture_t decodeCapture;
+static bool decodeHeader = false;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Parses a line of hex digits, spaces allowed between the bytes */
+static int decode_hex(const char *line, uint8_t *out, size_t maxLength)
+{
+    size_t length = 0;
+
+    while ('\0' != *line)
+    {
+        unsigned int value;
+
+        if (isspace((unsigned char)*line))
+        {
+            line++;
+            continue;
+        }
+        if (!isxdigit((unsigned char)line[0]) || !isxdigit((unsigned char)line[1]) || (length == maxLength) ||
+            (1 != sscanf(line, "%2x", &value)))
+        {
+            return -1;
+        }
+        out[length++] = (uint8_t)value;
+        line += 2;
+    }
+    return (int)length;
+}
+
+static bool decode_print(const DecodeCapture_t *capture)
+{
+    static uint16_t samples[WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS];
+    WaveCaptureInfo_t info;
+    uint16_t frames;
+
+    if (!WAVE_CAPTURE_Decode(capture->data, capture->length, &info, samples,
+                             sizeof(samples) / sizeof(samples[0])))
+    {
+        fprintf(stderr, "capture %u: %u bytes, cannot be decoded\n", capture->id, capture->length);
+        return false;
+    }
+    frames = (uint16_t)(info.preFrames + info.postFrames);
+    fprintf(stderr, "capture %u: %s, %u channels, %u + %u frames, %u bytes for %u raw\n", capture->id,
+            (WAVE_CAPTURE_FORMAT_RICE == info.format) ? "rice" : "raw", info.channels, info.preFrames,
+            info.postFrames, capture->length, WAVE_CAPTURE_HEADER_LENGTH + frames * info.channels * 2u);
+
+    /* The channels of the first capture, the same for all of a device */
+    if (!decodeHeader)
+    {
+        decodeHeader = true;
+        printf("capture,frame,time_ms");
+        for (uint8_t channel = 0; channel < info.channels; channel++)
+        {
+            printf(",ch%u", channel);
+        }
+        printf("\n");
+    }
+    for (uint16_t frame = 0; frame < frames; frame++)
+    {
+        /* The last pre-trigger frame is the scan of the trigger */
+        long timeMs = (frame < info.preFrames) ?
+                      -(long)(info.preFrames - 1u - frame) * (long)info.prePeriodMs :
+                      (long)(frame - info.preFrames + 1u) * (long)info.postPeriodMs;
+
+        printf("%u,%u,%ld", capture->id, frame, timeMs);
+        for (uint8_t channel = 0; channel < info.channels; channel++)
+        {
+            printf(",%u", samples[frame * info.channels + channel]);
+        }
+        printf("\n");
+    }
+    return true;
+}
+
+/* Adds a fragment, prints the capture it completes; false on an error */
+static bool decode_fragment(const uint8_t *fragment, int length)
+{
+    DecodeCapture_t *capture = &decodeCapture;
+    uint8_t id;
+    uint8_t index;
+    uint8_t count;
+    uint16_t dataLength;
+    bool ok = true;
+
+    if (length <= (int)WAVE_CAPTURE_FRAGMENT_HEADER)
+    {
+        fprintf(stderr, "fragment of %d bytes skipped\n", length);
+        return false;
+    }
+    id = fragment[0];
+    index = fragment[1];
+    count = fragment[2];
+    dataLength = (uint16_t)(length - WAVE_CAPTURE_FRAGMENT_HEADER);
+    if ((0 == count) || (count > DECODE_MAX_FRAGMENTS) || (index >= count) ||
+        (dataLength > WAVE_CAPTURE_FRAGMENT_DATA) ||
+        (((index + 1u) < count) && (dataLength < WAVE_CAPTURE_FRAGMENT_DATA)))
+    {
+        fprintf(stderr, "capture %u: invalid fragment %u/%u skipped\n", id, index, count);
+        return false;
+    }
+
+    if (capture->started && ((id != capture->id) || (count != capture->count)))
+    {
+        fprintf(stderr, "capture %u: %u of %u fragments, dropped\n", capture->id, capture->received,
+                capture->count);
+        ok = false;
+        capture->started = false;
+    }
+    if (!capture->started)
+    {
+        memset(capture, 0, sizeof(*capture));
+        capture->started = true;
+        capture->id = id;
+        capture->count = count;
+    }
+    if (!capture->have[index])
+    {
+        capture->have[index] = true;
+        capture->received++;
+        memcpy(&capture->data[index * WAVE_CAPTURE_FRAGMENT_DATA], &fragment[WAVE_CAPTURE_FRAGMENT_HEADER],
+               dataLength);
+        if ((index + 1u) == count)
+        {
+            capture->length = (uint16_t)(index * WAVE_CAPTURE_FRAGMENT_DATA + dataLength);
+        }
+    }
+    if (capture->received == capture->count)
+    {
+        ok = decode_print(capture) && ok;
+        capture->started = false;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *input = stdin;
+    char line[DECODE_LINE_LENGTH];
+    bool ok = true;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [payloads.txt]\n", argv[0]);
+        return 2;
+    }
+    if ((2 == argc) && (NULL == (input = fopen(argv[1], "r"))))
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    while (NULL != fgets(line, sizeof(line), input))
+    {
+        uint8_t fragment[DECODE_LINE_LENGTH / 2u];
+        char *start = line;
+        int length;
+
+        while (isspace((unsigned char)*start))
+        {
+            start++;
+        }
+        if (('\0' == *start) || ('#' == *start))
+        {
+            continue;
+        }
+        length = decode_hex(start, fragment, sizeof(fragment));
+        if (length < 0)
+        {
+            fprintf(stderr, "not hex: %s", line);
+            ok = false;
+            continue;
+        }
+        ok = decode_fragment(fragment, length) && ok;
+    }
+    if (decodeCapture.started)
+    {
+        fprintf(stderr, "capture %u: %u of %u fragments at the end of the input\n", decodeCapture.id,
+                decodeCapture.received, decodeCapture.count);
+        ok = false;
+    }
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    return ok ? 0 : 1;
+}
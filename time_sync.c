@@ -0,0 +1,208 @@
+/**
+* \file  time_sync.c
+*
+* \brief Network time kept from DeviceTimeAns with drift correction
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <stddef.h>
+#include <string.h>
+#include "time_sync.h"
+
+/******************************** MACROS ***************************************/
+#define TIME_SYNC_PPB                       1000000000LL
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint32_t syncPeriodMs;
+static uint32_t syncRetryMs;
+static bool syncRequested = false;
+static uint64_t syncRequestMs = 0;
+static bool syncValid = false;
+static bool syncDriftKnown = false;
+/* Network minus local time at syncLocalMs */
+static int64_t syncOffsetMs = 0;
+static uint64_t syncLocalMs = 0;
+static TimeSyncStats_t syncStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* Offset predicted at a local time from the last answer and the drift */
+static int64_t time_sync_predict(uint64_t localMs)
+{
+    int64_t elapsed = (int64_t)(localMs - syncLocalMs);
+
+    return syncOffsetMs + (elapsed * syncStats.driftPpb) / TIME_SYNC_PPB;
+}
+
+static void time_sync_restart(uint64_t localMs, int64_t offsetMs)
+{
+    syncOffsetMs = offsetMs;
+    syncLocalMs = localMs;
+    syncStats.driftPpb = 0;
+    syncDriftKnown = false;
+    syncValid = true;
+}
+
+/*********************************************************************//**
+\brief      Initializes the synchronisation
+\param[in]  periodMs - interval of the requests once synchronised
+\param[in]  retryMs  - interval of the requests until the first answer
+*************************************************************************/
+void TIME_SYNC_Init(uint32_t periodMs, uint32_t retryMs)
+{
+    syncPeriodMs = periodMs;
+    syncRetryMs = retryMs;
+    syncRequested = false;
+    syncRequestMs = 0;
+    syncValid = false;
+    syncDriftKnown = false;
+    syncOffsetMs = 0;
+    syncLocalMs = 0;
+    memset(&syncStats, 0, sizeof(syncStats));
+}
+
+/*********************************************************************//**
+\brief      Tells if the next uplink should carry a DeviceTimeReq
+\param[in]  localMs - local time
+*************************************************************************/
+bool TIME_SYNC_RequestDue(uint64_t localMs)
+{
+    uint32_t interval = syncValid ? syncPeriodMs : syncRetryMs;
+
+    return !syncRequested || ((localMs - syncRequestMs) >= interval);
+}
+
+/*********************************************************************//**
+\brief      Records that a DeviceTimeReq was sent
+\param[in]  localMs - local time of the request
+*************************************************************************/
+void TIME_SYNC_Requested(uint64_t localMs)
+{
+    syncRequested = true;
+    syncRequestMs = localMs;
+}
+
+/*********************************************************************//**
+\brief      Takes a DeviceTimeAns into account
+\param[in]  localMs   - local time the answer refers to
+\param[in]  networkMs - network time of the answer
+*************************************************************************/
+void TIME_SYNC_Update(uint64_t localMs, uint64_t networkMs)
+{
+    int64_t measured = (int64_t)networkMs - (int64_t)localMs;
+    int64_t predicted;
+    int64_t residual;
+    uint64_t elapsed;
+
+    syncStats.answers++;
+    if (!syncValid)
+    {
+        time_sync_restart(localMs, measured);
+        syncStats.lastResidualMs = 0;
+        return;
+    }
+
+    elapsed = localMs - syncLocalMs;
+    predicted = time_sync_predict(localMs);
+    residual = measured - predicted;
+    syncStats.lastResidualMs = (int32_t)((residual > INT32_MAX) ? INT32_MAX :
+                                         ((residual < INT32_MIN) ? INT32_MIN : residual));
+
+    /* The network time jumped or the local clock was reset */
+    if ((residual > TIME_SYNC_MAX_STEP_MS) || (residual < -TIME_SYNC_MAX_STEP_MS))
+    {
+        syncStats.restarts++;
+        time_sync_restart(localMs, measured);
+        return;
+    }
+
+    if (elapsed >= TIME_SYNC_MIN_DRIFT_INTERVAL_MS)
+    {
+        int64_t drift = syncStats.driftPpb;
+        int64_t correction = (residual * TIME_SYNC_PPB) / (int64_t)elapsed;
+
+        if (syncDriftKnown)
+        {
+            drift += correction / (1 << TIME_SYNC_DRIFT_GAIN_SHIFT);
+            predicted += residual / (1 << TIME_SYNC_OFFSET_GAIN_SHIFT);
+        }
+        else
+        {
+            /* First estimate from two answers, both taken as they are */
+            drift += correction;
+            predicted = measured;
+            syncDriftKnown = true;
+        }
+        if (drift > TIME_SYNC_MAX_DRIFT_PPB)
+        {
+            drift = TIME_SYNC_MAX_DRIFT_PPB;
+        }
+        else if (drift < -TIME_SYNC_MAX_DRIFT_PPB)
+        {
+            drift = -TIME_SYNC_MAX_DRIFT_PPB;
+        }
+        syncStats.driftPpb = (int32_t)drift;
+    }
+    else
+    {
+        predicted += residual / (1 << TIME_SYNC_OFFSET_GAIN_SHIFT);
+    }
+
+    syncOffsetMs = predicted;
+    syncLocalMs = localMs;
+}
+
+/*********************************************************************//**
+\brief      Returns true once a DeviceTimeAns was received
+*************************************************************************/
+bool TIME_SYNC_IsSynced(void)
+{
+    return syncValid;
+}
+
+/*********************************************************************//**
+\brief      Converts a local time to network time
+\param[in]  localMs   - local time
+\param[out] networkMs - drift corrected network time
+\return     false before the first answer
+*************************************************************************/
+bool TIME_SYNC_Now(uint64_t localMs, uint64_t *networkMs)
+{
+    if (!syncValid)
+    {
+        return false;
+    }
+    *networkMs = (uint64_t)((int64_t)localMs + time_sync_predict(localMs));
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Time until the next network time boundary of a period, so
+            devices sample in phase (same phaseMs) or staggered
+\param[in]  localMs  - local time
+\param[in]  periodMs - sampling period
+\param[in]  phaseMs  - offset of the samples within the period
+\return     delay in ms, periodMs when not synchronised
+*************************************************************************/
+uint32_t TIME_SYNC_MsToBoundary(uint64_t localMs, uint32_t periodMs, uint32_t phaseMs)
+{
+    uint64_t networkMs;
+    uint32_t position;
+
+    if ((0 == periodMs) || !TIME_SYNC_Now(localMs, &networkMs))
+    {
+        return periodMs;
+    }
+
+    position = (uint32_t)((networkMs + periodMs - (phaseMs % periodMs)) % periodMs);
+    return periodMs - position;
+}
+
+/*********************************************************************//**
+\brief      Returns the filter statistics
+*************************************************************************/
+const TimeSyncStats_t *TIME_SYNC_GetStats(void)
+{
+    return &syncStats;
+}
@@ -0,0 +1,52 @@
+/**
+* \file  time_sync.h
+*
+* \brief Network time kept from DeviceTimeAns with drift correction
+*
+* Every answer to a DeviceTimeReq gives the network (GPS) time at a known
+* local time. The offset between both clocks is tracked together with
+* the drift of the local crystal by an alpha-beta filter, so the network
+* time of a local timestamp stays accurate between requests.
+* Times are in milliseconds. The module does not touch the hardware and
+* also builds on a host.
+*/
+
+#ifndef TIME_SYNC_H_
+#define TIME_SYNC_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Weights of a residual in the offset and drift estimates, 1/2^n */
+#define TIME_SYNC_OFFSET_GAIN_SHIFT         1
+#define TIME_SYNC_DRIFT_GAIN_SHIFT          2
+/* Drift is only learnt from answers at least this far apart */
+#define TIME_SYNC_MIN_DRIFT_INTERVAL_MS     600000u
+/* Largest drift accepted, parts per billion */
+#define TIME_SYNC_MAX_DRIFT_PPB             200000
+/* A residual larger than this restarts the synchronisation */
+#define TIME_SYNC_MAX_STEP_MS               10000
+
+/****************************** TYPES **************************************/
+typedef struct _TimeSyncStats_t
+{
+    uint16_t answers;
+    uint16_t restarts;
+    /* Last difference between an answer and the prediction */
+    int32_t lastResidualMs;
+    int32_t driftPpb;
+} TimeSyncStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void TIME_SYNC_Init(uint32_t periodMs, uint32_t retryMs);
+bool TIME_SYNC_RequestDue(uint64_t localMs);
+void TIME_SYNC_Requested(uint64_t localMs);
+void TIME_SYNC_Update(uint64_t localMs, uint64_t networkMs);
+bool TIME_SYNC_IsSynced(void);
+bool TIME_SYNC_Now(uint64_t localMs, uint64_t *networkMs);
+uint32_t TIME_SYNC_MsToBoundary(uint64_t localMs, uint32_t periodMs, uint32_t phaseMs);
+const TimeSyncStats_t *TIME_SYNC_GetStats(void);
+
+#endif /* TIME_SYNC_H_ */
@@ -0,0 +1,129 @@
+/**
+* \file  tx_policy.c
+*
+* \brief Confirmed/unconfirmed selection of the application uplinks
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "tx_policy.h"
+
+/******************************** MACROS ***************************************/
+/* Weight of a new result in the smoothed ACK rate, 1/2^n */
+#define TX_POLICY_EWMA_SHIFT                3
+
+/************************** GLOBAL VARIABLES ***********************************/
+static TxPolicyStats_t txStats;
+static bool txAllConfirmed = false;
+static uint8_t txProbeMin = 1;
+static uint8_t txProbeMax = 1;
+/* Status frames sent since the last probe */
+static uint8_t txStatusCount = 0;
+/* A confirmed frame is waiting for its transaction to complete */
+static bool txAwaitingAck = false;
+
+/***************************** FUNCTIONS ***************************************/
+
+/*********************************************************************//**
+\brief      Initializes the policy
+\param[in]  allConfirmed - send every frame confirmed, the fixed policy
+\param[in]  probeMin     - shortest status probe interval
+\param[in]  probeMax     - longest status probe interval
+*************************************************************************/
+void TX_POLICY_Init(bool allConfirmed, uint8_t probeMin, uint8_t probeMax)
+{
+    memset(&txStats, 0, sizeof(txStats));
+    txAllConfirmed = allConfirmed;
+    txProbeMin = (probeMin > 0) ? probeMin : 1;
+    txProbeMax = (probeMax >= txProbeMin) ? probeMax : txProbeMin;
+    txStats.probeInterval = txProbeMin;
+    /* Assume a healthy link until told otherwise */
+    txStats.ackRate = 1000;
+    txStatusCount = 0;
+    txAwaitingAck = false;
+}
+
+/*********************************************************************//**
+\brief      Tells whether the next frame of a kind is sent confirmed
+\param[in]  kind - alarm or status frame
+\return     true for a confirmed frame
+*************************************************************************/
+bool TX_POLICY_Select(TxFrameKind_t kind)
+{
+    if (txAllConfirmed || (TX_FRAME_ALARM == kind))
+    {
+        return true;
+    }
+    return (txStatusCount + 1u) >= txStats.probeInterval;
+}
+
+/*********************************************************************//**
+\brief      Records a frame accepted by the stack
+\param[in]  kind      - alarm or status frame
+\param[in]  confirmed - type it was sent with
+*************************************************************************/
+void TX_POLICY_OnSent(TxFrameKind_t kind, bool confirmed)
+{
+    if (TX_FRAME_STATUS == kind)
+    {
+        txStatusCount = confirmed ? 0 : (uint8_t)(txStatusCount + 1u);
+    }
+
+    if (confirmed)
+    {
+        txStats.confirmedSent++;
+    }
+    else
+    {
+        txStats.unconfirmedSent++;
+    }
+    txAwaitingAck = confirmed;
+}
+
+/*********************************************************************//**
+\brief      Records the outcome of the last confirmed frame
+\param[in]  acked - true if the network acknowledged it
+*************************************************************************/
+void TX_POLICY_OnResult(bool acked)
+{
+    uint16_t sample = acked ? 1000u : 0u;
+
+    if (!txAwaitingAck)
+    {
+        return;
+    }
+    txAwaitingAck = false;
+
+    if (acked)
+    {
+        txStats.acked++;
+    }
+    else
+    {
+        txStats.notAcked++;
+    }
+
+    txStats.ackRate = (uint16_t)(txStats.ackRate -
+                      (txStats.ackRate >> TX_POLICY_EWMA_SHIFT) + (sample >> TX_POLICY_EWMA_SHIFT));
+
+    /* Probe less on a healthy link, more often when ACKs go missing */
+    if (txStats.ackRate >= TX_POLICY_ACK_RATE_HIGH)
+    {
+        uint16_t interval = (uint16_t)txStats.probeInterval * 2u;
+        txStats.probeInterval = (interval > txProbeMax) ? txProbeMax : (uint8_t)interval;
+    }
+    else if (txStats.ackRate < TX_POLICY_ACK_RATE_LOW)
+    {
+        uint8_t interval = txStats.probeInterval / 2u;
+        txStats.probeInterval = (interval < txProbeMin) ? txProbeMin : interval;
+    }
+}
+
+/*********************************************************************//**
+\brief      Returns the policy counters
+*************************************************************************/
+const TxPolicyStats_t *TX_POLICY_GetStats(void)
+{
+    return &txStats;
+}
@@ -0,0 +1,50 @@
+/**
+* \file  tx_policy.h
+*
+* \brief Confirmed/unconfirmed selection of the application uplinks
+*
+* Alarm frames are always confirmed. Status frames are unconfirmed except
+* every probeInterval-th one, which is confirmed to probe the link. The
+* interval follows the ACK rate of the confirmed frames: it grows while
+* the link is healthy and shrinks when ACKs get lost.
+*/
+
+#ifndef TX_POLICY_H_
+#define TX_POLICY_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* ACK rate thresholds in per mille */
+#define TX_POLICY_ACK_RATE_HIGH             950u
+#define TX_POLICY_ACK_RATE_LOW              800u
+
+/****************************** TYPES **************************************/
+typedef enum _TxFrameKind_t
+{
+    TX_FRAME_ALARM = 0,
+    TX_FRAME_STATUS
+} TxFrameKind_t;
+
+typedef struct _TxPolicyStats_t
+{
+    uint32_t confirmedSent;
+    uint32_t unconfirmedSent;
+    uint32_t acked;
+    uint32_t notAcked;
+    /* Smoothed ACK rate of the confirmed frames, per mille */
+    uint16_t ackRate;
+    /* Current number of status frames per confirmed probe */
+    uint8_t probeInterval;
+} TxPolicyStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void TX_POLICY_Init(bool allConfirmed, uint8_t probeMin, uint8_t probeMax);
+bool TX_POLICY_Select(TxFrameKind_t kind);
+void TX_POLICY_OnSent(TxFrameKind_t kind, bool confirmed);
+void TX_POLICY_OnResult(bool acked);
+const TxPolicyStats_t *TX_POLICY_GetStats(void);
+
+#endif /* TX_POLICY_H_ */
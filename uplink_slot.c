@@ -0,0 +1,123 @@
+/**
+* \file  uplink_slot.c
+*
+* \brief Per-device delay of the uplinks to break fleet synchronisation
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "uplink_slot.h"
+
+/******************************** MACROS ***************************************/
+#define UPLINK_SLOT_FNV_OFFSET              2166136261uL
+#define UPLINK_SLOT_FNV_PRIME               16777619uL
+#define UPLINK_SLOT_EUI_LENGTH              8u
+
+/************************** GLOBAL VARIABLES ***********************************/
+static uint32_t slotWindowMs;
+static uint32_t slotJitterMs;
+static uint8_t slotReslotFailures;
+static uint32_t slotRandom = 1;
+static UplinkSlotStats_t slotStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+/* FNV-1a, spreads EUIs that only differ in a few bits */
+static uint32_t uplink_slot_hash(const uint8_t *data, uint8_t length)
+{
+    uint32_t hash = UPLINK_SLOT_FNV_OFFSET;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= UPLINK_SLOT_FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Uniform value in [0, range), 0 for an empty range */
+static uint32_t uplink_slot_below(uint32_t range)
+{
+    return (0 == range) ? 0 : (uint32_t)(((uint64_t)UPLINK_SLOT_Random() * range) >> 32);
+}
+
+/*********************************************************************//**
+\brief      Derives the phase of the device
+\param[in]  devEui         - DevEUI, 8 bytes
+\param[in]  windowMs       - range of the phases
+\param[in]  jitterMs       - range of the random delay added to every send
+\param[in]  reslotFailures - consecutive failures that draw a new phase,
+                             0 never does
+*************************************************************************/
+void UPLINK_SLOT_Init(const uint8_t *devEui, uint32_t windowMs, uint32_t jitterMs, uint8_t reslotFailures)
+{
+    uint32_t hash = uplink_slot_hash(devEui, UPLINK_SLOT_EUI_LENGTH);
+
+    slotWindowMs = windowMs;
+    slotJitterMs = jitterMs;
+    slotReslotFailures = reslotFailures;
+    /* xorshift32 must not start from 0 */
+    slotRandom = (0 != hash) ? hash : 1u;
+    memset(&slotStats, 0, sizeof(slotStats));
+    slotStats.phaseMs = uplink_slot_below(slotWindowMs);
+}
+
+/*********************************************************************//**
+\brief      Returns the delay to apply before the next send
+*************************************************************************/
+uint32_t UPLINK_SLOT_NextDelayMs(void)
+{
+    return slotStats.phaseMs + uplink_slot_below(slotJitterMs + 1u);
+}
+
+/*********************************************************************//**
+\brief      Takes the outcome of a transaction into account
+\param[in]  collisionLikely - NO_ACK or TX_TIMEOUT, the slot may be shared
+\param[in]  entropy         - value that differs between devices and
+                              over time, e.g. a timer in microseconds
+*************************************************************************/
+void UPLINK_SLOT_OnResult(bool collisionLikely, uint32_t entropy)
+{
+    if (!collisionLikely)
+    {
+        slotStats.failures = 0;
+        return;
+    }
+
+    if (slotStats.failures < UINT8_MAX)
+    {
+        slotStats.failures++;
+    }
+    if ((0 != slotReslotFailures) && (slotStats.failures >= slotReslotFailures))
+    {
+        /* Devices that drew the same phase get different sequences */
+        slotRandom ^= entropy;
+        if (0 == slotRandom)
+        {
+            slotRandom = 1;
+        }
+        slotStats.phaseMs = uplink_slot_below(slotWindowMs);
+        slotStats.failures = 0;
+        slotStats.reslots++;
+    }
+}
+
+/*********************************************************************//**
+\brief      Next value of the xorshift32 generator of the module
+*************************************************************************/
+uint32_t UPLINK_SLOT_Random(void)
+{
+    slotRandom ^= slotRandom << 13;
+    slotRandom ^= slotRandom >> 17;
+    slotRandom ^= slotRandom << 5;
+    return slotRandom;
+}
+
+/*********************************************************************//**
+\brief      Returns the phase in use and the reslot counters
+*************************************************************************/
+const UplinkSlotStats_t *UPLINK_SLOT_GetStats(void)
+{
+    return &slotStats;
+}
@@ -0,0 +1,36 @@
+/**
+* \file  uplink_slot.h
+*
+* \brief Per-device delay of the uplinks to break fleet synchronisation
+*
+* Devices powered on together run the same sampling cadence and would
+* send on the same instants forever. Every send is delayed by a phase
+* derived from the DevEUI, stable for a device but spread over the fleet,
+* plus a bounded random jitter. After repeated NO_ACK or TX_TIMEOUT the
+* phase is drawn again, moving a device out of a colliding slot.
+* The module does not touch the hardware and also builds on a host.
+*/
+
+#ifndef UPLINK_SLOT_H_
+#define UPLINK_SLOT_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** TYPES **************************************/
+typedef struct _UplinkSlotStats_t
+{
+    uint32_t phaseMs;
+    uint16_t reslots;
+    uint8_t failures;
+} UplinkSlotStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void UPLINK_SLOT_Init(const uint8_t *devEui, uint32_t windowMs, uint32_t jitterMs, uint8_t reslotFailures);
+uint32_t UPLINK_SLOT_NextDelayMs(void);
+void UPLINK_SLOT_OnResult(bool collisionLikely, uint32_t entropy);
+uint32_t UPLINK_SLOT_Random(void);
+const UplinkSlotStats_t *UPLINK_SLOT_GetStats(void);
+
+#endif /* UPLINK_SLOT_H_ */
@@ -0,0 +1,518 @@
+/**
+* \file  wave_capture.c
+*
+* \brief Waveform around an alarm, compressed and uploaded in fragments
+*
+*/
+
+/****************************** INCLUDES **************************************/
+#include <string.h>
+#include "wave_capture.h"
+
+/****************************** TYPES **************************************/
+typedef enum _WaveCaptureState_t
+{
+    WAVE_CAPTURE_IDLE = 0,
+    WAVE_CAPTURE_POST,
+    WAVE_CAPTURE_UPLOAD
+} WaveCaptureState_t;
+
+typedef struct _WaveBits_t
+{
+    uint8_t *data;
+    uint16_t length;
+    /* Position in bits */
+    uint32_t pos;
+} WaveBits_t;
+
+/************************** GLOBAL VARIABLES ***********************************/
+static WaveCaptureState_t waveState = WAVE_CAPTURE_IDLE;
+/* Frames of waveInfo.channels samples, the ring of the pre-trigger frames
+   first, unrolled by the trigger */
+static uint16_t waveSamples[WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS];
+static uint8_t waveHead = 0;
+static uint8_t waveFilled = 0;
+static WaveCaptureInfo_t waveInfo;
+static uint8_t waveCapture[WAVE_CAPTURE_MAX_LENGTH];
+static uint16_t waveLength = 0;
+static uint8_t waveId = 0;
+static uint8_t waveFragment = 0;
+static uint8_t waveFragmentCount = 0;
+static WaveCaptureStats_t waveStats;
+
+/***************************** FUNCTIONS ***************************************/
+
+static bool wave_put_bits(WaveBits_t *bits, uint32_t value, uint8_t count)
+{
+    if ((bits->pos + count) > ((uint32_t)bits->length * 8u))
+    {
+        return false;
+    }
+    while (count-- > 0)
+    {
+        uint8_t mask = (uint8_t)(0x80u >> (bits->pos & 7u));
+
+        if (value & (1ul << count))
+        {
+            bits->data[bits->pos >> 3] |= mask;
+        }
+        else
+        {
+            bits->data[bits->pos >> 3] &= (uint8_t)~mask;
+        }
+        bits->pos++;
+    }
+    return true;
+}
+
+static bool wave_get_bits(WaveBits_t *bits, uint8_t count, uint32_t *value)
+{
+    if ((bits->pos + count) > ((uint32_t)bits->length * 8u))
+    {
+        return false;
+    }
+    *value = 0;
+    while (count-- > 0)
+    {
+        *value = (*value << 1) | ((bits->data[bits->pos >> 3] >> (7u - (bits->pos & 7u))) & 1u);
+        bits->pos++;
+    }
+    return true;
+}
+
+static uint16_t wave_zigzag(uint16_t sample, uint16_t previous)
+{
+    int16_t delta = (int16_t)(uint16_t)(sample - previous);
+
+    return (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+}
+
+/* Bits of a block of zigzag differences coded with the Rice parameter k */
+static uint32_t wave_rice_cost(const uint16_t *values, uint8_t count, uint8_t k)
+{
+    uint32_t cost = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint16_t quotient = values[i] >> k;
+
+        cost += (quotient < WAVE_CAPTURE_RICE_ESCAPE) ? (quotient + 1u + k) : (WAVE_CAPTURE_RICE_ESCAPE + 16u);
+    }
+    return cost;
+}
+
+static bool wave_rice_encode(WaveBits_t *bits, const uint16_t *samples, uint8_t channels, uint8_t frames)
+{
+    uint16_t values[WAVE_CAPTURE_RICE_BLOCK];
+
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        const uint16_t *sample = &samples[channel];
+
+        if (!wave_put_bits(bits, sample[0], 16))
+        {
+            return false;
+        }
+        for (uint8_t frame = 1; frame < frames; frame += WAVE_CAPTURE_RICE_BLOCK)
+        {
+            uint8_t count = ((uint8_t)(frames - frame) < WAVE_CAPTURE_RICE_BLOCK) ? (uint8_t)(frames - frame) :
+                            WAVE_CAPTURE_RICE_BLOCK;
+            uint8_t bestK = 0;
+            uint32_t bestCost = UINT32_MAX;
+
+            for (uint8_t i = 0; i < count; i++)
+            {
+                values[i] = wave_zigzag(sample[(frame + i) * channels], sample[(frame + i - 1u) * channels]);
+            }
+            for (uint8_t k = 0; k < 16u; k++)
+            {
+                uint32_t cost = wave_rice_cost(values, count, k);
+
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestK = k;
+                }
+            }
+
+            if (!wave_put_bits(bits, bestK, 4))
+            {
+                return false;
+            }
+            for (uint8_t i = 0; i < count; i++)
+            {
+                uint16_t quotient = values[i] >> bestK;
+                bool written;
+
+                if (quotient < WAVE_CAPTURE_RICE_ESCAPE)
+                {
+                    written = wave_put_bits(bits, (1ul << (quotient + 1u)) - 2u, (uint8_t)(quotient + 1u)) &&
+                              wave_put_bits(bits, values[i] & ((1u << bestK) - 1u), bestK);
+                }
+                else
+                {
+                    written = wave_put_bits(bits, (1ul << WAVE_CAPTURE_RICE_ESCAPE) - 1u, WAVE_CAPTURE_RICE_ESCAPE) &&
+                              wave_put_bits(bits, values[i], 16);
+                }
+                if (!written)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool wave_rice_decode(WaveBits_t *bits, uint16_t *samples, uint8_t channels, uint8_t frames)
+{
+    uint32_t value;
+
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        uint16_t *sample = &samples[channel];
+
+        if (!wave_get_bits(bits, 16, &value))
+        {
+            return false;
+        }
+        sample[0] = (uint16_t)value;
+        for (uint8_t frame = 1; frame < frames; frame += WAVE_CAPTURE_RICE_BLOCK)
+        {
+            uint8_t count = ((uint8_t)(frames - frame) < WAVE_CAPTURE_RICE_BLOCK) ? (uint8_t)(frames - frame) :
+                            WAVE_CAPTURE_RICE_BLOCK;
+            uint32_t k;
+
+            if (!wave_get_bits(bits, 4, &k))
+            {
+                return false;
+            }
+            for (uint8_t i = 0; i < count; i++)
+            {
+                uint16_t quotient = 0;
+                uint16_t zigzag;
+                uint32_t bit = 1;
+
+                while ((quotient < WAVE_CAPTURE_RICE_ESCAPE) && wave_get_bits(bits, 1, &bit) && bit)
+                {
+                    quotient++;
+                }
+                if (quotient == WAVE_CAPTURE_RICE_ESCAPE)
+                {
+                    if (!wave_get_bits(bits, 16, &value))
+                    {
+                        return false;
+                    }
+                    zigzag = (uint16_t)value;
+                }
+                else
+                {
+                    if (bit || !wave_get_bits(bits, (uint8_t)k, &value))
+                    {
+                        /* Out of data inside the unary code */
+                        return false;
+                    }
+                    zigzag = (uint16_t)((quotient << k) | value);
+                }
+                sample[(frame + i) * channels] = (uint16_t)(sample[(frame + i - 1u) * channels] +
+                                                            (uint16_t)((zigzag >> 1) ^ (uint16_t)-(zigzag & 1u)));
+            }
+        }
+    }
+    return true;
+}
+
+static uint16_t *wave_frame(uint8_t index)
+{
+    return &waveSamples[(uint16_t)index * waveInfo.channels];
+}
+
+/* Rotates frames [0, count) so that frame first comes first */
+static void wave_rotate(uint8_t first, uint8_t count)
+{
+    uint16_t frame[WAVE_CAPTURE_CHANNELS];
+    size_t frameSize = waveInfo.channels * sizeof(waveSamples[0]);
+
+    for (uint8_t step = 0; step < first; step++)
+    {
+        memcpy(frame, wave_frame(0), frameSize);
+        memmove(wave_frame(0), wave_frame(1), (count - 1u) * frameSize);
+        memcpy(wave_frame((uint8_t)(count - 1u)), frame, frameSize);
+    }
+}
+
+/*********************************************************************//**
+\brief      Initializes the capture, the pre-trigger ring is empty
+\param[in]  postPeriodMs - period of the frames after a trigger
+\param[in]  channels     - samples per frame, 0 disables the captures
+*************************************************************************/
+void WAVE_CAPTURE_Init(uint16_t postPeriodMs, uint8_t channels)
+{
+    waveState = WAVE_CAPTURE_IDLE;
+    waveHead = 0;
+    waveFilled = 0;
+    memset(&waveInfo, 0, sizeof(waveInfo));
+    waveInfo.channels = (channels > WAVE_CAPTURE_CHANNELS) ? WAVE_CAPTURE_CHANNELS : channels;
+    waveInfo.postPeriodMs = postPeriodMs;
+    waveLength = 0;
+    memset(&waveStats, 0, sizeof(waveStats));
+}
+
+/*********************************************************************//**
+\brief      Adds a frame to the pre-trigger ring, or after a trigger to
+            the capture, which is compressed once complete
+\param[in]  frame    - one sample per channel
+\param[in]  periodMs - time since the previous frame before a trigger
+*************************************************************************/
+void WAVE_CAPTURE_Add(const uint16_t *frame, uint32_t periodMs)
+{
+    size_t frameSize = waveInfo.channels * sizeof(waveSamples[0]);
+
+    if (WAVE_CAPTURE_POST != waveState)
+    {
+        memcpy(wave_frame(waveHead), frame, frameSize);
+        waveHead = (uint8_t)((waveHead + 1u) % WAVE_CAPTURE_PRE_FRAMES);
+        if (waveFilled < WAVE_CAPTURE_PRE_FRAMES)
+        {
+            waveFilled++;
+        }
+        waveInfo.prePeriodMs = periodMs;
+        return;
+    }
+
+    memcpy(wave_frame((uint8_t)(waveInfo.preFrames + waveInfo.postFrames)), frame, frameSize);
+    waveInfo.postFrames++;
+    if (waveInfo.postFrames < WAVE_CAPTURE_POST_FRAMES)
+    {
+        return;
+    }
+
+    waveLength = WAVE_CAPTURE_Encode(&waveInfo, waveSamples, waveCapture, sizeof(waveCapture));
+    waveStats.rawLength = (uint16_t)(WAVE_CAPTURE_HEADER_LENGTH +
+                                     (waveInfo.preFrames + waveInfo.postFrames) * waveInfo.channels * 2u);
+    waveStats.length = waveLength;
+    waveStats.captures++;
+    waveId++;
+    waveFragment = 0;
+    waveFragmentCount = (uint8_t)((waveLength + WAVE_CAPTURE_FRAGMENT_DATA - 1u) / WAVE_CAPTURE_FRAGMENT_DATA);
+    waveState = (waveFragmentCount > 0) ? WAVE_CAPTURE_UPLOAD : WAVE_CAPTURE_IDLE;
+    /* The ring starts over for the next trigger */
+    waveHead = 0;
+    waveFilled = 0;
+}
+
+/*********************************************************************//**
+\brief      Freezes the pre-trigger frames and starts the post-trigger part
+\return     false if the previous capture is not uploaded yet or the
+            captures are disabled
+*************************************************************************/
+bool WAVE_CAPTURE_Trigger(void)
+{
+    if (0 == waveInfo.channels)
+    {
+        return false;
+    }
+    if (WAVE_CAPTURE_IDLE != waveState)
+    {
+        waveStats.missed++;
+        return false;
+    }
+    /* Oldest frame first */
+    if (WAVE_CAPTURE_PRE_FRAMES == waveFilled)
+    {
+        wave_rotate(waveHead, WAVE_CAPTURE_PRE_FRAMES);
+    }
+    waveInfo.preFrames = waveFilled;
+    waveInfo.postFrames = 0;
+    waveState = WAVE_CAPTURE_POST;
+    return true;
+}
+
+/*********************************************************************//**
+\brief      Drops a capture whose post-trigger frames could not be taken,
+            counted as missed
+*************************************************************************/
+void WAVE_CAPTURE_Abort(void)
+{
+    if (WAVE_CAPTURE_POST != waveState)
+    {
+        return;
+    }
+    waveStats.missed++;
+    waveState = WAVE_CAPTURE_IDLE;
+    waveHead = 0;
+    waveFilled = 0;
+}
+
+/*********************************************************************//**
+\brief      Returns true while post-trigger frames are expected
+*************************************************************************/
+bool WAVE_CAPTURE_Capturing(void)
+{
+    return WAVE_CAPTURE_POST == waveState;
+}
+
+/*********************************************************************//**
+\brief      Returns true while fragments of a capture are to be sent
+*************************************************************************/
+bool WAVE_CAPTURE_UploadPending(void)
+{
+    return WAVE_CAPTURE_UPLOAD == waveState;
+}
+
+/*********************************************************************//**
+\brief      Copies the next fragment without consuming it
+\param[out] buffer    - destination of the fragment
+\param[in]  maxLength - room in buffer
+\return     Number of bytes written, 0 if nothing is pending or it does
+            not fit
+*************************************************************************/
+uint8_t WAVE_CAPTURE_PeekFragment(uint8_t *buffer, uint8_t maxLength)
+{
+    uint16_t offset = (uint16_t)waveFragment * WAVE_CAPTURE_FRAGMENT_DATA;
+    uint8_t length;
+
+    if ((WAVE_CAPTURE_UPLOAD != waveState) || (maxLength < WAVE_CAPTURE_FRAGMENT_LENGTH))
+    {
+        return 0;
+    }
+    length = ((uint16_t)(waveLength - offset) < WAVE_CAPTURE_FRAGMENT_DATA) ? (uint8_t)(waveLength - offset) :
+             WAVE_CAPTURE_FRAGMENT_DATA;
+    buffer[0] = waveId;
+    buffer[1] = waveFragment;
+    buffer[2] = waveFragmentCount;
+    memcpy(&buffer[WAVE_CAPTURE_FRAGMENT_HEADER], &waveCapture[offset], length);
+    return (uint8_t)(WAVE_CAPTURE_FRAGMENT_HEADER + length);
+}
+
+/*********************************************************************//**
+\brief      Moves to the next fragment once an uplink carrying one was
+            accepted, the capture is released after the last one
+*************************************************************************/
+void WAVE_CAPTURE_FragmentSent(void)
+{
+    if (WAVE_CAPTURE_UPLOAD != waveState)
+    {
+        return;
+    }
+    waveStats.fragments++;
+    if (++waveFragment >= waveFragmentCount)
+    {
+        waveState = WAVE_CAPTURE_IDLE;
+    }
+}
+
+/*********************************************************************//**
+\brief      Compresses a capture, Rice coded or raw whichever is shorter
+\param[in]  info      - capture layout, the format is chosen here
+\param[in]  samples   - frames oldest first, info->channels samples each
+\param[out] out       - capture
+\param[in]  maxLength - room in out
+\return     Length of the capture, 0 if it does not fit
+*************************************************************************/
+uint16_t WAVE_CAPTURE_Encode(const WaveCaptureInfo_t *info, const uint16_t *samples, uint8_t *out,
+                             uint16_t maxLength)
+{
+    uint16_t frames = (uint16_t)info->preFrames + info->postFrames;
+    uint16_t rawLength = (uint16_t)(WAVE_CAPTURE_HEADER_LENGTH + frames * info->channels * 2u);
+    WaveBits_t bits;
+
+    if ((maxLength < WAVE_CAPTURE_HEADER_LENGTH) || (frames > UINT8_MAX))
+    {
+        return 0;
+    }
+    out[1] = info->channels;
+    out[2] = info->preFrames;
+    out[3] = info->postFrames;
+    out[4] = (uint8_t)info->prePeriodMs;
+    out[5] = (uint8_t)(info->prePeriodMs >> 8);
+    out[6] = (uint8_t)(info->prePeriodMs >> 16);
+    out[7] = (uint8_t)(info->prePeriodMs >> 24);
+    out[8] = (uint8_t)info->postPeriodMs;
+    out[9] = (uint8_t)(info->postPeriodMs >> 8);
+
+    bits.data = &out[WAVE_CAPTURE_HEADER_LENGTH];
+    bits.length = (uint16_t)(((rawLength < maxLength) ? rawLength : maxLength) - WAVE_CAPTURE_HEADER_LENGTH);
+    bits.pos = 0;
+    if ((frames > 0) && wave_rice_encode(&bits, samples, info->channels, (uint8_t)frames) &&
+        (((bits.pos + 7u) / 8u) < (uint32_t)(rawLength - WAVE_CAPTURE_HEADER_LENGTH)))
+    {
+        out[0] = WAVE_CAPTURE_FORMAT_RICE;
+        return (uint16_t)(WAVE_CAPTURE_HEADER_LENGTH + ((bits.pos + 7u) / 8u));
+    }
+
+    if (rawLength > maxLength)
+    {
+        return 0;
+    }
+    out[0] = WAVE_CAPTURE_FORMAT_RAW;
+    for (uint16_t i = 0; i < (frames * info->channels); i++)
+    {
+        out[WAVE_CAPTURE_HEADER_LENGTH + (2u * i)] = (uint8_t)samples[i];
+        out[WAVE_CAPTURE_HEADER_LENGTH + (2u * i) + 1u] = (uint8_t)(samples[i] >> 8);
+    }
+    return rawLength;
+}
+
+/*********************************************************************//**
+\brief      Rebuilds the samples of a capture, for the backend
+\param[in]  data       - capture, the fragments data in index order
+\param[in]  length     - number of bytes in data
+\param[out] info       - capture layout
+\param[out] samples    - frames oldest first
+\param[in]  maxSamples - room in samples
+\return     false if the capture is truncated or does not fit
+*************************************************************************/
+bool WAVE_CAPTURE_Decode(const uint8_t *data, uint16_t length, WaveCaptureInfo_t *info, uint16_t *samples,
+                         uint16_t maxSamples)
+{
+    uint16_t count;
+    WaveBits_t bits;
+
+    if (length < WAVE_CAPTURE_HEADER_LENGTH)
+    {
+        return false;
+    }
+    info->format = data[0];
+    info->channels = data[1];
+    info->preFrames = data[2];
+    info->postFrames = data[3];
+    info->prePeriodMs = (uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) |
+                        ((uint32_t)data[7] << 24);
+    info->postPeriodMs = (uint16_t)(data[8] | ((uint16_t)data[9] << 8));
+    count = (uint16_t)((info->preFrames + info->postFrames) * info->channels);
+    if ((count > maxSamples) || ((info->preFrames + info->postFrames) > UINT8_MAX))
+    {
+        return false;
+    }
+
+    if (WAVE_CAPTURE_FORMAT_RAW == info->format)
+    {
+        if (length < (WAVE_CAPTURE_HEADER_LENGTH + (2u * count)))
+        {
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++)
+        {
+            samples[i] = (uint16_t)(data[WAVE_CAPTURE_HEADER_LENGTH + (2u * i)] |
+                                    ((uint16_t)data[WAVE_CAPTURE_HEADER_LENGTH + (2u * i) + 1u] << 8));
+        }
+        return true;
+    }
+    if ((WAVE_CAPTURE_FORMAT_RICE != info->format) || (0 == count))
+    {
+        return false;
+    }
+    bits.data = (uint8_t *)&data[WAVE_CAPTURE_HEADER_LENGTH];
+    bits.length = (uint16_t)(length - WAVE_CAPTURE_HEADER_LENGTH);
+    bits.pos = 0;
+    return wave_rice_decode(&bits, samples, info->channels, (uint8_t)(info->preFrames + info->postFrames));
+}
+
+/*********************************************************************//**
+\brief      Returns the capture counters and the last compression
+*************************************************************************/
+const WaveCaptureStats_t *WAVE_CAPTURE_GetStats(void)
+{
+    return &waveStats;
+}
@@ -0,0 +1,98 @@
+/**
+* \file  wave_capture.h
+*
+* \brief Waveform around an alarm, compressed and uploaded in fragments
+*
+* Every scan of the accelerometer axes goes into a ring of the last
+* WAVE_CAPTURE_PRE_FRAMES frames, one sample per fitted axis, at most
+* WAVE_CAPTURE_CHANNELS. A trigger freezes the ring and the next
+* WAVE_CAPTURE_POST_FRAMES frames complete the capture, which is then
+* compressed and uploaded one fragment per uplink. The capture waits in
+* RAM across sleep periods until its last fragment is sent.
+*
+* Capture, little endian:
+*   [format] [channels] [pre frames] [post frames] [pre period ms, u32]
+*   [post period ms, u16] [data]
+* The samples are coded channel after channel, oldest frame first. In the
+* Rice format a channel starts with its first sample on 16 bits, followed
+* by the differences to the previous sample in blocks of
+* WAVE_CAPTURE_RICE_BLOCK: a 4-bit Rice parameter k, then per difference
+* zigzag(d) >> k in unary (ones closed by a zero) and its k low bits. A
+* quotient of WAVE_CAPTURE_RICE_ESCAPE ones is followed by zigzag(d) on 16
+* bits instead. Bits are packed MSB first. The raw format, used when the
+* Rice code is not shorter, holds the samples as u16.
+*
+* Fragment: [capture id] [index] [count] [up to
+* WAVE_CAPTURE_FRAGMENT_DATA bytes of the capture]
+*
+* The module does not touch the hardware and also builds on a host, where
+* WAVE_CAPTURE_Decode() rebuilds the samples of a reassembled capture.
+*/
+
+#ifndef WAVE_CAPTURE_H_
+#define WAVE_CAPTURE_H_
+
+/****************************** INCLUDES **************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************************** MACROS **************************************/
+/* Most channels of a frame */
+#define WAVE_CAPTURE_CHANNELS               3u
+#define WAVE_CAPTURE_PRE_FRAMES             32u
+#define WAVE_CAPTURE_POST_FRAMES            32u
+#define WAVE_CAPTURE_FRAMES                 (WAVE_CAPTURE_PRE_FRAMES + WAVE_CAPTURE_POST_FRAMES)
+
+#define WAVE_CAPTURE_FORMAT_RAW             0u
+#define WAVE_CAPTURE_FORMAT_RICE            1u
+#define WAVE_CAPTURE_HEADER_LENGTH          10u
+#define WAVE_CAPTURE_RICE_BLOCK             16u
+#define WAVE_CAPTURE_RICE_ESCAPE            15u
+/* Longest capture, the raw format */
+#define WAVE_CAPTURE_MAX_LENGTH             (WAVE_CAPTURE_HEADER_LENGTH + \
+                                             (WAVE_CAPTURE_FRAMES * WAVE_CAPTURE_CHANNELS * 2u))
+
+#define WAVE_CAPTURE_FRAGMENT_HEADER        3u
+/* Fits the smallest payload of the application after the epoch and the MIC */
+#define WAVE_CAPTURE_FRAGMENT_LENGTH        32u
+#define WAVE_CAPTURE_FRAGMENT_DATA          (WAVE_CAPTURE_FRAGMENT_LENGTH - WAVE_CAPTURE_FRAGMENT_HEADER)
+
+/****************************** TYPES **************************************/
+typedef struct _WaveCaptureInfo_t
+{
+    uint8_t format;
+    uint8_t channels;
+    uint8_t preFrames;
+    uint8_t postFrames;
+    /* Period of the frames before and after the trigger */
+    uint32_t prePeriodMs;
+    uint16_t postPeriodMs;
+} WaveCaptureInfo_t;
+
+typedef struct _WaveCaptureStats_t
+{
+    uint16_t captures;
+    /* Triggers while a capture was being taken or uploaded */
+    uint16_t missed;
+    uint16_t fragments;
+    /* Last capture */
+    uint16_t rawLength;
+    uint16_t length;
+} WaveCaptureStats_t;
+
+/****************************** PROTOTYPES **************************************/
+void WAVE_CAPTURE_Init(uint16_t postPeriodMs, uint8_t channels);
+void WAVE_CAPTURE_Add(const uint16_t *frame, uint32_t periodMs);
+bool WAVE_CAPTURE_Trigger(void);
+void WAVE_CAPTURE_Abort(void);
+bool WAVE_CAPTURE_Capturing(void);
+bool WAVE_CAPTURE_UploadPending(void);
+uint8_t WAVE_CAPTURE_PeekFragment(uint8_t *buffer, uint8_t maxLength);
+void WAVE_CAPTURE_FragmentSent(void);
+uint16_t WAVE_CAPTURE_Encode(const WaveCaptureInfo_t *info, const uint16_t *samples, uint8_t *out,
+                             uint16_t maxLength);
+bool WAVE_CAPTURE_Decode(const uint8_t *data, uint16_t length, WaveCaptureInfo_t *info, uint16_t *samples,
+                         uint16_t maxSamples);
+const WaveCaptureStats_t *WAVE_CAPTURE_GetStats(void);
+
+#endif /* WAVE_CAPTURE_H_ */